@@ -43,11 +43,35 @@ extern char **environ;
 #    define strlcpy(dst,src,dstsize) _pappl_strlcpy(dst,src,dstsize)
 #  endif // !HAVE_STRLCPY
 
+#  ifdef DEBUG_LOCKS
+#    define _papplMutexLock(mutex,rank) (_papplLockAcquire(rank, __FILE__, __LINE__), pthread_mutex_lock(mutex))
+#    define _papplMutexUnlock(mutex,rank) (pthread_mutex_unlock(mutex), _papplLockRelease(rank, __FILE__, __LINE__))
+#    define _papplRWLockRead(rwlock,rank) (_papplLockAcquire(rank, __FILE__, __LINE__), pthread_rwlock_rdlock(rwlock))
+#    define _papplRWLockWrite(rwlock,rank) (_papplLockAcquire(rank, __FILE__, __LINE__), pthread_rwlock_wrlock(rwlock))
+#    define _papplRWUnlock(rwlock,rank) (pthread_rwlock_unlock(rwlock), _papplLockRelease(rank, __FILE__, __LINE__))
+#  else
+#    define _papplMutexLock(mutex,rank) pthread_mutex_lock(mutex)
+#    define _papplMutexUnlock(mutex,rank) pthread_mutex_unlock(mutex)
+#    define _papplRWLockRead(rwlock,rank) pthread_rwlock_rdlock(rwlock)
+#    define _papplRWLockWrite(rwlock,rank) pthread_rwlock_wrlock(rwlock)
+#    define _papplRWUnlock(rwlock,rank) pthread_rwlock_unlock(rwlock)
+#  endif // DEBUG_LOCKS
+
 
 //
 // Types and structures...
 //
 
+typedef enum _pappl_lock_e		// Lock ranks, in acquisition order
+{
+  _PAPPL_LOCK_SYSTEM,			// System (system->rwlock)
+  _PAPPL_LOCK_PRINTER,			// Printer configuration (printer->rwlock)
+  _PAPPL_LOCK_PRINTER_DEVICE,		// Printer device (printer->device_mutex)
+  _PAPPL_LOCK_PRINTER_JOBS,		// Printer job queue (printer->jobs_rwlock)
+  _PAPPL_LOCK_JOB,			// Job (job->rwlock)
+  _PAPPL_LOCK_MAX			// Number of lock ranks
+} _pappl_lock_t;
+
 typedef struct _pappl_ipp_filter_s	// Attribute filter
 {
   cups_array_t		*ra;			// Requested attributes
@@ -73,6 +97,11 @@ extern ipp_t		*_papplContactExport(pappl_contact_t *contact) _PAPPL_PRIVATE;
 extern void		_papplContactImport(ipp_t *col, pappl_contact_t *contact) _PAPPL_PRIVATE;
 extern void		_papplCopyAttributes(ipp_t *to, ipp_t *from, cups_array_t *ra, ipp_tag_t group_tag, int quickcopy) _PAPPL_PRIVATE;
 extern unsigned		_papplGetRand(void) _PAPPL_PRIVATE;
+extern double		_papplGetTime(void) _PAPPL_PRIVATE;
+#  ifdef DEBUG_LOCKS
+extern void		_papplLockAcquire(_pappl_lock_t rank, const char *file, int line) _PAPPL_PRIVATE;
+extern void		_papplLockRelease(_pappl_lock_t rank, const char *file, int line) _PAPPL_PRIVATE;
+#  endif // DEBUG_LOCKS
 extern const char	*_papplLookupString(unsigned bit, size_t num_strings, const char * const *strings) _PAPPL_PRIVATE;
 extern unsigned		_papplLookupValue(const char *keyword, size_t num_strings, const char * const *strings) _PAPPL_PRIVATE;
 
@@ -104,7 +104,13 @@ http_t *				// O - HTTP connection
 papplClientGetHTTP(
     pappl_client_t *client)		// I - Client
 {
-  return (client ? client->http : NULL);
+  if (!client)
+    return (NULL);
+
+  // Send any buffered HTML before the caller writes to the connection...
+  _papplClientFlushHTML(client);
+
+  return (client->http);
 }
 
 
@@ -23,6 +23,14 @@
 #endif // HAVE_LIBPAM
 
 
+//
+// Local constants...
+//
+
+#define _PAPPL_AUTH_TTL		300	// Lifetime of accepted credentials in seconds
+#define _PAPPL_AUTH_FAILED_TTL	30	// Lifetime of rejected credentials in seconds
+
+
 //
 // Types...
 //
@@ -38,12 +46,101 @@ typedef struct _pappl_authdata_s	// PAM authentication data
 // Local functions...
 //
 
+static void	auth_cache_add(pappl_system_t *system, const char *username, const char *password, bool valid, gid_t *groups, int num_groups);
+static int	auth_cache_find(pappl_system_t *system, const char *username, const char *password, gid_t *groups, int *num_groups);
+static void	auth_cache_hash(const unsigned char *salt, const char *password, unsigned char *hash);
 static int	pappl_authenticate_user(pappl_client_t *client, const char *username, const char *password);
 #ifdef HAVE_LIBPAM
 static int	pappl_pam_func(int num_msg, const struct pam_message **msg, struct pam_response **resp, _pappl_authdata_t *data);
 #endif // HAVE_LIBPAM
 
 
+//
+// '_papplSystemAuthenticate()' - Authenticate a username and password.
+//
+// A cached result is used when the same username and password were checked
+// recently.  Otherwise the authentication callback, if any, or PAM checks the
+// username and password and the result is cached.  The client is only used for
+// PAM and logging, so it can be `NULL` when an authentication callback is set.
+//
+
+int					// O  - 1 if accepted, 0 if rejected, -1 on error
+_papplSystemAuthenticate(
+    pappl_system_t *system,		// I  - System
+    pappl_client_t *client,		// I  - Client or `NULL`
+    const char     *username,		// I  - Username
+    const char     *password,		// I  - Password
+    gid_t          *groups,		// O  - Groups for user
+    int            *num_groups)		// IO - Number of groups
+{
+  int			status;		// Authentication status
+  struct passwd		*user;		// User information
+  _pappl_auth_cb_t	auth_cb;	// Authentication callback
+  void			*auth_cbdata;	// Authentication callback data
+
+
+  if ((status = auth_cache_find(system, username, password, groups, num_groups)) >= 0)
+  {
+    papplLogClient(client, PAPPL_LOGLEVEL_DEBUG, "Using cached authentication result for '%s'.", username);
+    return (status);
+  }
+
+  pthread_mutex_lock(&system->auth_mutex);
+  auth_cb     = system->auth_cb;
+  auth_cbdata = system->auth_cbdata;
+  pthread_mutex_unlock(&system->auth_mutex);
+
+  if (auth_cb)
+  {
+    status = (auth_cb)(system, username, password, groups, num_groups, auth_cbdata) ? 1 : 0;
+  }
+  else if ((status = pappl_authenticate_user(client, username, password)) != 0)
+  {
+    // Get the user information (groups, etc.)
+    if ((user = getpwnam(username)) == NULL)
+    {
+      papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to lookup user '%s'.", username);
+      return (-1);
+    }
+
+#ifdef __APPLE__
+    if (getgrouplist(username, (int)user->pw_gid, (int *)groups, num_groups))
+#else
+    if (getgrouplist(username, user->pw_gid, groups, num_groups))
+#endif // __APPLE__
+    {
+      papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to lookup groups for user '%s': %s", username, strerror(errno));
+      groups[0]   = user->pw_gid;
+      *num_groups = 1;
+    }
+  }
+
+  if (!status)
+    *num_groups = 0;
+
+  auth_cache_add(system, username, password, status != 0, groups, *num_groups);
+
+  return (status);
+}
+
+
+//
+// '_papplSystemClearAuthCache()' - Clear the authentication cache.
+//
+// This function is called when the admin or print groups change so that the
+// new group settings are used for the next request.
+//
+
+void
+_papplSystemClearAuthCache(
+    pappl_system_t *system)		// I - System
+{
+  pthread_mutex_lock(&system->auth_mutex);
+  memset(system->auth_cache, 0, sizeof(system->auth_cache));
+  pthread_mutex_unlock(&system->auth_mutex);
+}
+
+
 //
 // 'papplClientIsAuthorized()' - Determine whether a client is authorized for
 //                               administrative requests.
@@ -61,6 +158,26 @@ static int	pappl_pam_func(int num_msg, const struct pam_message **msg, struct pa
 http_status_t				// O - HTTP status
 papplClientIsAuthorized(
     pappl_client_t *client)		// I - Client
+{
+  return (_papplClientIsAuthorizedForGroup(client, false, client->system->admin_gid));
+}
+
+
+//
+// '_papplClientIsAuthorizedForGroup()' - Determine whether a client is
+//                                        authorized for a group.
+//
+// This function does the work for @link papplClientIsAuthorized@ using the
+// specified group, or any authenticated user if the group is `(gid_t)-1`.
+// When "allow_remote" is `true` and no PAM authentication service is
+// configured, remote access is allowed instead of forbidden.
+//
+
+http_status_t				// O - HTTP status
+_papplClientIsAuthorizedForGroup(
+    pappl_client_t *client,		// I - Client
+    bool           allow_remote,	// I - Allow remote access without authentication?
+    gid_t          group)		// I - Authorized group or `(gid_t)-1` for any
 {
   const char		*authorization;	// Authorization: header value
 
@@ -74,9 +191,9 @@ papplClientIsAuthorized(
 
   // Remote access is only allowed if a PAM authentication service is configured...
   if (!client->system->auth_service)
-    return (HTTP_STATUS_FORBIDDEN);
+    return (allow_remote ? HTTP_STATUS_CONTINUE : HTTP_STATUS_FORBIDDEN);
 
-  // Remote admin access requires encryption...
+  // Remote authenticated access requires encryption...
   if (!httpIsEncrypted(client->http) && !httpAddrLocalhost(httpGetAddress(client->http)))
     return (HTTP_STATUS_UPGRADE_REQUIRED);
 
@@ -90,8 +207,9 @@ papplClientIsAuthorized(
 		*password;		// Password value
       int	userlen = sizeof(username);
 					// Length of username:password
-      struct passwd *user;		// User information
-      int	num_groups;		// Number of autbenticated groups, if any
+      int	status;			// Authentication status
+      int	i,			// Looping var
+		num_groups;		// Number of autbenticated groups, if any
 #  ifdef __APPLE__
       int	groups[32];		// Authenticated groups, if any
 #  else
@@ -102,71 +220,47 @@ papplClientIsAuthorized(
       for (authorization += 6; *authorization && isspace(*authorization & 255); authorization ++);
 
       httpDecode64_2(username, &userlen, authorization);
-      if ((password = strchr(username, ':')) != NULL)
+      if ((password = strchr(username, ':')) == NULL)
       {
-	*password++ = '\0';
+	papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Bad Basic Authorization header value seen.");
+	return (HTTP_STATUS_BAD_REQUEST);
+      }
 
-        // Authenticate the username and password...
-	if (pappl_authenticate_user(client, username, password))
-	{
-	  // Get the user information (groups, etc.)
-	  if ((user = getpwnam(username)) != NULL)
-	  {
-	    papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Authenticated as \"%s\" using Basic.", username);
-	    strlcpy(client->username, username, sizeof(client->username));
+      *password++ = '\0';
 
-	    num_groups = (int)(sizeof(groups) / sizeof(groups[0]));
+      // Use a cached result or authenticate the username and password...
+      num_groups = (int)(sizeof(groups) / sizeof(groups[0]));
 
-#ifdef __APPLE__
-	    if (getgrouplist(username, (int)user->pw_gid, groups, &num_groups))
-#else
-	    if (getgrouplist(username, user->pw_gid, groups, &num_groups))
-#endif // __APPLE__
-	    {
-	      papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to lookup groups for user '%s': %s", username, strerror(errno));
-	      num_groups = 0;
-	    }
-
-            // Check group membership...
-            if (client->system->admin_gid != (gid_t)-1)
-            {
-              if (user->pw_gid != client->system->admin_gid)
-              {
-                int i;			// Looping var
-
-                for (i = 0; i < num_groups; i ++)
-		{
-		  if ((gid_t)groups[i] == client->system->admin_gid)
-		    break;
-		}
-
-                if (i >= num_groups)
-                {
-                  // Not in the admin group, access is forbidden...
-                  return (HTTP_STATUS_FORBIDDEN);
-		}
-              }
-            }
-
-            // If we get this far, authentication and authorization are good...
-            return (HTTP_STATUS_CONTINUE);
-	  }
-	  else
-	  {
-	    papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to lookup user '%s'.", username);
-	    return (HTTP_STATUS_SERVER_ERROR);
-	  }
+      if ((status = _papplSystemAuthenticate(client->system, client, username, password, (gid_t *)groups, &num_groups)) < 0)
+        return (HTTP_STATUS_SERVER_ERROR);
+
+      if (!status)
+      {
+	papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Basic authentication of '%s' failed.", username);
+	return (HTTP_STATUS_UNAUTHORIZED);
+      }
+
+      papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Authenticated as \"%s\" using Basic.", username);
+      strlcpy(client->username, username, sizeof(client->username));
+
+      // Check group membership...
+      if (group != (gid_t)-1)
+      {
+	for (i = 0; i < num_groups; i ++)
+	{
+	  if ((gid_t)groups[i] == group)
+	    break;
 	}
-	else
+
+	if (i >= num_groups)
 	{
-	  papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Basic authentication of '%s' failed.", username);
+	  // Not in the group, access is forbidden...
+	  return (HTTP_STATUS_FORBIDDEN);
 	}
       }
-      else
-      {
-	papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Bad Basic Authorization header value seen.");
-	return (HTTP_STATUS_BAD_REQUEST);
-      }
+
+      // If we get this far, authentication and authorization are good...
+      return (HTTP_STATUS_CONTINUE);
     }
     else
     {
@@ -180,6 +274,170 @@ papplClientIsAuthorized(
 }
 
 
+//
+// '_papplSystemSetAuthCallback()' - Set the authentication callback.
+//
+// The callback replaces PAM for checking usernames and passwords, which allows
+// the authentication cache to be tested without a PAM service.  It returns
+// `true` if the username and password are accepted and provides the user's
+// groups.  The authentication cache is cleared.
+//
+
+void
+_papplSystemSetAuthCallback(
+    pappl_system_t   *system,		// I - System
+    _pappl_auth_cb_t cb,		// I - Authentication callback or `NULL` to use PAM
+    void             *data)		// I - Callback data
+{
+  pthread_mutex_lock(&system->auth_mutex);
+
+  system->auth_cb     = cb;
+  system->auth_cbdata = data;
+
+  memset(system->auth_cache, 0, sizeof(system->auth_cache));
+
+  pthread_mutex_unlock(&system->auth_mutex);
+}
+
+
+//
+// 'auth_cache_add()' - Add an authentication result to the cache.
+//
+// The password is stored as a salted SHA2-256 hash.  When the cache is full,
+// the entry that expires first is replaced.
+//
+
+static void
+auth_cache_add(
+    pappl_system_t *system,		// I - System
+    const char     *username,		// I - Username
+    const char     *password,		// I - Password
+    bool           valid,		// I - Were the username and password accepted?
+    gid_t          *groups,		// I - Groups for user
+    int            num_groups)		// I - Number of groups
+{
+  int			i;		// Looping var
+  unsigned		rnd;		// Random number for salt
+  _pappl_authcache_t	*entry,		// Current entry
+			*oldest;	// Entry to replace
+  time_t		curtime = time(NULL);
+					// Current time
+
+
+  if (num_groups > (int)(sizeof(entry->groups) / sizeof(entry->groups[0])))
+    num_groups = (int)(sizeof(entry->groups) / sizeof(entry->groups[0]));
+
+  pthread_mutex_lock(&system->auth_mutex);
+
+  for (i = _PAPPL_MAX_AUTHCACHE, entry = system->auth_cache, oldest = entry; i > 0; i --, entry ++)
+  {
+    if (entry->expire <= curtime)
+    {
+      oldest = entry;
+      break;
+    }
+    else if (entry->expire < oldest->expire)
+      oldest = entry;
+  }
+
+  strlcpy(oldest->username, username, sizeof(oldest->username));
+
+  for (i = 0; i < (int)sizeof(oldest->salt); i += (int)sizeof(rnd))
+  {
+    rnd = _papplGetRand();
+    memcpy(oldest->salt + i, &rnd, sizeof(rnd));
+  }
+
+  auth_cache_hash(oldest->salt, password, oldest->hash);
+
+  oldest->valid      = valid;
+  oldest->num_groups = num_groups;
+  oldest->expire     = curtime + (valid ? _PAPPL_AUTH_TTL : _PAPPL_AUTH_FAILED_TTL);
+
+  memcpy(oldest->groups, groups, (size_t)num_groups * sizeof(gid_t));
+
+  pthread_mutex_unlock(&system->auth_mutex);
+}
+
+
+//
+// 'auth_cache_find()' - Find a cached authentication result.
+//
+
+static int				// O - 1 if accepted, 0 if rejected, -1 if not cached
+auth_cache_find(
+    pappl_system_t *system,		// I - System
+    const char     *username,		// I - Username
+    const char     *password,		// I - Password
+    gid_t          *groups,		// O - Groups for user
+    int            *num_groups)		// IO - Number of groups
+{
+  int			i,		// Looping var
+			j,		// Looping var
+			diff,		// Difference between hashes
+			ret = -1;	// Return value
+  _pappl_authcache_t	*entry;		// Current entry
+  unsigned char		hash[32];	// Hash of password
+  time_t		curtime = time(NULL);
+					// Current time
+
+
+  pthread_mutex_lock(&system->auth_mutex);
+
+  for (i = _PAPPL_MAX_AUTHCACHE, entry = system->auth_cache; i > 0; i --, entry ++)
+  {
+    if (entry->expire <= curtime || strcmp(entry->username, username))
+      continue;
+
+    auth_cache_hash(entry->salt, password, hash);
+
+    for (j = 0, diff = 0; j < (int)sizeof(hash); j ++)
+      diff |= hash[j] ^ entry->hash[j];
+
+    if (diff)
+      continue;
+
+    if (entry->num_groups < *num_groups)
+      *num_groups = entry->num_groups;
+
+    memcpy(groups, entry->groups, (size_t)*num_groups * sizeof(gid_t));
+
+    ret = entry->valid ? 1 : 0;
+    break;
+  }
+
+  pthread_mutex_unlock(&system->auth_mutex);
+
+  return (ret);
+}
+
+
+//
+// 'auth_cache_hash()' - Compute the salted hash of a password.
+//
+
+static void
+auth_cache_hash(
+    const unsigned char *salt,		// I - 16-byte salt
+    const char          *password,	// I - Password
+    unsigned char       *hash)		// O - 32-byte SHA2-256 hash
+{
+  unsigned char	data[528];		// Salt + password
+  size_t	len = strlen(password);	// Length of password
+
+
+  if (len > (sizeof(data) - 16))
+    len = sizeof(data) - 16;
+
+  memcpy(data, salt, 16);
+  memcpy(data + 16, password, len);
+
+  cupsHashData("sha2-256", data, len + 16, hash, 32);
+
+  memset(data, 0, sizeof(data));
+}
+
+
 //
 // 'pappl_authenticate_user()' - Validate a username + password combination.
 //
@@ -15,6 +15,13 @@
 #include "pappl-private.h"
 
 
+//
+// Local functions...
+//
+
+static ipp_t	*new_response(pappl_client_t *client);
+
+
 //
 // '_papplClientFlushDocumentData()' - Safely flush remaining document data.
 //
@@ -70,11 +77,15 @@ _papplClientProcessIPP(
   const char		*name;		// Name of attribute
   bool			printer_op = true;
 					// Printer operation?
+  uint64_t		trace_start;	// Start time for trace
+  bool			ret;		// Return value
 
 
   // First build an empty response message for this request...
+  trace_start = _papplTraceStart(client->system);
+
   client->operation_id = ippGetOperation(client->request);
-  client->response     = ippNewResponse(client->request);
+  client->response     = new_response(client);
 
   // Then validate the request header and required attributes...
   major = ippGetVersion(client->request, &minor);
@@ -235,7 +246,14 @@ _papplClientProcessIPP(
   if (httpGetState(client->http) != HTTP_STATE_POST_SEND)
     _papplClientFlushDocumentData(client);	// Flush trailing (junk) data
 
-  return (papplClientRespond(client, HTTP_STATUS_OK, NULL, "application/ipp", 0, ippLength(client->response)));
+  _papplTraceEnd(client->system, _PAPPL_TSTAGE_IPP_OP, trace_start, client->number, client->printer ? client->printer->printer_id : 0, client->operation_id);
+
+  trace_start = _papplTraceStart(client->system);
+  ret         = papplClientRespond(client, HTTP_STATUS_OK, NULL, "application/ipp", 0, ippLength(client->response));
+
+  _papplTraceEnd(client->system, _PAPPL_TSTAGE_RESPONSE, trace_start, client->number, client->printer ? client->printer->printer_id : 0, client->operation_id);
+
+  return (ret);
 }
 
 
@@ -308,3 +326,47 @@ papplClientRespondIPPUnsupported(
   temp = ippCopyAttribute(client->response, attr, 0);
   ippSetGroupTag(client->response, &temp, IPP_TAG_UNSUPPORTED_GROUP);
 }
+
+
+//
+// 'new_response()' - Create a response message for the current request.
+//
+// Like `ippNewResponse`, but reuses the cleared response message from the
+// previous request on this connection when there is one.
+//
+
+static ipp_t *				// O - Response message
+new_response(pappl_client_t *client)	// I - Client
+{
+  ipp_t			*response;	// Response message
+  ipp_attribute_t	*attr;		// Request attribute
+  int			major, minor;	// Request version
+  const char		*charset = "utf-8",
+					// attributes-charset value
+			*language = "en";
+					// attributes-natural-language value
+
+
+  if ((response = client->old_response) == NULL)
+    return (ippNewResponse(client->request));
+
+  client->old_response = NULL;
+
+  major = ippGetVersion(client->request, &minor);
+  ippSetVersion(response, major, minor);
+  ippSetRequestId(response, ippGetRequestId(client->request));
+  ippSetStatusCode(response, IPP_STATUS_OK);
+
+  if ((attr = ippFirstAttribute(client->request)) != NULL && ippGetGroupTag(attr) == IPP_TAG_OPERATION && ippGetValueTag(attr) == IPP_TAG_CHARSET)
+  {
+    charset = ippGetString(attr, 0, NULL);
+
+    if ((attr = ippNextAttribute(client->request)) != NULL && ippGetGroupTag(attr) == IPP_TAG_OPERATION && ippGetValueTag(attr) == IPP_TAG_LANGUAGE)
+      language = ippGetString(attr, 0, NULL);
+  }
+
+  ippAddString(response, IPP_TAG_OPERATION, IPP_TAG_CHARSET, "attributes-charset", NULL, charset);
+  ippAddString(response, IPP_TAG_OPERATION, IPP_TAG_LANGUAGE, "attributes-natural-language", NULL, language);
+
+  return (response);
+}
@@ -20,6 +20,14 @@
 #  include "log.h"
 
 
+//
+// Constants...
+//
+
+#  define _PAPPL_HTML_BUFFER	4096	// Initial size of HTML output buffer
+#  define _PAPPL_HTML_MAX	65536	// Maximum size of HTML output buffer
+
+
 //
 // Client structure...
 //
@@ -31,7 +39,10 @@ struct _pappl_client_s			// Client data
   pthread_t		thread_id;		// Thread ID
   http_t		*http;			// HTTP connection
   ipp_t			*request,		// IPP request
-			*response;		// IPP response
+			*response,		// IPP response
+			*old_request,		// Cleared IPP request for reuse
+			*old_response;		// Cleared IPP response for reuse
+  bool			corked;			// Are responses being held back?
   time_t		start;			// Request start time
   http_state_t		operation;		// Request operation
   ipp_op_t		operation_id;		// IPP operation-id
@@ -47,6 +58,9 @@ struct _pappl_client_s			// Client data
   pappl_job_t		*job;			// Job, if any
   int			num_files;		// Number of temporary files
   char			*files[10];		// Temporary files
+  char			*html;			// HTML output buffer
+  size_t		html_size,		// Size of HTML output buffer
+			html_used;		// Bytes used in HTML output buffer
 };
 
 
@@ -59,7 +73,9 @@ extern pappl_client_t	*_papplClientCreate(pappl_system_t *system, int sock) _PAP
 extern char		*_papplClientCreateTempFile(pappl_client_t *client, const void *data, size_t datasize) _PAPPL_PRIVATE;
 extern void		_papplClientDelete(pappl_client_t *client) _PAPPL_PRIVATE;
 extern void		_papplClientFlushDocumentData(pappl_client_t *client) _PAPPL_PRIVATE;
+extern void		_papplClientFlushHTML(pappl_client_t *client) _PAPPL_PRIVATE;
 extern bool		_papplClientHaveDocumentData(pappl_client_t *client) _PAPPL_PRIVATE;
+extern http_status_t	_papplClientIsAuthorizedForGroup(pappl_client_t *client, bool allow_remote, gid_t group) _PAPPL_PRIVATE;
 extern bool		_papplClientProcessHTTP(pappl_client_t *client) _PAPPL_PRIVATE;
 extern bool		_papplClientProcessIPP(pappl_client_t *client) _PAPPL_PRIVATE;
 extern void		*_papplClientRun(pappl_client_t *client) _PAPPL_PRIVATE;
@@ -16,6 +16,29 @@
 #include <math.h>
 
 
+//
+// Local functions...
+//
+
+static void	html_write(pappl_client_t *client, const char *s, size_t slen);
+
+
+//
+// '_papplClientFlushHTML()' - Write any buffered HTML to the client.
+//
+
+void
+_papplClientFlushHTML(
+    pappl_client_t *client)		// I - Client
+{
+  if (client->html_used > 0)
+  {
+    httpWrite2(client->http, client->html, client->html_used);
+    client->html_used = 0;
+  }
+}
+
+
 //
 // 'papplClientGetCookie()' - Get a cookie from the client.
 //
@@ -550,14 +573,14 @@ papplClientHTMLEscape(
     if (*s == '&' || *s == '<' || *s == '\"')
     {
       if (s > start)
-        httpWrite2(client->http, start, (size_t)(s - start));
+        html_write(client, start, (size_t)(s - start));
 
       if (*s == '&')
-        httpWrite2(client->http, "&amp;", 5);
+        html_write(client, "&amp;", 5);
       else if (*s == '<')
-        httpWrite2(client->http, "&lt;", 4);
+        html_write(client, "&lt;", 4);
       else
-        httpWrite2(client->http, "&quot;", 6);
+        html_write(client, "&quot;", 6);
 
       start = s + 1;
     }
@@ -566,7 +589,7 @@ papplClientHTMLEscape(
   }
 
   if (s > start)
-    httpWrite2(client->http, start, (size_t)(s - start));
+    html_write(client, start, (size_t)(s - start));
 }
 
 
@@ -602,6 +625,8 @@ papplClientHTMLFooter(
   papplClientHTMLPuts(client,
 		      "  </body>\n"
 		      "</html>\n");
+
+  _papplClientFlushHTML(client);
   httpWrite2(client->http, "", 0);
 }
 
@@ -632,9 +657,9 @@ papplClientHTMLHeader(
   const char		*name;		// Name for title/header
 
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   printer = (pappl_printer_t *)cupsArrayFirst(system->printers);
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   if ((system->options & PAPPL_SOPTIONS_MULTI_QUEUE) || !printer)
     name = system->name;
@@ -660,22 +685,22 @@ papplClientHTMLHeader(
 		      "        <div class=\"col-12 nav\">\n"
 		      "          <a class=\"btn\" href=\"/\"><img src=\"/navicon.png\"></a>\n");
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   _papplClientHTMLPutLinks(client, system->links, PAPPL_LOPTIONS_NAVIGATION);
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   if (!(system->options & PAPPL_SOPTIONS_MULTI_QUEUE) && printer)
   {
     if (cupsArrayCount(system->links) > 0)
       papplClientHTMLPuts(client, "          <span class=\"spacer\"></span>\n");
 
-    pthread_rwlock_rdlock(&printer->rwlock);
+    _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
     _papplClientHTMLPutLinks(client, printer->links, PAPPL_LOPTIONS_NAVIGATION);
 
-    pthread_rwlock_unlock(&printer->rwlock);
+    _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   }
 
   papplClientHTMLPuts(client,
@@ -900,7 +925,7 @@ papplClientHTMLPrinterHeader(
 
   if (printer->system->options & PAPPL_SOPTIONS_MULTI_QUEUE)
   {
-    pthread_rwlock_rdlock(&printer->rwlock);
+    _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
     papplClientHTMLPrintf(client,
 			  "    <div class=\"header2\">\n"
 			  "      <div class=\"row\">\n"
@@ -910,7 +935,7 @@ papplClientHTMLPrinterHeader(
 			"        </div>\n"
 			"      </div>\n"
 			"    </div>\n");
-    pthread_rwlock_unlock(&printer->rwlock);
+    _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   }
   else if (client->system->versions[0].sversion[0])
     papplClientHTMLPrintf(client,
@@ -974,14 +999,14 @@ papplClientHTMLPrintf(
     if (*format == '%')
     {
       if (format > start)
-        httpWrite2(client->http, start, (size_t)(format - start));
+        html_write(client, start, (size_t)(format - start));
 
       tptr    = tformat;
       *tptr++ = *format++;
 
       if (*format == '%')
       {
-        httpWrite2(client->http, "%", 1);
+        html_write(client, "%", 1);
         format ++;
 	start = format;
 	continue;
@@ -1088,7 +1113,7 @@ papplClientHTMLPrintf(
 
 	    snprintf(temp, sizeof(temp), tformat, va_arg(ap, double));
 
-            httpWrite2(client->http, temp, strlen(temp));
+            html_write(client, temp, strlen(temp));
 	    break;
 
         case 'B' : // Integer formats
@@ -1112,7 +1137,7 @@ papplClientHTMLPrintf(
 	    else
 	      snprintf(temp, sizeof(temp), tformat, va_arg(ap, int));
 
-            httpWrite2(client->http, temp, strlen(temp));
+            html_write(client, temp, strlen(temp));
 	    break;
 
 	case 'p' : // Pointer value
@@ -1121,7 +1146,7 @@ papplClientHTMLPrintf(
 
 	    snprintf(temp, sizeof(temp), tformat, va_arg(ap, void *));
 
-            httpWrite2(client->http, temp, strlen(temp));
+            html_write(client, temp, strlen(temp));
 	    break;
 
         case 'c' : // Character or character array
@@ -1148,7 +1173,7 @@ papplClientHTMLPrintf(
   }
 
   if (format > start)
-    httpWrite2(client->http, start, (size_t)(format - start));
+    html_write(client, start, (size_t)(format - start));
 
   va_end(ap);
 }
@@ -1207,7 +1232,7 @@ papplClientHTMLPuts(
     const char     *s)			// I - String
 {
   if (client && s && *s)
-    httpWrite2(client->http, s, strlen(s));
+    html_write(client, s, strlen(s));
 }
 
 
@@ -1323,3 +1348,59 @@ papplClientSetCookie(
     httpSetCookie(client->http, buffer);
   }
 }
+
+
+//
+// 'html_write()' - Buffer HTML output for the client.
+//
+// Output is collected in a per-client buffer that grows as needed up to
+// `_PAPPL_HTML_MAX` bytes and is then written with a single call, which is
+// much cheaper than sending each fragment through the HTTP chunk encoder.
+//
+
+static void
+html_write(pappl_client_t *client,	// I - Client
+           const char     *s,		// I - String to write
+           size_t         slen)		// I - Length of string
+{
+  size_t	newsize;		// New buffer size
+  char		*newhtml;		// New buffer
+
+
+  if (slen == 0)
+    return;
+
+  if (client->html_used + slen > client->html_size)
+  {
+    if (client->html_size < _PAPPL_HTML_MAX)
+    {
+      // Grow the buffer...
+      for (newsize = client->html_size ? client->html_size : _PAPPL_HTML_BUFFER; newsize < (client->html_used + slen) && newsize < _PAPPL_HTML_MAX; newsize *= 2);
+
+      if (newsize > _PAPPL_HTML_MAX)
+        newsize = _PAPPL_HTML_MAX;
+
+      if ((newhtml = realloc(client->html, newsize)) != NULL)
+      {
+        client->html      = newhtml;
+        client->html_size = newsize;
+      }
+    }
+
+    if (client->html_used + slen > client->html_size)
+    {
+      // Buffer is full, write it out...
+      _papplClientFlushHTML(client);
+
+      if (slen > client->html_size)
+      {
+        // Write large strings directly...
+        httpWrite2(client->http, s, slen);
+        return;
+      }
+    }
+  }
+
+  memcpy(client->html + client->html_used, s, slen);
+  client->html_used += slen;
+}
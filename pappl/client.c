@@ -13,13 +13,19 @@
 //
 
 #include "pappl-private.h"
+#include <sys/mman.h>
+#include <netinet/tcp.h>
 
 
 //
 // Local functions...
 //
 
-static bool	eval_if_modified(pappl_client_t *client, _pappl_resource_t *r);
+static bool	eval_if_modified(pappl_client_t *client, time_t last_modified, size_t length);
+static void	reuse_ipp(ipp_t **old_ipp, ipp_t *ipp);
+static bool	send_file(pappl_client_t *client, _pappl_resource_t *r, int fd, struct stat *fileinfo, const char *encoding);
+static void	set_cork(pappl_client_t *client, bool cork);
+static bool	start_tls(pappl_client_t *client, http_encryption_t encryption);
 
 
 //
@@ -60,8 +66,11 @@ _papplClientCreate(
     int            sock)		// I - Listen socket
 {
   pappl_client_t	*client;	// Client
+  uint64_t		trace_start;	// Start time for trace
 
 
+  trace_start = _papplTraceStart(system);
+
   if ((client = calloc(1, sizeof(pappl_client_t))) == NULL)
   {
     papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for client connection: %s", strerror(errno));
@@ -70,9 +79,9 @@ _papplClientCreate(
 
   client->system = system;
 
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   client->number = system->next_client ++;
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   // Accept the client and get the remote address...
   if ((client->http = httpAcceptConnection(sock, 1)) == NULL)
@@ -84,6 +93,8 @@ _papplClientCreate(
 
   httpGetHostname(client->http, client->hostname, sizeof(client->hostname));
 
+  _papplTraceEnd(system, _PAPPL_TSTAGE_ACCEPT, trace_start, client->number, 0, 0);
+
   papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Accepted connection from '%s'.", client->hostname);
 
   return (client);
@@ -155,8 +166,12 @@ _papplClientDelete(
   // Free memory...
   httpClose(client->http);
 
+  free(client->html);
+
   ippDelete(client->request);
   ippDelete(client->response);
+  ippDelete(client->old_request);
+  ippDelete(client->old_response);
 
   free(client);
 }
@@ -182,6 +197,7 @@ _papplClientProcessHTTP(
   int			port;		// Port number
   char			*ptr;		// Pointer into string
   _pappl_resource_t	*resource;	// Current resource
+  uint64_t		trace_start;	// Start time for trace
   static const char * const http_states[] =
   {					// Strings for logging HTTP method
     "WAITING",
@@ -203,15 +219,17 @@ _papplClientProcessHTTP(
   };
 
 
-  // Clear state variables...
-  ippDelete(client->request);
-  ippDelete(client->response);
+  // Clear state variables, keeping the IPP messages for the next request...
+  reuse_ipp(&client->old_request, client->request);
+  reuse_ipp(&client->old_response, client->response);
 
   client->request   = NULL;
   client->response  = NULL;
   client->operation = HTTP_STATE_WAITING;
 
   // Read a request from the connection...
+  trace_start = _papplTraceStart(client->system);
+
   while ((http_state = httpReadRequest(client->http, uri, sizeof(uri))) == HTTP_STATE_WAITING)
     usleep(1);
 
@@ -254,6 +272,8 @@ _papplClientProcessHTTP(
   // Parse incoming parameters until the status changes...
   while ((http_status = httpUpdate(client->http)) == HTTP_STATUS_CONTINUE);
 
+  _papplTraceEnd(client->system, _PAPPL_TSTAGE_HTTP, trace_start, client->number, 0, 0);
+
   if (http_status != HTTP_STATUS_OK)
   {
     papplClientRespond(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0, 0);
@@ -305,11 +325,8 @@ _papplClientProcessHTTP(
 
       papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Upgrading to encrypted connection.");
 
-      if (httpEncryption(client->http, HTTP_ENCRYPTION_REQUIRED))
-      {
-	papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to encrypt connection: %s", cupsLastErrorString());
+      if (!start_tls(client, HTTP_ENCRYPTION_REQUIRED))
 	return (false);
-      }
 
       papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Connection now encrypted.");
     }
@@ -345,10 +362,27 @@ _papplClientProcessHTTP(
         // See if we have a matching resource to serve...
         if ((resource = _papplSystemFindResource(client->system, client->uri)) != NULL)
         {
-          if (eval_if_modified(client, resource))
-	    return (papplClientRespond(client, HTTP_STATUS_OK, NULL, resource->format, resource->last_modified, 0));
+          time_t	last_modified = resource->last_modified;
+					// Last-Modified date/time
+          size_t	length = resource->cb ? 0 : resource->length;
+					// Length of resource
+
+          if (resource->filename)
+          {
+            // Report the current size and date of an external file...
+            struct stat	fileinfo;	// File information
+
+            if (stat(resource->filename, &fileinfo))
+	      return (papplClientRespond(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0, 0));
+
+            last_modified = fileinfo.st_mtime;
+            length        = (size_t)fileinfo.st_size;
+          }
+
+          if (resource->cb || eval_if_modified(client, last_modified, length))
+	    return (papplClientRespond(client, HTTP_STATUS_OK, NULL, resource->format, last_modified, length));
           else
-            return (papplClientRespond(client, HTTP_STATUS_NOT_MODIFIED, NULL, NULL, resource->last_modified, 0));
+            return (papplClientRespond(client, HTTP_STATUS_NOT_MODIFIED, NULL, NULL, last_modified, 0));
 	}
 
         // If we get here the resource wasn't found...
@@ -358,46 +392,56 @@ _papplClientProcessHTTP(
         // See if we have a matching resource to serve...
         if ((resource = _papplSystemFindResource(client->system, client->uri)) != NULL)
         {
-          if (!eval_if_modified(client, resource))
-          {
-            return (papplClientRespond(client, HTTP_STATUS_NOT_MODIFIED, NULL, NULL, resource->last_modified, 0));
-          }
-          else if (resource->cb)
+          const char *encoding = resource->compress ? httpGetContentEncoding(client->http) : NULL;
+					// Content-Encoding for response
+
+          if (resource->cb)
           {
             // Send output of a callback...
             return ((resource->cb)(client, resource->cbdata));
 	  }
 	  else if (resource->filename)
 	  {
-	    // Send an external file...
+	    // Send an external file, using the same file information for the
+	    // validators and the response...
 	    int		fd;		// Resource file descriptor
-	    char	buffer[8192];	// Copy buffer
-	    ssize_t	bytes;		// Bytes read/written
+	    struct stat	fileinfo;	// File information
+	    bool	ret;		// Return value
 
             if ((fd = open(resource->filename, O_RDONLY)) >= 0)
 	    {
-	      if (!papplClientRespond(client, HTTP_STATUS_OK, NULL, resource->format, resource->last_modified, 0))
-		return (false);
-
-              while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
-                httpWrite2(client->http, buffer, (size_t)bytes);
-
-	      httpWrite2(client->http, "", 0);
+	      if (fstat(fd, &fileinfo))
+	      {
+		papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to get information for '%s': %s", resource->filename, strerror(errno));
+		ret = papplClientRespond(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0, 0);
+	      }
+	      else if (!eval_if_modified(client, fileinfo.st_mtime, (size_t)fileinfo.st_size))
+		ret = papplClientRespond(client, HTTP_STATUS_NOT_MODIFIED, NULL, NULL, fileinfo.st_mtime, 0);
+	      else
+		ret = send_file(client, resource, fd, &fileinfo, encoding);
 
 	      close(fd);
 
-	      return (true);
+	      return (ret);
 	    }
 	  }
+	  else if (!eval_if_modified(client, resource->last_modified, resource->length))
+	  {
+            return (papplClientRespond(client, HTTP_STATUS_NOT_MODIFIED, NULL, NULL, resource->last_modified, 0));
+	  }
 	  else
 	  {
-	    // Send a static resource file...
-	    if (!papplClientRespond(client, HTTP_STATUS_OK, NULL, resource->format, resource->last_modified, resource->length))
+	    // Send a static resource file, letting the HTTP library compress it
+	    // as needed...
+	    if (!papplClientRespond(client, HTTP_STATUS_OK, encoding, resource->format, resource->last_modified, encoding ? 0 : resource->length))
 	      return (false);
 
-	    httpWrite2(client->http, (const char *)resource->data, resource->length);
-	    httpFlushWrite(client->http);
-	    return (true);
+	    if (httpWrite2(client->http, (const char *)resource->data, resource->length) < 0)
+	      return (false);
+	    else if (encoding)
+	      return (httpWrite2(client->http, "", 0) >= 0);
+	    else
+	      return (httpFlushWrite(client->http) >= 0);
 	  }
 	}
 
@@ -408,7 +452,12 @@ _papplClientProcessHTTP(
         if (!strcmp(httpGetField(client->http, HTTP_FIELD_CONTENT_TYPE), "application/ipp"))
         {
 	  // Read the IPP request...
-	  client->request = ippNew();
+	  if ((client->request = client->old_request) != NULL)
+	    client->old_request = NULL;
+	  else
+	    client->request = ippNew();
+
+	  trace_start = _papplTraceStart(client->system);
 
 	  while ((ipp_state = ippRead(client->http, client->request)) != IPP_STATE_DATA)
 	  {
@@ -420,6 +469,8 @@ _papplClientProcessHTTP(
 	    }
 	  }
 
+	  _papplTraceEnd(client->system, _PAPPL_TSTAGE_IPP_READ, trace_start, client->number, 0, ippGetOperation(client->request));
+
 	  // Now that we have the IPP request, process the request...
 	  return (_papplClientProcessIPP(client));
 	}
@@ -483,6 +534,13 @@ papplClientRespond(
   char	message[1024];			// Text message
 
 
+  // Discard any HTML left over from a previous response...
+  client->html_used = 0;
+
+  // Compress web pages for clients that support it...
+  if (!content_encoding && type && !length && code == HTTP_STATUS_OK && (client->system->options & PAPPL_SOPTIONS_WEB_COMPRESS) && !strcmp(type, "text/html"))
+    content_encoding = httpGetContentEncoding(client->http);
+
   if (type)
     papplLogClient(client, PAPPL_LOGLEVEL_INFO, "%s %s %d", httpStatus(code), type, (int)length);
   else
@@ -629,8 +687,8 @@ _papplClientRun(
   int first_time = 1;			// First time request?
 
 
-  // Loop until we are out of requests or timeout (30 seconds)...
-  while (httpWait(client->http, 30000))
+  // Loop until we are out of requests or the idle timeout...
+  while (httpWait(client->http, client->system->idle_timeout * 1000))
   {
     if (first_time)
     {
@@ -641,11 +699,8 @@ _papplClientRun(
       {
         papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Starting HTTPS session.");
 
-	if (httpEncryption(client->http, HTTP_ENCRYPTION_ALWAYS))
-	{
-          papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to encrypt connection: %s", cupsLastErrorString());
+	if (!start_tls(client, HTTP_ENCRYPTION_ALWAYS))
 	  break;
-        }
 
         papplLogClient(client, PAPPL_LOGLEVEL_INFO, "Connection now encrypted.");
       }
@@ -657,6 +712,10 @@ _papplClientRun(
       break;
 
     _papplClientCleanTempFiles(client);
+
+    // Hold back responses while the client has more (pipelined) requests
+    // waiting, and send them together once the input is drained...
+    set_cork(client, httpGetReady(client->http) > 0);
   }
 
   // Close the conection to the client and return...
@@ -669,21 +728,24 @@ _papplClientRun(
 //
 // 'eval_if_modified()' - Evaluate an "If-Modified-Since" header.
 //
+// The date and length are the ones sent with the response, which for external
+// files come from the same file information used to send the file.  Only
+// Last-Modified is used as a validator: libcups 2.x has no header fields for
+// ETag, If-None-Match, or Cache-Control and drops unknown request headers, so
+// clients can only revalidate with If-Modified-Since.
+//
 
 static bool				// O - `true` if modified, `false` otherwise
 eval_if_modified(
-    pappl_client_t    *client,		// I - Client
-    _pappl_resource_t *r)		// I - Resource
+    pappl_client_t *client,		// I - Client
+    time_t         last_modified,	// I - Last-Modified date/time of resource
+    size_t         length)		// I - Length of resource
 {
   const char	*ptr;			// Pointer into field
   time_t	date = 0;		// Time/date value
   off_t		size = 0;		// Size/length value
 
 
-  // Dynamic content always needs to be updated...
-  if (r->cb)
-    return (true);
-
   // Get "If-Modified-Since:" header
   ptr = httpGetField(client->http, HTTP_FIELD_IF_MODIFIED_SINCE);
 
@@ -719,6 +781,172 @@ eval_if_modified(
       ptr ++;
   }
 
-  // Return the evaluation based on the last modified date, time, and size...
-  return ((size != 0 && size != (off_t)r->length) || (date != 0 && date < r->last_modified) || (size == 0 && date == 0));
+  // Return the evaluation based on the last modified date, time, and size.
+  // The date must match exactly - an older or newer date means the client has
+  // a copy from another version of the file or another server run...
+  return ((size != 0 && size != (off_t)length) || (date != 0 && date != last_modified) || (size == 0 && date == 0));
+}
+
+
+//
+// 'reuse_ipp()' - Clear an IPP message so it can be reused.
+//
+// Clearing the attributes keeps the message itself, so a connection with many
+// requests doesn't allocate new messages for each one.
+//
+
+static void
+reuse_ipp(ipp_t **old_ipp,		// IO - Message to reuse
+          ipp_t *ipp)			// I  - Message to clear or `NULL`
+{
+  ipp_attribute_t	*attr;		// Current attribute
+
+
+  if (!ipp)
+    return;
+
+  if (*old_ipp)
+  {
+    ippDelete(ipp);
+    return;
+  }
+
+  while ((attr = ippFirstAttribute(ipp)) != NULL)
+    ippDeleteAttribute(ipp, attr);
+
+  ippSetState(ipp, IPP_STATE_IDLE);
+
+  *old_ipp = ipp;
+}
+
+
+//
+// 'send_file()' - Send an external file resource.
+//
+// The file is mapped into memory and written directly from the mapping, so
+// the data is not copied through a user space buffer.  Uncompressed files are
+// sent with a Content-Length from the file information used to validate the
+// request.  Compressed
+// files are sent chunked since the HTTP library compresses the data itself
+// whenever a Content-Encoding is set, which also means a pre-compressed copy
+// cannot be passed through it.
+//
+
+static bool				// O - `true` on success, `false` on error
+send_file(pappl_client_t    *client,	// I - Client
+          _pappl_resource_t *r,		// I - Resource
+          int               fd,		// I - File descriptor
+          struct stat       *fileinfo,	// I - File information
+          const char        *encoding)	// I - Content-Encoding, if any
+{
+  size_t	length;			// Length of file
+  void		*data;			// Mapped file data
+  bool		ret;			// Return value
+
+
+  if ((length = (size_t)fileinfo->st_size) == 0)
+    return (papplClientRespond(client, HTTP_STATUS_OK, NULL, r->format, fileinfo->st_mtime, 0) && httpWrite2(client->http, "", 0) >= 0);
+
+  // Map the file and write it in one call - the HTTP library retries partial
+  // writes until all of the data is sent or an error occurs...
+  if ((data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+  {
+    papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to map '%s': %s", r->filename, strerror(errno));
+    return (papplClientRespond(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0, 0));
+  }
+
+  if ((ret = papplClientRespond(client, HTTP_STATUS_OK, encoding, r->format, fileinfo->st_mtime, encoding ? 0 : length)) == true)
+  {
+    if (httpWrite2(client->http, (const char *)data, length) < 0)
+    {
+      papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to send '%s': %s", r->filename, strerror(errno));
+      ret = false;
+    }
+    else if (encoding)
+      ret = httpWrite2(client->http, "", 0) >= 0;
+    else
+      ret = httpFlushWrite(client->http) >= 0;
+  }
+
+  munmap(data, length);
+
+  return (ret);
+}
+
+
+//
+// 'set_cork()' - Hold back or send partial TCP frames.
+//
+
+static void
+set_cork(pappl_client_t *client,	// I - Client
+         bool           cork)		// I - `true` to hold back frames, `false` to send them
+{
+#if defined(TCP_CORK) || defined(TCP_NOPUSH)
+  int	val = cork ? 1 : 0;		// Option value
+
+
+  if (cork == client->corked || httpAddrFamily(httpGetAddress(client->http)) == AF_LOCAL)
+    return;
+
+#  ifdef TCP_CORK
+  if (!setsockopt(httpGetFd(client->http), IPPROTO_TCP, TCP_CORK, &val, sizeof(val)))
+#  else
+  if (!setsockopt(httpGetFd(client->http), IPPROTO_TCP, TCP_NOPUSH, &val, sizeof(val)))
+#  endif // TCP_CORK
+    client->corked = cork;
+
+#else
+  (void)client;
+  (void)cork;
+#endif // TCP_CORK || TCP_NOPUSH
+}
+
+
+//
+// 'start_tls()' - Negotiate a TLS session and record how long it took.
+//
+
+static bool				// O - `true` on success, `false` on error
+start_tls(
+    pappl_client_t    *client,		// I - Client
+    http_encryption_t encryption)	// I - Type of encryption
+{
+  pappl_system_t	*system = client->system;
+					// System
+  uint64_t		trace_start;	// Start time for trace
+  double		secs;		// Elapsed time in seconds
+  bool			ret;		// Return value
+
+
+  trace_start = _papplTraceStart(system);
+  secs        = _papplGetTime();
+  ret         = !httpEncryption(client->http, encryption);
+  secs        = _papplGetTime() - secs;
+
+  _papplTraceEnd(system, _PAPPL_TSTAGE_TLS, trace_start, client->number, 0, 0);
+
+  pthread_mutex_lock(&system->tls_mutex);
+
+  if (ret)
+  {
+    system->tls_count ++;
+    system->tls_total += secs;
+
+    if (secs > system->tls_max)
+      system->tls_max = secs;
+  }
+  else
+  {
+    system->tls_failures ++;
+  }
+
+  pthread_mutex_unlock(&system->tls_mutex);
+
+  if (!ret)
+    papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to encrypt connection: %s", cupsLastErrorString());
+  else
+    papplLogClient(client, PAPPL_LOGLEVEL_DEBUG, "TLS handshake took %.3f seconds.", secs);
+
+  return (ret);
 }
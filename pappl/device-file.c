@@ -13,6 +13,20 @@
 //
 
 #include "device-private.h"
+#include "uring-private.h"
+
+
+//
+// Local types...
+//
+
+typedef struct _pappl_file_s		// File device data
+{
+  int			fd;		// File descriptor
+  off_t			offset;		// Current offset or -1 for appending
+  bool			queue;		// Try queuing the first write?
+  _pappl_uring_t	*ring;		// io_uring write queue, if any
+} _pappl_file_t;
 
 
 //
@@ -42,15 +56,24 @@ _papplDeviceAddFileScheme(void)
 static void
 pappl_file_close(pappl_device_t *device)// I - Device
 {
-  int		*fd;			// File descriptor
+  _pappl_file_t	*file;			// File device data
 
 
   // Make sure we have a valid file descriptor...
-  if ((fd = papplDeviceGetData(device)) == NULL || *fd < 0)
+  if ((file = papplDeviceGetData(device)) == NULL || file->fd < 0)
     return;
 
-  close(*fd);
-  free(fd);
+  if (file->ring)
+  {
+    // Wait for queued writes to complete...
+    if (!_papplUringFlush(file->ring))
+      papplDeviceError(device, "Unable to write file: %s", strerror(errno));
+
+    _papplUringDelete(file->ring);
+  }
+
+  close(file->fd);
+  free(file);
 
   papplDeviceSetData(device, NULL);
 }
@@ -66,7 +89,7 @@ pappl_file_open(
     const char     *device_uri,		// I - Device URI
     const char     *name)		// I - Job name
 {
-  int		*fd;			// File descriptor
+  _pappl_file_t	*file;			// File device data
   char		scheme[32],		// URI scheme
 		userpass[32],		// Username/password (not used)
 		host[256],		// Host name or make
@@ -79,8 +102,8 @@ pappl_file_open(
   struct stat	resinfo;		// Resource path information
 
 
-  // Allocate memory for a file descriptor
-  if ((fd = (int *)malloc(sizeof(int))) == NULL)
+  // Allocate memory for the device data
+  if ((file = (_pappl_file_t *)calloc(1, sizeof(_pappl_file_t))) == NULL)
   {
     papplDeviceError(device, "Unable to allocate memory for file: %s", strerror(errno));
     return (false);
@@ -110,34 +133,42 @@ pappl_file_open(
         *fileptr = '_';
     }
 
-    *fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    file->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
   }
   else if (S_ISCHR(resinfo.st_mode))
   {
     // Resource is a character device...
-    *fd = open(resource, O_WRONLY | O_EXCL);
+    file->fd = open(resource, O_WRONLY | O_EXCL);
   }
   else if (S_ISREG(resinfo.st_mode))
   {
     // Resource is a regular file...
-    *fd = open(resource, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    file->fd = open(resource, O_WRONLY | O_APPEND | O_CREAT, 0666);
   }
   else
   {
-    *fd   = -1;
-    errno = EINVAL;
+    file->fd = -1;
+    errno    = EINVAL;
   }
 
   // If we were unable to open the file, return an error...
-  if (*fd < 0)
+  if (file->fd < 0)
   {
     papplDeviceError(device, "Unable to open '%s': %s", resource, strerror(errno));
-    free(fd);
+    free(file);
     return (false);
   }
 
-  // Otherwise, save the file descriptor and return success...
-  papplDeviceSetData(device, fd);
+  // Writes to regular files can be queued with io_uring, new files are
+  // written from the start and existing files are appended to...
+  if (!S_ISCHR(resinfo.st_mode))
+  {
+    file->offset = S_ISDIR(resinfo.st_mode) ? 0 : -1;
+    file->queue  = true;
+  }
+
+  // Otherwise, save the device data and return success...
+  papplDeviceSetData(device, file);
   return (true);
 }
 
@@ -151,19 +182,39 @@ pappl_file_write(pappl_device_t *device,// I - Device
                  const void     *buffer,// I - Buffer to write
                  size_t         bytes)	// I - Bytes to write
 {
-  int		*fd;			// File descriptor
+  _pappl_file_t	*file;			// File device data
   const char	*ptr;			// Pointer into buffer
   ssize_t	count,			// Total bytes written
 		written;		// Bytes written this time
 
 
   // Make sure we have a valid file descriptor...
-  if ((fd = papplDeviceGetData(device)) == NULL || *fd < 0)
+  if ((file = papplDeviceGetData(device)) == NULL || file->fd < 0)
     return (-1);
 
+  if (file->queue)
+  {
+    // Create the write queue on the first write, after the printer has
+    // enabled io_uring for the device...
+    file->ring  = _papplUringCreate(device->io_uring);
+    file->queue = false;
+  }
+
+  if (file->ring)
+  {
+    // Queue the data, any error is reported by a later write or close...
+    if (!_papplUringWrite(file->ring, file->fd, file->offset, buffer, bytes))
+      return (-1);
+
+    if (file->offset >= 0)
+      file->offset += (off_t)bytes;
+
+    return ((ssize_t)bytes);
+  }
+
   for (count = 0, ptr = (const char *)buffer; count < (ssize_t)bytes; count += written, ptr += written)
   {
-    if ((written = write(*fd, ptr, bytes - (size_t)count)) < 0)
+    if ((written = write(file->fd, ptr, bytes - (size_t)count)) < 0)
     {
       if (errno == EINTR || errno == EAGAIN)
       {
@@ -54,6 +54,7 @@ struct _pappl_device_s			// Device connection data
 						// Write buffer
   size_t		bufused;		// Number of bytes in write buffer
   pappl_devmetrics_t	metrics;		// Device metrics
+  bool			io_uring;		// Queue writes with io_uring if supported?
 };
 
 typedef void (*_pappl_devscheme_cb_t)(const char *scheme, void *data);
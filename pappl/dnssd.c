@@ -336,11 +336,11 @@ _papplPrinterRegisterDNSSDNoLock(
   papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Registering DNS-SD name '%s' on '%s'", printer->dns_sd_name, printer->system->hostname);
 
   // Get attributes and values for the TXT record...
-  color_supported           = ippFindAttribute(printer->driver_attrs, "color-supported", IPP_TAG_BOOLEAN);
-  document_format_supported = ippFindAttribute(printer->driver_attrs, "document-format-supported", IPP_TAG_MIMETYPE);
-  printer_kind              = ippFindAttribute(printer->driver_attrs, "printer-kind", IPP_TAG_KEYWORD);
+  color_supported           = ippFindAttribute(_papplPrinterGetDriverAttrs(printer), "color-supported", IPP_TAG_BOOLEAN);
+  document_format_supported = ippFindAttribute(_papplPrinterGetDriverAttrs(printer), "document-format-supported", IPP_TAG_MIMETYPE);
+  printer_kind              = ippFindAttribute(_papplPrinterGetDriverAttrs(printer), "printer-kind", IPP_TAG_KEYWORD);
   printer_uuid              = ippFindAttribute(printer->attrs, "printer-uuid", IPP_TAG_URI);
-  urf_supported             = ippFindAttribute(printer->driver_attrs, "urf-supported", IPP_TAG_KEYWORD);
+  urf_supported             = ippFindAttribute(_papplPrinterGetDriverAttrs(printer), "urf-supported", IPP_TAG_KEYWORD);
 
   for (i = 0, count = ippGetCount(document_format_supported), ptr = formats; i < count; i ++)
   {
@@ -1122,6 +1122,7 @@ dns_sd_printer_callback(
   {
     printer->dns_sd_collision             = true;
     printer->system->dns_sd_any_collision = true;
+    _papplSystemWakeup(printer->system);
   }
   else if (errorCode)
   {
@@ -1178,6 +1179,7 @@ dns_sd_system_callback(
   {
     system->dns_sd_collision     = true;
     system->dns_sd_any_collision = true;
+    _papplSystemWakeup(system);
   }
   else if (errorCode)
   {
@@ -1198,11 +1200,8 @@ static void
 dns_sd_client_cb(
     AvahiClient      *c,		// I - Client
     AvahiClientState state,		// I - Current state
-    void             *data)		// I - Callback data (unused)
+    void             *data)		// I - System, if any
 {
-  (void)data;
-
-
   if (!c)
     return;
 
@@ -1214,7 +1213,12 @@ dns_sd_client_cb(
     }
   }
   else if (state == AVAHI_CLIENT_S_RUNNING)
+  {
     pappl_dns_sd_host_name_changes ++;
+
+    if (data)
+      _papplSystemWakeup((pappl_system_t *)data);
+  }
 }
 
 
@@ -1234,6 +1238,7 @@ dns_sd_printer_callback(
   {
     printer->dns_sd_collision             = true;
     printer->system->dns_sd_any_collision = true;
+    _papplSystemWakeup(printer->system);
   }
 }
 
@@ -1254,6 +1259,7 @@ dns_sd_system_callback(
   {
     system->dns_sd_collision     = true;
     system->dns_sd_any_collision = true;
+    _papplSystemWakeup(system);
   }
 }
 #endif // HAVE_DNSSD
@@ -60,9 +60,9 @@ papplJobGetAttribute(pappl_job_t *job,	// I - Job
 
   if (job)
   {
-    pthread_rwlock_rdlock(&job->rwlock);
+    _papplRWLockRead(&job->rwlock, _PAPPL_LOCK_JOB);
     attr = ippFindAttribute(job->attrs, name, IPP_TAG_ZERO);
-    pthread_rwlock_unlock(&job->rwlock);
+    _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
   }
 
   return (attr);
@@ -89,11 +89,16 @@ papplJobGetData(pappl_job_t *job)	// I - Job
 //
 // This function returns the filename for the job's document data.
 //
+// > Note: When raw print data is compressed in the spool directory, or is
+// > printed while it is being received for a driver that sets
+// > `print_while_receiving`, the filename refers to a pipe that must be read
+// > sequentially until the end of the data.
+//
 
 const char *				// O - Filename or `NULL` if none
 papplJobGetFilename(pappl_job_t *job)	// I - Job
 {
-  return (job ? job->filename : NULL);
+  return (job ? (job->pipe_filename ? job->pipe_filename : job->filename) : NULL);
 }
 
 
@@ -366,9 +371,11 @@ papplJobSetImpressionsCompleted(
 {
   if (job)
   {
-    pthread_rwlock_wrlock(&job->rwlock);
+    _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
     job->impcompleted += add;
-    pthread_rwlock_unlock(&job->rwlock);
+    _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+
+    _papplSystemAddEvent(job->system, job->printer, job, _PAPPL_EVENT_JOB_PROGRESS);
   }
 }
 
@@ -396,10 +403,10 @@ papplJobSetMessage(pappl_job_t *job,	// I - Job
     vsnprintf(buffer, sizeof(buffer), message, ap);
     va_end(ap);
 
-    pthread_rwlock_wrlock(&job->rwlock);
+    _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
     free(job->message);
     job->message = strdup(buffer);
-    pthread_rwlock_unlock(&job->rwlock);
+    _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
   }
 }
 
@@ -419,10 +426,12 @@ papplJobSetReasons(
 {
   if (job)
   {
-    pthread_rwlock_wrlock(&job->rwlock);
+    _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
     job->state_reasons &= ~remove;
     job->state_reasons |= add;
-    pthread_rwlock_unlock(&job->rwlock);
+    _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+
+    _papplSystemAddEvent(job->system, job->printer, job, _PAPPL_EVENT_JOB_STATE_CHANGED);
   }
 }
 
@@ -437,7 +446,7 @@ _papplJobSetState(pappl_job_t  *job,	// I - Job
 {
   if (job && job->state != state)
   {
-    pthread_rwlock_wrlock(&job->rwlock);
+    _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
 
     job->state = state;
 
@@ -461,6 +470,6 @@ _papplJobSetState(pappl_job_t  *job,	// I - Job
       if (job->state_reasons & PAPPL_JREASON_WARNINGS_DETECTED)
         job->state_reasons |= PAPPL_JREASON_JOB_COMPLETED_WITH_WARNINGS;
     }
-    pthread_rwlock_unlock(&job->rwlock);
+    _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
   }
 }
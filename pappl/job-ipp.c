@@ -207,8 +207,7 @@ _papplJobCopyDocumentData(
     pappl_client_t *client,		// I - Client
     pappl_job_t    *job)		// I - Job
 {
-  char			filename[1024],	// Filename buffer
-			buffer[4096];	// Copy buffer
+  char			buffer[4096];	// Copy buffer
   ssize_t		bytes;		// Bytes read
   cups_array_t		*ra;		// Attributes to send in response
 
@@ -231,28 +230,20 @@ _papplJobCopyDocumentData(
     goto complete_job;
   }
 
-  // Create a file for the request data...
-  if ((job->fd = papplJobOpenFile(job, filename, sizeof(filename), client->system->directory, NULL, "w")) < 0)
+  // Create a file for the request data, using the Content-Length (if any) to
+  // pick the spool tier...
+  if (!_papplJobOpenSpool(job, httpIsChunked(client->http) ? 0 : httpGetRemaining(client->http)))
   {
     papplClientRespondIPP(client, IPP_STATUS_ERROR_INTERNAL, "Unable to create print file: %s", strerror(errno));
 
     goto abort_job;
   }
 
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Created job file \"%s\", format \"%s\".", filename, job->format);
-
   while ((bytes = httpRead2(client->http, buffer, sizeof(buffer))) > 0)
   {
-    if (write(job->fd, buffer, (size_t)bytes) < bytes)
+    if (!_papplJobWriteSpool(job, buffer, (size_t)bytes))
     {
-      int error = errno;		// Write error
-
-      close(job->fd);
-      job->fd = -1;
-
-      unlink(filename);
-
-      papplClientRespondIPP(client, IPP_STATUS_ERROR_INTERNAL, "Unable to write print file: %s", strerror(error));
+      papplClientRespondIPP(client, IPP_STATUS_ERROR_INTERNAL, "Unable to write print file: %s", strerror(errno));
 
       goto abort_job;
     }
@@ -261,34 +252,19 @@ _papplJobCopyDocumentData(
   if (bytes < 0)
   {
     // Got an error while reading the print data, so abort this job.
-    close(job->fd);
-    job->fd = -1;
-
-    unlink(filename);
-
     papplClientRespondIPP(client, IPP_STATUS_ERROR_INTERNAL, "Unable to read print file.");
 
     goto abort_job;
   }
 
-  if (close(job->fd))
+  // Submit the job for processing...
+  if (!_papplJobCloseSpool(job, true))
   {
-    int error = errno;			// Write error
-
-    job->fd = -1;
-
-    unlink(filename);
-
-    papplClientRespondIPP(client, IPP_STATUS_ERROR_INTERNAL, "Unable to write print file: %s", strerror(error));
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_INTERNAL, "Unable to write print file.");
 
-    goto abort_job;
+    goto abort_response;
   }
 
-  job->fd = -1;
-
-  // Submit the job for processing...
-  _papplJobSubmitFile(job, filename);
-
   complete_job:
 
   // Return the job info...
@@ -310,18 +286,9 @@ _papplJobCopyDocumentData(
 
   _papplClientFlushDocumentData(client);
 
-  job->state     = IPP_JSTATE_ABORTED;
-  job->completed = time(NULL);
-
-  pthread_rwlock_wrlock(&client->printer->rwlock);
+  _papplJobCloseSpool(job, false);
 
-  cupsArrayRemove(client->printer->active_jobs, job);
-  cupsArrayAdd(client->printer->completed_jobs, job);
-
-  if (!client->system->clean_time)
-    client->system->clean_time = time(NULL) + 60;
-
-  pthread_rwlock_unlock(&client->printer->rwlock);
+  abort_response:
 
   ra = cupsArrayNew((cups_array_func_t)strcmp, NULL);
   cupsArrayAdd(ra, "job-id");
@@ -360,6 +327,10 @@ _papplJobProcessIPP(
 	ipp_close_job(client);
 	break;
 
+    case IPP_OP_CREATE_JOB_SUBSCRIPTIONS :
+	_papplSubscriptionIPPCreate(client);
+	break;
+
     default :
         if (client->system->op_cb && (client->system->op_cb)(client, client->system->op_cbdata))
           break;
@@ -484,7 +455,7 @@ _papplJobValidateDocumentAttributes(
     }
   }
 
-  pthread_rwlock_rdlock(&client->printer->rwlock);
+  _papplRWLockRead(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   if (op != IPP_OP_CREATE_JOB && (supported = ippFindAttribute(client->printer->attrs, "document-format-supported", IPP_TAG_MIMETYPE)) != NULL && !ippContainsString(supported, format))
   {
@@ -492,7 +463,7 @@ _papplJobValidateDocumentAttributes(
     valid = false;
   }
 
-  pthread_rwlock_unlock(&client->printer->rwlock);
+  _papplRWUnlock(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (valid);
 }
@@ -690,7 +661,8 @@ ipp_send_document(
     job->state = IPP_JSTATE_ABORTED;
 
   // Then finish getting the document data and process things...
-  pthread_rwlock_wrlock(&(client->printer->rwlock));
+  _papplRWLockRead(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
+  _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
 
   _papplCopyAttributes(job->attrs, client->request, NULL, IPP_TAG_JOB, 0);
 
@@ -701,7 +673,8 @@ ipp_send_document(
   else
     job->format = client->printer->psdriver.driver_data.format;
 
-  pthread_rwlock_unlock(&(client->printer->rwlock));
+  _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+  _papplRWUnlock(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   if (have_data)
     _papplJobCopyDocumentData(client, job);
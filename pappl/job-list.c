@@ -0,0 +1,373 @@
+//
+// Job list functions for the Printer Application Framework
+//
+// Copyright © 2019-2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+//
+// Include necessary headers...
+//
+
+#include "pappl-private.h"
+
+
+//
+// Local constants...
+//
+
+#define _PAPPL_JOB_HASH_SIZE	64	// Initial number of hash buckets
+
+
+//
+// Local functions...
+//
+
+static void		hash_job(_pappl_joblist_t *list, pappl_job_t *job);
+static _pappl_joblink_t	*job_link(_pappl_joblist_t *list, pappl_job_t *job);
+static bool		rehash_list(_pappl_joblist_t *list);
+
+
+//
+// '_papplJobListAdd()' - Add a job to a list.
+//
+// A job that is in another list of the same kind is first removed from it, so
+// moving a job from the active to the completed list is a single call.
+//
+// New jobs have the highest "job-id" and are added to the front of the list,
+// while jobs loaded from the state file are typically added to the end, so
+// both are constant time operations.
+//
+
+void
+_papplJobListAdd(_pappl_joblist_t *list,// I - Job list
+                 pappl_job_t      *job)	// I - Job
+{
+  _pappl_joblink_t	*link = job_link(list, job);
+					// Links for job
+  pappl_job_t		*current;	// Job to insert before
+
+
+  if (link->list == list)
+    return;
+  else if (link->list)
+    _papplJobListRemove(link->list, job);
+
+  // Find the insertion point...
+  if (!list->first || job->job_id > list->first->job_id)
+  {
+    current = list->first;
+  }
+  else if (job->job_id < list->last->job_id)
+  {
+    current = NULL;
+  }
+  else
+  {
+    for (current = list->first; current && current->job_id > job->job_id; current = job_link(list, current)->next);
+  }
+
+  // Insert the job before the current one...
+  link->list = list;
+  link->next = current;
+
+  if (current)
+  {
+    link->prev = job_link(list, current)->prev;
+    job_link(list, current)->prev = job;
+  }
+  else
+  {
+    link->prev = list->last;
+    list->last = job;
+  }
+
+  if (link->prev)
+    job_link(list, link->prev)->next = job;
+  else
+    list->first = job;
+
+  list->count ++;
+
+  // Update the job ID index, growing it as needed...
+  if (list->hash && ((size_t)list->count <= 2 * list->hashsize || !rehash_list(list)))
+    hash_job(list, job);
+}
+
+
+//
+// '_papplJobListClear()' - Remove all jobs from a list.
+//
+// The jobs in a list of all jobs are deleted.
+//
+
+void
+_papplJobListClear(
+    _pappl_joblist_t *list)		// I - Job list
+{
+  pappl_job_t	*job,			// Current job
+		*next;			// Next job
+
+
+  for (job = list->first; job; job = next)
+  {
+    next = _papplJobListNext(list, job);
+
+    _papplJobListRemove(list, job);
+
+    if (list->all)
+      _papplJobDelete(job);
+  }
+
+  free(list->hash);
+
+  list->hash     = NULL;
+  list->hashsize = 0;
+}
+
+
+//
+// '_papplJobListFind()' - Find a job by ID.
+//
+
+pappl_job_t *				// O - Job or `NULL` if not found
+_papplJobListFind(
+    _pappl_joblist_t *list,		// I - Job list
+    int              job_id)		// I - Job ID
+{
+  pappl_job_t	*job;			// Current job
+
+
+  if (list->hash)
+  {
+    for (job = list->hash[(unsigned)job_id & (list->hashsize - 1)]; job; job = job->hash_next)
+    {
+      if (job->job_id == job_id)
+        return (job);
+    }
+  }
+  else
+  {
+    for (job = list->first; job; job = _papplJobListNext(list, job))
+    {
+      if (job->job_id == job_id)
+        return (job);
+    }
+  }
+
+  return (NULL);
+}
+
+
+//
+// '_papplJobListIndex()' - Get the Nth job in a list.
+//
+
+pappl_job_t *				// O - Job or `NULL` if none
+_papplJobListIndex(
+    _pappl_joblist_t *list,		// I - Job list
+    int              n)			// I - Job index (0-based)
+{
+  pappl_job_t	*job;			// Current job
+  int		i;			// Looping var
+
+
+  if (n < 0 || n >= list->count)
+    return (NULL);
+
+  // Walk from whichever end is closer...
+  if (n < list->count / 2)
+  {
+    for (job = list->first, i = 0; i < n; i ++)
+      job = _papplJobListNext(list, job);
+  }
+  else
+  {
+    for (job = list->last, i = list->count - 1; i > n; i --)
+      job = _papplJobListPrev(list, job);
+  }
+
+  return (job);
+}
+
+
+//
+// '_papplJobListInit()' - Initialize a job list.
+//
+// A list of all jobs includes a job ID index and owns the jobs in it.
+//
+
+void
+_papplJobListInit(_pappl_joblist_t *list,// I - Job list
+                  bool             all)	// I - `true` for a list of all jobs
+{
+  memset(list, 0, sizeof(_pappl_joblist_t));
+
+  list->all = all;
+
+  if (all && (list->hash = (pappl_job_t **)calloc(_PAPPL_JOB_HASH_SIZE, sizeof(pappl_job_t *))) != NULL)
+    list->hashsize = _PAPPL_JOB_HASH_SIZE;
+}
+
+
+//
+// '_papplJobListNext()' - Get the next (older) job in a list.
+//
+
+pappl_job_t *				// O - Next job or `NULL` if none
+_papplJobListNext(
+    _pappl_joblist_t *list,		// I - Job list
+    pappl_job_t      *job)		// I - Current job
+{
+  return (job_link(list, job)->next);
+}
+
+
+//
+// '_papplJobListOldest()' - Get the oldest job in a list with the given state.
+//
+// Jobs are processed in the order they were submitted, so the printer uses this
+// to pick the next pending job to start.
+//
+
+pappl_job_t *				// O - Oldest job or `NULL` if none
+_papplJobListOldest(
+    _pappl_joblist_t *list,		// I - Job list
+    ipp_jstate_t     state)		// I - Job state
+{
+  pappl_job_t	*job;			// Current job
+
+
+  for (job = list->last; job; job = _papplJobListPrev(list, job))
+  {
+    if (job->state == state)
+      break;
+  }
+
+  return (job);
+}
+
+
+//
+// '_papplJobListPrev()' - Get the previous (newer) job in a list.
+//
+
+pappl_job_t *				// O - Previous job or `NULL` if none
+_papplJobListPrev(
+    _pappl_joblist_t *list,		// I - Job list
+    pappl_job_t      *job)		// I - Current job
+{
+  return (job_link(list, job)->prev);
+}
+
+
+//
+// '_papplJobListRemove()' - Remove a job from a list.
+//
+// Nothing is done if the job is not in the list.  Jobs removed from a list of
+// all jobs are not deleted.
+//
+
+void
+_papplJobListRemove(
+    _pappl_joblist_t *list,		// I - Job list
+    pappl_job_t      *job)		// I - Job
+{
+  _pappl_joblink_t	*link = job_link(list, job);
+					// Links for job
+  pappl_job_t		**hjob;		// Pointer into hash bucket
+
+
+  if (link->list != list)
+    return;
+
+  if (link->prev)
+    job_link(list, link->prev)->next = link->next;
+  else
+    list->first = link->next;
+
+  if (link->next)
+    job_link(list, link->next)->prev = link->prev;
+  else
+    list->last = link->prev;
+
+  link->list = NULL;
+  link->prev = NULL;
+  link->next = NULL;
+
+  list->count --;
+
+  if (list->hash)
+  {
+    for (hjob = list->hash + ((unsigned)job->job_id & (list->hashsize - 1)); *hjob; hjob = &((*hjob)->hash_next))
+    {
+      if (*hjob == job)
+      {
+        *hjob = job->hash_next;
+        break;
+      }
+    }
+
+    job->hash_next = NULL;
+  }
+}
+
+
+//
+// 'hash_job()' - Add a job to the job ID index.
+//
+
+static void
+hash_job(_pappl_joblist_t *list,	// I - Job list
+         pappl_job_t      *job)		// I - Job
+{
+  pappl_job_t	**bucket = list->hash + ((unsigned)job->job_id & (list->hashsize - 1));
+					// Hash bucket
+
+
+  job->hash_next = *bucket;
+  *bucket        = job;
+}
+
+
+//
+// 'job_link()' - Get the links for a job in a list.
+//
+
+static _pappl_joblink_t *		// O - Links
+job_link(_pappl_joblist_t *list,	// I - Job list
+         pappl_job_t      *job)		// I - Job
+{
+  return (list->all ? &job->all_link : &job->state_link);
+}
+
+
+//
+// 'rehash_list()' - Double the number of hash buckets and re-index all jobs.
+//
+// If memory can't be allocated the current hash buckets are kept, which just
+// makes the chains longer.
+//
+
+static bool				// O - `true` on success, `false` on error
+rehash_list(_pappl_joblist_t *list)	// I - Job list
+{
+  pappl_job_t	**hash,			// New hash buckets
+		*job;			// Current job
+
+
+  if ((hash = (pappl_job_t **)calloc(2 * list->hashsize, sizeof(pappl_job_t *))) == NULL)
+    return (false);
+
+  free(list->hash);
+
+  list->hash     = hash;
+  list->hashsize *= 2;
+
+  for (job = list->first; job; job = _papplJobListNext(list, job))
+    hash_job(list, job);
+
+  return (true);
+}
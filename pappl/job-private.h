@@ -18,20 +18,61 @@
 #  include "base-private.h"
 #  include "job.h"
 #  include "log.h"
+#  include "uring-private.h"
 #  include <sys/wait.h>
 
 extern char **environ;
 
 
+//
+// Constants...
+//
+
+#  define _PAPPL_SPOOL_MAX_RESERVE	(256 * 1024 * 1024)
+					// Maximum print file disk reservation
+#  define _PAPPL_SPOOL_RESERVE_FRACTION	4
+					// Reserve at most 1/N of free disk space
+
+
 //
 // Types and structures...
 //
+// Each printer keeps its jobs in doubly-linked lists that are sorted by
+// descending "job-id" (newest first).  The links are stored in the job, so
+// adding and removing jobs doesn't allocate or copy memory, and the list of
+// all jobs includes a hash index for finding jobs by ID.  Lists are protected
+// by the printer's reader/writer lock - since there is no shared cursor, any
+// number of threads holding a reader lock can walk the lists at once.
+//
+
+typedef struct _pappl_joblist_s _pappl_joblist_t;
+					// Job list
+
+typedef struct _pappl_joblink_s		// Job list links
+{
+  _pappl_joblist_t	*list;			// List containing the job, if any
+  pappl_job_t		*prev,			// Previous (newer) job
+			*next;			// Next (older) job
+} _pappl_joblink_t;
+
+struct _pappl_joblist_s			// Job list
+{
+  bool			all;			// List of all jobs (vs. active/completed)?
+  pappl_job_t		*first,			// First (newest) job
+			*last;			// Last (oldest) job
+  int			count;			// Number of jobs
+  pappl_job_t		**hash;			// Job ID hash buckets, if any
+  size_t		hashsize;		// Number of hash buckets
+};
 
 struct _pappl_job_s			// Job data
 {
   pthread_rwlock_t	rwlock;			// Reader/writer lock
   pappl_system_t	*system;		// Containing system
   pappl_printer_t	*printer;		// Containing printer
+  _pappl_joblink_t	all_link,		// Links in list of all jobs
+			state_link;		// Links in list of active or completed jobs
+  pappl_job_t		*hash_next;		// Next job in hash bucket
   int			job_id;			// "job-id" value
   const char		*name,			// "job-name" value
 			*username,		// "job-originating-user-name" value
@@ -49,7 +90,22 @@ struct _pappl_job_s			// Job data
   ipp_t			*attrs;			// Static attributes
   char			*filename;		// Print file name
   int			fd;			// Print file descriptor
+  char			*spool_filename;	// Print file being written
+  bool			spool_memory;		// Is the print file in memory?
+  size_t		spool_bytes;		// Bytes written to print file
+  size_t		spool_reserved;		// Bytes of disk space reserved for print file
+  _pappl_uring_t	*spool_ring;		// io_uring write queue for print file, if any
+  cups_file_t		*spool_file;		// Compressed print file being written, if any
+  bool			spool_compressed;	// Is the print file compressed?
+  int			mem_fd;			// In-memory print file descriptor
   bool			streaming;		// Streaming job?
+  pthread_mutex_t	receive_mutex;		// Mutex for print-while-receiving
+  pthread_cond_t	receive_cond;		// Condition for received print data
+  bool			receiving,		// Is print data still being received?
+			receive_error;		// Did receiving the print data fail?
+  off_t			received;		// Bytes of print data received
+  char			*pipe_filename;		// Print data pipe for driver, if any
+  uint64_t		trace_queued;		// Time job was queued, if tracing
   void			*data;			// Per-job driver data
 };
 
@@ -58,27 +114,42 @@ struct _pappl_job_s			// Job data
 // Functions...
 //
 
-extern int		_papplJobCompareActive(pappl_job_t *a, pappl_job_t *b) _PAPPL_PRIVATE;
-extern int		_papplJobCompareAll(pappl_job_t *a, pappl_job_t *b) _PAPPL_PRIVATE;
-extern int		_papplJobCompareCompleted(pappl_job_t *a, pappl_job_t *b) _PAPPL_PRIVATE;
+extern void		_papplJobAddReceived(pappl_job_t *job, size_t bytes) _PAPPL_PRIVATE;
+extern bool		_papplJobCloseSpool(pappl_job_t *job, bool ok) _PAPPL_PRIVATE;
 extern void		_papplJobCopyAttributes(pappl_client_t *client, pappl_job_t *job, cups_array_t *ra) _PAPPL_PRIVATE;
 extern void		_papplJobCopyDocumentData(pappl_client_t *client, pappl_job_t *job) _PAPPL_PRIVATE;
 extern pappl_job_t	*_papplJobCreate(pappl_printer_t *printer, int job_id, const char *username, const char *format, const char *job_name, ipp_t *attrs) _PAPPL_PRIVATE;
 extern void		_papplJobDelete(pappl_job_t *job) _PAPPL_PRIVATE;
+extern void		_papplJobFinishReceiving(pappl_job_t *job, bool ok) _PAPPL_PRIVATE;
 #  ifdef HAVE_LIBJPEG
 extern bool		_papplJobFilterJPEG(pappl_job_t *job, pappl_device_t *device, void *data);
 #  endif // HAVE_LIBJPEG
 #  ifdef HAVE_LIBPNG
 extern bool		_papplJobFilterPNG(pappl_job_t *job, pappl_device_t *device, void *data);
 #  endif // HAVE_LIBPNG
+extern int		_papplJobInflateSpool(pappl_job_t *job) _PAPPL_PRIVATE;
+extern bool		_papplJobIsRaw(pappl_job_t *job) _PAPPL_PRIVATE;
+extern void		_papplJobListAdd(_pappl_joblist_t *list, pappl_job_t *job) _PAPPL_PRIVATE;
+extern void		_papplJobListClear(_pappl_joblist_t *list) _PAPPL_PRIVATE;
+extern pappl_job_t	*_papplJobListFind(_pappl_joblist_t *list, int job_id) _PAPPL_PRIVATE;
+extern pappl_job_t	*_papplJobListIndex(_pappl_joblist_t *list, int n) _PAPPL_PRIVATE;
+extern void		_papplJobListInit(_pappl_joblist_t *list, bool all) _PAPPL_PRIVATE;
+extern pappl_job_t	*_papplJobListNext(_pappl_joblist_t *list, pappl_job_t *job) _PAPPL_PRIVATE;
+extern pappl_job_t	*_papplJobListOldest(_pappl_joblist_t *list, ipp_jstate_t state) _PAPPL_PRIVATE;
+extern pappl_job_t	*_papplJobListPrev(_pappl_joblist_t *list, pappl_job_t *job) _PAPPL_PRIVATE;
+extern void		_papplJobListRemove(_pappl_joblist_t *list, pappl_job_t *job) _PAPPL_PRIVATE;
+extern bool		_papplJobOpenSpool(pappl_job_t *job, size_t length) _PAPPL_PRIVATE;
 extern void		*_papplJobProcess(pappl_job_t *job) _PAPPL_PRIVATE;
 extern void		_papplJobProcessIPP(pappl_client_t *client) _PAPPL_PRIVATE;
 extern void		_papplJobProcessRaster(pappl_job_t *job, pappl_client_t *client) _PAPPL_PRIVATE;
 extern const char	*_papplJobReasonString(pappl_jreason_t reason) _PAPPL_PRIVATE;
+extern void		_papplJobReleaseSpool(pappl_job_t *job) _PAPPL_PRIVATE;
 extern void		_papplJobRemoveFile(pappl_job_t *job) _PAPPL_PRIVATE;
 extern void		_papplJobSetState(pappl_job_t *job, ipp_jstate_t state) _PAPPL_PRIVATE;
+extern bool		_papplJobStartReceiving(pappl_job_t *job, const char *filename) _PAPPL_PRIVATE;
 extern void		_papplJobSubmitFile(pappl_job_t *job, const char *filename) _PAPPL_PRIVATE;
 extern bool		_papplJobValidateDocumentAttributes(pappl_client_t *client) _PAPPL_PRIVATE;
+extern bool		_papplJobWriteSpool(pappl_job_t *job, const void *buffer, size_t bytes) _PAPPL_PRIVATE;
 
 
 #endif // !_PAPPL_JOB_PRIVATE_H_
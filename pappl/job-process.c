@@ -12,6 +12,24 @@
 //
 
 #include "pappl-private.h"
+#include "device-private.h"
+#include <signal.h>
+#ifdef __linux
+#  include <sys/sendfile.h>
+#endif // __linux
+
+
+//
+// Local types...
+//
+
+typedef struct _pappl_feed_s		// Print-while-receiving feed data
+{
+  pappl_job_t		*job;		// Job
+  int			infd,		// Print file
+			outfd;		// Pipe to driver
+  bool			done;		// Has the driver finished?
+} _pappl_feed_t;
 
 
 //
@@ -19,9 +37,12 @@
 //
 
 static const char *cups_cspace_string(cups_cspace_t cspace);
+static void	*feed_raw(_pappl_feed_t *feed);
 static bool	filter_raw(pappl_job_t *job, pappl_device_t *device);
 static void	finish_job(pappl_job_t *job);
+static bool	inflate_raw(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 static void	start_job(pappl_job_t *job);
+static bool	stream_raw(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 
 
 //
@@ -66,7 +87,7 @@ papplJobCreatePrintOptions(
 
   options->media = printer->psdriver.driver_data.media_default;
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   // copies
   if ((attr = ippFindAttribute(job->attrs, "copies", IPP_TAG_INTEGER)) != NULL)
@@ -350,50 +371,53 @@ papplJobCreatePrintOptions(
 
   options->header.cupsInteger[CUPS_RASTER_PWG_TotalPageCount] = (unsigned)options->copies * options->num_pages;
 
-  // Log options...
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsWidth=%u", options->header.cupsWidth);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsHeight=%u", options->header.cupsHeight);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsBitsPerColor=%u", options->header.cupsBitsPerColor);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsBitsPerPixel=%u", options->header.cupsBitsPerPixel);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsBytesPerLine=%u", options->header.cupsBytesPerLine);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsColorOrder=%u", options->header.cupsColorOrder);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsColorSpace=%u (%s)", options->header.cupsColorSpace, cups_cspace_string(options->header.cupsColorSpace));
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsNumColors=%u", options->header.cupsNumColors);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.HWResolution=[%u %u]", options->header.HWResolution[0], options->header.HWResolution[1]);
-
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "num_pages=%u", options->num_pages);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "copies=%d", options->copies);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "finishings=0x%x", options->finishings);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.bottom-margin=%d", options->media.bottom_margin);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.left-margin=%d", options->media.left_margin);
-  if (printer->psdriver.driver_data.left_offset_supported[1])
-    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.left-offset=%d", options->media.left_offset);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.right-margin=%d", options->media.right_margin);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.size=%dx%d", options->media.size_width, options->media.size_length);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.size-name='%s'", options->media.size_name);
-  if (printer->psdriver.driver_data.num_source)
-    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.source='%s'", options->media.source);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.top-margin=%d", options->media.top_margin);
-  if (printer->psdriver.driver_data.top_offset_supported[1])
-    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.top-offset=%d", options->media.top_offset);
-  if (printer->psdriver.driver_data.tracking_supported)
-    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.tracking='%s'", _papplMediaTrackingString(options->media.tracking));
-  if (printer->psdriver.driver_data.num_type)
-    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.type='%s'", options->media.type);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "orientation-requested=%s", ippEnumString("orientation-requested", (int)options->orientation_requested));
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "page-ranges=%u-%u", options->first_page, options->last_page);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-color-mode='%s'", _papplColorModeString(options->print_color_mode));
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-content-optimize='%s'", _papplContentString(options->print_content_optimize));
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-darkness=%d", options->print_darkness);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-quality=%s", ippEnumString("print-quality", (int)options->print_quality));
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-scaling='%s'", _papplScalingString(options->print_scaling));
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-speed=%d", options->print_speed);
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "printer-resolution=%dx%ddpi", options->printer_resolution[0], options->printer_resolution[1]);
-
-  for (i = 0; i < options->num_vendor; i ++)
-    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "%s=%s", options->vendor[i].name, options->vendor[i].value);
-
-  pthread_rwlock_unlock(&printer->rwlock);
+  // Log options (only when debugging job messages)...
+  if (_papplLogEnabled(job->system, PAPPL_LOGCAT_JOB, PAPPL_LOGLEVEL_DEBUG))
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsWidth=%u", options->header.cupsWidth);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsHeight=%u", options->header.cupsHeight);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsBitsPerColor=%u", options->header.cupsBitsPerColor);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsBitsPerPixel=%u", options->header.cupsBitsPerPixel);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsBytesPerLine=%u", options->header.cupsBytesPerLine);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsColorOrder=%u", options->header.cupsColorOrder);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsColorSpace=%u (%s)", options->header.cupsColorSpace, cups_cspace_string(options->header.cupsColorSpace));
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.cupsNumColors=%u", options->header.cupsNumColors);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "header.HWResolution=[%u %u]", options->header.HWResolution[0], options->header.HWResolution[1]);
+
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "num_pages=%u", options->num_pages);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "copies=%d", options->copies);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "finishings=0x%x", options->finishings);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.bottom-margin=%d", options->media.bottom_margin);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.left-margin=%d", options->media.left_margin);
+    if (printer->psdriver.driver_data.left_offset_supported[1])
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.left-offset=%d", options->media.left_offset);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.right-margin=%d", options->media.right_margin);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.size=%dx%d", options->media.size_width, options->media.size_length);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.size-name='%s'", options->media.size_name);
+    if (printer->psdriver.driver_data.num_source)
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.source='%s'", options->media.source);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.top-margin=%d", options->media.top_margin);
+    if (printer->psdriver.driver_data.top_offset_supported[1])
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.top-offset=%d", options->media.top_offset);
+    if (printer->psdriver.driver_data.tracking_supported)
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.tracking='%s'", _papplMediaTrackingString(options->media.tracking));
+    if (printer->psdriver.driver_data.num_type)
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "media-col.type='%s'", options->media.type);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "orientation-requested=%s", ippEnumString("orientation-requested", (int)options->orientation_requested));
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "page-ranges=%u-%u", options->first_page, options->last_page);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-color-mode='%s'", _papplColorModeString(options->print_color_mode));
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-content-optimize='%s'", _papplContentString(options->print_content_optimize));
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-darkness=%d", options->print_darkness);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-quality=%s", ippEnumString("print-quality", (int)options->print_quality));
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-scaling='%s'", _papplScalingString(options->print_scaling));
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "print-speed=%d", options->print_speed);
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "printer-resolution=%dx%ddpi", options->printer_resolution[0], options->printer_resolution[1]);
+
+    for (i = 0; i < options->num_vendor; i ++)
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "%s=%s", options->vendor[i].name, options->vendor[i].value);
+  }
+
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (options);
 }
@@ -425,11 +449,17 @@ void *					// O - Thread exit status
 _papplJobProcess(pappl_job_t *job)	// I - Job
 {
   _pappl_mime_filter_t	*filter;	// Filter for printing
+  uint64_t		trace_start;	// Start time for trace
+  pappl_devmetrics_t	before,		// Device metrics before processing
+			after;		// Device metrics after processing
 
 
   // Start processing the job...
   start_job(job);
 
+  if ((trace_start = _papplTraceStart(job->system)) != 0)
+    papplDeviceGetMetrics(job->printer->device, &before);
+
   // Do file-specific conversions...
   if ((filter = _papplSystemFindMIMEFilter(job->system, job->format, job->printer->psdriver.driver_data.format)) == NULL)
     filter =_papplSystemFindMIMEFilter(job->system, job->format, "image/pwg-raster");
@@ -451,6 +481,15 @@ _papplJobProcess(pappl_job_t *job)	// I - Job
     job->state = IPP_JSTATE_ABORTED;
   }
 
+  if (trace_start)
+  {
+    // Record the processing time and the device I/O time within it...
+    _papplTraceEnd(job->system, _PAPPL_TSTAGE_JOB_RIP, trace_start, job->job_id, job->printer->printer_id, 0);
+
+    papplDeviceGetMetrics(job->printer->device, &after);
+    _papplTraceRecord(job->system, _PAPPL_TSTAGE_DEVICE, trace_start, (uint64_t)(after.read_msecs + after.write_msecs - before.read_msecs - before.write_msecs) * 1000000, job->job_id, job->printer->printer_id, 0);
+  }
+
   // Move the job to a completed state...
   finish_job(job);
 
@@ -801,6 +840,76 @@ cups_cspace_string(
 }
 
 
+//
+// 'feed_raw()' - Copy print data to the driver as it is received.
+//
+// SIGPIPE is blocked in this thread so that a driver that stops reading early
+// just ends the feed with an EPIPE error, without changing how the rest of the
+// application handles the signal.
+//
+
+static void *				// O - Thread exit status
+feed_raw(_pappl_feed_t *feed)		// I - Feed data
+{
+  pappl_job_t	*job = feed->job;	// Job
+  off_t		offset = 0,		// Offset in print file
+		received;		// Bytes received so far
+  bool		receiving = true;	// Still receiving?
+  ssize_t	bytes;			// Bytes copied
+  sigset_t	pipeset,		// SIGPIPE signal set
+		pending;		// Pending signals
+  int		sig;			// Signal
+#ifndef __linux
+  char		buffer[65536];		// Copy buffer
+#endif // !__linux
+
+
+  sigemptyset(&pipeset);
+  sigaddset(&pipeset, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeset, NULL);
+
+  while (receiving)
+  {
+    // Wait for more print data...
+    pthread_mutex_lock(&job->receive_mutex);
+    while (job->receiving && job->received <= offset && !feed->done && !job->is_canceled)
+      pthread_cond_wait(&job->receive_cond, &job->receive_mutex);
+
+    received  = job->received;
+    receiving = job->receiving && !feed->done && !job->is_canceled;
+    pthread_mutex_unlock(&job->receive_mutex);
+
+    // Then copy it to the driver...
+    while (offset < received)
+    {
+#ifdef __linux
+      if ((bytes = sendfile(feed->outfd, feed->infd, &offset, (size_t)(received - offset))) <= 0)
+#else
+      if ((bytes = pread(feed->infd, buffer, received - offset > (off_t)sizeof(buffer) ? sizeof(buffer) : (size_t)(received - offset), offset)) > 0 && (bytes = write(feed->outfd, buffer, (size_t)bytes)) > 0)
+        offset += bytes;
+      else
+#endif // __linux
+      {
+        if (bytes < 0 && (errno == EINTR || errno == EAGAIN))
+          continue;
+
+        // The driver stopped reading, so discard the SIGPIPE for a closed
+        // pipe...
+        if (bytes < 0 && errno == EPIPE && !sigpending(&pending) && sigismember(&pending, SIGPIPE))
+          sigwait(&pipeset, &sig);
+
+        receiving = false;
+        break;
+      }
+    }
+  }
+
+  close(feed->outfd);
+
+  return (NULL);
+}
+
+
 //
 // 'filter_raw()' - "Filter" a raw print file.
 //
@@ -810,12 +919,25 @@ filter_raw(pappl_job_t    *job,		// I - Job
            pappl_device_t *device)	// I - Device
 {
   pappl_pr_options_t	*options;	// Job options
+  bool			receiving,	// Still receiving print data?
+			ret;		// Return value
 
 
   papplJobSetImpressions(job, 1);
   options = papplJobCreatePrintOptions(job, 1, false);
 
-  if (!(job->printer->psdriver.driver_data.printfile_cb)(job, options, device))
+  pthread_mutex_lock(&job->receive_mutex);
+  receiving = job->receiving;
+  pthread_mutex_unlock(&job->receive_mutex);
+
+  if (receiving)
+    ret = stream_raw(job, options, device);
+  else if (job->spool_compressed)
+    ret = inflate_raw(job, options, device);
+  else
+    ret = (job->printer->psdriver.driver_data.printfile_cb)(job, options, device);
+
+  if (!ret)
   {
     papplJobDeletePrintOptions(options);
     return (false);
@@ -839,8 +961,8 @@ finish_job(pappl_job_t  *job)		// I - Job
 					// Printer
 
 
-  pthread_rwlock_wrlock(&job->rwlock);
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
 
   if (job->is_canceled)
     job->state = IPP_JSTATE_CANCELED;
@@ -852,9 +974,7 @@ finish_job(pappl_job_t  *job)		// I - Job
   job->completed          = time(NULL);
   printer->processing_job = NULL;
 
-  _papplJobRemoveFile(job);
-
-  pthread_rwlock_unlock(&job->rwlock);
+  _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
 
   if (printer->is_stopped)
   {
@@ -870,23 +990,28 @@ finish_job(pappl_job_t  *job)		// I - Job
 
   printer->state_time = time(NULL);
 
-  cupsArrayRemove(printer->active_jobs, job);
-  cupsArrayAdd(printer->completed_jobs, job);
+  _papplJobListRemove(&printer->active_jobs, job);
+  _papplJobListAdd(&printer->completed_jobs, job);
 
   printer->impcompleted += job->impcompleted;
 
-  if (!job->system->clean_time)
-    job->system->clean_time = time(NULL) + 60;
+  _papplSystemScheduleCleanJobs(job->system, time(NULL) + 60);
+
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  // Remove the print file after releasing the job queue...
+  _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
+  _papplJobRemoveFile(job);
+  _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
 
-  _papplSystemConfigChanged(printer->system);
+  _papplSystemJobChanged(printer->system, job);
+  _papplSystemAddEvent(printer->system, printer, NULL, _PAPPL_EVENT_PRINTER_STATE_CHANGED);
 
   if (printer->is_deleted)
   {
     papplPrinterDelete(printer);
   }
-  else if (cupsArrayCount(printer->active_jobs) > 0)
+  else if (printer->active_jobs.count > 0)
   {
     _papplPrinterCheckJobs(printer);
   }
@@ -894,7 +1019,7 @@ finish_job(pappl_job_t  *job)		// I - Job
   {
     pappl_devmetrics_t	metrics;	// Metrics for device IO
 
-    pthread_rwlock_wrlock(&printer->rwlock);
+    _papplMutexLock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
 
     papplDeviceGetMetrics(printer->device, &metrics);
     papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Device read metrics: %lu requests, %lu bytes, %lu msecs", metrics.read_requests, metrics.read_bytes, metrics.read_msecs);
@@ -903,11 +1028,46 @@ finish_job(pappl_job_t  *job)		// I - Job
     papplDeviceClose(printer->device);
     printer->device = NULL;
 
-    pthread_rwlock_unlock(&printer->rwlock);
+    _papplMutexUnlock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
   }
 }
 
 
+//
+// 'inflate_raw()' - Print a compressed raw print file.
+//
+// The driver reads the decompressed print data from a pipe.
+//
+
+static bool				// O - `true` on success, `false` otherwise
+inflate_raw(pappl_job_t        *job,	// I - Job
+            pappl_pr_options_t *options,// I - Job options
+            pappl_device_t     *device)	// I - Device
+{
+  int		fd;			// Pipe to driver
+  char		pipename[64];		// Pipe filename
+  bool		ret;			// Return value
+
+
+  if ((fd = _papplJobInflateSpool(job)) < 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to open print file '%s': %s", job->filename, strerror(errno));
+    return (false);
+  }
+
+  snprintf(pipename, sizeof(pipename), "/dev/fd/%d", fd);
+  job->pipe_filename = pipename;
+
+  ret = (job->printer->psdriver.driver_data.printfile_cb)(job, options, device);
+
+  job->pipe_filename = NULL;
+
+  close(fd);
+
+  return (ret);
+}
+
+
 //
 // 'start_job()' - Start processing a job...
 //
@@ -921,8 +1081,8 @@ start_job(pappl_job_t *job)		// I - Job
 
 
   // Move the job to the 'processing' state...
-  pthread_rwlock_wrlock(&job->rwlock);
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
 
   papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Starting print job.");
 
@@ -930,14 +1090,23 @@ start_job(pappl_job_t *job)		// I - Job
   job->processing         = time(NULL);
   printer->processing_job = job;
 
-  pthread_rwlock_wrlock(&job->rwlock);
+  _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  _papplSystemJobChanged(printer->system, job);
 
   // Open the output device...
+  _papplMutexLock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
+
   while (!printer->device)
   {
     printer->device = papplDeviceOpen(printer->device_uri, job->name, papplLogDevice, job->system);
 
-    if (!printer->device)
+    if (printer->device)
+    {
+      printer->device->io_uring = (job->system->options & PAPPL_SOPTIONS_IO_URING) != 0;
+    }
+    else
     {
       // Log that the printer is unavailable then sleep for 5 seconds to retry.
       if (first_open)
@@ -945,17 +1114,114 @@ start_job(pappl_job_t *job)		// I - Job
         papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to open device '%s', pausing queue until printer becomes available.", printer->device_uri);
         first_open = false;
 
+        _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 	printer->state      = IPP_PSTATE_STOPPED;
 	printer->state_time = time(NULL);
+        _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
       }
 
+      _papplMutexUnlock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
       sleep(5);
+      _papplMutexLock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
     }
   }
 
+  _papplMutexUnlock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
+
   // Move the printer to the 'processing' state...
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
   printer->state      = IPP_PSTATE_PROCESSING;
   printer->state_time = time(NULL);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  _papplSystemAddEvent(printer->system, printer, NULL, _PAPPL_EVENT_PRINTER_STATE_CHANGED);
+
+  _papplTraceEnd(job->system, _PAPPL_TSTAGE_JOB_WAIT, job->trace_queued, job->job_id, printer->printer_id, 0);
+}
+
+
+//
+// 'stream_raw()' - Print a raw print file while it is being received.
+//
+// The driver reads the print data from a pipe that is fed from the print file
+// as the data arrives.
+//
+
+static bool				// O - `true` on success, `false` otherwise
+stream_raw(pappl_job_t        *job,	// I - Job
+           pappl_pr_options_t *options,	// I - Job options
+           pappl_device_t     *device)	// I - Device
+{
+  _pappl_feed_t	feed;			// Feed data
+  int		fds[2];			// Pipe to driver
+  pthread_t	tid;			// Feed thread
+  char		pipename[64];		// Pipe filename
+  bool		ret;			// Return value
+
+
+  memset(&feed, 0, sizeof(feed));
+  feed.job = job;
+
+  if ((feed.infd = open(job->filename, O_RDONLY | O_CLOEXEC)) < 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to open print file '%s': %s", job->filename, strerror(errno));
+    return (false);
+  }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(feed.infd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif // POSIX_FADV_SEQUENTIAL
+
+  if (pipe(fds))
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to create print pipe: %s", strerror(errno));
+    close(feed.infd);
+    return (false);
+  }
+
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+  feed.outfd = fds[1];
+
+  if (pthread_create(&tid, NULL, (void *(*)(void *))feed_raw, &feed))
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to create print feed thread: %s", strerror(errno));
+    close(feed.infd);
+    close(fds[0]);
+    close(fds[1]);
+    return (false);
+  }
+
+  // Have the driver read from the pipe...
+  snprintf(pipename, sizeof(pipename), "/dev/fd/%d", fds[0]);
+  job->pipe_filename = pipename;
+
+  ret = (job->printer->psdriver.driver_data.printfile_cb)(job, options, device);
+
+  job->pipe_filename = NULL;
+
+  // Stop the feed thread and collect the receive status...
+  pthread_mutex_lock(&job->receive_mutex);
+  feed.done = true;
+  pthread_cond_broadcast(&job->receive_cond);
+  pthread_mutex_unlock(&job->receive_mutex);
+
+  close(fds[0]);
+
+  pthread_join(tid, NULL);
+  close(feed.infd);
+
+  pthread_mutex_lock(&job->receive_mutex);
+  while (job->receiving)
+    pthread_cond_wait(&job->receive_cond, &job->receive_mutex);
+
+  if (job->receive_error)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to receive all of the print data.");
+    ret = false;
+  }
+  pthread_mutex_unlock(&job->receive_mutex);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  return (ret);
 }
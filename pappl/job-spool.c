@@ -0,0 +1,634 @@
+//
+// Job spool functions for the Printer Application Framework
+//
+// Copyright © 2019-2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+//
+// Include necessary headers...
+//
+
+#ifdef __linux
+#  define _GNU_SOURCE			// For memfd_create()
+#endif // __linux
+#include "pappl-private.h"
+#ifdef __linux
+#  include <sys/mman.h>
+#  include <sys/sendfile.h>
+#  include <sys/statvfs.h>
+#endif // __linux
+#include <signal.h>
+
+
+//
+// Local types...
+//
+
+typedef struct _pappl_inflate_s		// Decompression thread data
+{
+  cups_file_t	*fp;			// Compressed print file
+  int		fd;			// Pipe for decompressed data
+} _pappl_inflate_t;
+
+
+//
+// Local functions...
+//
+
+static void	*inflate_spool(_pappl_inflate_t *inflate);
+static void	release_spool(pappl_job_t *job);
+static void	reserve_spool(pappl_job_t *job, size_t length);
+static bool	spill_spool(pappl_job_t *job);
+static void	start_spool(pappl_job_t *job, int fd);
+
+
+//
+// '_papplJobCloseSpool()' - Finish writing the print file for a job.
+//
+// If "ok" is `true`, the print file is submitted for printing.  Otherwise the
+// print file is removed and the job is aborted, or for a job that is printed
+// while it is received, the job thread is told to abort it.
+//
+
+bool					// O - `true` on success, `false` on error
+_papplJobCloseSpool(pappl_job_t *job,	// I - Job
+                    bool        ok)	// I - `true` if all of the print data was written
+{
+  pappl_system_t	*system = job->system;
+					// System
+  pappl_printer_t	*printer = job->printer;
+					// Printer
+  bool			receiving;	// Printing while receiving?
+
+
+  if (job->spool_file)
+  {
+    // Finish the compressed data, which also closes the print file...
+    if (cupsFileClose(job->spool_file) && ok)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to write print file: %s", strerror(errno));
+      ok = false;
+    }
+
+    job->spool_file = NULL;
+    job->fd         = -1;
+  }
+
+  if (job->spool_ring)
+  {
+    // Wait for queued writes to complete...
+    if (!_papplUringFlush(job->spool_ring) && ok)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to write print file: %s", strerror(errno));
+      ok = false;
+    }
+
+    _papplUringDelete(job->spool_ring);
+    job->spool_ring = NULL;
+  }
+
+  // Give back any disk space that was reserved but not written...
+  release_spool(job);
+
+  if (job->fd >= 0)
+  {
+    if (job->spool_memory)
+    {
+      // Keep the memory file open until the job file is removed...
+      job->mem_fd = job->fd;
+    }
+    else if (close(job->fd) && ok)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to write print file: %s", strerror(errno));
+      ok = false;
+    }
+
+    job->fd = -1;
+  }
+
+  pthread_mutex_lock(&job->receive_mutex);
+  receiving = job->receiving;
+  pthread_mutex_unlock(&job->receive_mutex);
+
+  if (receiving)
+  {
+    // The job is already printing, let the job thread finish or abort it...
+    _papplJobFinishReceiving(job, ok);
+  }
+  else if (ok)
+  {
+    // Submit the job for processing...
+    _papplJobSubmitFile(job, job->spool_filename);
+  }
+  else
+  {
+    // Remove the print file and abort the job...
+    if (job->spool_memory)
+      _papplJobReleaseSpool(job);
+    else if (job->spool_filename)
+      unlink(job->spool_filename);
+
+    job->state     = IPP_JSTATE_ABORTED;
+    job->completed = time(NULL);
+
+    _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+    _papplJobListRemove(&printer->active_jobs, job);
+    _papplJobListAdd(&printer->completed_jobs, job);
+
+    _papplSystemScheduleCleanJobs(system, time(NULL) + 60);
+
+    _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+    _papplSystemJobChanged(system, job);
+  }
+
+  free(job->spool_filename);
+  job->spool_filename = NULL;
+
+  return (ok);
+}
+
+
+//
+// '_papplJobInflateSpool()' - Open the decompressed print file for a job.
+//
+// The print file is decompressed by a separate thread into a pipe, so the
+// returned file descriptor must be read sequentially.  The thread stops when
+// the pipe is closed.
+//
+
+int					// O - File descriptor or -1 on error
+_papplJobInflateSpool(pappl_job_t *job)	// I - Job
+{
+  _pappl_inflate_t	*inflate;	// Decompression thread data
+  int			fds[2];		// Pipe
+  pthread_t		tid;		// Decompression thread
+
+
+  if (!job->filename)
+  {
+    errno = ENOENT;
+    return (-1);
+  }
+
+  if ((inflate = (_pappl_inflate_t *)calloc(1, sizeof(_pappl_inflate_t))) == NULL)
+    return (-1);
+
+  if ((inflate->fp = cupsFileOpen(job->filename, "r")) == NULL)
+  {
+    free(inflate);
+    return (-1);
+  }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(cupsFileNumber(inflate->fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif // POSIX_FADV_SEQUENTIAL
+
+  if (pipe(fds))
+  {
+    cupsFileClose(inflate->fp);
+    free(inflate);
+    return (-1);
+  }
+
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+  inflate->fd = fds[1];
+
+  if (pthread_create(&tid, NULL, (void *(*)(void *))inflate_spool, inflate))
+  {
+    cupsFileClose(inflate->fp);
+    free(inflate);
+    close(fds[0]);
+    close(fds[1]);
+    return (-1);
+  }
+
+  pthread_detach(tid);
+
+  return (fds[0]);
+}
+
+
+//
+// '_papplJobOpenSpool()' - Create the print file for a job.
+//
+// Documents that are no larger than the system's in-memory spool limit are
+// kept in memory, and move to a file in the spool directory if they grow
+// beyond it.  The "length" argument is the expected length of the document,
+// if known, so that larger documents go directly to the spool directory.
+//
+// Raw documents in the spool directory are compressed when the
+// `PAPPL_SOPTIONS_COMPRESS_SPOOL` system option is set, unless they are
+// printed while they are received.
+//
+
+bool					// O - `true` on success, `false` on error
+_papplJobOpenSpool(pappl_job_t *job,	// I - Job
+                   size_t      length)	// I - Expected length or `0` if unknown
+{
+  pappl_system_t	*system = job->system;
+					// System
+  char			filename[1024];	// Print file
+
+
+  job->spool_bytes    = 0;
+  job->spool_reserved = 0;
+  job->spool_memory   = false;
+
+#ifdef __linux
+  pthread_mutex_lock(&system->spool_mutex);
+  job->spool_memory = system->spool_max_document > 0 && length <= system->spool_max_document && system->spool_used < system->spool_max_total;
+  pthread_mutex_unlock(&system->spool_mutex);
+
+  if (job->spool_memory)
+  {
+    // Start with an in-memory file, the driver and filters see it as
+    // "/dev/fd/N"...
+    snprintf(filename, sizeof(filename), "pappl-p%05dj%09d", job->printer->printer_id, job->job_id);
+
+    if ((job->fd = memfd_create(filename, MFD_CLOEXEC)) >= 0)
+    {
+      snprintf(filename, sizeof(filename), "/dev/fd/%d", job->fd);
+      job->spool_filename = strdup(filename);
+
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Created in-memory job file, format \"%s\".", job->format);
+      return (true);
+    }
+
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Unable to create in-memory job file: %s", strerror(errno));
+    job->spool_memory = false;
+  }
+#else
+  (void)length;
+#endif // __linux
+
+  // Create a file in the spool directory...
+  if ((job->fd = papplJobOpenFile(job, filename, sizeof(filename), system->directory, NULL, "w")) < 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to create print file: %s", strerror(errno));
+    return (false);
+  }
+
+  job->spool_filename = strdup(filename);
+
+  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Created job file \"%s\", format \"%s\".", filename, job->format);
+
+  // Raw print data can be printed while it is received...
+  if (!_papplJobStartReceiving(job, filename))
+    start_spool(job, job->fd);
+
+  // Reserve disk space for the whole document when the length is known, so
+  // the file isn't grown (and fragmented) one write at a time...
+  if (length > 0 && !job->spool_file)
+    reserve_spool(job, length);
+
+  return (true);
+}
+
+
+//
+// '_papplJobReleaseSpool()' - Free the in-memory print file for a job.
+//
+
+void
+_papplJobReleaseSpool(pappl_job_t *job)	// I - Job
+{
+  pappl_system_t	*system = job->system;
+					// System
+
+
+  if (!job->spool_memory)
+    return;
+
+  if (job->mem_fd >= 0)
+  {
+    close(job->mem_fd);
+    job->mem_fd = -1;
+  }
+
+  pthread_mutex_lock(&system->spool_mutex);
+  system->spool_used -= job->spool_bytes;
+  pthread_mutex_unlock(&system->spool_mutex);
+
+  job->spool_bytes  = 0;
+  job->spool_memory = false;
+}
+
+
+//
+// '_papplJobWriteSpool()' - Write print data to the print file for a job.
+//
+
+bool					// O - `true` on success, `false` on error
+_papplJobWriteSpool(
+    pappl_job_t *job,			// I - Job
+    const void  *buffer,		// I - Print data
+    size_t      bytes)			// I - Number of bytes
+{
+  pappl_system_t	*system = job->system;
+					// System
+  const char		*bufptr;	// Pointer into buffer
+  ssize_t		written;	// Bytes written
+
+
+  if (job->spool_memory)
+  {
+    // See if the document still fits in memory...
+    bool	fits;			// Does the data fit?
+
+    pthread_mutex_lock(&system->spool_mutex);
+    if ((fits = (job->spool_bytes + bytes) <= system->spool_max_document && (system->spool_used + bytes) <= system->spool_max_total) == true)
+      system->spool_used += bytes;
+    pthread_mutex_unlock(&system->spool_mutex);
+
+    if (!fits && !spill_spool(job))
+      return (false);
+  }
+
+  if (job->spool_file)
+  {
+    // Compress the data...
+    if (cupsFileWrite(job->spool_file, buffer, bytes) < 0)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to write print file: %s", strerror(errno));
+      return (false);
+    }
+
+    job->spool_bytes += bytes;
+
+    return (true);
+  }
+  else if (job->spool_ring)
+  {
+    // Queue the data for writing at the end of the print file...
+    if (!_papplUringWrite(job->spool_ring, job->fd, (off_t)job->spool_bytes, buffer, bytes))
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to write print file: %s", strerror(errno));
+      return (false);
+    }
+
+    job->spool_bytes += bytes;
+
+    return (true);
+  }
+
+  job->spool_bytes += bytes;
+
+  for (bufptr = (const char *)buffer; bytes > 0; bufptr += written, bytes -= (size_t)written)
+  {
+    if ((written = write(job->fd, bufptr, bytes)) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+      {
+        written = 0;
+        continue;
+      }
+
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to write print file: %s", strerror(errno));
+      return (false);
+    }
+
+    _papplJobAddReceived(job, (size_t)written);
+  }
+
+  return (true);
+}
+
+
+//
+// 'inflate_spool()' - Decompress a print file into a pipe.
+//
+// SIGPIPE is blocked in this thread so that a reader that closes the pipe
+// early (on cancel or a driver error) just ends the decompression with an
+// EPIPE error instead of terminating the application.
+//
+
+static void *				// O - Thread exit status
+inflate_spool(_pappl_inflate_t *inflate)// I - Decompression thread data
+{
+  char		buffer[65536],		// Decompressed data
+		*bufptr;		// Pointer into buffer
+  ssize_t	bytes,			// Bytes read
+		written;		// Bytes written
+  sigset_t	pipeset,		// SIGPIPE signal set
+		pending;		// Pending signals
+  int		sig;			// Signal
+
+
+  sigemptyset(&pipeset);
+  sigaddset(&pipeset, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeset, NULL);
+
+  while ((bytes = cupsFileRead(inflate->fp, buffer, sizeof(buffer))) > 0)
+  {
+    for (bufptr = buffer; bytes > 0; bufptr += written, bytes -= written)
+    {
+      if ((written = write(inflate->fd, bufptr, (size_t)bytes)) < 0)
+      {
+        if (errno == EINTR || errno == EAGAIN)
+        {
+          written = 0;
+          continue;
+        }
+
+        // The reader closed the pipe, so discard the SIGPIPE for it...
+        if (errno == EPIPE && !sigpending(&pending) && sigismember(&pending, SIGPIPE))
+          sigwait(&pipeset, &sig);
+
+        goto done;
+      }
+    }
+  }
+
+  done:
+
+  cupsFileClose(inflate->fp);
+  close(inflate->fd);
+  free(inflate);
+
+  return (NULL);
+}
+
+
+//
+// 'release_spool()' - Release unused disk space reserved for a print file.
+//
+// The reservation is larger than the print file when the upload was truncated
+// or aborted, so the blocks past the data that was written are freed.
+//
+
+static void
+release_spool(pappl_job_t *job)		// I - Job
+{
+#ifdef __linux
+  if (job->spool_reserved > job->spool_bytes && job->fd >= 0)
+  {
+    if (fallocate(job->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)job->spool_bytes, (off_t)(job->spool_reserved - job->spool_bytes)) && ftruncate(job->fd, (off_t)job->spool_bytes))
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Unable to release %lu reserved bytes for print file: %s", (unsigned long)(job->spool_reserved - job->spool_bytes), strerror(errno));
+  }
+#endif // __linux
+
+  job->spool_reserved = 0;
+}
+
+
+//
+// 'reserve_spool()' - Reserve disk space for a print file.
+//
+// Large documents and documents that would use a significant part of the
+// remaining disk space are not reserved, since the client can claim any
+// length up front and a reservation is only a hint for the file system.
+//
+
+static void
+reserve_spool(pappl_job_t *job,		// I - Job
+              size_t      length)	// I - Expected length of print file
+{
+#ifdef __linux
+  struct statvfs	fsinfo;		// File system information
+
+
+  if (length > _PAPPL_SPOOL_MAX_RESERVE)
+    return;
+
+  if (fstatvfs(job->fd, &fsinfo) || length > (size_t)((unsigned long long)fsinfo.f_bavail * fsinfo.f_frsize / _PAPPL_SPOOL_RESERVE_FRACTION))
+    return;
+
+  if (fallocate(job->fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)length))
+  {
+    if (errno != EOPNOTSUPP)
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Unable to preallocate %lu bytes for print file: %s", (unsigned long)length, strerror(errno));
+    return;
+  }
+
+  job->spool_reserved = length;
+
+#else
+  (void)job;
+  (void)length;
+#endif // __linux
+}
+
+
+//
+// 'spill_spool()' - Move an in-memory print file to the spool directory.
+//
+
+static bool				// O - `true` on success, `false` on error
+spill_spool(pappl_job_t *job)		// I - Job
+{
+  int		fd;			// Spool file
+  char		filename[1024];		// Spool filename
+  size_t	bytes = job->spool_bytes;
+					// Bytes in memory file
+  bool		receiving;		// Printing while receiving?
+
+
+  if ((fd = papplJobOpenFile(job, filename, sizeof(filename), job->system->directory, NULL, "w")) < 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to create print file: %s", strerror(errno));
+    return (false);
+  }
+
+  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Moving in-memory job file to \"%s\".", filename);
+
+  // Now that the document is known to be large, print it while it is
+  // received if possible.  The job thread only reads the data that has been
+  // reported with _papplJobAddReceived...
+  if ((receiving = _papplJobStartReceiving(job, filename)) == false)
+    start_spool(job, fd);
+
+#ifdef __linux
+  if (job->spool_file)
+  {
+    // Compress the in-memory data...
+    void	*data;			// Mapped memory file
+
+    if ((data = mmap(NULL, bytes, PROT_READ, MAP_SHARED, job->fd, 0)) == MAP_FAILED || cupsFileWrite(job->spool_file, data, bytes) < 0)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to write print file: %s", strerror(errno));
+
+      if (data != MAP_FAILED)
+        munmap(data, bytes);
+
+      cupsFileClose(job->spool_file);
+      job->spool_file       = NULL;
+      job->spool_compressed = false;
+      unlink(filename);
+      return (false);
+    }
+
+    munmap(data, bytes);
+  }
+  else
+  {
+    off_t	offset = 0;		// Offset in memory file
+
+    while ((size_t)offset < bytes)
+    {
+      ssize_t	copied;			// Bytes copied
+
+      if ((copied = sendfile(fd, job->fd, &offset, bytes - (size_t)offset)) <= 0)
+      {
+        if (copied < 0 && (errno == EINTR || errno == EAGAIN))
+          continue;
+
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to write print file: %s", strerror(errno));
+        close(fd);
+        unlink(filename);
+        return (false);
+      }
+    }
+  }
+#endif // __linux
+
+  // Switch to the new file, then release the memory...
+  job->mem_fd = job->fd;
+  job->fd     = fd;
+
+  _papplJobReleaseSpool(job);
+
+  job->spool_bytes = bytes;
+
+  free(job->spool_filename);
+  job->spool_filename = strdup(filename);
+
+  if (receiving)
+    _papplJobAddReceived(job, bytes);
+
+  return (true);
+}
+
+
+//
+// 'start_spool()' - Start writing a print file in the spool directory.
+//
+// Raw print files are compressed if the `PAPPL_SOPTIONS_COMPRESS_SPOOL` system
+// option is set, otherwise writes are queued with io_uring when enabled.
+//
+
+static void
+start_spool(pappl_job_t *job,		// I - Job
+            int         fd)		// I - Print file
+{
+  if ((job->system->options & PAPPL_SOPTIONS_COMPRESS_SPOOL) && _papplJobIsRaw(job))
+  {
+    // Use fast gzip compression, which the job thread decompresses when it
+    // reads the print file...
+    if ((job->spool_file = cupsFileOpenFd(fd, "w1")) != NULL)
+    {
+      job->spool_compressed = true;
+      return;
+    }
+
+    papplLogJob(job, PAPPL_LOGLEVEL_WARN, "Unable to compress print file: %s", strerror(errno));
+  }
+
+  job->spool_ring = _papplUringCreate((job->system->options & PAPPL_SOPTIONS_IO_URING) != 0);
+}
@@ -15,6 +15,27 @@
 #include "pappl-private.h"
 
 
+//
+// '_papplJobAddReceived()' - Note that more print data has been written to
+//                            a job that is printed while it is received.
+//
+// Nothing is done if the job is not printed while it is received.
+//
+
+void
+_papplJobAddReceived(pappl_job_t *job,	// I - Job
+                     size_t      bytes)	// I - Number of bytes written
+{
+  pthread_mutex_lock(&job->receive_mutex);
+  if (job->receiving)
+  {
+    job->received += (off_t)bytes;
+    pthread_cond_broadcast(&job->receive_cond);
+  }
+  pthread_mutex_unlock(&job->receive_mutex);
+}
+
+
 //
 // 'papplJobCancel()' - Cancel a job.
 //
@@ -29,8 +50,8 @@ papplJobCancel(pappl_job_t *job)	// I - Job
   if (!job)
     return;
 
-  pthread_rwlock_wrlock(&job->rwlock);
-  pthread_rwlock_wrlock(&job->printer->rwlock);
+  _papplRWLockWrite(&job->printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
 
   if (job->state == IPP_JSTATE_PROCESSING || (job->state == IPP_JSTATE_HELD && job->fd >= 0))
   {
@@ -43,16 +64,16 @@ papplJobCancel(pappl_job_t *job)	// I - Job
 
     _papplJobRemoveFile(job);
 
-    cupsArrayRemove(job->printer->active_jobs, job);
-    cupsArrayAdd(job->printer->completed_jobs, job);
+    _papplJobListRemove(&job->printer->active_jobs, job);
+    _papplJobListAdd(&job->printer->completed_jobs, job);
   }
 
-  pthread_rwlock_unlock(&job->printer->rwlock);
+  _papplSystemScheduleCleanJobs(job->system, time(NULL) + 60);
 
-  if (!job->system->clean_time)
-    job->system->clean_time = time(NULL) + 60;
+  _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+  _papplRWUnlock(&job->printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  pthread_rwlock_unlock(&job->rwlock);
+  _papplSystemJobChanged(job->system, job);
 }
 
 
@@ -78,11 +99,13 @@ _papplJobCreate(
 
 
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  if (printer->max_active_jobs > 0 && cupsArrayCount(printer->active_jobs) >= printer->max_active_jobs)
+  if (printer->max_active_jobs > 0 && printer->active_jobs.count >= printer->max_active_jobs)
   {
-    pthread_rwlock_unlock(&printer->rwlock);
+    _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+    _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
     return (NULL);
   }
 
@@ -90,12 +113,17 @@ _papplJobCreate(
   if ((job = calloc(1, sizeof(pappl_job_t))) == NULL)
   {
     papplLog(printer->system, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for job: %s", strerror(errno));
-    pthread_rwlock_unlock(&printer->rwlock);
+    _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+    _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
     return (NULL);
   }
 
+  pthread_mutex_init(&job->receive_mutex, NULL);
+  pthread_cond_init(&job->receive_cond, NULL);
+
   job->attrs   = ippNew();
   job->fd      = -1;
+  job->mem_fd  = -1;
   job->format  = format;
   job->name    = job_name;
   job->printer = printer;
@@ -149,14 +177,15 @@ _papplJobCreate(
   ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI, "job-uuid", NULL, job_uuid);
   ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI, "job-printer-uri", NULL, job_printer_uri);
 
-  cupsArrayAdd(printer->all_jobs, job);
+  _papplJobListAdd(&printer->all_jobs, job);
 
   if (!job_id)
-    cupsArrayAdd(printer->active_jobs, job);
+    _papplJobListAdd(&printer->active_jobs, job);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
-  _papplSystemConfigChanged(printer->system);
+  _papplSystemJobChanged(printer->system, job);
 
   return (job);
 }
@@ -206,10 +235,52 @@ _papplJobDelete(pappl_job_t *job)	// I - Job
   if (job->state >= IPP_JSTATE_CANCELED)
     _papplJobRemoveFile(job);
 
+  pthread_mutex_destroy(&job->receive_mutex);
+  pthread_cond_destroy(&job->receive_cond);
+
   free(job);
 }
 
 
+//
+// '_papplJobFinishReceiving()' - Finish receiving print data for a job that is
+//                                printed while it is received.
+//
+// If "ok" is `false`, the job is aborted once the data that was received has
+// been sent to the driver.
+//
+
+void
+_papplJobFinishReceiving(
+    pappl_job_t *job,			// I - Job
+    bool        ok)			// I - `true` if all of the print data was received
+{
+  pthread_mutex_lock(&job->receive_mutex);
+  job->receiving     = false;
+  job->receive_error = !ok;
+  pthread_cond_broadcast(&job->receive_cond);
+  pthread_mutex_unlock(&job->receive_mutex);
+}
+
+
+//
+// '_papplJobIsRaw()' - Determine whether a job's print data goes to the
+//                      driver as-is.
+//
+
+bool					// O - `true` if raw, `false` if filtered
+_papplJobIsRaw(pappl_job_t *job)	// I - Job
+{
+  pappl_printer_t	*printer = job->printer;
+					// Printer
+  const char		*format = printer->psdriver.driver_data.format;
+					// Driver format
+
+
+  return (job->format && format && !strcmp(job->format, format) && printer->psdriver.driver_data.printfile_cb && !_papplSystemFindMIMEFilter(job->system, job->format, format) && !_papplSystemFindMIMEFilter(job->system, job->format, "image/pwg-raster"));
+}
+
+
 //
 // 'papplJobOpenFile()' - Create or open a file for the document in a job.
 //
@@ -221,7 +292,9 @@ _papplJobDelete(pappl_job_t *job)	// I - Job
 //
 // The "mode" argument is "r" to read an existing job file or "w" to write a
 // new job file.  New files are created with restricted permissions for
-// security purposes.
+// security purposes.  When the job's document is compressed in the spool
+// directory, reading it returns a pipe with the decompressed data, which must
+// be read sequentially.
 //
 
 int					// O - File descriptor or -1 on error
@@ -285,7 +358,22 @@ papplJobOpenFile(
   snprintf(fname, fnamesize, "%s/p%05dj%09d-%s.%s", directory ? directory : job->system->directory, job->printer->printer_id, job->job_id, name, ext);
 
   if (!strcmp(mode, "r"))
-    return (open(fname, O_RDONLY | O_NOFOLLOW | O_CLOEXEC));
+  {
+    int	fd;				// File descriptor
+
+    if (job->spool_compressed && job->filename && !strcmp(fname, job->filename))
+      return (_papplJobInflateSpool(job));
+
+    fd = open(fname, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Job files are read from start to finish...
+    if (fd >= 0)
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif // POSIX_FADV_SEQUENTIAL
+
+    return (fd);
+  }
   else if (!strcmp(mode, "w"))
     return (open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600));
   else if (!strcmp(mode, "x"))
@@ -306,15 +394,91 @@ _papplJobRemoveFile(pappl_job_t *job)	// I - Job
 					// Length of spool directory
 
 
-  // Only remove the file if it is in spool directory...
+  // Only remove the file if it is in spool directory, which also frees its
+  // cached pages...
   if (job->filename && !strncmp(job->filename, job->system->directory, dirlen) && job->filename[dirlen] == '/')
+  {
     unlink(job->filename);
+  }
+#ifdef POSIX_FADV_DONTNEED
+  else if (job->filename && strncmp(job->filename, "/dev/", 5))
+  {
+    // Otherwise drop the printed file from the page cache so large jobs don't
+    // push out other data...
+    int	fd;				// File descriptor
+
+    if ((fd = open(job->filename, O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) >= 0)
+    {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+  }
+#endif // POSIX_FADV_DONTNEED
+
+  // Free any in-memory file...
+  _papplJobReleaseSpool(job);
 
   free(job->filename);
   job->filename = NULL;
 }
 
 
+//
+// '_papplJobStartReceiving()' - Start printing a job while it is received.
+//
+// Print data that goes to the driver as-is (no filter) can be printed while it
+// is still being written to the print file, if the printer has nothing else
+// to do.  If so, the job is submitted right away, the receiver reports its
+// progress with `_papplJobAddReceived`, and finishes with
+// `_papplJobFinishReceiving` instead of `_papplJobSubmitFile`.
+//
+
+bool					// O - `true` if the job was submitted, `false` to spool
+_papplJobStartReceiving(
+    pappl_job_t *job,			// I - Job
+    const char  *filename)		// I - Print file being written
+{
+  pappl_printer_t	*printer = job->printer;
+					// Printer
+  pappl_job_t		*pjob;		// Current job
+  bool			ret;		// Return value
+
+
+  // Only raw print data is streamed, and only for drivers that can read it
+  // from a pipe...
+  if (!printer->psdriver.driver_data.print_while_receiving || !_papplJobIsRaw(job))
+    return (false);
+
+  // ...and only when the printer is not busy with other jobs.
+  _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  ret = !printer->processing_job && !printer->is_deleted && !printer->is_stopped && printer->state != IPP_PSTATE_STOPPED;
+
+  for (pjob = printer->active_jobs.first; ret && pjob; pjob = _papplJobListNext(&printer->active_jobs, pjob))
+  {
+    if (pjob != job && pjob->state == IPP_JSTATE_PENDING)
+      ret = false;
+  }
+
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  if (!ret)
+    return (false);
+
+  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Printing while receiving.");
+
+  pthread_mutex_lock(&job->receive_mutex);
+  job->receiving     = true;
+  job->receive_error = false;
+  job->received      = 0;
+  pthread_mutex_unlock(&job->receive_mutex);
+
+  _papplJobSubmitFile(job, filename);
+
+  return (true);
+}
+
+
 //
 // '_papplJobSubmitFile()' - Submit a file for printing.
 //
@@ -385,7 +549,10 @@ _papplJobSubmitFile(
   job->filename = strdup(filename);
 
   // Process the job...
-  job->state = IPP_JSTATE_PENDING;
+  job->state        = IPP_JSTATE_PENDING;
+  job->trace_queued = _papplTraceStart(job->system);
+
+  _papplSystemJobChanged(job->system, job);
 
   _papplPrinterCheckJobs(job->printer);
 }
@@ -420,40 +587,32 @@ _papplPrinterCheckJobs(
     return;
   }
 
-  pthread_rwlock_wrlock(&printer->rwlock);
-
-  // Enumerate the jobs.  Since we have a writer (exclusive) lock, we are the
-  // only thread enumerating and can use cupsArrayFirst/Last...
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  for (job = (pappl_job_t *)cupsArrayFirst(printer->active_jobs); job; job = (pappl_job_t *)cupsArrayNext(printer->active_jobs))
+  // Start the oldest pending job...
+  if ((job = _papplJobListOldest(&printer->active_jobs, IPP_JSTATE_PENDING)) != NULL)
   {
-    if (job->state == IPP_JSTATE_PENDING)
-    {
-      pthread_t	t;			// Thread
+    pthread_t	t;			// Thread
 
-      papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Starting job %d.", job->job_id);
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Starting job %d.", job->job_id);
 
-      if (pthread_create(&t, NULL, (void *(*)(void *))_papplJobProcess, job))
-      {
-	job->state     = IPP_JSTATE_ABORTED;
-	job->completed = time(NULL);
+    if (pthread_create(&t, NULL, (void *(*)(void *))_papplJobProcess, job))
+    {
+      job->state     = IPP_JSTATE_ABORTED;
+      job->completed = time(NULL);
 
-	cupsArrayRemove(printer->active_jobs, job);
-	cupsArrayAdd(printer->completed_jobs, job);
+      _papplJobListRemove(&printer->active_jobs, job);
+      _papplJobListAdd(&printer->completed_jobs, job);
 
-	if (!printer->system->clean_time)
-	  printer->system->clean_time = time(NULL) + 60;
-      }
-      else
-	pthread_detach(t);
-      break;
+      _papplSystemScheduleCleanJobs(printer->system, time(NULL) + 60);
     }
+    else
+      pthread_detach(t);
   }
-
-  if (!job)
+  else
     papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "No jobs to process at this time.");
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 }
 
 
@@ -468,15 +627,12 @@ papplPrinterFindJob(
     pappl_printer_t *printer,		// I - Printer
     int             job_id)		// I - Job ID
 {
-  pappl_job_t		key,		// Job search key
-			*job;		// Matching job, if any
+  pappl_job_t		*job;		// Matching job, if any
 
 
-  key.job_id = job_id;
-
-  pthread_rwlock_rdlock(&(printer->rwlock));
-  job = (pappl_job_t *)cupsArrayFind(printer->all_jobs, &key);
-  pthread_rwlock_unlock(&(printer->rwlock));
+  _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  job = _papplJobListFind(&printer->all_jobs, job_id);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
   return (job);
 }
@@ -500,13 +656,19 @@ papplSystemCleanJobs(
   int			i,		// Looping var
 			count;		// Number of printers
   pappl_printer_t	*printer;	// Current printer
-  pappl_job_t		*job;		// Current job
+  pappl_job_t		*job,		// Current job
+			*prev;		// Previous (newer) job
   time_t		cleantime;	// Clean time
+  _pappl_jchange_t	*deleted = NULL,// Deleted jobs
+			*temp;		// New deleted jobs array
+  size_t		num_deleted = 0,// Number of deleted jobs
+			alloc_deleted = 0;
+					// Allocated deleted jobs
 
 
   cleantime = time(NULL) - 60;
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   // Loop through the printers.
   //
@@ -517,27 +679,54 @@ papplSystemCleanJobs(
   {
     printer = (pappl_printer_t *)cupsArrayIndex(system->printers, i);
 
-    if (cupsArrayCount(printer->completed_jobs) == 0 || printer->max_completed_jobs <= 0)
+    if (printer->completed_jobs.count == 0 || printer->max_completed_jobs <= 0)
       continue;
 
-    pthread_rwlock_wrlock(&printer->rwlock);
-
-    // Enumerate the jobs.  Since we have a writer (exclusive) lock, we are the
-    // only thread enumerating and can use cupsArrayFirst/Last...
+    _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-    for (job = (pappl_job_t *)cupsArrayFirst(printer->completed_jobs); job; job = (pappl_job_t *)cupsArrayNext(printer->completed_jobs))
+    // Enumerate the jobs, oldest first...
+    for (job = printer->completed_jobs.last; job; job = prev)
     {
-      if (job->completed && job->completed < cleantime && cupsArrayCount(printer->completed_jobs) > printer->max_completed_jobs)
+      prev = _papplJobListPrev(&printer->completed_jobs, job);
+
+      if (job->completed && job->completed < cleantime && printer->completed_jobs.count > printer->max_completed_jobs)
       {
-	cupsArrayRemove(printer->completed_jobs, job);
-	cupsArrayRemove(printer->all_jobs, job);
+        // Remember the job so its deletion can be journaled...
+        if (num_deleted >= alloc_deleted && (temp = (_pappl_jchange_t *)realloc(deleted, (alloc_deleted + 32) * sizeof(_pappl_jchange_t))) != NULL)
+        {
+          deleted       = temp;
+          alloc_deleted += 32;
+        }
+
+        if (num_deleted < alloc_deleted)
+        {
+          deleted[num_deleted].printer_id = printer->printer_id;
+          deleted[num_deleted].job_id     = job->job_id;
+          num_deleted ++;
+        }
+
+	_papplJobListRemove(&printer->completed_jobs, job);
+	_papplJobListRemove(&printer->all_jobs, job);
+	_papplJobDelete(job);
       }
       else
+      {
+        // Check again once a recent job is old enough to be deleted...
+        if (job->completed && printer->completed_jobs.count > printer->max_completed_jobs)
+          _papplSystemScheduleCleanJobs(system, job->completed + 61);
 	break;
+      }
     }
 
-    pthread_rwlock_unlock(&printer->rwlock);
+    _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
   }
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+
+  // Record the deleted jobs in the state journal so they don't come back from
+  // an older state file.  This needs the system write lock...
+  for (temp = deleted; num_deleted > 0; num_deleted --, temp ++)
+    _papplSystemJobDeleted(system, temp->printer_id, temp->job_id);
+
+  free(deleted);
 }
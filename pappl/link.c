@@ -46,7 +46,7 @@ papplPrinterAddLink(
   if (!printer || !label || !path_or_url)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   if (!printer->links)
     printer->links = cupsArrayNew3((cups_array_func_t)compare_links, NULL, NULL, 0, (cups_acopy_func_t)copy_link, (cups_afree_func_t)free_link);
@@ -58,7 +58,7 @@ papplPrinterAddLink(
   if (!cupsArrayFind(printer->links, &l))
     cupsArrayAdd(printer->links, &l);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 }
 
 
@@ -79,13 +79,13 @@ papplPrinterRemoveLink(
   if (!printer || !label)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   l.label = (char *)label;
 
   cupsArrayRemove(printer->links, &l);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 }
 
 
@@ -112,7 +112,7 @@ papplSystemAddLink(
   if (!system || !label || !path_or_url)
     return;
 
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   if (!system->links)
     system->links = cupsArrayNew3((cups_array_func_t)compare_links, NULL, NULL, 0, (cups_acopy_func_t)copy_link, (cups_afree_func_t)free_link);
@@ -124,7 +124,7 @@ papplSystemAddLink(
   if (!cupsArrayFind(system->links, &l))
     cupsArrayAdd(system->links, &l);
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 }
 
 
@@ -145,13 +145,13 @@ papplSystemRemoveLink(
   if (!system || !label)
     return;
 
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   l.label = (char *)label;
 
   cupsArrayRemove(system->links, &l);
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 }
 
 
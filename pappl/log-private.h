@@ -16,6 +16,39 @@
 
 #  include "base-private.h"
 #  include "log.h"
+#  include <stdatomic.h>
+
+
+//
+// Constants...
+//
+
+#  define _PAPPL_LOG_RING_SIZE	256	// Number of messages in log ring (power of 2)
+#  define _PAPPL_LOG_LINE_SIZE	2048	// Maximum length of a log line
+#  define _PAPPL_LOGCAT_MAX	5	// Number of log categories
+
+
+//
+// Macros...
+//
+
+// Is the given category/level enabled?  Only one atomic load, so it is cheap
+// enough to use before doing any work to log a message.  Out-of-range levels
+// (including PAPPL_LOGLEVEL_UNSPEC) and categories are never enabled...
+#  define _papplLogEnabled(system,category,level) ((unsigned)(level) <= (unsigned)PAPPL_LOGLEVEL_FATAL && (unsigned)(category) < _PAPPL_LOGCAT_MAX && ((atomic_load_explicit(&(system)->logmask, memory_order_relaxed) >> ((unsigned)(category) * 5 + (unsigned)(level))) & 1))
+
+
+//
+// Types...
+//
+
+typedef struct _pappl_logmsg_s		// Log ring message
+{
+  atomic_size_t		seq;			// Sequence number for ring
+  size_t		length;			// Length of message
+  char			buffer[_PAPPL_LOG_LINE_SIZE];
+						// Formatted message
+} _pappl_logmsg_t;
 
 
 //
@@ -23,6 +56,10 @@
 //
 
 extern void	_papplLogAttributes(pappl_client_t *client, const char *title, ipp_t *ipp, bool is_response) _PAPPL_PRIVATE;
+extern void	_papplLogClose(pappl_system_t *system) _PAPPL_PRIVATE;
 extern void	_papplLogOpen(pappl_system_t *system) _PAPPL_PRIVATE;
+extern size_t	_papplLogTail(int fd, off_t *offset, pappl_loglevel_t level, const char *match, char *buffer, size_t bufsize) _PAPPL_PRIVATE;
+extern bool	_papplLogWait(pappl_system_t *system, off_t offset, int msecs) _PAPPL_PRIVATE;
+extern void	_papplLogUpdateMask(pappl_system_t *system) _PAPPL_PRIVATE;
 
 #endif // !_PAPPL_LOG_PRIVATE_H_
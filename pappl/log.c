@@ -17,15 +17,28 @@
 #include "printer-private.h"
 #include "system-private.h"
 #include <stdarg.h>
+#include <sched.h>
 #include <syslog.h>
+#include <sys/uio.h>
+
+
+//
+// Local constants...
+//
+
+#define _PAPPL_LOG_BATCH	64	// Maximum number of messages per write
 
 
 //
 // Local functions...
 //
 
-static void	rotate_log(pappl_system_t *system);
+static size_t	format_log(pappl_loglevel_t level, const char *message, va_list ap, char *buffer, size_t bufsize);
+static void	*log_thread(pappl_system_t *system);
+static void	open_log(pappl_system_t *system);
+static bool	rotate_log(pappl_system_t *system);
 static void	write_log(pappl_system_t *system, pappl_loglevel_t level, const char *message, va_list ap);
+static void	write_logf(pappl_system_t *system, pappl_loglevel_t level, const char *message, ...) _PAPPL_FORMAT(3,4);
 
 
 //
@@ -33,7 +46,11 @@ static void	write_log(pappl_system_t *system, pappl_loglevel_t level, const char
 //
 
 static pthread_mutex_t	log_mutex = PTHREAD_MUTEX_INITIALIZER;
-					// Log rotation mutex
+					// Log file mutex
+static pthread_cond_t	log_cond = PTHREAD_COND_INITIALIZER;
+					// Log file update condition
+static __thread time_t	log_time = 0;	// Time for cached date/time prefix
+static __thread char	log_date[20];	// Cached "YYYY-MM-DDTHH:MM:SS" prefix
 static const int	syslevels[] =	// Mapping of log levels to syslog
 {
   LOG_DEBUG | LOG_PID | LOG_LPR,
@@ -86,7 +103,7 @@ papplLog(pappl_system_t   *system,	// I - System
     return;
   }
 
-  if (level < system->loglevel)
+  if (!_papplLogEnabled(system, PAPPL_LOGCAT_SYSTEM, level))
     return;
 
   va_start(ap, message);
@@ -126,7 +143,7 @@ _papplLogAttributes(
   if (!client || !title || !ipp)
     return;
 
-  if (client->system->loglevel > PAPPL_LOGLEVEL_DEBUG)
+  if (!_papplLogEnabled(client->system, PAPPL_LOGCAT_CLIENT, PAPPL_LOGLEVEL_DEBUG))
     return;
 
   major = ippGetVersion(ipp, &minor);
@@ -186,7 +203,7 @@ papplLogClient(
   if (!client || !message)
     return;
 
-  if (level < client->system->loglevel)
+  if (!_papplLogEnabled(client->system, PAPPL_LOGCAT_CLIENT, level))
     return;
 
   snprintf(cmessage, sizeof(cmessage), "[Client %d] %s", client->number, message);
@@ -201,6 +218,34 @@ papplLogClient(
 }
 
 
+//
+// '_papplLogClose()' - Stop the log writer thread.
+//
+// Any queued log messages are written before this function returns.
+//
+
+void
+_papplLogClose(pappl_system_t *system)	// I - System
+{
+  if (!system->logring)
+    return;
+
+  // Tell the log writer thread to stop and wait for it to finish...
+  pthread_mutex_lock(&system->logwait_mutex);
+  system->logstop = true;
+  pthread_cond_signal(&system->logwait_cond);
+  pthread_mutex_unlock(&system->logwait_mutex);
+
+  pthread_join(system->logtid, NULL);
+
+  pthread_mutex_destroy(&system->logwait_mutex);
+  pthread_cond_destroy(&system->logwait_cond);
+
+  free(system->logring);
+  system->logring = NULL;
+}
+
+
 //
 // 'papplLogDevice()' - Log a device error for the system...
 //
@@ -216,7 +261,16 @@ papplLogDevice(
 					// System
 
 
-  papplLog(system, PAPPL_LOGLEVEL_ERROR, "[Device] %s", message);
+  if (!system || !message)
+    return;
+
+  if (!_papplLogEnabled(system, PAPPL_LOGCAT_DEVICE, PAPPL_LOGLEVEL_ERROR))
+    return;
+
+  if (system->logfd >= 0)
+    write_logf(system, PAPPL_LOGLEVEL_ERROR, "[Device] %s", message);
+  else
+    syslog(syslevels[PAPPL_LOGLEVEL_ERROR], "[Device] %s", message);
 }
 
 
@@ -251,7 +305,7 @@ papplLogJob(
   if (!job || !message)
     return;
 
-  if (level < job->system->loglevel)
+  if (!_papplLogEnabled(job->system, PAPPL_LOGCAT_JOB, level))
     return;
 
   snprintf(jmessage, sizeof(jmessage), "[Job %d] %s", job->job_id, message);
@@ -269,38 +323,47 @@ papplLogJob(
 //
 // '_papplLogOpen()' - Open the log file
 //
+// Messages written to a log file (or the standard error) are queued by the
+// logging thread and written by a separate log writer thread, which is
+// started the first time the log is opened.
+//
 
 void
 _papplLogOpen(
     pappl_system_t *system)		// I - System
 {
+  size_t	i;			// Looping var
+
+
   // Open the log file...
-  if (!strcmp(system->logfile, "syslog"))
-  {
-    // Log to syslog...
-    system->logfd = -1;
-  }
-  else if (!strcmp(system->logfile, "-"))
-  {
-    // Log to stderr...
-    system->logfd = 2;
-  }
-  else
+  pthread_mutex_lock(&log_mutex);
+  open_log(system);
+  pthread_mutex_unlock(&log_mutex);
+
+  // Start the log writer thread as needed...
+  if (system->logfd >= 0 && !system->logring && (system->logring = calloc(_PAPPL_LOG_RING_SIZE, sizeof(_pappl_logmsg_t))) != NULL)
   {
-    int	oldfd = system->logfd;		// Old log file descriptor
+    for (i = 0; i < _PAPPL_LOG_RING_SIZE; i ++)
+      atomic_init(&system->logring[i].seq, i);
 
-    // Log to a file...
-    if ((system->logfd = open(system->logfile, O_CREAT | O_WRONLY | O_APPEND | O_NOFOLLOW | O_CLOEXEC, 0600)) < 0)
+    atomic_init(&system->loghead, 0);
+    atomic_init(&system->logwaiting, false);
+
+    system->logtail = 0;
+    system->logstop = false;
+
+    pthread_mutex_init(&system->logwait_mutex, NULL);
+    pthread_cond_init(&system->logwait_cond, NULL);
+
+    if (pthread_create(&system->logtid, NULL, (void *(*)(void *))log_thread, system))
     {
-      // Fallback to logging to stderr if we can't open the log file...
-      perror(system->logfile);
+      // Unable to create the log writer thread, write log messages directly...
+      pthread_mutex_destroy(&system->logwait_mutex);
+      pthread_cond_destroy(&system->logwait_cond);
 
-      system->logfd = 2;
+      free(system->logring);
+      system->logring = NULL;
     }
-
-    // Close any old file...
-    if (oldfd != -1)
-      close(oldfd);
   }
 
   // Log the system status information
@@ -341,7 +404,7 @@ papplLogPrinter(
   if (!printer || !message)
     return;
 
-  if (level < printer->system->loglevel)
+  if (!_papplLogEnabled(printer->system, PAPPL_LOGCAT_PRINTER, level))
     return;
 
   // Prefix the message with "[Printer foo]", making sure to not insert any
@@ -370,43 +433,175 @@ papplLogPrinter(
 
 
 //
-// 'rotate_log()' - Rotate the log file...
+// '_papplLogTail()' - Read lines from a log file.
+//
+// This function reads complete log lines starting at the specified offset
+// using `pread`, so the same file descriptor can be shared and no seeking is
+// needed.  Lines below the specified log level or that do not contain the
+// "match" string (if not `NULL`) are dropped, and the offset is advanced past
+// all of the lines that were read.
+//
+// Since matching lines can be dropped, callers should check whether the
+// offset has changed and not just the number of bytes returned.
 //
 
-static void
-rotate_log(pappl_system_t *system)	// I - System
+size_t					// O - Number of bytes in buffer
+_papplLogTail(
+    int              fd,		// I - Log file descriptor
+    off_t            *offset,		// IO - Offset in log file
+    pappl_loglevel_t level,		// I - Minimum log level
+    const char       *match,		// I - String to match or `NULL` for all lines
+    char             *buffer,		// I - Buffer for lines
+    size_t           bufsize)		// I - Size of buffer
 {
-  struct stat	loginfo;		// Lof file information
+  ssize_t	bytes;			// Bytes read
+  char		*line,			// Current line
+		*next,			// Next line
+		*end,			// End of lines
+		*outptr,		// Output pointer
+		save;			// Saved character
+  const char	*levelptr;		// Pointer to level character
+  static const char *prefix = "DIWEF";	// Message prefix
+
 
+  if ((bytes = pread(fd, buffer, bufsize, *offset)) <= 0)
+    return (0);
 
-  // Re-check whether we need to rotate the log file...
-  if (!fstat(system->logfd, &loginfo) && loginfo.st_size >= (off_t)system->logmaxsize)
+  // Only use complete lines, unless a single line fills the buffer...
+  for (end = buffer + bytes; end > buffer && end[-1] != '\n'; end --);
+
+  if (end == buffer)
   {
-    // Rename existing log file to "xxx.O"
-    char	backname[1024];		// Backup log filename
+    if ((size_t)bytes < bufsize)
+      return (0);
+
+    end = buffer + bytes;
+  }
 
-    snprintf(backname, sizeof(backname), "%s.O", system->logfile);
-    unlink(backname);
-    rename(system->logfile, backname);
+  *offset += end - buffer;
 
-    _papplLogOpen(system);
+  // Filter the lines in place...
+  for (line = buffer, outptr = buffer; line < end; line = next)
+  {
+    if ((next = memchr(line, '\n', (size_t)(end - line))) != NULL)
+      next ++;
+    else
+      next = end;
+
+    if (level > PAPPL_LOGLEVEL_DEBUG && ((levelptr = strchr(prefix, *line)) == NULL || (levelptr - prefix) < level))
+      continue;
+
+    if (match)
+    {
+      bool	matched;		// Does the line match?
+
+      save      = next[-1];
+      next[-1]  = '\0';
+      matched   = strstr(line, match) != NULL;
+      next[-1]  = save;
+
+      if (!matched)
+        continue;
+    }
+
+    if (outptr != line)
+      memmove(outptr, line, (size_t)(next - line));
+
+    outptr += next - line;
   }
+
+  return ((size_t)(outptr - buffer));
 }
 
 
 //
-// 'write_log()' - Write a line to the log file...
+// '_papplLogUpdateMask()' - Update the mask of enabled log levels.
+//
+// This function must be called whenever the system log level or the log level
+// for a category changes.
 //
 
-static void
-write_log(pappl_system_t   *system,	// I - System
-          pappl_loglevel_t level,	// I - Log level
-          const char       *message,	// I - Printf-style message string
-          va_list          ap)		// I - Pointer to additional arguments
+void
+_papplLogUpdateMask(
+    pappl_system_t *system)		// I - System
 {
-  struct stat	loginfo;		// Log file information
-  char		buffer[2048],		// Output buffer
-		*bufptr,		// Pointer into buffer
+  int			category;	// Current category
+  pappl_loglevel_t	level,		// Current level
+			minlevel;	// Minimum level for category
+  unsigned		mask = 0;	// Enabled log levels
+
+
+  for (category = 0; category < _PAPPL_LOGCAT_MAX; category ++)
+  {
+    if ((minlevel = system->logcatlevels[category]) == PAPPL_LOGLEVEL_UNSPEC)
+      minlevel = system->loglevel;
+
+    for (level = PAPPL_LOGLEVEL_DEBUG; level <= PAPPL_LOGLEVEL_FATAL; level ++)
+    {
+      if (level >= minlevel)
+        mask |= 1U << (category * 5 + (int)level);
+    }
+  }
+
+  atomic_store(&system->logmask, mask);
+}
+
+
+//
+// '_papplLogWait()' - Wait for the log file to change.
+//
+// This function waits up to "msecs" milliseconds for the log file to be
+// written to or rotated, returning immediately if its size no longer matches
+// the specified offset.
+//
+
+bool					// O - `true` if the log changed, `false` on timeout
+_papplLogWait(
+    pappl_system_t *system,		// I - System
+    off_t          offset,		// I - Current offset in log file
+    int            msecs)		// I - Milliseconds to wait
+{
+  bool			changed;	// Did the log change?
+  struct timespec	timeout;	// Timeout for wait
+
+
+  clock_gettime(CLOCK_REALTIME, &timeout);
+  timeout.tv_sec  += msecs / 1000;
+  timeout.tv_nsec += (msecs % 1000) * 1000000;
+  if (timeout.tv_nsec >= 1000000000)
+  {
+    timeout.tv_sec ++;
+    timeout.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock(&log_mutex);
+
+  while (system->logsize == (size_t)offset)
+  {
+    if (pthread_cond_timedwait(&log_cond, &log_mutex, &timeout))
+      break;
+  }
+
+  changed = system->logsize != (size_t)offset;
+
+  pthread_mutex_unlock(&log_mutex);
+
+  return (changed);
+}
+
+
+//
+// 'format_log()' - Format a log line.
+//
+
+static size_t				// O - Length of log line
+format_log(pappl_loglevel_t level,	// I - Log level
+           const char       *message,	// I - Printf-style message string
+           va_list          ap,		// I - Pointer to additional arguments
+           char             *buffer,	// I - Output buffer
+           size_t           bufsize)	// I - Size of output buffer
+{
+  char		*bufptr,		// Pointer into buffer
 		*bufend;		// Pointer to end of buffer
   struct timeval curtime;		// Current time
   struct tm	curdate;		// Current date
@@ -420,21 +615,20 @@ write_log(pappl_system_t   *system,	// I - System
 		*tptr;			// Pointer into temporary format
 
 
-  // Rotate log as needed...
-  if (system->logmaxsize > 0 && !fstat(system->logfd, &loginfo) && loginfo.st_size >= (off_t)system->logmaxsize)
+  // Each log line starts with a standard prefix of log level and date/time,
+  // the date/time (minus milliseconds) only changes once per second...
+  gettimeofday(&curtime, NULL);
+
+  if (curtime.tv_sec != log_time)
   {
-    pthread_mutex_lock(&log_mutex);
-    rotate_log(system);
-    pthread_mutex_unlock(&log_mutex);
+    log_time = curtime.tv_sec;
+    gmtime_r(&curtime.tv_sec, &curdate);
+    snprintf(log_date, sizeof(log_date), "%04d-%02d-%02dT%02d:%02d:%02d", curdate.tm_year + 1900, curdate.tm_mon + 1, curdate.tm_mday, curdate.tm_hour, curdate.tm_min, curdate.tm_sec);
   }
 
-  // Each log line starts with a standard prefix of log level and date/time...
-  gettimeofday(&curtime, NULL);
-  gmtime_r(&curtime.tv_sec, &curdate);
-
-  snprintf(buffer, sizeof(buffer), "%c [%04d-%02d-%02dT%02d:%02d:%02d.%03dZ] ", prefix[level], curdate.tm_year + 1900, curdate.tm_mon + 1, curdate.tm_mday, curdate.tm_hour, curdate.tm_min, curdate.tm_sec, (int)(curtime.tv_usec / 1000));
+  snprintf(buffer, bufsize, "%c [%s.%03dZ] ", prefix[level], log_date, (int)(curtime.tv_usec / 1000));
   bufptr = buffer + 29;			// Skip level/date/time
-  bufend = buffer + sizeof(buffer) - 1;	// Leave room for newline on end
+  bufend = buffer + bufsize - 1;	// Leave room for newline on end
 
   // Then format the message line using printf format sequences...
   while (*message && bufptr < bufend)
@@ -637,8 +831,285 @@ write_log(pappl_system_t   *system,	// I - System
       *bufptr++ = *message++;
   }
 
-  // Add a newline and write it out...
+  // Add a newline...
   *bufptr++ = '\n';
 
-  write(system->logfd, buffer, (size_t)(bufptr - buffer));
+  return ((size_t)(bufptr - buffer));
+}
+
+
+//
+// 'log_thread()' - Write queued log messages.
+//
+// Messages are taken from the ring in order and written in batches using
+// `writev`.  The file size is tracked here rather than calling `fstat` for
+// every message.
+//
+
+static void *				// O - Thread exit status
+log_thread(pappl_system_t *system)	// I - System
+{
+  _pappl_logmsg_t	*msg;		// Current message
+  struct iovec		iov[_PAPPL_LOG_BATCH];
+					// Messages to write
+  int			i,		// Looping var
+			count;		// Number of messages to write
+  ssize_t		bytes;		// Bytes written
+  bool			rotated;	// Was the log file rotated?
+  struct timespec	timeout;	// Timeout for wait
+
+
+  for (;;)
+  {
+    // Collect the messages that are ready to be written...
+    for (count = 0; count < _PAPPL_LOG_BATCH; count ++)
+    {
+      msg = system->logring + ((system->logtail + (size_t)count) & (_PAPPL_LOG_RING_SIZE - 1));
+
+      if (atomic_load_explicit(&msg->seq, memory_order_acquire) != system->logtail + (size_t)count + 1)
+        break;
+
+      iov[count].iov_base = msg->buffer;
+      iov[count].iov_len  = msg->length;
+    }
+
+    if (count == 0)
+    {
+      // Nothing to write, stop or wait for more messages...
+      if (system->logstop)
+        break;
+
+      pthread_mutex_lock(&system->logwait_mutex);
+      atomic_store(&system->logwaiting, true);
+
+      msg = system->logring + (system->logtail & (_PAPPL_LOG_RING_SIZE - 1));
+
+      if (!system->logstop && atomic_load(&msg->seq) != system->logtail + 1)
+      {
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_sec ++;
+
+        pthread_cond_timedwait(&system->logwait_cond, &system->logwait_mutex, &timeout);
+      }
+
+      atomic_store(&system->logwaiting, false);
+      pthread_mutex_unlock(&system->logwait_mutex);
+      continue;
+    }
+
+    // Write the messages and rotate the log as needed...
+    pthread_mutex_lock(&log_mutex);
+
+    if ((bytes = writev(system->logfd, iov, count)) > 0)
+      system->logsize += (size_t)bytes;
+
+    rotated = rotate_log(system);
+
+    pthread_cond_broadcast(&log_cond);
+
+    pthread_mutex_unlock(&log_mutex);
+
+    // Return the message buffers to the ring...
+    for (i = 0; i < count; i ++, system->logtail ++)
+    {
+      msg = system->logring + (system->logtail & (_PAPPL_LOG_RING_SIZE - 1));
+      atomic_store_explicit(&msg->seq, system->logtail + _PAPPL_LOG_RING_SIZE, memory_order_release);
+    }
+
+    if (rotated)
+      papplLog(system, PAPPL_LOGLEVEL_INFO, "Starting log, system up %ld second(s), %d printer(s), listening for connections on '%s:%d'.", (long)(time(NULL) - system->start_time), cupsArrayCount(system->printers), system->hostname, system->port);
+  }
+
+  return (NULL);
+}
+
+
+//
+// 'open_log()' - Open the log file.
+//
+// The caller must hold the log mutex.
+//
+
+static void
+open_log(pappl_system_t *system)	// I - System
+{
+  struct stat	loginfo;		// Log file information
+
+
+  if (!strcmp(system->logfile, "syslog"))
+  {
+    // Log to syslog...
+    system->logfd = -1;
+  }
+  else if (!strcmp(system->logfile, "-"))
+  {
+    // Log to stderr...
+    system->logfd   = 2;
+    system->logsize = 0;
+  }
+  else
+  {
+    int	oldfd = system->logfd;		// Old log file descriptor
+
+    // Log to a file...
+    if ((system->logfd = open(system->logfile, O_CREAT | O_WRONLY | O_APPEND | O_NOFOLLOW | O_CLOEXEC, 0600)) < 0)
+    {
+      // Fallback to logging to stderr if we can't open the log file...
+      perror(system->logfile);
+
+      system->logfd = 2;
+    }
+
+    // Get the current size once, after that we track it ourselves...
+    if (system->logfd != 2 && !fstat(system->logfd, &loginfo))
+      system->logsize = (size_t)loginfo.st_size;
+    else
+      system->logsize = 0;
+
+    // Close any old file...
+    if (oldfd != -1 && oldfd != 2)
+      close(oldfd);
+  }
+}
+
+
+//
+// 'rotate_log()' - Rotate the log file as needed.
+//
+// The caller must hold the log mutex.
+//
+
+static bool				// O - `true` if rotated, `false` otherwise
+rotate_log(pappl_system_t *system)	// I - System
+{
+  char	backname[1024];			// Backup log filename
+
+
+  if (system->logmaxsize == 0 || system->logsize < system->logmaxsize || system->logfd == 2)
+    return (false);
+
+  // Rename existing log file to "xxx.O"
+  snprintf(backname, sizeof(backname), "%s.O", system->logfile);
+  unlink(backname);
+  rename(system->logfile, backname);
+
+  open_log(system);
+
+  return (true);
+}
+
+
+//
+// 'write_log()' - Write a line to the log file...
+//
+// The message is formatted directly into the next free buffer in the log ring
+// for the writer thread.  If there is no writer thread the message is written
+// immediately.
+//
+
+static void
+write_log(pappl_system_t   *system,	// I - System
+          pappl_loglevel_t level,	// I - Log level
+          const char       *message,	// I - Printf-style message string
+          va_list          ap)		// I - Pointer to additional arguments
+{
+  _pappl_logmsg_t	*msg = NULL;	// Ring message
+  size_t		pos,		// Ring position
+			seq;		// Sequence number of ring message
+  char			buffer[_PAPPL_LOG_LINE_SIZE];
+					// Output buffer
+  size_t		length;		// Length of message
+  bool			rotated;	// Was the log file rotated?
+
+
+  if (system->logring)
+  {
+    // Claim the next free message in the ring...
+    pos = atomic_load_explicit(&system->loghead, memory_order_relaxed);
+
+    for (;;)
+    {
+      msg = system->logring + (pos & (_PAPPL_LOG_RING_SIZE - 1));
+      seq = atomic_load_explicit(&msg->seq, memory_order_acquire);
+
+      if (seq == pos)
+      {
+        // Free, try to claim it...
+        if (atomic_compare_exchange_weak_explicit(&system->loghead, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+          break;
+      }
+      else if ((ssize_t)(seq - pos) < 0)
+      {
+        // Ring is full, write directly from the writer thread or wait for the
+        // writer to catch up to preserve the order of messages...
+        if (pthread_equal(pthread_self(), system->logtid))
+        {
+          msg = NULL;
+          break;
+        }
+
+        sched_yield();
+        pos = atomic_load_explicit(&system->loghead, memory_order_relaxed);
+      }
+      else
+      {
+        // Another thread claimed it, try again...
+        pos = atomic_load_explicit(&system->loghead, memory_order_relaxed);
+      }
+    }
+
+    if (msg)
+    {
+      // Format the message and hand it to the writer thread...
+      msg->length = format_log(level, message, ap, msg->buffer, sizeof(msg->buffer));
+
+      atomic_store_explicit(&msg->seq, pos + 1, memory_order_release);
+      atomic_thread_fence(memory_order_seq_cst);
+
+      if (atomic_load(&system->logwaiting))
+      {
+        pthread_mutex_lock(&system->logwait_mutex);
+        pthread_cond_signal(&system->logwait_cond);
+        pthread_mutex_unlock(&system->logwait_mutex);
+      }
+
+      return;
+    }
+  }
+
+  // Write the message directly...
+  length = format_log(level, message, ap, buffer, sizeof(buffer));
+
+  pthread_mutex_lock(&log_mutex);
+
+  if (write(system->logfd, buffer, length) > 0)
+    system->logsize += length;
+
+  rotated = rotate_log(system);
+
+  pthread_cond_broadcast(&log_cond);
+
+  pthread_mutex_unlock(&log_mutex);
+
+  if (rotated)
+    papplLog(system, PAPPL_LOGLEVEL_INFO, "Starting log, system up %ld second(s), %d printer(s), listening for connections on '%s:%d'.", (long)(time(NULL) - system->start_time), cupsArrayCount(system->printers), system->hostname, system->port);
+}
+
+
+//
+// 'write_logf()' - Write a formatted line to the log file...
+//
+
+static void
+write_logf(pappl_system_t   *system,	// I - System
+           pappl_loglevel_t level,	// I - Log level
+           const char       *message,	// I - Printf-style message string
+           ...)				// I - Additional arguments as needed
+{
+  va_list	ap;			// Pointer to arguments
+
+
+  va_start(ap, message);
+  write_log(system, level, message, ap);
+  va_end(ap);
 }
@@ -41,6 +41,15 @@ typedef enum pappl_loglevel_e		// Log levels
   PAPPL_LOGLEVEL_FATAL				// Fatal message
 } pappl_loglevel_t;
 
+typedef enum pappl_logcat_e		// Log categories
+{
+  PAPPL_LOGCAT_SYSTEM,				// System messages (@link papplLog@)
+  PAPPL_LOGCAT_CLIENT,				// Client messages (@link papplLogClient@)
+  PAPPL_LOGCAT_DEVICE,				// Device messages (@link papplLogDevice@)
+  PAPPL_LOGCAT_JOB,				// Job messages (@link papplLogJob@)
+  PAPPL_LOGCAT_PRINTER				// Printer messages (@link papplLogPrinter@)
+} pappl_logcat_t;
+
 
 //
 // Functions...
@@ -13,6 +13,7 @@
 
 #include "printer-private.h"
 #include "system-private.h"
+#include "device-private.h"
 
 
 //
@@ -29,18 +30,21 @@ papplPrinterCloseDevice(
   if (!printer || !printer->device || !printer->device_in_use || printer->processing_job)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplMutexLock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
 
-  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Closing device.");
+  if (printer->device && printer->device_in_use)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Closing device.");
 
-  papplDeviceClose(printer->device);
+    papplDeviceClose(printer->device);
 
-  printer->device        = NULL;
-  printer->device_in_use = false;
+    printer->device        = NULL;
+    printer->device_in_use = false;
 
-  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Device closed.");
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Device closed.");
+  }
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplMutexUnlock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
 }
 
 
@@ -64,11 +68,11 @@ papplPrinterGetContact(
     return (contact);
   }
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   *contact = printer->contact;
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (contact);
 }
@@ -124,9 +128,9 @@ papplPrinterGetDNSSDName(
     return (NULL);
   }
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   strlcpy(buffer, printer->dns_sd_name, bufsize);
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (buffer);
 }
@@ -154,9 +158,9 @@ papplPrinterGetGeoLocation(
     return (NULL);
   }
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   strlcpy(buffer, printer->geo_location, bufsize);
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (buffer);
 }
@@ -213,9 +217,9 @@ papplPrinterGetLocation(
     return (NULL);
   }
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   strlcpy(buffer, printer->location, bufsize);
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (buffer);
 }
@@ -295,7 +299,7 @@ int					// O - Number of active print jobs
 papplPrinterGetNumberOfActiveJobs(
     pappl_printer_t *printer)		// I - Printer
 {
-  return (printer ? cupsArrayCount(printer->active_jobs) : 0);
+  return (printer ? printer->active_jobs.count : 0);
 }
 
 
@@ -311,7 +315,7 @@ int					// O - Number of completed print jobs
 papplPrinterGetNumberOfCompletedJobs(
     pappl_printer_t *printer)		// I - Printer
 {
-  return (printer ? cupsArrayCount(printer->completed_jobs) : 0);
+  return (printer ? printer->completed_jobs.count : 0);
 }
 
 
@@ -326,7 +330,7 @@ int					// O - Total number of print jobs
 papplPrinterGetNumberOfJobs(
     pappl_printer_t *printer)		// I - Printer
 {
-  return (printer ? cupsArrayCount(printer->all_jobs) : 0);
+  return (printer ? printer->all_jobs.count : 0);
 }
 
 
@@ -351,9 +355,9 @@ papplPrinterGetOrganization(
     return (NULL);
   }
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   strlcpy(buffer, printer->organization, bufsize);
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (buffer);
 }
@@ -380,9 +384,9 @@ papplPrinterGetOrganizationalUnit(
     return (NULL);
   }
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   strlcpy(buffer, printer->org_unit, bufsize);
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (buffer);
 }
@@ -441,9 +445,9 @@ papplPrinterGetPrintGroup(
     return (NULL);
   }
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   strlcpy(buffer, printer->print_group, bufsize);
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (buffer);
 }
@@ -522,14 +526,14 @@ papplPrinterGetSupplies(
 
   memset(supplies, 0, (size_t)max_supplies * sizeof(pappl_supply_t));
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   if ((count = printer->num_supply) > max_supplies)
     count = max_supplies;
 
   memcpy(supplies, printer->supply, (size_t)count * sizeof(pappl_supply_t));
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (count);
 }
@@ -577,9 +581,11 @@ papplPrinterIterateActiveJobs(
   if (!printer || !cb)
     return;
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  // Callbacks may query the printer, so hold the configuration lock too...
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
+  _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  for (job = (pappl_job_t *)cupsArrayIndex(printer->active_jobs, job_index - 1), count = 0; job; job = (pappl_job_t *)cupsArrayNext(printer->active_jobs), count ++)
+  for (job = _papplJobListIndex(&printer->active_jobs, job_index - 1), count = 0; job; job = _papplJobListNext(&printer->active_jobs, job), count ++)
   {
     if (limit == 0 || count < limit)
       (cb)(job, data);
@@ -587,7 +593,8 @@ papplPrinterIterateActiveJobs(
       break;
   }
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 }
 
 
@@ -617,9 +624,11 @@ papplPrinterIterateAllJobs(
   if (!printer || !cb)
     return;
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  // Callbacks may query the printer, so hold the configuration lock too...
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
+  _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  for (job = (pappl_job_t *)cupsArrayIndex(printer->all_jobs, job_index - 1), count = 0; job; job = (pappl_job_t *)cupsArrayNext(printer->all_jobs), count ++)
+  for (job = _papplJobListIndex(&printer->all_jobs, job_index - 1), count = 0; job; job = _papplJobListNext(&printer->all_jobs, job), count ++)
   {
     if (limit == 0 || count < limit)
       (cb)(job, data);
@@ -627,7 +636,8 @@ papplPrinterIterateAllJobs(
       break;
   }
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 }
 
 
@@ -658,9 +668,11 @@ papplPrinterIterateCompletedJobs(
   if (!printer || !cb)
     return;
 
-  pthread_rwlock_rdlock(&printer->rwlock);
+  // Callbacks may query the printer, so hold the configuration lock too...
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
+  _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  for (job = (pappl_job_t *)cupsArrayIndex(printer->completed_jobs, job_index - 1), count = 0; job; job = (pappl_job_t *)cupsArrayNext(printer->completed_jobs), count ++)
+  for (job = _papplJobListIndex(&printer->completed_jobs, job_index - 1), count = 0; job; job = _papplJobListNext(&printer->completed_jobs, job), count ++)
   {
     if (limit == 0 || count < limit)
       (cb)(job, data);
@@ -668,7 +680,8 @@ papplPrinterIterateCompletedJobs(
       break;
   }
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 }
 
 
@@ -687,19 +700,27 @@ papplPrinterOpenDevice(
     pappl_printer_t *printer)		// I - Printer
 {
   pappl_device_t	*device = NULL;	// Open device
+  bool			busy;		// Is the device busy?
 
 
   if (!printer || printer->device_in_use || printer->processing_job || !printer->device_uri)
     return (NULL);
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplMutexLock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
+
+  _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  busy = printer->device_in_use || printer->processing_job != NULL;
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  if (!printer->device_in_use && !printer->processing_job)
+  if (!busy)
   {
     papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Opening device.");
 
     printer->device        = device = papplDeviceOpen(printer->device_uri, "printer", papplLogDevice, printer->system);
     printer->device_in_use = device != NULL;
+
+    if (device)
+      device->io_uring = (printer->system->options & PAPPL_SOPTIONS_IO_URING) != 0;
   }
 
   if (device)
@@ -707,7 +728,7 @@ papplPrinterOpenDevice(
   else
     papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Device not open.");
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplMutexUnlock(&printer->device_mutex, _PAPPL_LOCK_PRINTER_DEVICE);
 
   return (device);
 }
@@ -727,14 +748,16 @@ papplPrinterPause(
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
   if (printer->processing_job)
     printer->is_stopped = true;
   else
     printer->state = IPP_PSTATE_STOPPED;
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  _papplSystemAddEvent(printer->system, printer, NULL, _PAPPL_EVENT_PRINTER_STATE_CHANGED);
 }
 
 
@@ -751,12 +774,14 @@ papplPrinterResume(
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
   printer->is_stopped = false;
   printer->state      = IPP_PSTATE_IDLE;
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  _papplSystemAddEvent(printer->system, printer, NULL, _PAPPL_EVENT_PRINTER_STATE_CHANGED);
 
   _papplPrinterCheckJobs(printer);
 }
@@ -776,12 +801,12 @@ papplPrinterSetContact(
   if (!printer || !contact)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   printer->contact     = *contact;
   printer->config_time = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 }
@@ -802,7 +827,7 @@ papplPrinterSetDNSSDName(
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   free(printer->dns_sd_name);
   printer->dns_sd_name      = value ? strdup(value) : NULL;
@@ -815,7 +840,7 @@ papplPrinterSetDNSSDName(
   else
     _papplPrinterRegisterDNSSDNoLock(printer);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 }
@@ -836,7 +861,7 @@ papplPrinterSetGeoLocation(
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   free(printer->geo_location);
   printer->geo_location = value ? strdup(value) : NULL;
@@ -844,7 +869,7 @@ papplPrinterSetGeoLocation(
 
   _papplPrinterRegisterDNSSDNoLock(printer);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 }
@@ -866,13 +891,9 @@ papplPrinterSetImpressionsCompleted(
   if (!printer || add <= 0)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
-
   printer->impcompleted += add;
   printer->state_time   = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
-
   _papplSystemConfigChanged(printer->system);
 }
 
@@ -892,7 +913,7 @@ papplPrinterSetLocation(
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   free(printer->location);
   printer->location    = value ? strdup(value) : NULL;
@@ -900,7 +921,7 @@ papplPrinterSetLocation(
 
   _papplPrinterRegisterDNSSDNoLock(printer);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 }
@@ -925,14 +946,19 @@ papplPrinterSetMaxActiveJobs(
   if (!printer || max_active_jobs < 0)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
   printer->max_active_jobs = max_active_jobs;
-  printer->config_time     = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  printer->config_time = time(NULL);
+
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
+  _papplSystemWakeRaw(printer->system);
 }
 
 
@@ -952,12 +978,16 @@ papplPrinterSetMaxCompletedJobs(
   if (!printer || max_completed_jobs < 0)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
   printer->max_completed_jobs = max_completed_jobs;
-  printer->config_time        = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  printer->config_time = time(NULL);
+
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 }
@@ -981,12 +1011,16 @@ papplPrinterSetNextJobID(
   if (!printer || next_job_id < 1)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
   printer->next_job_id = next_job_id;
+
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
   printer->config_time = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 }
@@ -1007,13 +1041,13 @@ papplPrinterSetOrganization(
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   free(printer->organization);
   printer->organization = value ? strdup(value) : NULL;
   printer->config_time  = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 }
@@ -1034,13 +1068,13 @@ papplPrinterSetOrganizationalUnit(
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   free(printer->org_unit);
   printer->org_unit    = value ? strdup(value) : NULL;
   printer->config_time = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 }
@@ -1064,7 +1098,7 @@ papplPrinterSetPrintGroup(
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   free(printer->print_group);
   printer->print_group = value ? strdup(value) : NULL;
@@ -1084,8 +1118,9 @@ papplPrinterSetPrintGroup(
   else
     printer->print_gid = (gid_t)-1;
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
+  _papplSystemClearAuthCache(printer->system);
   _papplSystemConfigChanged(printer->system);
 }
 
@@ -1105,16 +1140,20 @@ papplPrinterSetReasons(
     pappl_preason_t add,		// I - "printer-state-reasons" bit values to add or `PAPPL_PREASON_NONE` for none
     pappl_preason_t remove)		// I - "printer-state-reasons" bit values to remove or `PAPPL_PREASON_NONE` for none
 {
+  pappl_preason_t	reasons;	// Current reasons
+
+
   if (!printer)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  // Update the reasons atomically so concurrent changes are not lost...
+  reasons = printer->state_reasons;
 
-  printer->state_reasons &= ~remove;
-  printer->state_reasons |= add;
-  printer->state_time    = printer->status_time = time(NULL);
+  while (!atomic_compare_exchange_weak(&printer->state_reasons, &reasons, (reasons & ~remove) | add));
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  printer->state_time = printer->status_time = time(NULL);
+
+  _papplSystemAddEvent(printer->system, printer, NULL, _PAPPL_EVENT_PRINTER_STATE_CHANGED);
 }
 
 
@@ -1133,7 +1172,7 @@ papplPrinterSetSupplies(
   if (!printer || num_supplies < 0 || num_supplies > PAPPL_MAX_SUPPLY || (num_supplies > 0 && !supplies))
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   printer->num_supply = num_supplies;
   memset(printer->supply, 0, sizeof(printer->supply));
@@ -1141,5 +1180,7 @@ papplPrinterSetSupplies(
     memcpy(printer->supply, supplies, (size_t)num_supplies * sizeof(pappl_supply_t));
   printer->state_time = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
+
+  _papplSystemAddEvent(printer->system, printer, NULL, _PAPPL_EVENT_PRINTER_CONFIG_CHANGED);
 }
@@ -19,6 +19,7 @@
 // Local functions...
 //
 
+static void	add_vendor_default(pappl_printer_t *printer, ipp_t *driver_attrs, const char *name, const char *value);
 static ipp_t	*make_attrs(pappl_system_t *system, pappl_pr_driver_data_t *data);
 static bool	validate_defaults(pappl_printer_t *printer, pappl_pr_driver_data_t *data);
 static bool	validate_driver(pappl_printer_t *printer, pappl_pr_driver_data_t *data);
@@ -35,7 +36,50 @@ ipp_t *					// O - Driver attributes
 papplPrinterGetDriverAttributes(
     pappl_printer_t *printer)		// I - Printer
 {
-  return (printer ? printer->driver_attrs : NULL);
+  return (printer ? _papplPrinterGetDriverAttrs(printer) : NULL);
+}
+
+
+//
+// '_papplPrinterGetDriverAttrs()' - Get the driver attributes, building them
+//                                   as needed.
+//
+// The driver (capability) attributes are not built until they are first used
+// so that creating printers, particularly when loading the system state, stays
+// fast.  Vendor defaults set before then are applied when the attributes are
+// built.
+//
+
+ipp_t *					// O - Driver attributes
+_papplPrinterGetDriverAttrs(
+    pappl_printer_t *printer)		// I - Printer
+{
+  int	i;				// Looping var
+  ipp_t	*attrs;				// Driver attributes
+
+
+  pthread_mutex_lock(&printer->driver_mutex);
+
+  if (!printer->driver_attrs)
+  {
+    printer->driver_attrs = make_attrs(printer->system, &printer->psdriver.driver_data);
+
+    if (printer->driver_xattrs)
+      ippCopyAttributes(printer->driver_attrs, printer->driver_xattrs, 0, NULL, NULL);
+
+    for (i = 0; i < printer->num_driver_vendor; i ++)
+      add_vendor_default(printer, printer->driver_attrs, printer->driver_vendor[i].name, printer->driver_vendor[i].value);
+
+    cupsFreeOptions(printer->num_driver_vendor, printer->driver_vendor);
+    printer->num_driver_vendor = 0;
+    printer->driver_vendor     = NULL;
+  }
+
+  attrs = printer->driver_attrs;
+
+  pthread_mutex_unlock(&printer->driver_mutex);
+
+  return (attrs);
 }
 
 
@@ -124,8 +168,9 @@ _papplPrinterInitDriverData(
 // This function validates and sets the driver data, including all defaults and
 // ready (loaded) media.
 //
-// > Note: This function regenerates all of the driver-specific capability
-// > attributes like "media-col-database", "sides-supported", and so forth.
+// > Note: This function invalidates all of the driver-specific capability
+// > attributes like "media-col-database", "sides-supported", and so forth,
+// > which are regenerated when next used.
 // > Use the @link papplPrinterSetDriverDefaults@ or
 // > @link papplPrinterSetReadyMedia@ functions to efficiently change the
 // > "xxx-default" or "xxx-ready" values, respectively.
@@ -144,22 +189,36 @@ papplPrinterSetDriverData(
   if (!validate_defaults(printer, data) || !validate_driver(printer, data) || !validate_ready(printer, data->num_source, data->media_ready))
     return (false);
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   // Copy driver data to printer
   memcpy(&printer->psdriver.driver_data, data, sizeof(printer->psdriver.driver_data));
 
-  // Create printer (capability) attributes based on driver data...
+  // Discard the old printer (capability) attributes, new ones are created
+  // from the driver data the next time they are needed...
+  pthread_mutex_lock(&printer->driver_mutex);
+
   ippDelete(printer->driver_attrs);
-  // if (PAPPL_SERVICE_TYPE_SCAN == 1)
-  //   printer->driver_attrs = make_attrs_scan(printer->system, &printer->psdriver.driver_data);
-  // else
-    printer->driver_attrs = make_attrs(printer->system, &printer->psdriver.driver_data);
+  printer->driver_attrs = NULL;
+
+  ippDelete(printer->driver_xattrs);
+  printer->driver_xattrs = NULL;
+
+  cupsFreeOptions(printer->num_driver_vendor, printer->driver_vendor);
+  printer->num_driver_vendor = 0;
+  printer->driver_vendor     = NULL;
 
   if (attrs)
-    ippCopyAttributes(printer->driver_attrs, attrs, 0, NULL, NULL);
+  {
+    printer->driver_xattrs = ippNew();
+    ippCopyAttributes(printer->driver_xattrs, attrs, 0, NULL, NULL);
+  }
+
+  pthread_mutex_unlock(&printer->driver_mutex);
+
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  return (true);
 }
 
 //
@@ -181,9 +240,6 @@ papplPrinterSetDriverDefaults(
 {
   int			i;		// Looping var
   const char		*value;		// Vendor value
-  char			defname[128],	// xxx-default name
-			supname[128];	// xxx-supported name
-  ipp_attribute_t	*supported;	// xxx-supported attribute
 
 
   if (!printer || !data)
@@ -192,7 +248,7 @@ papplPrinterSetDriverDefaults(
   if (!validate_defaults(printer, data))
     return (false);
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   // Copy xxx_default values...
   printer->psdriver.driver_data.color_default          = data->color_default;
@@ -214,46 +270,13 @@ papplPrinterSetDriverDefaults(
   // Copy any vendor-specific xxx-default values...
   for (i = 0; i < data->num_vendor; i ++)
   {
-    if ((value = cupsGetOption(data->vendor[i], num_vendor, vendor)) == NULL)
-      continue;
-
-    snprintf(defname, sizeof(defname), "%s-default", data->vendor[i]);
-    snprintf(supname, sizeof(supname), "%s-supported", data->vendor[i]);
-
-    ippDeleteAttribute(printer->driver_attrs, ippFindAttribute(printer->driver_attrs, defname, IPP_TAG_ZERO));
-
-    if ((supported = ippFindAttribute(printer->driver_attrs, supname, IPP_TAG_ZERO)) != NULL)
-    {
-      switch (ippGetValueTag(supported))
-      {
-        case IPP_TAG_INTEGER :
-        case IPP_TAG_RANGE :
-            ippAddInteger(printer->driver_attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, defname, atoi(value));
-            break;
-
-        case IPP_TAG_BOOLEAN :
-            ippAddBoolean(printer->driver_attrs, IPP_TAG_PRINTER, defname, !strcmp(value, "true") || !strcmp(value, "on"));
-            break;
-
-	case IPP_TAG_KEYWORD :
-	    ippAddString(printer->driver_attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, defname, NULL, value);
-	    break;
-
-        default :
-            papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Driver '%s' attribute syntax not supported, only boolean, integer, keyword, and rangeOfInteger are supported.", supname);
-            break;
-      }
-    }
-    else
-    {
-      // Default to simple text values...
-      ippAddString(printer->driver_attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT, defname, NULL, value);
-    }
+    if ((value = cupsGetOption(data->vendor[i], num_vendor, vendor)) != NULL)
+      _papplPrinterSetVendorDefault(printer, data->vendor[i], value);
   }
 
   printer->config_time = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 
@@ -279,7 +302,7 @@ papplPrinterSetReadyMedia(
   if (!validate_ready(printer, num_ready, ready))
     return (false);
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   if (num_ready > printer->psdriver.driver_data.num_source)
     num_ready = printer->psdriver.driver_data.num_source;
@@ -288,7 +311,7 @@ papplPrinterSetReadyMedia(
   memcpy(printer->psdriver.driver_data.media_ready, ready, (size_t)num_ready * sizeof(pappl_media_col_t));
   printer->state_time = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(printer->system);
 
@@ -296,6 +319,81 @@ papplPrinterSetReadyMedia(
 }
 
 
+//
+// '_papplPrinterSetVendorDefault()' - Set a vendor "xxx-default" value.
+//
+// If the driver attributes have not been built yet, the value is saved and
+// applied when they are.
+//
+
+void
+_papplPrinterSetVendorDefault(
+    pappl_printer_t *printer,		// I - Printer
+    const char      *name,		// I - Vendor attribute name without "-default"
+    const char      *value)		// I - Default value
+{
+  pthread_mutex_lock(&printer->driver_mutex);
+
+  if (printer->driver_attrs)
+    add_vendor_default(printer, printer->driver_attrs, name, value);
+  else
+    printer->num_driver_vendor = cupsAddOption(name, value, printer->num_driver_vendor, &printer->driver_vendor);
+
+  pthread_mutex_unlock(&printer->driver_mutex);
+}
+
+
+//
+// 'add_vendor_default()' - Add a vendor "xxx-default" attribute.
+//
+
+static void
+add_vendor_default(
+    pappl_printer_t *printer,		// I - Printer
+    ipp_t           *driver_attrs,	// I - Driver attributes
+    const char      *name,		// I - Vendor attribute name without "-default"
+    const char      *value)		// I - Default value
+{
+  char			defname[128],	// xxx-default name
+			supname[128];	// xxx-supported name
+  ipp_attribute_t	*supported;	// xxx-supported attribute
+
+
+  snprintf(defname, sizeof(defname), "%s-default", name);
+  snprintf(supname, sizeof(supname), "%s-supported", name);
+
+  ippDeleteAttribute(driver_attrs, ippFindAttribute(driver_attrs, defname, IPP_TAG_ZERO));
+
+  if ((supported = ippFindAttribute(driver_attrs, supname, IPP_TAG_ZERO)) != NULL)
+  {
+    switch (ippGetValueTag(supported))
+    {
+      case IPP_TAG_INTEGER :
+      case IPP_TAG_RANGE :
+          ippAddInteger(driver_attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, defname, atoi(value));
+          break;
+
+      case IPP_TAG_BOOLEAN :
+          ippAddBoolean(driver_attrs, IPP_TAG_PRINTER, defname, !strcmp(value, "true") || !strcmp(value, "on"));
+          break;
+
+      case IPP_TAG_KEYWORD :
+          ippAddString(driver_attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, defname, NULL, value);
+          break;
+
+      default :
+          papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Driver '%s' attribute syntax not supported, only boolean, integer, keyword, and rangeOfInteger are supported.", supname);
+          break;
+    }
+  }
+  else
+  {
+    // Default to simple text values...
+    ippAddString(driver_attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT, defname, NULL, value);
+  }
+}
+
+
 //
 // 'make_attrs()' - Make the capability attributes for the given driver data.
 //
@@ -70,7 +70,7 @@ _papplPrinterCopyAttributes(
 
 
   _papplCopyAttributes(client->response, printer->attrs, ra, IPP_TAG_ZERO, IPP_TAG_CUPS_CONST);
-  _papplCopyAttributes(client->response, printer->driver_attrs, ra, IPP_TAG_ZERO, IPP_TAG_CUPS_CONST);
+  _papplCopyAttributes(client->response, _papplPrinterGetDriverAttrs(printer), ra, IPP_TAG_ZERO, IPP_TAG_CUPS_CONST);
   _papplPrinterCopyState(client->response, printer, ra);
 
   if (!ra || cupsArrayFind(ra, "copies-supported"))
@@ -407,13 +407,13 @@ _papplPrinterCopyAttributes(
   {
     _pappl_resource_t	*r;		// Current resource
 
-    pthread_rwlock_rdlock(&printer->system->rwlock);
+    pthread_rwlock_rdlock(&printer->system->resource_rwlock);
     for (num_values = 0, r = (_pappl_resource_t *)cupsArrayFirst(printer->system->resources); r && num_values < (int)(sizeof(svalues) / sizeof(svalues[0])); r = (_pappl_resource_t *)cupsArrayNext(printer->system->resources))
     {
       if (r->language)
         svalues[num_values ++] = r->language;
     }
-    pthread_rwlock_unlock(&printer->system->rwlock);
+    pthread_rwlock_unlock(&printer->system->resource_rwlock);
 
     if (num_values > 0)
       ippAddStrings(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_LANGUAGE, "printer-strings-languages-supported", num_values, NULL, svalues);
@@ -429,7 +429,7 @@ _papplPrinterCopyAttributes(
 
     strlcpy(baselang, lang, sizeof(baselang));
 
-    pthread_rwlock_rdlock(&printer->system->rwlock);
+    pthread_rwlock_rdlock(&printer->system->resource_rwlock);
     for (r = (_pappl_resource_t *)cupsArrayFirst(printer->system->resources); r; r = (_pappl_resource_t *)cupsArrayNext(printer->system->resources))
     {
       if (r->language && (!strcmp(r->language, lang) || !strcmp(r->language, baselang)))
@@ -439,7 +439,7 @@ _papplPrinterCopyAttributes(
         break;
       }
     }
-    pthread_rwlock_unlock(&printer->system->rwlock);
+    pthread_rwlock_unlock(&printer->system->resource_rwlock);
   }
 
   if (printer->num_supply > 0)
@@ -508,7 +508,7 @@ _papplPrinterCopyAttributes(
     _papplPrinterCopyXRI(client, client->response, printer);
 
   if (!ra || cupsArrayFind(ra, "queued-job-count"))
-    ippAddInteger(client->response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "queued-job-count", cupsArrayCount(printer->active_jobs));
+    ippAddInteger(client->response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "queued-job-count", printer->active_jobs.count);
 
   if (!ra || cupsArrayFind(ra, "sides-default"))
   {
@@ -716,6 +716,27 @@ _papplPrinterProcessIPP(
 	ipp_resume_printer(client);
 	break;
 
+    case IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS :
+    case IPP_OP_CREATE_JOB_SUBSCRIPTIONS :
+	_papplSubscriptionIPPCreate(client);
+	break;
+
+    case IPP_OP_GET_NOTIFICATIONS :
+	_papplSubscriptionIPPGetNotifications(client);
+	break;
+
+    case IPP_OP_GET_SUBSCRIPTION_ATTRIBUTES :
+	_papplSubscriptionIPPGetAttributes(client);
+	break;
+
+    case IPP_OP_RENEW_SUBSCRIPTION :
+	_papplSubscriptionIPPRenew(client);
+	break;
+
+    case IPP_OP_CANCEL_SUBSCRIPTION :
+	_papplSubscriptionIPPCancel(client);
+	break;
+
     default :
         if (client->system->op_cb && (client->system->op_cb)(client, client->system->op_cbdata))
           break;
@@ -815,7 +836,7 @@ _papplPrinterSetAttributes(
     return (0);
 
   // Now apply changes...
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   for (rattr = ippFirstAttribute(client->request); rattr; rattr = ippNextAttribute(client->request))
   {
@@ -946,15 +967,15 @@ _papplPrinterSetAttributes(
     else
     {
       // Vendor xxx-default attribute, copy it...
-      ippDeleteAttribute(printer->driver_attrs, ippFindAttribute(printer->driver_attrs, name, IPP_TAG_ZERO));
+      ippDeleteAttribute(_papplPrinterGetDriverAttrs(printer), ippFindAttribute(_papplPrinterGetDriverAttrs(printer), name, IPP_TAG_ZERO));
 
-      ippCopyAttribute(printer->driver_attrs, rattr, 0);
+      ippCopyAttribute(_papplPrinterGetDriverAttrs(printer), rattr, 0);
     }
   }
 
   printer->config_time = time(NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplSystemConfigChanged(client->system);
 
@@ -1122,7 +1143,7 @@ ipp_get_jobs(pappl_client_t *client)	// I - Client
 			limit,		// Maximum number of jobs to return
 			count;		// Number of jobs that match
   const char		*username;	// Username
-  cups_array_t		*list;		// Jobs list
+  _pappl_joblist_t	*list;		// Jobs list
   pappl_job_t		*job;		// Current job pointer
   cups_array_t		*ra;		// Requested attributes array
 
@@ -1138,19 +1159,19 @@ ipp_get_jobs(pappl_client_t *client)	// I - Client
   {
     job_comparison = -1;
     job_state      = IPP_JSTATE_STOPPED;
-    list           = client->printer->active_jobs;
+    list           = &client->printer->active_jobs;
   }
   else if (!strcmp(which_jobs, "completed"))
   {
     job_comparison = 1;
     job_state      = IPP_JSTATE_CANCELED;
-    list           = client->printer->completed_jobs;
+    list           = &client->printer->completed_jobs;
   }
   else if (!strcmp(which_jobs, "all"))
   {
     job_comparison = 1;
     job_state      = IPP_JSTATE_PENDING;
-    list           = client->printer->all_jobs;
+    list           = &client->printer->all_jobs;
   }
   else
   {
@@ -1197,16 +1218,13 @@ ipp_get_jobs(pappl_client_t *client)	// I - Client
 
   papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
 
-  pthread_rwlock_rdlock(&(client->printer->rwlock));
+  _papplRWLockRead(&client->printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  count = cupsArrayCount(list);
-  if (limit <= 0 || limit > count)
-    limit = count;
+  if (limit <= 0 || limit > list->count)
+    limit = list->count;
 
-  for (count = 0, i = 0; i < limit; i ++)
+  for (count = 0, i = 0, job = list->first; job && i < limit; i ++, job = _papplJobListNext(list, job))
   {
-    job = (pappl_job_t *)cupsArrayIndex(list, i);
-
     // Filter out jobs that don't match...
     if ((job_comparison < 0 && job->state > job_state) || (job_comparison == 0 && job->state != job_state) || (job_comparison > 0 && job->state < job_state) || (username && job->username && strcasecmp(username, job->username)))
       continue;
@@ -1220,7 +1238,7 @@ ipp_get_jobs(pappl_client_t *client)	// I - Client
 
   cupsArrayDelete(ra);
 
-  pthread_rwlock_unlock(&(client->printer->rwlock));
+  _papplRWUnlock(&client->printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 }
 
 
@@ -1249,11 +1267,11 @@ ipp_get_printer_attributes(
 
   papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
 
-  pthread_rwlock_rdlock(&(printer->rwlock));
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   _papplPrinterCopyAttributes(client, printer, ra, ippGetString(ippFindAttribute(client->request, "document-format", IPP_TAG_MIMETYPE), 0, NULL));
 
-  pthread_rwlock_unlock(&(printer->rwlock));
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   cupsArrayDelete(ra);
 }
@@ -1445,7 +1463,7 @@ valid_job_attributes(
   // Check operation attributes...
   valid = _papplJobValidateDocumentAttributes(client);
 
-  pthread_rwlock_rdlock(&client->printer->rwlock);
+  _papplRWLockRead(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   // Check the various job template attributes...
   if ((attr = ippFindAttribute(client->request, "copies", IPP_TAG_ZERO)) != NULL)
@@ -1524,7 +1542,7 @@ valid_job_attributes(
     }
     else
     {
-      supported = ippFindAttribute(client->printer->driver_attrs, "media-supported", IPP_TAG_KEYWORD);
+      supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "media-supported", IPP_TAG_KEYWORD);
 
       if (!ippContainsString(supported, ippGetString(attr, 0, NULL)))
       {
@@ -1561,7 +1579,7 @@ valid_job_attributes(
       }
       else
       {
-	supported = ippFindAttribute(client->printer->driver_attrs, "media-supported", IPP_TAG_KEYWORD);
+	supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "media-supported", IPP_TAG_KEYWORD);
 
 	if (!ippContainsString(supported, ippGetString(member, 0, NULL)))
 	{
@@ -1590,7 +1608,7 @@ valid_job_attributes(
 	{
 	  x_value   = ippGetInteger(x_dim, 0);
 	  y_value   = ippGetInteger(y_dim, 0);
-	  supported = ippFindAttribute(client->printer->driver_attrs, "media-size-supported", IPP_TAG_BEGIN_COLLECTION);
+	  supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "media-size-supported", IPP_TAG_BEGIN_COLLECTION);
 	  count     = ippGetCount(supported);
 
 	  for (i = 0; i < count ; i ++)
@@ -1745,7 +1763,7 @@ valid_job_attributes(
     }
   }
 
-  pthread_rwlock_unlock(&client->printer->rwlock);
+  _papplRWUnlock(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (valid);
 }
@@ -2030,7 +2048,7 @@ valid_scan_doc_attributes(
     {
       flag = 0;   // 0: no acceptable document format supported
       num_supported = ippGetCount(attr);
-      supported   = ippFindAttribute(client->printer->driver_attrs, "document-format-supported", IPP_TAG_MIMETYPE);
+      supported   = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "document-format-supported", IPP_TAG_MIMETYPE);
 
       for(i = 0; i < num_supported; i++)
       {
@@ -2113,7 +2131,7 @@ valid_scan_doc_attributes(
       valid = 0;  
     }
 
-    supported = ippFindAttribute(client->printer->driver_attrs, "media-size-supported", IPP_TAG_BEGIN_COLLECTION);
+    supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "media-size-supported", IPP_TAG_BEGIN_COLLECTION);
 	  num_supported  = ippGetCount(supported);
 
     if(is_present_input_auto_exposure)
@@ -2167,7 +2185,7 @@ valid_scan_doc_attributes(
       }
       else
       {
-        inner_supported = ippFindAttribute(client->printer->driver_attrs, "input-color-mode-supported", IPP_TAG_ZERO);
+        inner_supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "input-color-mode-supported", IPP_TAG_ZERO);
         attr_string_val = ippGetString(inner_attr,0,NULL);
         if (!ippContainsString(inner_supported, attr_string_val))
         {
@@ -2247,7 +2265,7 @@ valid_scan_doc_attributes(
       }
       else
       {
-        inner_supported = ippFindAttribute(client->printer->driver_attrs, "input-media-supported", IPP_TAG_ZERO);
+        inner_supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "input-media-supported", IPP_TAG_ZERO);
         attr_string_val = ippGetString(inner_attr,0,NULL);
         if (!ippContainsString(inner_supported, attr_string_val))
         {
@@ -2293,7 +2311,7 @@ valid_scan_doc_attributes(
           x_res;    // horizontal resolution input 
 
         flag = 0;
-        inner_supported = ippFindAttribute(client->printer->driver_attrs, "input-resolution-supported", IPP_TAG_ZERO);
+        inner_supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "input-resolution-supported", IPP_TAG_ZERO);
         num_supported = ippGetCount(inner_supported);
 
         x_res = ippGetResolution(inner_attr, 0, &y_res, IPP_RES_PER_INCH);
@@ -2365,7 +2383,7 @@ valid_scan_doc_attributes(
       }
       else
       {
-        inner_supported = ippFindAttribute(client->printer->driver_attrs, "input-sides-supported", IPP_TAG_ZERO);
+        inner_supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "input-sides-supported", IPP_TAG_ZERO);
         attr_string_val = ippGetString(inner_attr,0,NULL);
         if (!ippContainsString(inner_supported, attr_string_val))
         {
@@ -2385,7 +2403,7 @@ valid_scan_doc_attributes(
       }
       else
       {
-        inner_supported = ippFindAttribute(client->printer->driver_attrs, "input-source-supported", IPP_TAG_ZERO);
+        inner_supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "input-source-supported", IPP_TAG_ZERO);
         attr_string_val = ippGetString(inner_attr,0,NULL);
         if (!ippContainsString(inner_supported, attr_string_val))
         {
@@ -2411,7 +2429,7 @@ valid_scan_doc_attributes(
       bool    is_present_noise_removal = (ippFindAttribute(coll, "noise-removal", IPP_TAG_ZERO) != NULL),
         is_present_output_compression_quality_factor = (ippFindAttribute(coll, "output-compression-quality-factor", IPP_TAG_ZERO) != NULL),
 
-      supported = ippFindAttribute(client->printer->driver_attrs, "output-attributes-supported", IPP_TAG_ZERO);
+      supported = ippFindAttribute(_papplPrinterGetDriverAttrs(client->printer), "output-attributes-supported", IPP_TAG_ZERO);
       //num_supported = ippGetCount(supported);
 
       if(is_present_noise_removal)
@@ -2469,7 +2487,7 @@ valid_scan_job_attributes(
   // Check operation attributes...
   valid = valid_doc_attributes(client);
 
-  pthread_rwlock_rdlock(&client->printer->rwlock);
+  _papplRWLockRead(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   // Check the various job template attributes...
   if ((attr = ippFindAttribute(client->request, "copies", IPP_TAG_ZERO)) != NULL)
@@ -2618,7 +2636,7 @@ valid_scan_job_attributes(
 
   } 
 
-  pthread_rwlock_unlock(&client->printer->rwlock);
+  _papplRWUnlock(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (valid);
 }
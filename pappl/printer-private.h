@@ -16,9 +16,11 @@
 //
 
 #  include "dnssd-private.h"
+#  include "job-private.h"
 #  include "printer.h"
 #  include "log.h"
 #  include <grp.h>
+#  include <stdatomic.h>
 #  ifdef __APPLE__
 #    include <sys/param.h>
 #    include <sys/mount.h>
@@ -45,10 +47,28 @@
 //
 // Types and structures...
 //
+// Each printer has three locks, which are acquired after the system lock and
+// before any job lock in the following order:
+//
+// 1. "rwlock" protects the configuration: names, location, driver data,
+//    supplies, links, and so forth.
+// 2. "device_mutex" protects the device connection and is held while the
+//    device is being opened or closed.
+// 3. "jobs_rwlock" protects the job queue: the job lists, job limits, next
+//    job ID, and the currently processing job.
+//
+// The printer state values are atomic so they can be read without a lock.
+// Changes that go with a job queue transition (starting or finishing a job,
+// pausing or resuming the printer) are made while holding "jobs_rwlock".
+//
+// Debug builds check the lock order - see the `_pappl_lock_t` ranks.
+//
 
 struct _pappl_printer_s			// Printer data
 {
-  pthread_rwlock_t	rwlock;			// Reader/writer lock
+  pthread_rwlock_t	rwlock;			// Reader/writer lock for configuration
+  pthread_mutex_t	device_mutex;		// Mutex for device
+  pthread_rwlock_t	jobs_rwlock;		// Reader/writer lock for job queue
   pappl_system_t	*system;		// Containing system
   int			printer_id;		// "printer-id" value
   char			*name,			// "printer-name" value
@@ -61,11 +81,11 @@ struct _pappl_printer_s			// Printer data
   char			*resource;		// Resource path of printer
   size_t		resourcelen;		// Length of resource path
   char			*uriname;		// Name for URLs
-  ipp_pstate_t		state;			// "printer-state" value
-  pappl_preason_t	state_reasons;		// "printer-state-reasons" values
-  time_t		state_time;		// "printer-state-change-time" value
-  bool			is_stopped,		// Are we stopping this printer?
-			is_deleted;		// Has this printer been deleted?
+  _Atomic ipp_pstate_t	state;			// "printer-state" value
+  _Atomic pappl_preason_t state_reasons;	// "printer-state-reasons" values
+  _Atomic time_t	state_time;		// "printer-state-change-time" value
+  _Atomic bool		is_stopped;		// Are we stopping this printer?
+  bool			is_deleted;		// Has this printer been deleted?
   char			*device_id,		// "printer-device-id" value
 			*device_uri;		// Device URI
   pappl_device_t	*device;		// Current connection to device (if any)
@@ -76,11 +96,15 @@ struct _pappl_printer_s			// Printer data
     pappl_sdriver_data_t scan_driver_data;
 } psdriver;
   
-  ipp_t			*driver_attrs;		// Driver attributes
+  pthread_mutex_t	driver_mutex;		// Mutex for building driver attributes
+  ipp_t			*driver_attrs,		// Driver attributes or `NULL` if not built
+			*driver_xattrs;		// Additional driver attributes
+  int			num_driver_vendor;	// Number of vendor defaults to apply
+  cups_option_t		*driver_vendor;		// Vendor defaults to apply when driver attributes are built
   ipp_t			*attrs;			// Other (static) printer attributes
   time_t		start_time;		// Startup time
   time_t		config_time;		// "printer-config-change-time" value
-  time_t		status_time;		// Last time status was updated
+  _Atomic time_t	status_time;		// Last time status was updated
   char			*print_group;		// PAM printing group, if any
   gid_t			print_gid;		// PAM printing group ID
   int			num_supply;		// Number of "printer-supply" values
@@ -89,11 +113,11 @@ struct _pappl_printer_s			// Printer data
   pappl_job_t		*processing_job;	// Currently printing job, if any
   int			max_active_jobs,	// Maximum number of active jobs to accept
 			max_completed_jobs;	// Maximum number of completed jobs to retain in history
-  cups_array_t		*active_jobs,		// Array of active jobs
-			*all_jobs,		// Array of all jobs
-			*completed_jobs;	// Array of completed jobs
-  int			next_job_id,		// Next "job-id" value
-			impcompleted;		// "printer-impressions-completed" value
+  _pappl_joblist_t	active_jobs,		// Active jobs
+			all_jobs,		// All jobs (owns the jobs)
+			completed_jobs;		// Completed jobs
+  int			next_job_id;		// Next "job-id" value
+  _Atomic int		impcompleted;		// "printer-impressions-completed" value
   cups_array_t		*links;			// Web navigation links
 #  ifdef HAVE_DNSSD
   _pappl_srv_t		dns_sd_ipp_ref,		// DNS-SD IPP service
@@ -123,7 +147,7 @@ struct _pappl_printer_s			// Printer data
 //
 
 extern bool		_papplPrinterAddRawListeners(pappl_printer_t *printer) _PAPPL_PRIVATE;
-extern void		*_papplPrinterRunRaw(pappl_printer_t *printer) _PAPPL_PRIVATE;
+extern void		_papplPrinterCloseRaw(pappl_printer_t *printer) _PAPPL_PRIVATE;
 
 extern void		*_papplPrinterRunUSB(pappl_printer_t *printer) _PAPPL_PRIVATE;
 
@@ -133,10 +157,12 @@ extern void		_papplPrinterCopyAttributes(pappl_client_t *client, pappl_printer_t
 extern void		_papplPrinterCopyState(ipp_t *ipp, pappl_printer_t *printer, cups_array_t *ra) _PAPPL_PRIVATE;
 extern void		_papplPrinterCopyXRI(pappl_client_t *client, ipp_t *ipp, pappl_printer_t *printer) _PAPPL_PRIVATE;
 extern void		_papplPrinterDelete(pappl_printer_t *printer) _PAPPL_PRIVATE;
+extern ipp_t		*_papplPrinterGetDriverAttrs(pappl_printer_t *printer) _PAPPL_PRIVATE;
 extern void		_papplPrinterInitDriverData(pappl_pr_driver_data_t *d) _PAPPL_PRIVATE;
 extern void		_papplPrinterProcessIPP(pappl_client_t *client) _PAPPL_PRIVATE;
 extern bool		_papplPrinterRegisterDNSSDNoLock(pappl_printer_t *printer) _PAPPL_PRIVATE;
 extern bool		_papplPrinterSetAttributes(pappl_client_t *client, pappl_printer_t *printer) _PAPPL_PRIVATE;
+extern void		_papplPrinterSetVendorDefault(pappl_printer_t *printer, const char *name, const char *value) _PAPPL_PRIVATE;
 extern void		_papplPrinterUnregisterDNSSDNoLock(pappl_printer_t *printer) _PAPPL_PRIVATE;
 
 extern void		_papplPrinterWebCancelAllJobs(pappl_client_t *client, pappl_printer_t *printer) _PAPPL_PRIVATE;
@@ -15,6 +15,35 @@
 #include "pappl-private.h"
 
 
+//
+// Local types...
+//
+
+typedef struct _pappl_raw_s		// Raw socket print session
+{
+  pappl_printer_t	*printer;	// Printer
+  pappl_job_t		*job;		// Job
+  int			fd;		// Client socket
+  time_t		activity;	// Time of last activity
+} _pappl_raw_t;
+
+typedef struct _pappl_rawpoll_s		// Raw socket poll data
+{
+  pappl_printer_t	*printer;	// Printer for listener, if any
+  _pappl_raw_t		*session;	// Session, if any
+} _pappl_rawpoll_t;
+
+
+//
+// Local functions...
+//
+
+static void	accept_raw(pappl_printer_t *printer, int fd);
+static bool	admit_raw(pappl_printer_t *printer);
+static void	finish_raw(_pappl_raw_t *session, bool aborted);
+static int	read_raw(_pappl_raw_t *session);
+
+
 //
 // '_papplPrinterAddRawListeners()' - Create listener sockets for raw print queues.
 //
@@ -23,178 +52,430 @@ bool					// O - `true` on success, `false` otherwise
 _papplPrinterAddRawListeners(
     pappl_printer_t *printer)		// I - Printer
 {
-  int			sock,		// Listener socket
+  pappl_system_t	*system = printer->system;
+					// System
+  int			i,		// Looping var
+			sock,		// Listener socket
+			socks[2],	// Listener sockets
+			num_socks = 0,	// Number of listener sockets
 			port;		// Listener port
   http_addrlist_t	*addrlist;	// Listen addresses
   char			service[255];	// Service port
+  static const int	families[2] = { AF_INET, AF_INET6 };
+					// Address families
 
 
   // Listen on port 9100, 9101, etc.
   port = 9099 + printer->printer_id;
   snprintf(service, sizeof(service), "%d", port);
 
-  if ((addrlist = httpAddrGetList(NULL, AF_INET, service)) != NULL)
+  for (i = 0; i < 2; i ++)
   {
+    if ((addrlist = httpAddrGetList(NULL, families[i], service)) == NULL)
+      continue;
+
     if ((sock = httpAddrListen(&(addrlist->addr), port)) < 0)
     {
       papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to create socket print listener for '*:%d': %s", port, cupsLastErrorString());
     }
     else
     {
-      printer->listeners[printer->num_listeners].fd     = sock;
-      printer->listeners[printer->num_listeners].events = POLLIN | POLLERR;
-      printer->num_listeners ++;
+      fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+      socks[num_socks ++] = sock;
     }
 
     httpAddrFreeList(addrlist);
   }
 
-  if ((addrlist = httpAddrGetList(NULL, AF_INET6, service)) != NULL)
-  {
-    if ((sock = httpAddrListen(&(addrlist->addr), port)) < 0)
-    {
-      papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to create socket print listener for '*:%d': %s", port, cupsLastErrorString());
-    }
-    else
-    {
-      printer->listeners[printer->num_listeners].fd     = sock;
-      printer->listeners[printer->num_listeners].events = POLLIN | POLLERR;
-      printer->num_listeners ++;
-    }
+  if (num_socks == 0)
+    return (false);
 
-    httpAddrFreeList(addrlist);
+  // The printer is already visible to the raw socket thread, so update the
+  // listeners under the raw mutex...
+  pthread_mutex_lock(&system->raw_mutex);
+
+  for (i = 0; i < num_socks; i ++)
+  {
+    printer->listeners[printer->num_listeners].fd     = socks[i];
+    printer->listeners[printer->num_listeners].events = POLLIN | POLLERR;
+    printer->num_listeners ++;
   }
 
-  if (printer->num_listeners > 0)
-    papplLogPrinter(printer, PAPPL_LOGLEVEL_INFO, "Listening for socket print jobs on '*:%d'.", port);
+  system->raw_generation ++;
+
+  pthread_mutex_unlock(&system->raw_mutex);
 
-  return (printer->num_listeners > 0);
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_INFO, "Listening for socket print jobs on '*:%d'.", port);
+
+  // Let the raw socket thread know about the new listeners...
+  _papplSystemWakeRaw(system);
+
+  return (true);
 }
 
 
 //
-// '_papplPrinterRunRaw()' - Accept raw print requests over sockets.
+// '_papplPrinterCloseRaw()' - Close the raw listeners and sessions for a printer.
+//
+// This function must be called before the printer is removed from the
+// system, without holding the system lock.
 //
 
-void *					// O - Thread exit value
-_papplPrinterRunRaw(
+void
+_papplPrinterCloseRaw(
     pappl_printer_t *printer)		// I - Printer
 {
-  int	i;				// Looping var
+  pappl_system_t	*system = printer->system;
+					// System
+  int			i;		// Looping var
+  _pappl_raw_t		*session;	// Current session
+
 
+  pthread_mutex_lock(&system->raw_mutex);
 
-  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Running socket print thread with %d listeners.", printer->num_listeners);
+  for (i = 0; i < printer->num_listeners; i ++)
+    close(printer->listeners[i].fd);
 
-  while (printer->listeners[0].fd >= 0)
+  printer->num_listeners = 0;
+
+  for (session = (_pappl_raw_t *)cupsArrayFirst(system->raw_sessions); session; session = (_pappl_raw_t *)cupsArrayNext(system->raw_sessions))
   {
-    // Don't accept connections if we can't accept a new job...
-    while (cupsArrayCount(printer->active_jobs) >= printer->max_active_jobs && printer->listeners[0].fd >= 0)
-      sleep(1);
+    if (session->printer == printer)
+      finish_raw(session, true);
+  }
 
-    if (printer->listeners[0].fd < 0)
-      break;
+  system->raw_generation ++;
+
+  pthread_mutex_unlock(&system->raw_mutex);
+}
+
+
+//
+// '_papplSystemRunRaw()' - Accept and receive raw print jobs over sockets.
+//
+// A single thread serves the raw listeners and receive sessions of all
+// printers, so one slow sender does not hold up the others.  A printer's
+// listeners are only polled while it can accept another job, and the thread
+// is woken up as soon as that changes.
+//
 
-    // Wait 1 second for new connections...
-    if ((i = poll(printer->listeners, (nfds_t)printer->num_listeners, 1000)) > 0)
+void *					// O - Thread exit value
+_papplSystemRunRaw(
+    pappl_system_t *system)		// I - System
+{
+  int			i,		// Looping var
+			count;		// Number of poll events
+  struct pollfd		*pfds = NULL;	// Poll data
+  _pappl_rawpoll_t	*pdata = NULL;	// Poll listener/session data
+  int			num_pfds,	// Number of poll entries
+			alloc_pfds = 0;	// Allocated poll entries
+  unsigned		generation;	// Generation for poll data
+  pappl_printer_t	*printer;	// Current printer
+  _pappl_raw_t		*session;	// Current session
+  int			status;		// Read status
+  time_t		curtime;	// Current time
+  char			buffer[256];	// Wakeup buffer
+
+
+  papplLog(system, PAPPL_LOGLEVEL_DEBUG, "Running socket print thread.");
+
+  while (system->raw_running)
+  {
+    // Build the poll data from the printer listeners and active sessions...
+    pthread_mutex_lock(&system->raw_mutex);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+
+    count = 1 + 2 * cupsArrayCount(system->printers) + cupsArrayCount(system->raw_sessions);
+
+    if (count > alloc_pfds)
+    {
+      struct pollfd	*temp;		// New poll data
+      _pappl_rawpoll_t	*tempdata;	// New listener/session data
+
+      if ((temp = (struct pollfd *)realloc(pfds, (size_t)count * sizeof(struct pollfd))) != NULL)
+        pfds = temp;
+
+      if ((tempdata = (_pappl_rawpoll_t *)realloc(pdata, (size_t)count * sizeof(_pappl_rawpoll_t))) != NULL)
+        pdata = tempdata;
+
+      if (!temp || !tempdata)
+      {
+        papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for socket print connections.");
+        _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+        pthread_mutex_unlock(&system->raw_mutex);
+        break;
+      }
+
+      alloc_pfds = count;
+    }
+
+    pfds[0].fd      = system->raw_pipe[0];
+    pfds[0].events  = POLLIN;
+    pdata[0].printer = NULL;
+    pdata[0].session = NULL;
+    num_pfds        = 1;
+
+    for (printer = (pappl_printer_t *)cupsArrayFirst(system->printers); printer; printer = (pappl_printer_t *)cupsArrayNext(system->printers))
     {
-      // Got a new connection request, accept from the corresponding listener...
-      for (i = 0; i < printer->num_listeners; i ++)
+      // Don't accept connections if we can't accept a new job...
+      if (!admit_raw(printer))
+        continue;
+
+      for (i = 0; i < printer->num_listeners; i ++, num_pfds ++)
       {
-        if (printer->listeners[i].revents & POLLIN)
-        {
-          int		sock;		// Client socket
-          http_addr_t	sockaddr;	// Client address
-          socklen_t	sockaddrlen;	// Length of client address
-          struct pollfd	sockp;		// poll() data for client socket
-          pappl_job_t	*job;		// New print job
-          ssize_t	bytes;		// Bytes read from socket
-          char		buffer[8192];	// Copy buffer
-          char		filename[1024];	// Job filename
-
-          // Accept the connection...
-          sockaddrlen = sizeof(sockaddr);
-          if ((sock = accept(printer->listeners[i].fd, (struct sockaddr *)&sockaddr, &sockaddrlen)) < 0)
-          {
-            papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to accept socket print connection: %s", strerror(errno));
-            continue;
-          }
-
-	  // Create a new job with default attributes...
-	  papplLogPrinter(printer, PAPPL_LOGLEVEL_INFO, "Accepted socket print connection from '%s'.", httpAddrString(&sockaddr, buffer, sizeof(buffer)));
-          if ((job = _papplJobCreate(printer, 0, "guest", printer->psdriver.driver_data.format ? printer->psdriver.driver_data.format : "application/octet-stream", "Untitled", NULL)) == NULL)
-          {
-            close(sock);
-            continue;
-          }
-
-          // Read the print data from the socket...
-	  if ((job->fd = papplJobOpenFile(job, filename, sizeof(filename), printer->system->directory, NULL, "w")) < 0)
-	  {
-	    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to create print file: %s", strerror(errno));
-
-	    goto abort_job;
-	  }
-
-	  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Created job file \"%s\", format \"%s\".", filename, job->format);
-
-          sockp.fd     = sock;
-          sockp.events = POLLIN | POLLERR;
-
-          while ((bytes = poll(&sockp, 1, 60000)) >= 0)
-          {
-            if (sockp.revents & POLLIN)
-            {
-              if ((bytes = read(sock, buffer, sizeof(buffer))) > 0)
-                write(job->fd, buffer, (size_t)bytes);
-              else
-                break;
-            }
-            else if (sockp.revents & POLLERR)
-            {
-              bytes = -1;
-              break;
-            }
-          }
-
-          close(sock);
-	  close(job->fd);
-	  job->fd = -1;
-
-          if (bytes < 0)
-          {
-            // Error while reading
-	    unlink(filename);
-	    goto abort_job;
-	  }
-
-	  // Finish the job...
-	  job->filename = strdup(filename);
-	  job->state    = IPP_JSTATE_PENDING;
-
-	  _papplPrinterCheckJobs(printer);
-	  continue;
-
-	  // Abort the job...
-	  abort_job:
-
-	  job->state     = IPP_JSTATE_ABORTED;
-	  job->completed = time(NULL);
-
-	  pthread_rwlock_wrlock(&printer->rwlock);
-
-	  cupsArrayRemove(printer->active_jobs, job);
-	  cupsArrayAdd(printer->completed_jobs, job);
-
-	  if (!printer->system->clean_time)
-	    printer->system->clean_time = time(NULL) + 60;
-
-	  pthread_rwlock_unlock(&printer->rwlock);
-        }
+        pfds[num_pfds].fd      = printer->listeners[i].fd;
+        pfds[num_pfds].events  = POLLIN;
+        pdata[num_pfds].printer = printer;
+        pdata[num_pfds].session = NULL;
       }
     }
-    else if (i < 0 && errno != EAGAIN)
+
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+
+    for (session = (_pappl_raw_t *)cupsArrayFirst(system->raw_sessions); session; session = (_pappl_raw_t *)cupsArrayNext(system->raw_sessions), num_pfds ++)
+    {
+      pfds[num_pfds].fd      = session->fd;
+      pfds[num_pfds].events  = POLLIN;
+      pdata[num_pfds].printer = NULL;
+      pdata[num_pfds].session = session;
+    }
+
+    generation = system->raw_generation;
+
+    pthread_mutex_unlock(&system->raw_mutex);
+
+    // Wait for connections, data, or a wakeup...
+    if ((count = poll(pfds, (nfds_t)num_pfds, 1000)) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to poll socket print connections: %s", strerror(errno));
       break;
+    }
+
+    if (pfds[0].revents & POLLIN)
+    {
+      while (read(system->raw_pipe[0], buffer, sizeof(buffer)) > 0);
+    }
+
+    pthread_mutex_lock(&system->raw_mutex);
+
+    if (generation == system->raw_generation)
+    {
+      // Accept new connections and read print data...
+      for (i = 1; i < num_pfds && count > 0; i ++)
+      {
+        if (!pfds[i].revents)
+          continue;
+
+        count --;
+
+        if (pdata[i].printer)
+          accept_raw(pdata[i].printer, pfds[i].fd);
+        else if (!(pfds[i].revents & (POLLIN | POLLHUP)))
+          finish_raw(pdata[i].session, true);
+        else if ((status = read_raw(pdata[i].session)) <= 0)
+          finish_raw(pdata[i].session, status < 0);
+      }
+    }
+
+    // Abort sessions that have been idle for too long...
+    curtime = time(NULL);
+
+    for (session = (_pappl_raw_t *)cupsArrayFirst(system->raw_sessions); session; session = (_pappl_raw_t *)cupsArrayNext(system->raw_sessions))
+    {
+      if ((curtime - session->activity) > 60)
+      {
+        papplLogJob(session->job, PAPPL_LOGLEVEL_ERROR, "Timed out waiting for print data.");
+        finish_raw(session, true);
+      }
+    }
+
+    pthread_mutex_unlock(&system->raw_mutex);
   }
 
+  // Abort any remaining sessions...
+  pthread_mutex_lock(&system->raw_mutex);
+
+  for (session = (_pappl_raw_t *)cupsArrayFirst(system->raw_sessions); session; session = (_pappl_raw_t *)cupsArrayNext(system->raw_sessions))
+    finish_raw(session, true);
+
+  pthread_mutex_unlock(&system->raw_mutex);
+
+  free(pfds);
+  free(pdata);
+
   return (NULL);
 }
+
+
+//
+// '_papplSystemWakeRaw()' - Wake up the raw socket thread.
+//
+// The thread rebuilds its list of listeners and sessions after a wakeup, so
+// this is called when printers are added or jobs finish.
+//
+
+void
+_papplSystemWakeRaw(
+    pappl_system_t *system)		// I - System
+{
+  if (system->raw_pipe[1] >= 0)
+  {
+    if (write(system->raw_pipe[1], "", 1) < 0 && errno != EAGAIN)
+      papplLog(system, PAPPL_LOGLEVEL_DEBUG, "Unable to wake socket print thread: %s", strerror(errno));
+  }
+}
+
+
+//
+// 'accept_raw()' - Accept a new raw print connection.
+//
+// Called with the raw mutex held.
+//
+
+static void
+accept_raw(pappl_printer_t *printer,	// I - Printer
+           int             fd)		// I - Listener socket
+{
+  pappl_system_t	*system = printer->system;
+					// System
+  int			sock;		// Client socket
+  http_addr_t		sockaddr;	// Client address
+  socklen_t		sockaddrlen;	// Length of client address
+  _pappl_raw_t		*session;	// New session
+  char			temp[256];	// Address string
+
+
+  // Leave the connection in the backlog if we can't accept a new job...
+  if (!admit_raw(printer))
+    return;
+
+  // Accept the connection...
+  sockaddrlen = sizeof(sockaddr);
+  if ((sock = accept(fd, (struct sockaddr *)&sockaddr, &sockaddrlen)) < 0)
+  {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to accept socket print connection: %s", strerror(errno));
+    return;
+  }
+
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_INFO, "Accepted socket print connection from '%s'.", httpAddrString(&sockaddr, temp, sizeof(temp)));
+
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+  fcntl(sock, F_SETFD, fcntl(sock, F_GETFD) | FD_CLOEXEC);
+
+  if ((session = (_pappl_raw_t *)calloc(1, sizeof(_pappl_raw_t))) == NULL)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for socket print connection: %s", strerror(errno));
+    close(sock);
+    return;
+  }
+
+  session->printer  = printer;
+  session->fd       = sock;
+  session->activity = time(NULL);
+
+  // Create a new job with default attributes...
+  if ((session->job = _papplJobCreate(printer, 0, "guest", printer->psdriver.driver_data.format ? printer->psdriver.driver_data.format : "application/octet-stream", "Untitled", NULL)) == NULL)
+  {
+    close(sock);
+    free(session);
+    return;
+  }
+
+  // Create the print file...
+  if (!_papplJobOpenSpool(session->job, 0))
+  {
+    finish_raw(session, true);
+    return;
+  }
+
+  if (!system->raw_sessions)
+    system->raw_sessions = cupsArrayNew(NULL, NULL);
+
+  cupsArrayAdd(system->raw_sessions, session);
+}
+
+
+//
+// 'admit_raw()' - Determine whether a printer can accept a new raw print job.
+//
+
+static bool				// O - `true` if a new job can be accepted
+admit_raw(pappl_printer_t *printer)	// I - Printer
+{
+  bool	ret;				// Return value
+
+
+  _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  ret = !printer->is_deleted && (printer->max_active_jobs <= 0 || printer->active_jobs.count < printer->max_active_jobs);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  return (ret);
+}
+
+
+//
+// 'finish_raw()' - Finish a raw print session, queuing or aborting the job.
+//
+// Called with the raw mutex held.  The session is removed from the system and
+// freed.
+//
+
+static void
+finish_raw(_pappl_raw_t *session,	// I - Session
+           bool         aborted)	// I - Abort the job?
+{
+  pappl_system_t	*system = session->printer->system;
+					// System
+
+
+  cupsArrayRemove(system->raw_sessions, session);
+
+  close(session->fd);
+
+  // Queue or abort the job...
+  _papplJobCloseSpool(session->job, !aborted);
+
+  free(session);
+}
+
+
+//
+// 'read_raw()' - Read print data from a raw socket.
+//
+// At most one buffer is read per wakeup so that a fast sender cannot starve
+// the other sessions served by the same thread - any remaining data is read
+// on the next poll().
+//
+
+static int				// O - `1` to continue, `0` at end of data, `-1` on error
+read_raw(_pappl_raw_t *session)		// I - Session
+{
+  ssize_t	bytes;			// Bytes read from socket
+  char		buffer[65536];		// Copy buffer
+
+
+  session->activity = time(NULL);
+
+  if ((bytes = read(session->fd, buffer, sizeof(buffer))) > 0)
+  {
+    if (!_papplJobWriteSpool(session->job, buffer, (size_t)bytes))
+      return (-1);
+
+    // Stop receiving a job that was canceled while printing...
+    if (session->job->receiving && session->job->is_canceled)
+      return (-1);
+
+    return (1);
+  }
+  else if (bytes == 0)
+    return (0);
+  else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+    return (1);
+
+  papplLogJob(session->job, PAPPL_LOGLEVEL_ERROR, "Unable to read print data: %s", strerror(errno));
+  return (-1);
+}
@@ -23,6 +23,7 @@ static void	job_cb(pappl_job_t *job, pappl_client_t *client);
 static char	*localize_keyword(const char *attrname, const char *keyword, char *buffer, size_t bufsize);
 static char	*localize_media(pappl_media_col_t *media, bool include_source, char *buffer, size_t bufsize);
 static void	media_chooser(pappl_client_t *client, pappl_pr_driver_data_t *driver_data, const char *title, const char *name, pappl_media_col_t *media);
+static void	printer_events(pappl_client_t *client, pappl_printer_t *printer);
 static char	*time_string(time_t tv, char *buffer, size_t bufsize);
 static void	job_pager(pappl_client_t *client, pappl_printer_t *printer, int job_index, int limit);
 
@@ -425,7 +426,7 @@ _papplPrinterWebDefaults(
 
         if ((value = cupsGetOption(data.vendor[i], num_form, form)) != NULL)
 	  num_vendor = cupsAddOption(data.vendor[i], value, num_vendor, &vendor);
-	else if (ippFindAttribute(printer->driver_attrs, supattr, IPP_TAG_BOOLEAN))
+	else if (ippFindAttribute(_papplPrinterGetDriverAttrs(printer), supattr, IPP_TAG_BOOLEAN))
 	  num_vendor = cupsAddOption(data.vendor[i], "false", num_vendor, &vendor);
       }
 
@@ -615,7 +616,7 @@ _papplPrinterWebDefaults(
   papplClientHTMLPuts(client, "</td></tr>\n");
 
   // Vendor options
-  pthread_rwlock_rdlock(&printer->rwlock);
+  _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   for (i = 0; i < data.num_vendor; i ++)
   {
@@ -628,12 +629,12 @@ _papplPrinterWebDefaults(
     snprintf(defname, sizeof(defname), "%s-default", data.vendor[i]);
     snprintf(supname, sizeof(defname), "%s-supported", data.vendor[i]);
 
-    if ((attr = ippFindAttribute(printer->driver_attrs, defname, IPP_TAG_ZERO)) != NULL)
+    if ((attr = ippFindAttribute(_papplPrinterGetDriverAttrs(printer), defname, IPP_TAG_ZERO)) != NULL)
       ippAttributeString(attr, defvalue, sizeof(defvalue));
     else
       defvalue[0] = '\0';
 
-    if ((attr = ippFindAttribute(printer->driver_attrs, supname, IPP_TAG_ZERO)) != NULL)
+    if ((attr = ippFindAttribute(_papplPrinterGetDriverAttrs(printer), supname, IPP_TAG_ZERO)) != NULL)
     {
       count = ippGetCount(attr);
 
@@ -685,7 +686,7 @@ _papplPrinterWebDefaults(
     }
   }
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   papplClientHTMLPuts(client,
                       "              <tr><th></th><td><input type=\"submit\" value=\"Save Changes\"></td></tr>\n"
@@ -768,7 +769,6 @@ _papplPrinterWebHome(
     pappl_printer_t *printer)		// I - Printer
 {
   const char	*status = NULL;		// Status text, if any
-  ipp_pstate_t	printer_state;		// Printer state
   char		edit_path[1024];	// Edit configuration URL
   const int	limit = 20;		// Jobs per page
   int		job_index = 1;		// Job index
@@ -853,9 +853,8 @@ _papplPrinterWebHome(
   }
 
   // Show status...
-  printer_state = papplPrinterGetState(printer);
-
-  papplClientHTMLPrinterHeader(client, printer, NULL, printer_state == IPP_PSTATE_PROCESSING ? 10 : 0, NULL, NULL);
+  papplClientHTMLPrinterHeader(client, printer, NULL, 0, NULL, NULL);
+  printer_events(client, printer);
 
   papplClientHTMLPuts(client,
                       "      <div class=\"row\">\n"
@@ -883,7 +882,7 @@ _papplPrinterWebHome(
 
   if (papplPrinterGetNumberOfJobs(printer) > 0)
   {
-    if (cupsArrayCount(printer->active_jobs) > 0)
+    if (printer->active_jobs.count > 0)
       papplClientHTMLPrintf(client, " <a class=\"btn\" href=\"https://%s:%d%s/cancelall\">Cancel All Jobs</a></h1>\n", client->host_field, client->host_port, printer->uriname);
     else
       papplClientHTMLPuts(client, "</h1>\n");
@@ -971,13 +970,15 @@ _papplPrinterWebIteratorCallback(
     papplClientHTMLPuts(client, "          <h1 class=\"title\">Status</h1>\n");
 
   papplClientHTMLPrintf(client,
-			"          <p><img class=\"%s\" src=\"%s/icon-md.png\">%s, %d %s", ippEnumString("printer-state", (int)printer_state), printer->uriname, states[printer_state - IPP_PSTATE_IDLE], printer_jobs, printer_jobs == 1 ? "job" : "jobs");
+			"          <p><img id=\"printer-icon-%d\" class=\"%s\" src=\"%s/icon-md.png\"><span id=\"printer-status-%d\" data-jobs=\"%d\">%s, %d %s", printer->printer_id, ippEnumString("printer-state", (int)printer_state), printer->uriname, printer->printer_id, printer_jobs, states[printer_state - IPP_PSTATE_IDLE], printer_jobs, printer_jobs == 1 ? "job" : "jobs");
   for (i = 0, reason = PAPPL_PREASON_OTHER; reason <= PAPPL_PREASON_TONER_LOW; i ++, reason *= 2)
   {
     if (printer_reasons & reason)
       papplClientHTMLPrintf(client, ", %s", reasons[i]);
   }
 
+  papplClientHTMLPuts(client, "</span>");
+
   if (strcmp(printer->name, printer->psdriver.driver_data.make_and_model))
     papplClientHTMLPrintf(client, ".<br>%s</p>\n", printer->psdriver.driver_data.make_and_model);
   else
@@ -1016,7 +1017,6 @@ _papplPrinterWebJobs(
     pappl_client_t  *client,		// I - Client
     pappl_printer_t *printer)		// I - Printer
 {
-  ipp_pstate_t	printer_state;		// Printer state
   int		job_index = 1,		// Job index
 		limit = 20;		// Jobs per page
 
@@ -1024,8 +1024,6 @@ _papplPrinterWebJobs(
   if (!papplClientHTMLAuthorize(client))
     return;
 
-  printer_state = papplPrinterGetState(printer);
-
   if (client->operation == HTTP_STATE_GET)
   {
     cups_option_t	*form = NULL;	// Form variables
@@ -1039,19 +1037,21 @@ _papplPrinterWebJobs(
     cupsFreeOptions(num_form, form);
   }
 
-  if (cupsArrayCount(printer->active_jobs) > 0)
+  if (printer->active_jobs.count > 0)
   {
     char	url[1024];		// URL for Cancel All Jobs
 
     httpAssembleURIf(HTTP_URI_CODING_ALL, url, sizeof(url), "https", NULL, client->host_field, client->host_port, "%s/cancelall", printer->uriname);
 
-    papplClientHTMLPrinterHeader(client, printer, "Jobs", printer_state == IPP_PSTATE_PROCESSING ? 10 : 0, "Cancel All Jobs", url);
+    papplClientHTMLPrinterHeader(client, printer, "Jobs", 0, "Cancel All Jobs", url);
   }
   else
   {
-    papplClientHTMLPrinterHeader(client, printer, "Jobs", printer_state == IPP_PSTATE_PROCESSING ? 10 : 0, NULL, NULL);
+    papplClientHTMLPrinterHeader(client, printer, "Jobs", 0, NULL, NULL);
   }
 
+  printer_events(client, printer);
+
   if (papplPrinterGetNumberOfJobs(printer) > 0)
   {
     job_pager(client, printer, job_index, limit);
@@ -1341,7 +1341,7 @@ job_cb(pappl_job_t    *job,		// I - Job
 	break;
   }
 
-  papplClientHTMLPrintf(client, "              <tr><td>%d</td><td>%s</td><td>%s</td><td>%d</td><td>%s</td>", papplJobGetID(job), papplJobGetName(job), papplJobGetUsername(job), papplJobGetImpressionsCompleted(job), when);
+  papplClientHTMLPrintf(client, "              <tr data-job-id=\"%d\" data-job-state=\"%d\"><td>%d</td><td>%s</td><td>%s</td><td>%d</td><td>%s</td>", papplJobGetID(job), (int)papplJobGetState(job), papplJobGetID(job), papplJobGetName(job), papplJobGetUsername(job), papplJobGetImpressionsCompleted(job), when);
 
   if (show_cancel)
     papplClientHTMLPrintf(client, "          <td><a class=\"btn\" href=\"%s/cancel?job-id=%d\">Cancel Job</a></td></tr>\n", job->printer->uriname, papplJobGetID(job));
@@ -1690,6 +1690,70 @@ media_chooser(
 }
 
 
+//
+// 'printer_events()' - Update the page when the printer or its jobs change.
+//
+// This replaces the periodic refresh of the status and jobs pages with a
+// subscription to the "/events" stream.  The printer status and any job rows
+// on the page are updated in place from the event data.  Since the events do
+// not include the job name or owner, the page is only reloaded when a new job
+// appears or the printer configuration changes, with multiple changes
+// coalesced into a single reload.
+//
+
+static void
+printer_events(
+    pappl_client_t  *client,		// I - Client
+    pappl_printer_t *printer)		// I - Printer
+{
+  papplClientHTMLPrintf(client,
+			"          <script>if (window.EventSource) {\n"
+			"  const states = ['Idle', 'Printing', 'Stopped'];\n"
+			"  const reasons = ['Other', 'Cover Open', 'Tray Missing', 'Out of Ink', 'Low Ink', 'Waste Tank Almost Full', 'Waste Tank Full', 'Media Empty', 'Media Jam', 'Media Low', 'Media Needed', 'Too Many Jobs', 'Out of Toner', 'Low Toner'];\n"
+			"  const completed = {7: 'Canceled', 8: 'Aborted', 9: 'Completed'};\n"
+			"  const events = new EventSource('/events?printer=%d');\n"
+			"  let reload_timer = 0;\n"
+			"  const reload = function () {\n"
+			"    if (!reload_timer) reload_timer = setTimeout(function () { events.close(); window.location.reload(); }, 500);\n"
+			"  };\n"
+			"  const update_status = function (d) {\n"
+			"    const icon = document.getElementById('printer-icon-%d'), status = document.getElementById('printer-status-%d');\n"
+			"    if (!icon || !status || d['printer-state'] < 3 || d['printer-state'] > 5) return;\n"
+			"    const jobs = parseInt(status.dataset.jobs);\n"
+			"    let text = states[d['printer-state'] - 3] + ', ' + jobs + (jobs == 1 ? ' job' : ' jobs');\n"
+			"    for (let i = 0; i < reasons.length; i ++)\n"
+			"      if (d['printer-state-reasons'] & (1 << i)) text += ', ' + reasons[i];\n"
+			"    icon.className = ['idle', 'processing', 'stopped'][d['printer-state'] - 3];\n"
+			"    status.textContent = text;\n"
+			"  };\n"
+			"  const update_job = function (e) {\n"
+			"    const d = JSON.parse(e.data), rows = document.querySelectorAll('tr[data-job-id]');\n"
+			"    let row = null, last = 0;\n"
+			"    rows.forEach(function (r) { const id = parseInt(r.dataset.jobId); if (id == d['job-id']) row = r; if (id > last) last = id; });\n"
+			"    if (!row) { if (d['job-id'] > last) reload(); return; }\n"
+			"    const old_state = parseInt(row.dataset.jobState);\n"
+			"    row.dataset.jobState = d['job-state'];\n"
+			"    row.cells[3].textContent = d['job-impressions-completed'];\n"
+			"    if (d['job-state'] == 5 && old_state < 5)\n"
+			"      row.cells[4].textContent = 'Started at ' + new Date(d['time'] * 1000).toLocaleTimeString();\n"
+			"    else if (completed[d['job-state']] && !completed[old_state])\n"
+			"    {\n"
+			"      const status = document.getElementById('printer-status-%d');\n"
+			"      row.cells[4].textContent = completed[d['job-state']] + ' at ' + new Date(d['time'] * 1000).toLocaleTimeString();\n"
+			"      row.cells[5].textContent = '';\n"
+			"      if (status && status.dataset.jobs > 0) status.dataset.jobs --;\n"
+			"    }\n"
+			"    update_status(d);\n"
+			"  };\n"
+			"  events.addEventListener('job-completed', update_job);\n"
+			"  events.addEventListener('job-progress', update_job);\n"
+			"  events.addEventListener('job-state-changed', update_job);\n"
+			"  events.addEventListener('printer-config-changed', reload);\n"
+			"  events.addEventListener('printer-state-changed', function (e) { update_status(JSON.parse(e.data)); });\n"
+			"}</script>\n", printer->printer_id, printer->printer_id, printer->printer_id, printer->printer_id);
+}
+
+
 //
 // 'time_string()' - Return the local time in hours, minutes, and seconds.
 //
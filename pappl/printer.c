@@ -15,14 +15,6 @@
 #include "pappl-private.h"
 
 
-//
-// Local functions...
-//
-
-static int	compare_active_jobs(pappl_job_t *a, pappl_job_t *b);
-static int	compare_all_jobs(pappl_job_t *a, pappl_job_t *b);
-static int	compare_completed_jobs(pappl_job_t * _papplPrinterInitPrintDriverDataa, pappl_job_t *b);
-
 
 //
 // 'papplPrinterCancelAllJobs()' - Cancel all jobs on the printer.
@@ -36,14 +28,17 @@ void
 papplPrinterCancelAllJobs(
     pappl_printer_t *printer)		// I - Printer
 {
-  pappl_job_t	*job;			// Job information
+  pappl_job_t	*job,			// Job information
+		*next;			// Next job
 
 
   // Loop through all jobs and cancel them...
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  for (job = (pappl_job_t *)cupsArrayFirst(printer->active_jobs); job; job = (pappl_job_t *)cupsArrayNext(printer->active_jobs))
+  for (job = printer->active_jobs.first; job; job = next)
   {
+    next = _papplJobListNext(&printer->active_jobs, job);
+
     // Cancel this job...
     if (job->state == IPP_JSTATE_PROCESSING || (job->state == IPP_JSTATE_HELD && job->fd >= 0))
     {
@@ -56,15 +51,13 @@ papplPrinterCancelAllJobs(
 
       _papplJobRemoveFile(job);
 
-      cupsArrayRemove(printer->active_jobs, job);
-      cupsArrayAdd(printer->completed_jobs, job);
+      _papplJobListAdd(&printer->completed_jobs, job);
     }
   }
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  if (!printer->system->clean_time)
-    printer->system->clean_time = time(NULL) + 60;
+  _papplSystemScheduleCleanJobs(printer->system, time(NULL) + 60);
 }
 
 
@@ -137,7 +130,13 @@ papplPrinterCreate(
     IPP_OP_SET_PRINTER_ATTRIBUTES,
     IPP_OP_CANCEL_MY_JOBS,
     IPP_OP_CLOSE_JOB,
-    IPP_OP_IDENTIFY_PRINTER
+    IPP_OP_IDENTIFY_PRINTER,
+    IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS,
+    IPP_OP_CREATE_JOB_SUBSCRIPTIONS,
+    IPP_OP_GET_SUBSCRIPTION_ATTRIBUTES,
+    IPP_OP_RENEW_SUBSCRIPTION,
+    IPP_OP_CANCEL_SUBSCRIPTION,
+    IPP_OP_GET_NOTIFICATIONS
     // IPP_OP_GET_NEXT_DOCUMENT_DATA
   };
   static const char * const charset[] =	// charset-supported values
@@ -163,6 +162,14 @@ papplPrinterCreate(
     "separate-documents-uncollated-copies",
     "separate-documents-collated-copies"
   };
+  static const char * const notify_events[] =
+  {					// notify-events-supported values
+    "job-completed",
+    "job-progress",
+    "job-state-changed",
+    "printer-config-changed",
+    "printer-state-changed"
+  };
   static const int orientation_requested[] =
   {
     IPP_ORIENT_PORTRAIT,
@@ -265,6 +272,9 @@ papplPrinterCreate(
 
   // Initialize printer structure and attributes...
   pthread_rwlock_init(&printer->rwlock, NULL);
+  pthread_mutex_init(&printer->device_mutex, NULL);
+  pthread_rwlock_init(&printer->jobs_rwlock, NULL);
+  pthread_mutex_init(&printer->driver_mutex, NULL);
 
   printer->system             = system;
   printer->name               = strdup(printer_name);
@@ -284,9 +294,11 @@ papplPrinterCreate(
   printer->state              = IPP_PSTATE_IDLE;
   printer->state_reasons      = PAPPL_PREASON_NONE;
   printer->state_time         = printer->start_time;
-  printer->all_jobs           = cupsArrayNew3((cups_array_func_t)compare_all_jobs, NULL, NULL, 0, NULL, (cups_afree_func_t)_papplJobDelete);
-  printer->active_jobs        = cupsArrayNew((cups_array_func_t)compare_active_jobs, NULL);
-  printer->completed_jobs     = cupsArrayNew((cups_array_func_t)compare_completed_jobs, NULL);
+
+  _papplJobListInit(&printer->all_jobs, true);
+  _papplJobListInit(&printer->active_jobs, false);
+  _papplJobListInit(&printer->completed_jobs, false);
+
   printer->next_job_id        = 1;
   printer->max_active_jobs    = (system->options & PAPPL_SOPTIONS_MULTI_QUEUE) ? 0 : 1;
   printer->max_completed_jobs = 100;
@@ -340,7 +352,7 @@ papplPrinterCreate(
     else
       mdl = mfg;			// No separator, so assume the make and model are the same
 
-    formats = ippFindAttribute(printer->driver_attrs, "document-format-supported", IPP_TAG_MIMETYPE);
+    formats = ippFindAttribute(_papplPrinterGetDriverAttrs(printer), "document-format-supported", IPP_TAG_MIMETYPE);
     count   = ippGetCount(formats);
     for (i = 0, ptr = cmd; i < count; i ++)
     {
@@ -461,6 +473,24 @@ papplPrinterCreate(
   // natural-language-configured
   ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_LANGUAGE), "natural-language-configured", NULL, "en");
 
+  // notify-events-default
+  ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-events-default", NULL, "job-completed");
+
+  // notify-events-supported
+  ippAddStrings(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-events-supported", (int)(sizeof(notify_events) / sizeof(notify_events[0])), NULL, notify_events);
+
+  // notify-lease-duration-default
+  ippAddInteger(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "notify-lease-duration-default", 86400);
+
+  // notify-lease-duration-supported
+  ippAddRange(printer->attrs, IPP_TAG_PRINTER, "notify-lease-duration-supported", 0, 604800);
+
+  // notify-max-events-supported
+  ippAddInteger(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "notify-max-events-supported", _PAPPL_MAX_EVENTS);
+
+  // notify-pull-method-supported
+  ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-pull-method-supported", NULL, "ippget");
+
   // operations-supported
   ippAddIntegers(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_ENUM, "operations-supported", (int)(sizeof(operations) / sizeof(operations[0])), operations);
 
@@ -549,23 +579,7 @@ papplPrinterCreate(
 
   // Add socket listeners...
   if (system->options & PAPPL_SOPTIONS_RAW_SOCKET)
-  {
-    if (_papplPrinterAddRawListeners(printer) && system->is_running)
-    {
-      pthread_t	tid;			// Thread ID
-
-      if (pthread_create(&tid, NULL, (void *(*)(void *))_papplPrinterRunRaw, printer))
-      {
-	// Unable to create client thread...
-	papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to create raw listener thread: %s", strerror(errno));
-      }
-      else
-      {
-	// Detach the main thread from the raw thread to prevent hangs...
-	pthread_detach(tid);
-      }
-    }
-  }
+    _papplPrinterAddRawListeners(printer);
 
   // Add icons...
   _papplSystemAddPrinterIcons(system, printer);
@@ -625,6 +639,9 @@ void
 _papplPrinterDelete(
     pappl_printer_t *printer)		// I - Printer
 {
+  int		i;			// Looping var
+
+
   // Remove DNS-SD registrations...
   _papplPrinterUnregisterDNSSDNoLock(printer);
 
@@ -632,10 +649,14 @@ _papplPrinterDelete(
   if (printer->psdriver.driver_data.delete_cb)
     (printer->psdriver.driver_data.delete_cb)(printer, &printer->psdriver.driver_data);
 
+  // Close raw listeners...
+  for (i = 0; i < printer->num_listeners; i ++)
+    close(printer->listeners[i].fd);
+
   // Delete jobs...
-  cupsArrayDelete(printer->active_jobs);
-  cupsArrayDelete(printer->completed_jobs);
-  cupsArrayDelete(printer->all_jobs);
+  _papplJobListClear(&printer->active_jobs);
+  _papplJobListClear(&printer->completed_jobs);
+  _papplJobListClear(&printer->all_jobs);
 
   // Free memory...
   free(printer->name);
@@ -651,8 +672,11 @@ _papplPrinterDelete(
   free(printer->usb_storage);
 
   ippDelete(printer->driver_attrs);
+  ippDelete(printer->driver_xattrs);
   ippDelete(printer->attrs);
 
+  cupsFreeOptions(printer->num_driver_vendor, printer->driver_vendor);
+
   cupsArrayDelete(printer->links);
 
   free(printer);
@@ -673,46 +697,14 @@ papplPrinterDelete(
   pappl_system_t *system = printer->system;
 					// System
 
+  // Stop accepting raw print jobs...
+  _papplPrinterCloseRaw(printer);
+
   // Remove the printer from the system object...
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   cupsArrayRemove(system->printers, printer);
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   _papplSystemConfigChanged(system);
 }
 
-
-//
-// 'compare_active_jobs()' - Compare two active jobs.
-//
-
-static int				// O - Result of comparison
-compare_active_jobs(pappl_job_t *a,	// I - First job
-                    pappl_job_t *b)	// I - Second job
-{
-  return (b->job_id - a->job_id);
-}
-
-
-//
-// 'compare_jobs()' - Compare two jobs.
-//
-
-static int				// O - Result of comparison
-compare_all_jobs(pappl_job_t *a,	// I - First job
-                 pappl_job_t *b)	// I - Second job
-{
-  return (b->job_id - a->job_id);
-}
-
-
-//
-// 'compare_completed_jobs()' - Compare two completed jobs.
-//
-
-static int				// O - Result of comparison
-compare_completed_jobs(pappl_job_t *a,	// I - First job
-                       pappl_job_t *b)	// I - Second job
-{
-  return (b->job_id - a->job_id);
-}
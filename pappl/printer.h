@@ -433,6 +433,7 @@ struct pappl_pr_driver_data_s		// Printer driver data
   int			num_vendor;		// Number of vendor attributes
   const char		*vendor[PAPPL_MAX_VENDOR];
 						// Vendor attribute names
+  bool			print_while_receiving;	// Can printfile_cb read raw data from a pipe while it is received?
 };
 
 
@@ -24,6 +24,7 @@ static void		add_resource(pappl_system_t *system, _pappl_resource_t *r);
 static int		compare_resources(_pappl_resource_t *a, _pappl_resource_t *b);
 static _pappl_resource_t *copy_resource(_pappl_resource_t *r);
 static void		free_resource(_pappl_resource_t *r);
+static unsigned		hash_path(const char *path, size_t pathlen);
 
 
 //
@@ -338,34 +339,46 @@ papplSystemAddStringsFile(
 //
 // '_papplSystemFindResource()' - Find a resource at a path.
 //
+// Resources are hashed without any trailing slash so that a path and the
+// same path with a trailing slash (a directory) are in the same bucket and
+// can be found with a single lookup.  An exact match is preferred.
+//
 
 _pappl_resource_t *			// O - Resource object
 _papplSystemFindResource(
     pappl_system_t *system,		// I - System object
     const char     *path)		// I - Resource path
 {
-  _pappl_resource_t	key,		// Search key
-			*match;		// Matching resource, if any
-  char			altpath[1024];	// Alternate path
+  size_t		pathlen;	// Length of path
+  _pappl_resource_t	*r,		// Current resource
+			*match = NULL,	// Matching resource, if any
+			*altmatch = NULL;
+					// Matching resource with trailing slash, if any
 
 
-  if (!system || !system->resources || !path)
+  if (!system || !path)
     return (NULL);
 
-  key.path = (char *)path;
+  pathlen = strlen(path);
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  pthread_rwlock_rdlock(&system->resource_rwlock);
 
-  if ((match = (_pappl_resource_t *)cupsArrayFind(system->resources, &key)) == NULL)
+  for (r = system->resource_hash[hash_path(path, pathlen)]; r; r = r->next)
   {
-    snprintf(altpath, sizeof(altpath), "%s/", path);
-    key.path = altpath;
-    match = (_pappl_resource_t *)cupsArrayFind(system->resources, &key);
+    if (r->pathlen == pathlen && !strcmp(r->path, path))
+    {
+      match = r;
+      break;
+    }
+    else if (!altmatch && r->pathlen == (pathlen + 1) && r->path[pathlen] == '/' && !strncmp(r->path, path, pathlen))
+    {
+      altmatch = r;
+    }
   }
 
-  pthread_rwlock_unlock(&system->rwlock);
+  pthread_rwlock_unlock(&system->resource_rwlock);
 
-  return (match);
+  return (match ? match : altmatch);
 }
 
 
@@ -381,7 +394,8 @@ papplSystemRemoveResource(
     const char     *path)		// I - Resource path
 {
   _pappl_resource_t	key,		// Search key
-			*match;		// Matching resource, if any
+			*match,		// Matching resource, if any
+			**rptr;		// Pointer into hash bucket
 
 
   if (!system || !system->resources || !path)
@@ -389,15 +403,25 @@ papplSystemRemoveResource(
 
   key.path = (char *)path;
 
-  pthread_rwlock_wrlock(&system->rwlock);
+  pthread_rwlock_wrlock(&system->resource_rwlock);
 
   if ((match = (_pappl_resource_t *)cupsArrayFind(system->resources, &key)) != NULL)
   {
     papplLog(system, PAPPL_LOGLEVEL_DEBUG, "Removing resource for '%s'.", path);
+
+    for (rptr = system->resource_hash + hash_path(match->path, match->pathlen); *rptr; rptr = &(*rptr)->next)
+    {
+      if (*rptr == match)
+      {
+        *rptr = match->next;
+        break;
+      }
+    }
+
     cupsArrayRemove(system->resources, match);
   }
 
-  pthread_rwlock_unlock(&system->rwlock);
+  pthread_rwlock_unlock(&system->resource_rwlock);
 }
 
 
@@ -409,7 +433,15 @@ static void
 add_resource(pappl_system_t    *system,	// I - System object
              _pappl_resource_t *r)	// I - Resource
 {
-  pthread_rwlock_wrlock(&system->rwlock);
+  _pappl_resource_t	*newr;		// New resource
+  unsigned		hash;		// Hash bucket
+
+
+  // Text resources are compressed on the fly for clients that support it,
+  // everything else (PNG, JPEG, PDF, etc.) is already compressed...
+  r->compress = !r->cb && r->length >= 1024 && !strncmp(r->format, "text/", 5);
+
+  pthread_rwlock_wrlock(&system->resource_rwlock);
 
   if (!cupsArrayFind(system->resources, r))
   {
@@ -419,9 +451,16 @@ add_resource(pappl_system_t    *system,	// I - System object
       system->resources = cupsArrayNew3((cups_array_func_t)compare_resources, NULL, NULL, 0, (cups_acopy_func_t)copy_resource, (cups_afree_func_t)free_resource);
 
     cupsArrayAdd(system->resources, r);
+
+    if ((newr = (_pappl_resource_t *)cupsArrayFind(system->resources, r)) != NULL)
+    {
+      hash                        = hash_path(newr->path, newr->pathlen);
+      newr->next                  = system->resource_hash[hash];
+      system->resource_hash[hash] = newr;
+    }
   }
 
-  pthread_rwlock_unlock(&system->rwlock);
+  pthread_rwlock_unlock(&system->resource_rwlock);
 }
 
 
@@ -450,10 +489,12 @@ copy_resource(_pappl_resource_t *r)	// I - Resource to copy
   if ((newr = (_pappl_resource_t *)calloc(1, sizeof(_pappl_resource_t))) != NULL)
   {
     newr->path          = strdup(r->path);
+    newr->pathlen       = strlen(r->path);
     newr->format        = strdup(r->format);
     newr->last_modified = r->last_modified;
     newr->data          = r->data;
     newr->length        = r->length;
+    newr->compress      = r->compress;
     newr->cb            = r->cb;
     newr->cbdata        = r->cbdata;
 
@@ -481,3 +522,31 @@ free_resource(_pappl_resource_t *r)	// I - Resource
 
   free(r);
 }
+
+
+//
+// 'hash_path()' - Compute the hash bucket for a resource path.
+//
+// Any trailing slash is ignored so that "/foo" and "/foo/" use the same
+// bucket.
+//
+
+static unsigned				// O - Hash bucket
+hash_path(const char *path,		// I - Resource path
+          size_t     pathlen)		// I - Length of path
+{
+  unsigned	hash = 2166136261U;	// FNV-1a hash
+
+
+  if (pathlen > 1 && path[pathlen - 1] == '/')
+    pathlen --;
+
+  while (pathlen > 0)
+  {
+    hash ^= (unsigned char)*path++;
+    hash *= 16777619U;
+    pathlen --;
+  }
+
+  return (hash % _PAPPL_RESOURCE_HASH);
+}
@@ -54,9 +54,9 @@ papplPrinterGetScanDriverData(
 //     return (NULL);
 //   }
 
-//   pthread_rwlock_rdlock(&printer->rwlock);
+//   _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 //   strlcpy(buffer, printer->driver_name, bufsize);
-//   pthread_rwlock_unlock(&printer->rwlock);
+//   _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
 //   return (buffer);
 // }
@@ -95,7 +95,7 @@ papplPrinterSetScanDriverData(
   if (!printer || !data)
     return;
 
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   // Copy driver data to scanner
   memcpy(&printer->psdriver.scan_driver_data, data, sizeof(printer->psdriver.scan_driver_data));
@@ -107,7 +107,7 @@ papplPrinterSetScanDriverData(
   if (attrs)
     ippCopyAttributes(printer->driver_attrs, attrs, 0, NULL, NULL);
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 }
 
 
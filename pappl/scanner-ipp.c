@@ -95,7 +95,7 @@ valid_job_attributes(
   // Check operation attributes...
   valid = _papplJobValidateDocumentAttributes(client);
 
-  pthread_rwlock_rdlock(&client->printer->rwlock);
+  _papplRWLockRead(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   // Check the various job template attributes...
   if ((attr = ippFindAttribute(client->request, "copies", IPP_TAG_ZERO)) != NULL)
@@ -395,7 +395,7 @@ valid_job_attributes(
     }
   }
 
-  pthread_rwlock_unlock(&client->printer->rwlock);
+  _papplRWUnlock(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (valid);
 }
@@ -936,7 +936,7 @@ valid_scan_job_attributes(
   // Check operation attributes...
   valid = valid_doc_attributes(client);
 
-  pthread_rwlock_rdlock(&client->printer->rwlock);
+  _papplRWLockRead(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   // Check the various job template attributes...
   if ((attr = ippFindAttribute(client->request, "copies", IPP_TAG_ZERO)) != NULL)
@@ -1085,7 +1085,7 @@ valid_scan_job_attributes(
 
   } 
 
-  pthread_rwlock_unlock(&client->printer->rwlock);
+  _papplRWUnlock(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
 
   return (valid);
 }
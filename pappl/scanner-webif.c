@@ -615,7 +615,7 @@ _papplScannerWebDefaults(
   papplClientHTMLPuts(client, "</td></tr>\n");
 
   // Vendor options
-  pthread_rwlock_rdlock(&Scanner->rwlock);
+  _papplRWLockRead(&Scanner->rwlock, _PAPPL_LOCK_PRINTER);
 
   for (i = 0; i < data.num_vendor; i ++)
   {
@@ -690,7 +690,7 @@ _papplScannerWebDefaults(
     }
   }
 
-  pthread_rwlock_unlock(&Scanner->rwlock);
+  _papplRWUnlock(&Scanner->rwlock, _PAPPL_LOCK_PRINTER);
 
   papplClientHTMLPuts(client,
                       "              <tr><th></th><td><input type=\"submit\" value=\"Save Changes\"></td></tr>\n"
@@ -886,7 +886,7 @@ _papplScannerWebHome(
 
   if (papplScannerGetNumberOfJobs(Scanner) > 0)
   {
-    if (cupsArrayCount(Scanner->active_jobs) > 0)
+    if (Scanner->active_jobs.count > 0)
       papplClientHTMLPrintf(client, " <a class=\"btn\" href=\"https://%s:%d%s/cancelall\">Cancel All Jobs</a></h1>\n", client->host_field, client->host_port, Scanner->uriname);
     else
       papplClientHTMLPuts(client, "</h1>\n");
@@ -1105,7 +1105,7 @@ _papplScannerWebJobs(
     cupsFreeOptions(num_form, form);
   }
 
-  if (cupsArrayCount(Scanner->active_jobs) > 0)
+  if (Scanner->active_jobs.count > 0)
   {
     char	url[1024];		// URL for Cancel All Jobs
 
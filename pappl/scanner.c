@@ -15,14 +15,6 @@
 #include "pappl-private.h"
 
 
-//
-// Local functions...
-//
-
-static int	compare_active_jobs(pappl_job_t *a, pappl_job_t *b);
-static int	compare_all_jobs(pappl_job_t *a, pappl_job_t *b);
-static int	compare_completed_jobs(pappl_job_t * _papplPrinterInitPrintDriverDataa, pappl_job_t *b);
-
 //
 // comman types...
 //
@@ -43,14 +35,17 @@ void
 papplPrinterCancelAllJobs(
     pappl_printer_t *printer)		// I - Printer
 {
-  pappl_job_t	*job;			// Job information
+  pappl_job_t	*job,			// Job information
+		*next;			// Next job
 
 
   // Loop through all jobs and cancel them...
-  pthread_rwlock_wrlock(&printer->rwlock);
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  for (job = (pappl_job_t *)cupsArrayFirst(printer->active_jobs); job; job = (pappl_job_t *)cupsArrayNext(printer->active_jobs))
+  for (job = printer->active_jobs.first; job; job = next)
   {
+    next = _papplJobListNext(&printer->active_jobs, job);
+
     // Cancel this job...
     if (job->state == IPP_JSTATE_PROCESSING || (job->state == IPP_JSTATE_HELD && job->fd >= 0))
     {
@@ -63,15 +58,13 @@ papplPrinterCancelAllJobs(
 
       _papplJobRemoveFile(job);
 
-      cupsArrayRemove(printer->active_jobs, job);
-      cupsArrayAdd(printer->completed_jobs, job);
+      _papplJobListAdd(&printer->completed_jobs, job);
     }
   }
 
-  pthread_rwlock_unlock(&printer->rwlock);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-  if (!printer->system->clean_time)
-    printer->system->clean_time = time(NULL) + 60;
+  _papplSystemScheduleCleanJobs(printer->system, time(NULL) + 60);
 }
 
 
@@ -269,6 +262,8 @@ papplPrinterCreate(
 
   // Initialize printer structure and attributes...
   pthread_rwlock_init(&printer->rwlock, NULL);
+  pthread_mutex_init(&printer->device_mutex, NULL);
+  pthread_rwlock_init(&printer->jobs_rwlock, NULL);
 
   printer->system             = system;
   printer->name               = strdup(printer_name);
@@ -288,9 +283,11 @@ papplPrinterCreate(
   printer->state              = IPP_PSTATE_IDLE;
   printer->state_reasons      = PAPPL_PREASON_NONE;
   printer->state_time         = printer->start_time;
-  printer->all_jobs           = cupsArrayNew3((cups_array_func_t)compare_all_jobs, NULL, NULL, 0, NULL, (cups_afree_func_t)_papplJobDelete);
-  printer->active_jobs        = cupsArrayNew((cups_array_func_t)compare_active_jobs, NULL);
-  printer->completed_jobs     = cupsArrayNew((cups_array_func_t)compare_completed_jobs, NULL);
+
+  _papplJobListInit(&printer->all_jobs, true);
+  _papplJobListInit(&printer->active_jobs, false);
+  _papplJobListInit(&printer->completed_jobs, false);
+
   printer->next_job_id        = 1;
   printer->max_active_jobs    = (system->options & PAPPL_SOPTIONS_MULTI_QUEUE) ? 0 : 1;
   printer->max_completed_jobs = 100;
@@ -482,23 +479,7 @@ papplPrinterCreate(
 
   // Add socket listeners...
   if (system->options & PAPPL_SOPTIONS_RAW_SOCKET)
-  {
-    if (_papplPrinterAddRawListeners(printer) && system->is_running)
-    {
-      pthread_t	tid;			// Thread ID
-
-      if (pthread_create(&tid, NULL, (void *(*)(void *))_papplPrinterRunRaw, printer))
-      {
-	// Unable to create client thread...
-	papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to create raw listener thread: %s", strerror(errno));
-      }
-      else
-      {
-	// Detach the main thread from the raw thread to prevent hangs...
-	pthread_detach(tid);
-      }
-    }
-  }
+    _papplPrinterAddRawListeners(printer);
 
   // Add icons...
   _papplSystemAddPrinterIcons(system, printer);
@@ -558,6 +539,9 @@ void
 _papplPrinterDelete(
     pappl_printer_t *printer)		// I - Printer
 {
+  int		i;			// Looping var
+
+
   // Remove DNS-SD registrations...
   _papplPrinterUnregisterDNSSDNoLock(printer);
 
@@ -565,10 +549,14 @@ _papplPrinterDelete(
   if (printer->driver_data.delete_cb)
     (printer->driver_data.delete_cb)(printer, &printer->driver_data);
 
+  // Close raw listeners...
+  for (i = 0; i < printer->num_listeners; i ++)
+    close(printer->listeners[i].fd);
+
   // Delete jobs...
-  cupsArrayDelete(printer->active_jobs);
-  cupsArrayDelete(printer->completed_jobs);
-  cupsArrayDelete(printer->all_jobs);
+  _papplJobListClear(&printer->active_jobs);
+  _papplJobListClear(&printer->completed_jobs);
+  _papplJobListClear(&printer->all_jobs);
 
   // Free memory...
   free(printer->name);
@@ -606,46 +594,14 @@ papplPrinterDelete(
   pappl_system_t *system = printer->system;
 					// System
 
+  // Stop accepting raw print jobs...
+  _papplPrinterCloseRaw(printer);
+
   // Remove the printer from the system object...
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   cupsArrayRemove(system->printers, printer);
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   _papplSystemConfigChanged(system);
 }
 
-
-//
-// 'compare_active_jobs()' - Compare two active jobs.
-//
-
-static int				// O - Result of comparison
-compare_active_jobs(pappl_job_t *a,	// I - First job
-                    pappl_job_t *b)	// I - Second job
-{
-  return (b->job_id - a->job_id);
-}
-
-
-//
-// 'compare_jobs()' - Compare two jobs.
-//
-
-static int				// O - Result of comparison
-compare_all_jobs(pappl_job_t *a,	// I - First job
-                 pappl_job_t *b)	// I - Second job
-{
-  return (b->job_id - a->job_id);
-}
-
-
-//
-// 'compare_completed_jobs()' - Compare two completed jobs.
-//
-
-static int				// O - Result of comparison
-compare_completed_jobs(pappl_job_t *a,	// I - First job
-                       pappl_job_t *b)	// I - Second job
-{
-  return (b->job_id - a->job_id);
-}
@@ -0,0 +1,653 @@
+//
+// Subscription IPP processing for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+//
+// Include necessary headers...
+//
+
+#include "pappl-private.h"
+
+
+//
+// Local constants...
+//
+
+#define _PAPPL_NOTIFY_INTERVAL	30	// "notify-get-interval" value
+#define _PAPPL_NOTIFY_LEASE	86400	// Default "notify-lease-duration" value
+#define _PAPPL_NOTIFY_LEASE_MAX	604800	// Maximum "notify-lease-duration" value
+
+
+//
+// Local functions...
+//
+
+static bool		authorize_subscription(pappl_client_t *client, _pappl_subscription_t *sub);
+static void		copy_notification(pappl_client_t *client, _pappl_subscription_t *sub, _pappl_notify_t *n, _pappl_event_t sub_event, int seq_num);
+static void		copy_subscription(pappl_client_t *client, _pappl_subscription_t *sub);
+static _pappl_event_t	event_value(const char *name);
+static int		get_subscription_id(pappl_client_t *client);
+static const char	*get_username(pappl_client_t *client);
+
+
+//
+// '_papplSubscriptionIPPCancel()' - Cancel a subscription.
+//
+
+void
+_papplSubscriptionIPPCancel(
+    pappl_client_t *client)		// I - Client
+{
+  int			subscription_id,// "notify-subscription-id" value
+			first = 0;	// First sequence number
+  _pappl_subscription_t	sub;		// Subscription
+
+
+  if ((subscription_id = get_subscription_id(client)) == 0)
+    return;
+
+  if (_papplSystemGetNotifications(client->system, subscription_id, &first, &sub, NULL, NULL, 0) < 0)
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Subscription #%d does not exist.", subscription_id);
+    return;
+  }
+
+  if (!authorize_subscription(client, &sub))
+    return;
+
+  if (_papplSystemCancelSubscription(client->system, subscription_id))
+    papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
+  else
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Subscription #%d does not exist.", subscription_id);
+}
+
+
+//
+// '_papplSubscriptionIPPCreate()' - Create printer or job subscriptions.
+//
+// Each subscription template group in the request creates a subscription
+// with the "ippget" pull method.  Create-Job-Subscriptions requests use the
+// target job or the "notify-job-id" attribute.  When the printer has a print
+// group, the client must be authorized for that group.
+//
+
+void
+_papplSubscriptionIPPCreate(
+    pappl_client_t *client)		// I - Client
+{
+  ipp_op_t		op = ippGetOperation(client->request);
+					// Operation
+  ipp_attribute_t	*attr;		// Current attribute
+  const char		*name;		// Attribute name
+  _pappl_subscription_t	sub;		// Subscription template
+  ipp_status_t		status;		// Status for this subscription
+  int			i,		// Looping var
+			num_subs = 0,	// Number of subscription groups
+			num_created = 0,// Number of subscriptions created
+			subscription_id = 0;
+					// New subscription ID
+  _pappl_event_t	event;		// Current event
+  const void		*data;		// "notify-user-data" value
+  int			datalen;	// Length of "notify-user-data" value
+  const char		*username;	// Subscriber user name
+
+
+  if (client->printer)
+  {
+    http_status_t	auth_status = HTTP_STATUS_CONTINUE;
+					// Authorization status
+
+    _papplRWLockRead(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
+    if (client->printer->print_group && strcmp(client->printer->print_group, "none"))
+    {
+      gid_t print_gid = client->printer->print_gid;
+					// Print group ID
+
+      _papplRWUnlock(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
+      auth_status = _papplClientIsAuthorizedForGroup(client, true, print_gid);
+    }
+    else
+      _papplRWUnlock(&client->printer->rwlock, _PAPPL_LOCK_PRINTER);
+
+    if (auth_status != HTTP_STATUS_CONTINUE)
+    {
+      papplClientRespond(client, auth_status, NULL, NULL, 0, 0);
+      return;
+    }
+  }
+
+  username = get_username(client);
+
+  papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
+
+  for (attr = ippFirstAttribute(client->request); attr;)
+  {
+    // Skip to the next subscription template group...
+    if (ippGetGroupTag(attr) != IPP_TAG_SUBSCRIPTION)
+    {
+      attr = ippNextAttribute(client->request);
+      continue;
+    }
+
+    memset(&sub, 0, sizeof(sub));
+    strlcpy(sub.username, username, sizeof(sub.username));
+
+    status = IPP_STATUS_OK;
+
+    if (op == IPP_OP_CREATE_JOB_SUBSCRIPTIONS)
+    {
+      sub.lease = 0;
+
+      if (client->job)
+        sub.job_id = client->job->job_id;
+    }
+    else
+      sub.lease = _PAPPL_NOTIFY_LEASE;
+
+    if (client->printer)
+      sub.printer_id = client->printer->printer_id;
+
+    for (; attr && ippGetGroupTag(attr) == IPP_TAG_SUBSCRIPTION; attr = ippNextAttribute(client->request))
+    {
+      if ((name = ippGetName(attr)) == NULL)
+        break;
+
+      if (!strcmp(name, "notify-events") && ippGetValueTag(attr) == IPP_TAG_KEYWORD)
+      {
+        for (i = 0; i < ippGetCount(attr); i ++)
+        {
+          if ((event = event_value(ippGetString(attr, i, NULL))) == _PAPPL_EVENT_NONE)
+            status = IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES;
+          else
+            sub.mask |= event;
+	}
+      }
+      else if (!strcmp(name, "notify-job-id") && ippGetValueTag(attr) == IPP_TAG_INTEGER && op == IPP_OP_CREATE_JOB_SUBSCRIPTIONS && !client->job)
+      {
+        if (client->printer && papplPrinterFindJob(client->printer, ippGetInteger(attr, 0)))
+          sub.job_id = ippGetInteger(attr, 0);
+	else
+	  status = IPP_STATUS_ERROR_NOT_FOUND;
+      }
+      else if (!strcmp(name, "notify-lease-duration") && ippGetValueTag(attr) == IPP_TAG_INTEGER && op == IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS)
+      {
+        if ((sub.lease = ippGetInteger(attr, 0)) < 0)
+          status = IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES;
+	else if (sub.lease == 0)
+	  sub.lease = _PAPPL_NOTIFY_LEASE;
+	else if (sub.lease > _PAPPL_NOTIFY_LEASE_MAX)
+	  sub.lease = _PAPPL_NOTIFY_LEASE_MAX;
+      }
+      else if (!strcmp(name, "notify-pull-method"))
+      {
+        if (ippGetValueTag(attr) != IPP_TAG_KEYWORD || strcmp(ippGetString(attr, 0, NULL), "ippget"))
+          status = IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES;
+      }
+      else if (!strcmp(name, "notify-recipient-uri"))
+      {
+        // Only the "ippget" pull method is supported...
+        status = IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES;
+      }
+      else if (!strcmp(name, "notify-user-data") && ippGetValueTag(attr) == IPP_TAG_STRING)
+      {
+        if ((data = ippGetOctetString(attr, 0, &datalen)) == NULL || datalen > (int)sizeof(sub.user_data))
+        {
+          status = IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES;
+	}
+	else
+	{
+	  memcpy(sub.user_data, data, (size_t)datalen);
+	  sub.user_data_len = (size_t)datalen;
+	}
+      }
+    }
+
+    if (!sub.mask)
+      sub.mask = _PAPPL_EVENT_JOB_COMPLETED;
+
+    if (status == IPP_STATUS_OK && op == IPP_OP_CREATE_JOB_SUBSCRIPTIONS && !sub.job_id)
+      status = IPP_STATUS_ERROR_BAD_REQUEST;
+
+    if (status == IPP_STATUS_OK && (subscription_id = _papplSystemAddSubscription(client->system, &sub)) == 0)
+      status = IPP_STATUS_ERROR_TOO_MANY_SUBSCRIPTIONS;
+
+    // Report the new subscription or the reason it was ignored...
+    if (num_subs ++ > 0)
+      ippAddSeparator(client->response);
+
+    if (status == IPP_STATUS_OK)
+    {
+      num_created ++;
+
+      ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-subscription-id", subscription_id);
+
+      if (op == IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS)
+        ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-duration", sub.lease);
+
+      papplLogClient(client, PAPPL_LOGLEVEL_DEBUG, "Created subscription #%d for printer %d, job %d.", subscription_id, sub.printer_id, sub.job_id);
+    }
+    else
+    {
+      ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_ENUM, "notify-status-code", (int)status);
+    }
+  }
+
+  if (num_subs == 0)
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST, "Missing subscription template group.");
+  else if (num_created == 0)
+    ippSetStatusCode(client->response, IPP_STATUS_ERROR_IGNORED_ALL_SUBSCRIPTIONS);
+  else if (num_created < num_subs)
+    ippSetStatusCode(client->response, IPP_STATUS_OK_IGNORED_SUBSCRIPTIONS);
+}
+
+
+//
+// '_papplSubscriptionIPPGetAttributes()' - Get the attributes of a subscription.
+//
+
+void
+_papplSubscriptionIPPGetAttributes(
+    pappl_client_t *client)		// I - Client
+{
+  int			subscription_id,// "notify-subscription-id" value
+			first = 0;	// First sequence number
+  _pappl_subscription_t	sub;		// Subscription
+
+
+  if ((subscription_id = get_subscription_id(client)) == 0)
+    return;
+
+  if (_papplSystemGetNotifications(client->system, subscription_id, &first, &sub, NULL, NULL, 0) < 0)
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Subscription #%d does not exist.", subscription_id);
+    return;
+  }
+
+  if (!authorize_subscription(client, &sub))
+    return;
+
+  papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
+  copy_subscription(client, &sub);
+}
+
+
+//
+// '_papplSubscriptionIPPGetNotifications()' - Get event notifications.
+//
+// When "notify-wait" is true and there are no new events, the request waits
+// up to "notify-get-interval" seconds for one, so clients can long-poll
+// instead of repeating Get-Job-Attributes and Get-Printer-Attributes
+// requests.
+//
+
+void
+_papplSubscriptionIPPGetNotifications(
+    pappl_client_t *client)		// I - Client
+{
+  pappl_system_t	*system = client->system;
+					// System
+  ipp_attribute_t	*ids,		// "notify-subscription-ids"
+			*seqs;		// "notify-sequence-numbers"
+  bool			notify_wait;	// "notify-wait" value
+  int			i, j,		// Looping vars
+			num_ids,	// Number of subscriptions
+			count,		// Number of events
+			first;		// First sequence number
+  size_t		seq;		// Last system event sequence number
+  time_t		deadline;	// Time to stop waiting
+  bool			have_events;	// Have events to return?
+  _pappl_subscription_t	sub;		// Subscription
+  _pappl_notify_t	events[_PAPPL_MAX_EVENTS];
+					// Events
+  _pappl_event_t	sub_events[_PAPPL_MAX_EVENTS];
+					// Subscribed events
+
+
+  if ((ids = ippFindAttribute(client->request, "notify-subscription-ids", IPP_TAG_ZERO)) == NULL || ippGetGroupTag(ids) != IPP_TAG_OPERATION || ippGetValueTag(ids) != IPP_TAG_INTEGER)
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST, "Missing or bad notify-subscription-ids attribute.");
+    return;
+  }
+
+  if ((seqs = ippFindAttribute(client->request, "notify-sequence-numbers", IPP_TAG_ZERO)) != NULL && (ippGetGroupTag(seqs) != IPP_TAG_OPERATION || ippGetValueTag(seqs) != IPP_TAG_INTEGER))
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST, "Bad notify-sequence-numbers attribute.");
+    return;
+  }
+
+  notify_wait = ippGetBoolean(ippFindAttribute(client->request, "notify-wait", IPP_TAG_BOOLEAN), 0);
+  num_ids     = ippGetCount(ids);
+  deadline    = time(NULL) + _PAPPL_NOTIFY_INTERVAL;
+
+  // See if there are any events, waiting as needed...
+  for (;;)
+  {
+    pthread_mutex_lock(&system->event_mutex);
+    seq = system->event_seq;
+    pthread_mutex_unlock(&system->event_mutex);
+
+    for (i = 0, have_events = false; i < num_ids; i ++)
+    {
+      first = i < ippGetCount(seqs) ? ippGetInteger(seqs, i) : 0;
+
+      if (_papplSystemGetNotifications(system, ippGetInteger(ids, i), &first, &sub, NULL, NULL, 0) < 0)
+      {
+	papplClientRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Subscription #%d does not exist.", ippGetInteger(ids, i));
+	return;
+      }
+
+      if (!authorize_subscription(client, &sub))
+        return;
+
+      if (sub.num_events >= first)
+        have_events = true;
+    }
+
+    if (have_events || !notify_wait || !system->is_running || time(NULL) >= deadline)
+      break;
+
+    _papplSystemWaitEvents(system, seq, (int)(deadline - time(NULL)) * 1000);
+  }
+
+  // Send the events...
+  papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
+
+  ippAddInteger(client->response, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-get-interval", _PAPPL_NOTIFY_INTERVAL);
+  ippAddInteger(client->response, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "printer-up-time", (int)(time(NULL) - system->start_time));
+
+  for (i = 0; i < num_ids; i ++)
+  {
+    first = i < ippGetCount(seqs) ? ippGetInteger(seqs, i) : 0;
+
+    if ((count = _papplSystemGetNotifications(system, ippGetInteger(ids, i), &first, &sub, events, sub_events, _PAPPL_MAX_EVENTS)) <= 0)
+      continue;
+
+    for (j = 0; j < count; j ++)
+      copy_notification(client, &sub, events + j, sub_events[j], first + j);
+  }
+}
+
+
+//
+// '_papplSubscriptionIPPRenew()' - Renew a subscription.
+//
+
+void
+_papplSubscriptionIPPRenew(
+    pappl_client_t *client)		// I - Client
+{
+  int			subscription_id,// "notify-subscription-id" value
+			first = 0,	// First sequence number
+			lease;		// "notify-lease-duration" value
+  ipp_attribute_t	*attr;		// "notify-lease-duration" attribute
+  _pappl_subscription_t	sub;		// Subscription
+
+
+  if ((subscription_id = get_subscription_id(client)) == 0)
+    return;
+
+  if (_papplSystemGetNotifications(client->system, subscription_id, &first, &sub, NULL, NULL, 0) < 0)
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Subscription #%d does not exist.", subscription_id);
+    return;
+  }
+
+  if (!authorize_subscription(client, &sub))
+    return;
+
+  if (sub.job_id)
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_NOT_POSSIBLE, "Job subscriptions cannot be renewed.");
+    return;
+  }
+
+  if ((attr = ippFindAttribute(client->request, "notify-lease-duration", IPP_TAG_ZERO)) == NULL)
+  {
+    lease = _PAPPL_NOTIFY_LEASE;
+  }
+  else if (ippGetGroupTag(attr) != IPP_TAG_SUBSCRIPTION || ippGetValueTag(attr) != IPP_TAG_INTEGER || ippGetInteger(attr, 0) < 0)
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST, "Bad notify-lease-duration attribute.");
+    return;
+  }
+  else if ((lease = ippGetInteger(attr, 0)) == 0)
+  {
+    lease = _PAPPL_NOTIFY_LEASE;
+  }
+  else if (lease > _PAPPL_NOTIFY_LEASE_MAX)
+  {
+    lease = _PAPPL_NOTIFY_LEASE_MAX;
+  }
+
+  if (!_papplSystemRenewSubscription(client->system, subscription_id, lease))
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Subscription #%d does not exist.", subscription_id);
+    return;
+  }
+
+  papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
+  ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-duration", lease);
+}
+
+
+//
+// 'authorize_subscription()' - Verify the client can access a subscription.
+//
+// Only the subscriber or an authenticated administrator can use a
+// subscription.  Clients that have not authenticated, including local ones,
+// are identified by their "requesting-user-name" value.
+//
+
+static bool				// O - `true` if authorized, `false` otherwise
+authorize_subscription(
+    pappl_client_t        *client,	// I - Client
+    _pappl_subscription_t *sub)		// I - Subscription
+{
+  if (!strcmp(sub->username, get_username(client)))
+    return (true);
+
+  if (papplClientIsAuthorized(client) == HTTP_STATUS_CONTINUE && client->username[0])
+    return (true);
+
+  papplClientRespondIPP(client, IPP_STATUS_ERROR_NOT_AUTHORIZED, "Not authorized to access subscription #%d.", sub->subscription_id);
+
+  return (false);
+}
+
+
+//
+// 'copy_notification()' - Copy an event notification to the response.
+//
+
+static void
+copy_notification(
+    pappl_client_t        *client,	// I - Client
+    _pappl_subscription_t *sub,		// I - Subscription
+    _pappl_notify_t       *n,		// I - Event
+    _pappl_event_t        sub_event,	// I - Subscribed event
+    int                   seq_num)	// I - "notify-sequence-number" value
+{
+  pappl_printer_t	*printer;	// Printer
+  char			uri[1024],	// "notify-printer-uri" value
+			text[256];	// "notify-text" value
+
+
+  ippAddSeparator(client->response);
+
+  ippAddString(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_CONST_TAG(IPP_TAG_CHARSET), "notify-charset", NULL, "utf-8");
+  ippAddString(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_CONST_TAG(IPP_TAG_LANGUAGE), "notify-natural-language", NULL, "en");
+  ippAddInteger(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "notify-subscription-id", sub->subscription_id);
+  ippAddInteger(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "notify-sequence-number", seq_num);
+  ippAddString(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-subscribed-event", NULL, _papplEventString(sub_event));
+
+  if (n->job_id)
+    snprintf(text, sizeof(text), "Job #%d %s.", n->job_id, _papplEventString(n->event));
+  else
+    snprintf(text, sizeof(text), "Printer %s.", _papplEventString(n->event));
+
+  ippAddString(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_TEXT, "notify-text", NULL, text);
+
+  if (sub->user_data_len > 0)
+    ippAddOctetString(client->response, IPP_TAG_EVENT_NOTIFICATION, "notify-user-data", sub->user_data, (int)sub->user_data_len);
+
+  ippAddInteger(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "printer-up-time", (int)(n->time - client->system->start_time));
+
+  if (n->printer_id && (printer = papplSystemFindPrinter(client->system, NULL, n->printer_id, NULL)) != NULL)
+  {
+    httpAssembleURI(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipps", NULL, client->host_field, client->host_port, printer->resource);
+    ippAddString(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_URI, "notify-printer-uri", NULL, uri);
+  }
+
+  if (n->printer_id)
+  {
+    ipp_attribute_t	*attr = NULL;	// "printer-state-reasons" attribute
+    pappl_preason_t	bit;		// Reason bit
+
+    ippAddBoolean(client->response, IPP_TAG_EVENT_NOTIFICATION, "printer-is-accepting-jobs", 1);
+    ippAddInteger(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "printer-state", (int)n->printer_state);
+
+    for (bit = PAPPL_PREASON_OTHER; bit <= PAPPL_PREASON_TONER_LOW; bit *= 2)
+    {
+      if (n->printer_reasons & bit)
+      {
+	if (attr)
+	  ippSetString(client->response, &attr, ippGetCount(attr), _papplPrinterReasonString(bit));
+	else
+	  attr = ippAddString(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "printer-state-reasons", NULL, _papplPrinterReasonString(bit));
+      }
+    }
+
+    if (!attr)
+      ippAddString(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "printer-state-reasons", NULL, n->printer_state == IPP_PSTATE_STOPPED ? "paused" : "none");
+  }
+
+  if (n->job_id)
+  {
+    int			num_values = 0;	// Number of "job-state-reasons" values
+    const char		*svalues[32];	// "job-state-reasons" values
+    pappl_jreason_t	bit;		// Reason bit
+
+    ippAddInteger(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "notify-job-id", n->job_id);
+    ippAddInteger(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "job-impressions-completed", n->job_impressions);
+    ippAddInteger(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "job-state", (int)n->job_state);
+
+    for (bit = PAPPL_JREASON_ABORTED_BY_SYSTEM; bit <= PAPPL_JREASON_WARNINGS_DETECTED; bit *= 2)
+    {
+      if (n->job_reasons & bit)
+	svalues[num_values ++] = _papplJobReasonString(bit);
+    }
+
+    if (num_values > 0)
+      ippAddStrings(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "job-state-reasons", num_values, NULL, svalues);
+    else
+      ippAddString(client->response, IPP_TAG_EVENT_NOTIFICATION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "job-state-reasons", NULL, "none");
+  }
+}
+
+
+//
+// 'copy_subscription()' - Copy the subscription attributes to the response.
+//
+
+static void
+copy_subscription(
+    pappl_client_t        *client,	// I - Client
+    _pappl_subscription_t *sub)		// I - Subscription
+{
+  int		num_events = 0;		// Number of events
+  const char	*events[5];		// "notify-events" values
+  _pappl_event_t event;			// Current event
+
+
+  for (event = _PAPPL_EVENT_JOB_PROGRESS; event <= _PAPPL_EVENT_JOB_COMPLETED; event *= 2)
+  {
+    if (sub->mask & event)
+      events[num_events ++] = _papplEventString(event);
+  }
+
+  ippAddStrings(client->response, IPP_TAG_SUBSCRIPTION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-events", num_events, NULL, events);
+
+  if (sub->job_id)
+    ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-job-id", sub->job_id);
+  else
+    ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-duration", sub->lease);
+
+  if (sub->expire)
+    ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-expiration-time", (int)(sub->expire - client->system->start_time));
+
+  if (sub->printer_id)
+    ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-printer-id", sub->printer_id);
+
+  ippAddString(client->response, IPP_TAG_SUBSCRIPTION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-pull-method", NULL, "ippget");
+  ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-sequence-number", sub->num_events);
+  ippAddString(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_NAME, "notify-subscriber-user-name", NULL, sub->username);
+  ippAddInteger(client->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-subscription-id", sub->subscription_id);
+
+  if (sub->user_data_len > 0)
+    ippAddOctetString(client->response, IPP_TAG_SUBSCRIPTION, "notify-user-data", sub->user_data, (int)sub->user_data_len);
+}
+
+
+//
+// 'event_value()' - Get the event bit for a "notify-events" keyword.
+//
+
+static _pappl_event_t			// O - Event or `_PAPPL_EVENT_NONE` if not supported
+event_value(const char *name)		// I - Keyword
+{
+  _pappl_event_t	event;		// Current event
+
+
+  for (event = _PAPPL_EVENT_JOB_PROGRESS; event <= _PAPPL_EVENT_JOB_COMPLETED; event *= 2)
+  {
+    if (!strcmp(name, _papplEventString(event)))
+      return (event);
+  }
+
+  return (_PAPPL_EVENT_NONE);
+}
+
+
+//
+// 'get_subscription_id()' - Get the "notify-subscription-id" operation attribute.
+//
+
+static int				// O - Subscription ID or `0` on error
+get_subscription_id(
+    pappl_client_t *client)		// I - Client
+{
+  ipp_attribute_t	*attr;		// "notify-subscription-id" attribute
+
+
+  if ((attr = ippFindAttribute(client->request, "notify-subscription-id", IPP_TAG_ZERO)) == NULL || ippGetGroupTag(attr) != IPP_TAG_OPERATION || ippGetValueTag(attr) != IPP_TAG_INTEGER || ippGetCount(attr) != 1 || ippGetInteger(attr, 0) < 1)
+  {
+    papplClientRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST, "Missing or bad notify-subscription-id attribute.");
+    return (0);
+  }
+
+  return (ippGetInteger(attr, 0));
+}
+
+
+//
+// 'get_username()' - Get the user name for the client.
+//
+
+static const char *			// O - User name
+get_username(pappl_client_t *client)	// I - Client
+{
+  ipp_attribute_t	*attr;		// "requesting-user-name" attribute
+
+
+  if (client->username[0])
+    return (client->username);
+  else if ((attr = ippFindAttribute(client->request, "requesting-user-name", IPP_TAG_NAME)) != NULL)
+    return (ippGetString(attr, 0, NULL));
+  else
+    return ("anonymous");
+}
@@ -338,14 +338,14 @@ _papplSystemFindMIMEFilter(
   if (!system || !srctype || !dsttype)
     return (NULL);
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   key.src = srctype;
   key.dst = dsttype;
 
   match = (_pappl_mime_filter_t *)cupsArrayFind(system->filters, &key);
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   return (match);
 }
@@ -369,7 +369,7 @@ papplSystemGetAdminGroup(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->admin_group)
     {
@@ -379,7 +379,7 @@ papplSystemGetAdminGroup(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -423,11 +423,11 @@ papplSystemGetContact(
     return (contact);
   }
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   *contact = system->contact;
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   return (contact);
 }
@@ -466,7 +466,7 @@ papplSystemGetDefaultPrintGroup(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->default_print_group)
     {
@@ -476,7 +476,7 @@ papplSystemGetDefaultPrintGroup(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -503,7 +503,7 @@ papplSystemGetDNSSDName(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->dns_sd_name)
     {
@@ -513,7 +513,7 @@ papplSystemGetDNSSDName(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -555,7 +555,7 @@ papplSystemGetGeoLocation(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->geo_location)
     {
@@ -565,7 +565,7 @@ papplSystemGetGeoLocation(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -591,7 +591,7 @@ papplSystemGetHostname(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->hostname)
     {
@@ -601,7 +601,7 @@ papplSystemGetHostname(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -610,6 +610,21 @@ papplSystemGetHostname(
 }
 
 
+//
+// 'papplSystemGetIdleTimeout()' - Get the keep-alive idle timeout.
+//
+// This function returns the number of seconds an idle client connection is
+// kept open waiting for another request.
+//
+
+int					// O - Idle timeout in seconds
+papplSystemGetIdleTimeout(
+    pappl_system_t *system)		// I - System
+{
+  return (system ? system->idle_timeout : 0);
+}
+
+
 //
 // 'papplSystemGetLocation()' - Get the system location string, if any.
 //
@@ -628,7 +643,7 @@ papplSystemGetLocation(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->location)
     {
@@ -638,7 +653,7 @@ papplSystemGetLocation(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -647,6 +662,33 @@ papplSystemGetLocation(
 }
 
 
+//
+// 'papplSystemGetLogCategoryLevel()' - Get the log level for a category.
+//
+// This function returns the log level for the specified category of messages
+// or `PAPPL_LOGLEVEL_UNSPEC` if the category uses the system log level.
+//
+
+pappl_loglevel_t			// O - Log level or `PAPPL_LOGLEVEL_UNSPEC` for the system log level
+papplSystemGetLogCategoryLevel(
+    pappl_system_t *system,		// I - System
+    pappl_logcat_t category)		// I - Log category
+{
+  pappl_loglevel_t	ret = PAPPL_LOGLEVEL_UNSPEC;
+					// Return value
+
+
+  if (system && category >= PAPPL_LOGCAT_SYSTEM && category <= PAPPL_LOGCAT_PRINTER)
+  {
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+    ret = system->logcatlevels[category];
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+  }
+
+  return (ret);
+}
+
+
 //
 // 'papplSystemGetLogLevel()' - Get the system log level.
 //
@@ -679,6 +721,41 @@ papplSystemGetMaxLogSize(
 }
 
 
+//
+// 'papplSystemGetMemorySpool()' - Get the in-memory spool limits.
+//
+// This function returns the maximum size of a document that is spooled in
+// memory and, optionally, the maximum total size of in-memory documents.
+// Larger documents are written to the spool directory.
+//
+// In-memory spooling is disabled by default.
+//
+
+size_t					// O - Maximum document size or `0` if disabled
+papplSystemGetMemorySpool(
+    pappl_system_t *system,		// I - System
+    size_t         *max_total)		// O - Maximum total size or `NULL`
+{
+  size_t	max_document = 0;	// Maximum document size
+
+
+  if (system)
+  {
+    pthread_mutex_lock(&system->spool_mutex);
+    max_document = system->spool_max_document;
+    if (max_total)
+      *max_total = system->spool_max_total;
+    pthread_mutex_unlock(&system->spool_mutex);
+  }
+  else if (max_total)
+  {
+    *max_total = 0;
+  }
+
+  return (max_document);
+}
+
+
 //
 // 'papplSystemGetName()' - Get the system name.
 //
@@ -696,7 +773,7 @@ papplSystemGetName(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->name)
     {
@@ -706,7 +783,7 @@ papplSystemGetName(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -762,7 +839,7 @@ papplSystemGetOrganization(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->organization)
     {
@@ -772,7 +849,7 @@ papplSystemGetOrganization(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -799,7 +876,7 @@ papplSystemGetOrganizationalUnit(
 
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (system->org_unit)
     {
@@ -809,7 +886,7 @@ papplSystemGetOrganizationalUnit(
     else
       *buffer = '\0';
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -836,11 +913,11 @@ papplSystemGetPassword(
 {
   if (system && buffer && bufsize > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     strlcpy(buffer, system->password_hash, bufsize);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
   else if (buffer)
     *buffer = '\0';
@@ -865,6 +942,70 @@ papplSystemGetPort(
 }
 
 
+//
+// 'papplSystemGetSaveDelay()' - Get the delay before saving the system state.
+//
+// This function returns the number of milliseconds the save thread waits for
+// additional changes before calling the save callback.
+//
+
+int					// O - Delay in milliseconds
+papplSystemGetSaveDelay(
+    pappl_system_t *system)		// I - System
+{
+  int	msecs = 0;			// Delay in milliseconds
+
+
+  if (system)
+  {
+    pthread_mutex_lock(&system->save_mutex);
+    msecs = system->save_delay;
+    pthread_mutex_unlock(&system->save_mutex);
+  }
+
+  return (msecs);
+}
+
+
+//
+// 'papplSystemGetSaveStats()' - Get save callback statistics.
+//
+// This function returns the number of times the save callback has been called
+// along with the average and maximum time it took, in seconds.
+//
+
+size_t					// O - Number of saves
+papplSystemGetSaveStats(
+    pappl_system_t *system,		// I - System
+    double         *avg_secs,		// O - Average save time in seconds or `NULL`
+    double         *max_secs)		// O - Maximum save time in seconds or `NULL`
+{
+  size_t	count = 0;		// Number of saves
+
+
+  if (avg_secs)
+    *avg_secs = 0.0;
+  if (max_secs)
+    *max_secs = 0.0;
+
+  if (system)
+  {
+    pthread_mutex_lock(&system->save_mutex);
+
+    count = system->save_count;
+
+    if (avg_secs && count > 0)
+      *avg_secs = system->save_total / count;
+    if (max_secs)
+      *max_secs = system->save_max;
+
+    pthread_mutex_unlock(&system->save_mutex);
+  }
+
+  return (count);
+}
+
+
 //
 // 'papplSystemGetServerHeader()' - Get the Server: header for HTTP responses.
 //
@@ -939,6 +1080,51 @@ papplSystemGetTLSOnly(
 }
 
 
+//
+// 'papplSystemGetTLSStats()' - Get TLS handshake statistics.
+//
+// This function returns the number of successful TLS handshakes along with
+// the number of failed handshakes and the average and maximum time taken by
+// a successful handshake, in seconds.
+//
+
+size_t					// O - Number of TLS handshakes
+papplSystemGetTLSStats(
+    pappl_system_t *system,		// I - System
+    size_t         *failures,		// O - Number of failed handshakes or `NULL`
+    double         *avg_secs,		// O - Average handshake time in seconds or `NULL`
+    double         *max_secs)		// O - Maximum handshake time in seconds or `NULL`
+{
+  size_t	count = 0;		// Number of handshakes
+
+
+  if (failures)
+    *failures = 0;
+  if (avg_secs)
+    *avg_secs = 0.0;
+  if (max_secs)
+    *max_secs = 0.0;
+
+  if (system)
+  {
+    pthread_mutex_lock(&system->tls_mutex);
+
+    count = system->tls_count;
+
+    if (failures)
+      *failures = system->tls_failures;
+    if (avg_secs && count > 0)
+      *avg_secs = system->tls_total / count;
+    if (max_secs)
+      *max_secs = system->tls_max;
+
+    pthread_mutex_unlock(&system->tls_mutex);
+  }
+
+  return (count);
+}
+
+
 //
 // 'papplSystemGetUUID()' - Get the "system-uuid" value.
 //
@@ -973,14 +1159,14 @@ papplSystemGetVersions(
 
   if (system && versions && system->num_versions > 0)
   {
-    pthread_rwlock_rdlock(&system->rwlock);
+    _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (max_versions > system->num_versions)
       memcpy(versions, system->versions, (size_t)system->num_versions * sizeof(pappl_version_t));
     else
       memcpy(versions, system->versions, (size_t)max_versions * sizeof(pappl_version_t));
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 
   return (system ? system->num_versions : 0);
@@ -1088,10 +1274,10 @@ papplSystemIteratePrinters(
   if (!system || !cb)
     return;
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   for (printer = (pappl_printer_t *)cupsArrayFirst(system->printers); printer; printer = (pappl_printer_t *)cupsArrayNext(system->printers))
     (cb)(printer, data);
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 }
 
 
@@ -1193,7 +1379,7 @@ papplSystemSetAdminGroup(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->admin_group);
     system->admin_group = value ? strdup(value) : NULL;
@@ -1212,10 +1398,12 @@ papplSystemSetAdminGroup(
     else
       system->admin_gid = (gid_t)-1;
 
+    _papplSystemClearAuthCache(system);
+
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1234,14 +1422,14 @@ papplSystemSetContact(
   if (!system || !contact)
     return;
 
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   system->contact = *contact;
 
   system->config_time = time(NULL);
-  system->config_changes ++;
+  _papplSystemConfigChangedNoLock(system);
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 }
 
 
@@ -1259,14 +1447,14 @@ papplSystemSetDefaultPrinterID(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     system->default_printer_id = default_printer_id;
 
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1287,15 +1475,17 @@ papplSystemSetDefaultPrintGroup(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->default_print_group);
     system->default_print_group = value ? strdup(value) : NULL;
 
+    _papplSystemClearAuthCache(system);
+
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1314,21 +1504,21 @@ papplSystemSetDNSSDName(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->dns_sd_name);
     system->dns_sd_name      = value ? strdup(value) : NULL;
     system->dns_sd_collision = false;
     system->dns_sd_serial    = 0;
     system->config_time      = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
     if (!value)
       _papplSystemUnregisterDNSSDNoLock(system);
     else
       _papplSystemRegisterDNSSDNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1349,12 +1539,12 @@ papplSystemSetFooterHTML(
 {
   if (system && html && !system->is_running)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->footer_html);
     system->footer_html = strdup(html);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1373,16 +1563,16 @@ papplSystemSetGeoLocation(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->geo_location);
     system->geo_location = value ? strdup(value) : NULL;
     system->config_time  = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
     _papplSystemRegisterDNSSDNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1401,7 +1591,7 @@ papplSystemSetHostname(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->hostname);
 
@@ -1463,7 +1653,30 @@ papplSystemSetHostname(
     // Force an update of all DNS-SD registrations...
     system->dns_sd_host_changes = -1;
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+  }
+}
+
+
+//
+// 'papplSystemSetIdleTimeout()' - Set the keep-alive idle timeout.
+//
+// This function sets the number of seconds an idle client connection is kept
+// open waiting for another request.  Clients that reuse a connection avoid
+// the cost of a new TLS handshake, so longer timeouts help clients that poll
+// the system.  The default is 30 seconds.
+//
+
+void
+papplSystemSetIdleTimeout(
+    pappl_system_t *system,		// I - System
+    int            secs)		// I - Idle timeout in seconds
+{
+  if (system && secs > 0)
+  {
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+    system->idle_timeout = secs;
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1482,19 +1695,46 @@ papplSystemSetLocation(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->location);
     system->location    = value ? strdup(value) : NULL;
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
     _papplSystemRegisterDNSSDNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+  }
+}
+
+//
+// 'papplSystemSetLogCategoryLevel()' - Set the log level for a category.
+//
+// This function sets the log level for the specified category of messages,
+// for example to log debugging messages for jobs without logging debugging
+// messages for every client connection.  Specify `PAPPL_LOGLEVEL_UNSPEC` to
+// use the system log level for the category.
+//
+
+void
+papplSystemSetLogCategoryLevel(
+    pappl_system_t   *system,		// I - System
+    pappl_logcat_t   category,		// I - Log category
+    pappl_loglevel_t loglevel)		// I - Log level or `PAPPL_LOGLEVEL_UNSPEC` for the system log level
+{
+  if (system && category >= PAPPL_LOGCAT_SYSTEM && category <= PAPPL_LOGCAT_PRINTER && loglevel >= PAPPL_LOGLEVEL_UNSPEC && loglevel <= PAPPL_LOGLEVEL_FATAL)
+  {
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+
+    system->logcatlevels[category] = loglevel;
+    _papplLogUpdateMask(system);
+
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
+
 //
 // 'papplSystemSetLogLevel()' - Set the system log level
 //
@@ -1508,14 +1748,15 @@ papplSystemSetLogLevel(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     system->loglevel = loglevel;
+    _papplLogUpdateMask(system);
 
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1537,14 +1778,44 @@ papplSystemSetMaxLogSize(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     system->logmaxsize = maxsize;
 
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+  }
+}
+
+
+//
+// 'papplSystemSetMemorySpool()' - Set the in-memory spool limits.
+//
+// This function sets the maximum size of a document that is spooled in memory
+// instead of the spool directory, and the maximum total size of in-memory
+// documents.  Small documents such as receipts and labels then never touch
+// the file system.  Documents that grow beyond either limit are moved to the
+// spool directory.  In-memory spooling is disabled by default, and setting
+// "max_document" to `0` disables it again.
+//
+// > Note: In-memory spooling is currently only supported on Linux.  Jobs
+// > spooled in memory are not preserved when the system is restarted.
+//
+
+void
+papplSystemSetMemorySpool(
+    pappl_system_t *system,		// I - System
+    size_t         max_document,	// I - Maximum document size in bytes or `0` to disable
+    size_t         max_total)		// I - Maximum total size in bytes
+{
+  if (system)
+  {
+    pthread_mutex_lock(&system->spool_mutex);
+    system->spool_max_document = max_document;
+    system->spool_max_total    = max_total;
+    pthread_mutex_unlock(&system->spool_mutex);
   }
 }
 
@@ -1571,13 +1842,13 @@ papplSystemSetMIMECallback(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     system->config_time = time(NULL);
     system->mime_cb     = cb;
     system->mime_cbdata = data;
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1600,14 +1871,14 @@ papplSystemSetNextPrinterID(
 {
   if (system && !system->is_running)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     system->next_printer_id = next_printer_id;
 
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1631,10 +1902,10 @@ papplSystemSetOperationCallback(
 {
   if (system && !system->is_running)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
     system->op_cb     = cb;
     system->op_cbdata = data;
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1653,15 +1924,15 @@ papplSystemSetOrganization(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->organization);
     system->organization = value ? strdup(value) : NULL;
 
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1681,15 +1952,15 @@ papplSystemSetOrganizationalUnit(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->org_unit);
     system->org_unit = value ? strdup(value) : NULL;
 
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1711,14 +1982,14 @@ papplSystemSetPassword(
 {
   if (system && hash)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     strlcpy(system->password_hash, hash, sizeof(system->password_hash));
 
     system->config_time = time(NULL);
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1757,7 +2028,7 @@ papplSystemSetPrinterDrivers(
 {
   if (system)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     system->config_time   = time(NULL);
     system->num_drivers   = num_drivers;
@@ -1767,7 +2038,7 @@ papplSystemSetPrinterDrivers(
     system->driver_cb     = driver_cb;
     system->driver_cbdata = data;
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1797,10 +2068,32 @@ papplSystemSetSaveCallback(
 {
   if (system && !system->is_running)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
     system->save_cb     = cb;
     system->save_cbdata = data;
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+  }
+}
+
+
+//
+// 'papplSystemSetSaveDelay()' - Set the delay before saving the system state.
+//
+// This function sets the number of milliseconds the save thread waits for
+// additional changes before calling the save callback, so that a burst of
+// changes results in a single save.  The default is 1000 milliseconds.
+//
+
+void
+papplSystemSetSaveDelay(
+    pappl_system_t *system,		// I - System
+    int            msecs)		// I - Delay in milliseconds
+{
+  if (system && msecs >= 0)
+  {
+    pthread_mutex_lock(&system->save_mutex);
+    system->save_delay = msecs;
+    pthread_mutex_unlock(&system->save_mutex);
   }
 }
 
@@ -1822,7 +2115,7 @@ papplSystemSetUUID(
 {
   if (system && !system->is_running)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     free(system->uuid);
 
@@ -1840,7 +2133,7 @@ papplSystemSetUUID(
 
     _papplSystemRegisterDNSSDNoLock(system);
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -1863,7 +2156,7 @@ papplSystemSetVersions(
 {
   if (system && num_versions && versions && !system->is_running)
   {
-    pthread_rwlock_wrlock(&system->rwlock);
+    _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
     if (num_versions > (int)(sizeof(system->versions) / sizeof(system->versions[0])))
       system->num_versions = (int)(sizeof(system->versions) / sizeof(system->versions[0]));
@@ -1872,7 +2165,7 @@ papplSystemSetVersions(
 
     memcpy(system->versions, versions, (size_t)system->num_versions * sizeof(pappl_version_t));
 
-    pthread_rwlock_unlock(&system->rwlock);
+    _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
   }
 }
 
@@ -0,0 +1,467 @@
+//
+// System event functions for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+//
+// Include necessary headers...
+//
+
+#include "pappl-private.h"
+
+
+//
+// Local functions...
+//
+
+static _pappl_subscription_t *find_subscription(pappl_system_t *system, int subscription_id);
+static _pappl_event_t	match_subscription(_pappl_subscription_t *sub, _pappl_notify_t *n);
+static bool		wait_events(pappl_system_t *system, size_t seq, int msecs);
+
+
+//
+// '_papplSystemAddEvent()' - Add a printer or job event.
+//
+// Events are recorded in a fixed-size ring along with a snapshot of the
+// printer and job state, the sequence numbers of any matching subscriptions
+// are updated, and any threads waiting for events are woken up.  The caller
+// must not hold the printer or job lock.
+//
+
+void
+_papplSystemAddEvent(
+    pappl_system_t  *system,		// I - System
+    pappl_printer_t *printer,		// I - Printer, if any
+    pappl_job_t     *job,		// I - Job, if any
+    _pappl_event_t  event)		// I - Event
+{
+  _pappl_notify_t	n;		// New event
+  _pappl_subscription_t	*sub;		// Current subscription
+  _pappl_event_t	sub_event;	// Subscribed event
+
+
+  if (!system || !system->is_running)
+    return;
+
+  memset(&n, 0, sizeof(n));
+
+  n.time  = time(NULL);
+  n.event = event;
+
+  if (!printer && job)
+    printer = job->printer;
+
+  if (printer)
+  {
+    // Printer state values are atomic...
+    n.printer_id      = printer->printer_id;
+    n.printer_state   = printer->state;
+    n.printer_reasons = printer->state_reasons;
+  }
+
+  if (job)
+  {
+    _papplRWLockRead(&job->rwlock, _PAPPL_LOCK_JOB);
+    n.job_id          = job->job_id;
+    n.job_state       = job->state;
+    n.job_reasons     = job->state_reasons;
+    n.job_impressions = job->impcompleted;
+    _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+  }
+
+  pthread_mutex_lock(&system->event_mutex);
+
+  n.seq = ++ system->event_seq;
+  system->events[n.seq % _PAPPL_MAX_EVENTS] = n;
+
+  for (sub = (_pappl_subscription_t *)cupsArrayFirst(system->subscriptions); sub; sub = (_pappl_subscription_t *)cupsArrayNext(system->subscriptions))
+  {
+    if (sub->expire && sub->expire <= n.time)
+    {
+      // Lease expired, remove the subscription...
+      cupsArrayRemove(system->subscriptions, sub);
+      continue;
+    }
+
+    if ((sub_event = match_subscription(sub, &n)) == _PAPPL_EVENT_NONE)
+      continue;
+
+    sub->last_seq = n.seq;
+    sub->num_events ++;
+
+    // Job subscriptions end shortly after the job does, leaving time for the
+    // final events to be collected...
+    if (sub->job_id && sub_event == _PAPPL_EVENT_JOB_COMPLETED)
+      sub->expire = n.time + 60;
+  }
+
+  pthread_cond_broadcast(&system->event_cond);
+  pthread_mutex_unlock(&system->event_mutex);
+
+  // Job and printer state changes may allow more raw print jobs...
+  if (event & (_PAPPL_EVENT_JOB_STATE_CHANGED | _PAPPL_EVENT_PRINTER_STATE_CHANGED))
+    _papplSystemWakeRaw(system);
+}
+
+
+//
+// '_papplSystemAddSubscription()' - Add an event subscription.
+//
+// The subscription ID, sequence numbers, and expiration time are filled in
+// from the system and the requested lease duration.  Expired subscriptions
+// are removed first, then `0` is returned if there are too many subscriptions
+// in total or for the subscriber.
+//
+
+int					// O - Subscription ID or `0` on error
+_papplSystemAddSubscription(
+    pappl_system_t        *system,	// I - System
+    _pappl_subscription_t *sub)		// I - Subscription template
+{
+  _pappl_subscription_t	*newsub,	// New subscription
+			*s;		// Current subscription
+  int			subscription_id = 0,
+					// Subscription ID
+			num_user = 0;	// Number of subscriptions for user
+  time_t		curtime = time(NULL);
+					// Current time
+
+
+  pthread_mutex_lock(&system->event_mutex);
+
+  if (!system->subscriptions)
+    system->subscriptions = cupsArrayNew3(NULL, NULL, NULL, 0, NULL, (cups_afree_func_t)free);
+
+  for (s = (_pappl_subscription_t *)cupsArrayFirst(system->subscriptions); s; s = (_pappl_subscription_t *)cupsArrayNext(system->subscriptions))
+  {
+    if (s->expire && s->expire <= curtime)
+      cupsArrayRemove(system->subscriptions, s);
+    else if (!strcmp(s->username, sub->username))
+      num_user ++;
+  }
+
+  if (cupsArrayCount(system->subscriptions) < _PAPPL_MAX_SUBSCRIPTIONS && num_user < _PAPPL_MAX_USER_SUBSCRIPTIONS && (newsub = malloc(sizeof(_pappl_subscription_t))) != NULL)
+  {
+    *newsub = *sub;
+
+    newsub->subscription_id = subscription_id = ++ system->next_subscription_id;
+    newsub->start_seq       = newsub->last_seq = system->event_seq;
+    newsub->num_events      = 0;
+    newsub->expire          = newsub->lease > 0 ? curtime + newsub->lease : 0;
+
+    cupsArrayAdd(system->subscriptions, newsub);
+  }
+
+  pthread_mutex_unlock(&system->event_mutex);
+
+  return (subscription_id);
+}
+
+
+//
+// '_papplSystemCancelSubscription()' - Cancel an event subscription.
+//
+
+bool					// O - `true` on success, `false` if not found
+_papplSystemCancelSubscription(
+    pappl_system_t *system,		// I - System
+    int            subscription_id)	// I - Subscription ID
+{
+  _pappl_subscription_t	*sub;		// Subscription
+
+
+  pthread_mutex_lock(&system->event_mutex);
+
+  if ((sub = find_subscription(system, subscription_id)) != NULL)
+    cupsArrayRemove(system->subscriptions, sub);
+
+  pthread_mutex_unlock(&system->event_mutex);
+
+  return (sub != NULL);
+}
+
+
+//
+// '_papplSystemGetEvents()' - Get events after a sequence number.
+//
+// This function copies up to "max" events after the sequence number pointed
+// to by "since", waiting up to "msecs" milliseconds for a new event if there
+// are none.  Only events for the specified printer are copied unless
+// "printer_id" is `0`.  Events that are no longer in the ring are skipped.
+//
+// On return, "since" is updated to the last event that was looked at.
+//
+
+size_t					// O - Number of events
+_papplSystemGetEvents(
+    pappl_system_t  *system,		// I - System
+    size_t          *since,		// IO - Last event sequence number seen
+    int             printer_id,		// I - Printer ID or `0` for all
+    _pappl_notify_t *events,		// I - Events array
+    size_t          max,		// I - Maximum number of events
+    int             msecs)		// I - Milliseconds to wait for events
+{
+  size_t		count = 0,	// Number of events
+			seq;		// Current sequence number
+  _pappl_notify_t	*n;		// Current event
+
+
+  pthread_mutex_lock(&system->event_mutex);
+
+  wait_events(system, *since, msecs);
+
+  if (*since > system->event_seq)
+    *since = system->event_seq;		// Sequence from a previous run...
+  else if (system->event_seq > _PAPPL_MAX_EVENTS && *since < (system->event_seq - _PAPPL_MAX_EVENTS))
+    *since = system->event_seq - _PAPPL_MAX_EVENTS;
+
+  for (seq = *since + 1; seq <= system->event_seq && count < max; seq ++)
+  {
+    n      = system->events + (seq % _PAPPL_MAX_EVENTS);
+    *since = seq;
+
+    if (!printer_id || n->printer_id == printer_id)
+      events[count ++] = *n;
+  }
+
+  pthread_mutex_unlock(&system->event_mutex);
+
+  return (count);
+}
+
+
+//
+// '_papplSystemGetNotifications()' - Get the events for a subscription.
+//
+// This function copies the subscription and up to "max" of its events that
+// are still in the event ring, starting with the "notify-sequence-number"
+// pointed to by "first".  The subscribed event for each notification is
+// copied to the "sub_events" array.
+//
+// On return, "first" is updated to the sequence number of the first event.
+// `-1` is returned if the subscription does not exist.
+//
+
+int					// O - Number of events or `-1` if not found
+_papplSystemGetNotifications(
+    pappl_system_t        *system,	// I - System
+    int                   subscription_id,
+					// I - Subscription ID
+    int                   *first,	// IO - First sequence number
+    _pappl_subscription_t *sub,		// O - Subscription
+    _pappl_notify_t       *events,	// I - Events array
+    _pappl_event_t        *sub_events,	// I - Subscribed events array
+    int                   max)		// I - Maximum number of events
+{
+  int			count = 0,	// Number of events
+			num_events;	// Sequence number of current event
+  size_t		seq,		// Current system sequence number
+			oldest;		// Oldest system sequence number in ring
+  _pappl_subscription_t	*s;		// Subscription
+  _pappl_event_t	sub_event;	// Subscribed event
+
+
+  pthread_mutex_lock(&system->event_mutex);
+
+  if ((s = find_subscription(system, subscription_id)) == NULL)
+  {
+    pthread_mutex_unlock(&system->event_mutex);
+    return (-1);
+  }
+
+  *sub = *s;
+
+  // Subscription sequence numbers are not stored in the ring, so count back
+  // from the last event for the subscription to find the first one wanted...
+  if (system->event_seq > _PAPPL_MAX_EVENTS)
+    oldest = system->event_seq - _PAPPL_MAX_EVENTS + 1;
+  else
+    oldest = 1;
+
+  if (oldest <= s->start_seq)
+    oldest = s->start_seq + 1;
+
+  for (seq = s->last_seq, num_events = s->num_events + 1; seq >= oldest && num_events > *first; seq --)
+  {
+    if (match_subscription(s, system->events + (seq % _PAPPL_MAX_EVENTS)))
+      num_events --;
+  }
+
+  *first = num_events;
+
+  // Then copy events going forward...
+  for (seq ++; seq <= s->last_seq && count < max; seq ++)
+  {
+    if ((sub_event = match_subscription(s, system->events + (seq % _PAPPL_MAX_EVENTS))) != _PAPPL_EVENT_NONE)
+    {
+      events[count]       = system->events[seq % _PAPPL_MAX_EVENTS];
+      sub_events[count ++] = sub_event;
+    }
+  }
+
+  pthread_mutex_unlock(&system->event_mutex);
+
+  return (count);
+}
+
+
+//
+// '_papplSystemRenewSubscription()' - Renew the lease for an event subscription.
+//
+
+bool					// O - `true` on success, `false` if not found
+_papplSystemRenewSubscription(
+    pappl_system_t *system,		// I - System
+    int            subscription_id,	// I - Subscription ID
+    int            lease)		// I - Lease duration in seconds or `0` for none
+{
+  _pappl_subscription_t	*sub;		// Subscription
+
+
+  pthread_mutex_lock(&system->event_mutex);
+
+  if ((sub = find_subscription(system, subscription_id)) != NULL)
+  {
+    sub->lease  = lease;
+    sub->expire = lease > 0 ? time(NULL) + lease : 0;
+  }
+
+  pthread_mutex_unlock(&system->event_mutex);
+
+  return (sub != NULL);
+}
+
+
+//
+// '_papplSystemWaitEvents()' - Wait for an event after a sequence number.
+//
+
+bool					// O - `true` if there are new events, `false` on timeout
+_papplSystemWaitEvents(
+    pappl_system_t *system,		// I - System
+    size_t         seq,			// I - Last event sequence number seen
+    int            msecs)		// I - Milliseconds to wait
+{
+  bool	ret;				// Return value
+
+
+  pthread_mutex_lock(&system->event_mutex);
+  ret = wait_events(system, seq, msecs);
+  pthread_mutex_unlock(&system->event_mutex);
+
+  return (ret);
+}
+
+
+//
+// '_papplEventString()' - Get the name of an event.
+//
+
+const char *				// O - Event name
+_papplEventString(_pappl_event_t event)	// I - Event
+{
+  switch (event)
+  {
+    case _PAPPL_EVENT_JOB_COMPLETED :
+        return ("job-completed");
+    case _PAPPL_EVENT_JOB_PROGRESS :
+        return ("job-progress");
+    case _PAPPL_EVENT_JOB_STATE_CHANGED :
+        return ("job-state-changed");
+    case _PAPPL_EVENT_PRINTER_CONFIG_CHANGED :
+        return ("printer-config-changed");
+    case _PAPPL_EVENT_PRINTER_STATE_CHANGED :
+        return ("printer-state-changed");
+    default :
+        return ("none");
+  }
+}
+
+
+//
+// 'find_subscription()' - Find a subscription by ID.
+//
+// The caller must hold the event mutex.
+//
+
+static _pappl_subscription_t *		// O - Subscription or `NULL`
+find_subscription(
+    pappl_system_t *system,		// I - System
+    int            subscription_id)	// I - Subscription ID
+{
+  _pappl_subscription_t	*sub;		// Current subscription
+  time_t		curtime = time(NULL);
+					// Current time
+
+
+  for (sub = (_pappl_subscription_t *)cupsArrayFirst(system->subscriptions); sub; sub = (_pappl_subscription_t *)cupsArrayNext(system->subscriptions))
+  {
+    if (sub->subscription_id == subscription_id)
+      return ((sub->expire && sub->expire <= curtime) ? NULL : sub);
+  }
+
+  return (NULL);
+}
+
+
+//
+// 'match_subscription()' - Determine whether an event matches a subscription.
+//
+// The "job-completed" event is a "job-state-changed" event for a job in a
+// terminating state and is preferred when a subscription has both.
+//
+
+static _pappl_event_t			// O - Subscribed event or `_PAPPL_EVENT_NONE`
+match_subscription(
+    _pappl_subscription_t *sub,		// I - Subscription
+    _pappl_notify_t       *n)		// I - Event
+{
+  if (n->seq <= sub->start_seq || (sub->printer_id && n->printer_id != sub->printer_id) || (sub->job_id && n->job_id != sub->job_id))
+    return (_PAPPL_EVENT_NONE);
+
+  if ((sub->mask & _PAPPL_EVENT_JOB_COMPLETED) && n->event == _PAPPL_EVENT_JOB_STATE_CHANGED && n->job_state >= IPP_JSTATE_CANCELED)
+    return (_PAPPL_EVENT_JOB_COMPLETED);
+
+  return ((_pappl_event_t)(sub->mask & n->event));
+}
+
+
+//
+// 'wait_events()' - Wait for an event after a sequence number.
+//
+// The caller must hold the event mutex.
+//
+
+static bool				// O - `true` if there are new events, `false` on timeout
+wait_events(pappl_system_t *system,	// I - System
+            size_t         seq,		// I - Last event sequence number seen
+            int            msecs)	// I - Milliseconds to wait
+{
+  struct timespec	timeout;	// Timeout for wait
+
+
+  if (seq >= system->event_seq && msecs > 0)
+  {
+    // Wait for a new event...
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec  += msecs / 1000;
+    timeout.tv_nsec += (msecs % 1000) * 1000000;
+    if (timeout.tv_nsec >= 1000000000)
+    {
+      timeout.tv_sec ++;
+      timeout.tv_nsec -= 1000000000;
+    }
+
+    while (seq >= system->event_seq)
+    {
+      if (pthread_cond_timedwait(&system->event_cond, &system->event_mutex, &timeout))
+        break;
+    }
+  }
+
+  return (seq < system->event_seq);
+}
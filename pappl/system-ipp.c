@@ -80,6 +80,22 @@ _papplSystemProcessIPP(
 	ipp_shutdown_all_printers(client);
 	break;
 
+    case IPP_OP_GET_NOTIFICATIONS :
+	_papplSubscriptionIPPGetNotifications(client);
+	break;
+
+    case IPP_OP_GET_SUBSCRIPTION_ATTRIBUTES :
+	_papplSubscriptionIPPGetAttributes(client);
+	break;
+
+    case IPP_OP_RENEW_SUBSCRIPTION :
+	_papplSubscriptionIPPRenew(client);
+	break;
+
+    case IPP_OP_CANCEL_SUBSCRIPTION :
+	_papplSubscriptionIPPCancel(client);
+	break;
+
     default :
         if (client->system->op_cb && (client->system->op_cb)(client, client->system->op_cbdata))
           break;
@@ -289,7 +305,7 @@ ipp_get_printers(
 
   papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   // Enumerate the printers for the client...
   count = cupsArrayCount(system->printers);
@@ -307,12 +323,12 @@ ipp_get_printers(
     if (i)
       ippAddSeparator(client->response);
 
-    pthread_rwlock_rdlock(&printer->rwlock);
+    _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
     _papplPrinterCopyAttributes(client, printer, ra, format);
-    pthread_rwlock_unlock(&printer->rwlock);
+    _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
   }
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   cupsArrayDelete(ra);
 }
@@ -343,7 +359,7 @@ ipp_get_system_attributes(
 
   papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   _papplCopyAttributes(client->response, system->attrs, ra, IPP_TAG_ZERO, IPP_TAG_CUPS_CONST);
 
@@ -374,7 +390,7 @@ ipp_get_system_attributes(
 
       col = ippNew();
 
-      pthread_rwlock_rdlock(&printer->rwlock);
+      _papplRWLockRead(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
       ippAddInteger(col, IPP_TAG_SYSTEM, IPP_TAG_INTEGER, "printer-id", printer->printer_id);
       ippAddString(col, IPP_TAG_SYSTEM, IPP_TAG_TEXT, "printer-info", NULL, printer->name);
@@ -384,7 +400,7 @@ ipp_get_system_attributes(
       _papplPrinterCopyState(col, printer, NULL);
       _papplPrinterCopyXRI(client, col, printer);
 
-      pthread_rwlock_unlock(&printer->rwlock);
+      _papplRWUnlock(&printer->rwlock, _PAPPL_LOCK_PRINTER);
 
       ippSetCollection(client->response, &attr, i, col);
       ippDelete(col);
@@ -513,7 +529,7 @@ ipp_get_system_attributes(
     ippDelete(col);
   }
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   cupsArrayDelete(ra);
 }
@@ -595,7 +611,7 @@ ipp_set_system_attributes(
     return;
 
   // Now apply changes...
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   for (rattr = ippFirstAttribute(client->request); rattr; rattr = ippNextAttribute(client->request))
   {
@@ -635,9 +651,9 @@ ipp_set_system_attributes(
     }
   }
 
-  system->config_changes ++;
+  _papplSystemConfigChangedNoLock(system);
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
 }
@@ -661,7 +677,7 @@ ipp_shutdown_all_printers(
     return;
   }
 
-  client->system->shutdown_time = time(NULL);
+  papplSystemShutdown(client->system);
 
   papplClientRespondIPP(client, IPP_STATUS_OK, NULL);
 }
@@ -14,14 +14,53 @@
 #include "pappl-private.h"
 
 
+//
+// Local constants...
+//
+
+#define _PAPPL_MAX_LOAD_THREADS	8	// Maximum number of printer loading threads
+
+
+//
+// Local types...
+//
+
+typedef struct _pappl_ldprinter_s	// Printer definition from the state file
+{
+  int			linenum,	// Line number of "<Printer ...>"
+			num_options;	// Number of printer options
+  cups_option_t		*options;	// Printer options (id, name, etc.)
+  cups_array_t		*lines;		// Printer directive lines
+} _pappl_ldprinter_t;
+
+typedef struct _pappl_ldstate_s		// Printer loading state
+{
+  pappl_system_t	*system;	// System
+  const char		*filename;	// State filename
+  pthread_mutex_t	mutex;		// Mutex for next printer
+  cups_array_t		*printers;	// Printer definitions
+  int			next_printer;	// Index of next printer to load
+} _pappl_ldstate_t;
+
+
 //
 // Local functions...
 //
 
+static bool	load_job(pappl_system_t *system, pappl_printer_t *printer, int num_options, cups_option_t *options, int linenum, const char *filename);
+static void	load_journal(pappl_system_t *system, const char *journame);
+static void	load_printer(pappl_system_t *system, _pappl_ldprinter_t *ldprinter, const char *filename);
+static void	*load_printers(_pappl_ldstate_t *ldstate);
 static void	parse_contact(char *value, pappl_contact_t *contact);
 static void	parse_media_col(char *value, pappl_media_col_t *media);
 static char	*read_line(cups_file_t *fp, char *line, size_t linesize, char **value, int *linenum);
+static void	split_line(char *line, char **value);
+static void	sync_directory(pappl_system_t *system, const char *filename);
+static bool	save_journal(pappl_system_t *system, const char *journame, cups_array_t *changes);
+static bool	save_snapshot(pappl_system_t *system, const char *filename, const char *journame);
+static void	trim_journal(pappl_system_t *system, const char *journame);
 static void	write_contact(cups_file_t *fp, pappl_contact_t *contact);
+static void	write_job(pappl_system_t *system, cups_file_t *fp, pappl_job_t *job, int printer_id);
 static void	write_media_col(cups_file_t *fp, const char *name, pappl_media_col_t *media);
 static void	write_options(cups_file_t *fp, const char *name, int num_options, cups_option_t *options);
 
@@ -40,6 +79,14 @@ static void	write_options(cups_file_t *fp, const char *name, int num_options, cu
 // name, including the use its auto-add callback to find a compatible new
 // driver.
 //
+// When the `PAPPL_SOPTIONS_PARALLEL_LOAD` system option is set, printers are
+// created by several threads at once to keep startup fast with many printers,
+// so the driver callback and each driver's status callback may be called
+// concurrently for different printers while the state is loaded.
+//
+// Any job changes recorded in the journal file ("filename.journal") since the
+// state file was last written are applied after the state file is loaded.
+//
 // > Note: This function must be called prior to @link papplSystemRun@.
 //
 
@@ -48,346 +95,889 @@ papplSystemLoadState(
     pappl_system_t *system,		// I - System
     const char     *filename)		// I - File to load
 {
-  int			i;		// Looping var
-  cups_file_t		*fp;		// Output file
-  int			linenum;	// Line number
-  char			line[2048],	// Line from file
-			*ptr,		// Pointer into line/value
-			*value;		// Value from line
+  int			i;		// Looping var
+  cups_file_t		*fp;		// Output file
+  int			linenum;	// Line number
+  char			line[2048],	// Line from file
+			journame[1024],	// Journal filename
+			*value;		// Value from line
+  _pappl_ldstate_t	ldstate;	// Printer loading state
+  _pappl_ldprinter_t	*ldprinter;	// Current printer definition
+  int			num_threads;	// Number of loading threads
+  long			num_cpus;	// Number of online CPUs
+  pthread_t		tids[_PAPPL_MAX_LOAD_THREADS];
+					// Loading threads
+  double		start,		// Start time
+			read_time,	// Time after reading the state file
+			printer_time,	// Time after loading printers
+			end;		// End time
+
+
+  // Range check input...
+  if (!system || !filename)
+  {
+    return (false);
+  }
+  else if (system->is_running)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Cannot load system state while running.");
+    return (false);
+  }
+
+  // Open the state file...
+  start = _papplGetTime();
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+  {
+    if (errno != ENOENT)
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to open system state file '%s': %s", filename, cupsLastErrorString());
+
+    return (false);
+  }
+
+  // Read lines from the state file...
+  papplLog(system, PAPPL_LOGLEVEL_INFO, "Loading system state from '%s'.", filename);
+
+  memset(&ldstate, 0, sizeof(ldstate));
+  ldstate.system   = system;
+  ldstate.filename = filename;
+  ldstate.printers = cupsArrayNew(NULL, NULL);
+
+  linenum = 0;
+  while (read_line(fp, line, sizeof(line), &value, &linenum))
+  {
+    if (!strcasecmp(line, "DNSSDName"))
+      papplSystemSetDNSSDName(system, value);
+    else if (!strcasecmp(line, "Location"))
+      papplSystemSetLocation(system, value);
+    else if (!strcasecmp(line, "GeoLocation"))
+      papplSystemSetGeoLocation(system, value);
+    else if (!strcasecmp(line, "Organization"))
+      papplSystemSetOrganization(system, value);
+    else if (!strcasecmp(line, "OrganizationalUnit"))
+      papplSystemSetOrganizationalUnit(system, value);
+    else if (!strcasecmp(line, "Contact"))
+    {
+      pappl_contact_t	contact;		// "system-contact" value
+
+      parse_contact(value, &contact);
+      papplSystemSetContact(system, &contact);
+    }
+    else if (!strcasecmp(line, "AdminGroup"))
+      papplSystemSetAdminGroup(system, value);
+    else if (!strcasecmp(line, "DefaultPrintGroup"))
+      papplSystemSetDefaultPrintGroup(system, value);
+    else if (!strcasecmp(line, "Password"))
+      papplSystemSetPassword(system, value);
+    else if (!strcasecmp(line, "DefaultPrinterID") && value)
+      system->default_printer_id = atoi(value);
+    else if (!strcasecmp(line, "NextPrinterID") && value)
+      system->next_printer_id = atoi(value);
+    else if (!strcasecmp(line, "UUID") && value)
+      system->uuid = strdup(value);
+    else if (!strcasecmp(line, "<Printer") && value)
+    {
+      // Read a printer definition, the printer is created later...
+      const char	*printer_id;	// Printer ID
+
+      if ((ldprinter = calloc(1, sizeof(_pappl_ldprinter_t))) == NULL)
+      {
+        papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for printer on line %d of '%s': %s", linenum, filename, strerror(errno));
+        break;
+      }
+
+      ldprinter->linenum     = linenum;
+      ldprinter->num_options = cupsParseOptions(value, 0, &ldprinter->options);
+      ldprinter->lines       = cupsArrayNew3(NULL, NULL, NULL, 0, (cups_acopy_func_t)strdup, (cups_afree_func_t)free);
+
+      cupsArrayAdd(ldstate.printers, ldprinter);
+
+      if (ldprinter->num_options != 5 || (printer_id = cupsGetOption("id", ldprinter->num_options, ldprinter->options)) == NULL || atoi(printer_id) <= 0 || !cupsGetOption("name", ldprinter->num_options, ldprinter->options) || !cupsGetOption("did", ldprinter->num_options, ldprinter->options) || !cupsGetOption("uri", ldprinter->num_options, ldprinter->options) || !cupsGetOption("driver", ldprinter->num_options, ldprinter->options))
+      {
+        papplLog(system, PAPPL_LOGLEVEL_ERROR, "Bad printer definition on line %d of '%s'.", linenum, filename);
+        cupsArrayRemove(ldstate.printers, ldprinter);
+        cupsFreeOptions(ldprinter->num_options, ldprinter->options);
+        cupsArrayDelete(ldprinter->lines);
+        free(ldprinter);
+        break;
+      }
+
+      // Save the printer directives as-is, every line (including the closing
+      // "</Printer>") counts so that line numbers can be reconstructed...
+      while (cupsFileGets(fp, line, sizeof(line)))
+      {
+        linenum ++;
+
+        if (!strcasecmp(line, "</Printer>"))
+          break;
+
+        cupsArrayAdd(ldprinter->lines, line);
+      }
+    }
+    else
+    {
+      papplLog(system, PAPPL_LOGLEVEL_WARN, "Unknown directive '%s' on line %d of '%s'.", line, linenum, filename);
+    }
+  }
+
+  cupsFileClose(fp);
+
+  read_time = _papplGetTime();
+
+  // Create the printers, using a pool of threads if allowed...
+  if (system->options & PAPPL_SOPTIONS_PARALLEL_LOAD)
+  {
+    num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if ((num_threads = cupsArrayCount(ldstate.printers)) > _PAPPL_MAX_LOAD_THREADS)
+      num_threads = _PAPPL_MAX_LOAD_THREADS;
+    if (num_cpus > 0 && num_threads > num_cpus)
+      num_threads = (int)num_cpus;
+  }
+  else
+  {
+    num_threads = 1;
+  }
+
+  pthread_mutex_init(&ldstate.mutex, NULL);
+
+  // The current thread loads printers as well, so only start num_threads - 1
+  // additional threads...
+  for (i = 1; i < num_threads; i ++)
+  {
+    if (pthread_create(tids + i, NULL, (void *(*)(void *))load_printers, &ldstate))
+    {
+      papplLog(system, PAPPL_LOGLEVEL_WARN, "Unable to create printer loading thread: %s", strerror(errno));
+      break;
+    }
+  }
+
+  num_threads = i;
+
+  load_printers(&ldstate);
+
+  for (i = 1; i < num_threads; i ++)
+    pthread_join(tids[i], NULL);
+
+  pthread_mutex_destroy(&ldstate.mutex);
+
+  for (ldprinter = (_pappl_ldprinter_t *)cupsArrayFirst(ldstate.printers); ldprinter; ldprinter = (_pappl_ldprinter_t *)cupsArrayNext(ldstate.printers))
+  {
+    cupsFreeOptions(ldprinter->num_options, ldprinter->options);
+    cupsArrayDelete(ldprinter->lines);
+    free(ldprinter);
+  }
+
+  printer_time = _papplGetTime();
+
+  // Apply any job changes made since the state file was written...
+  snprintf(journame, sizeof(journame), "%s.journal", filename);
+  load_journal(system, journame);
+
+  end = _papplGetTime();
+
+  papplLog(system, PAPPL_LOGLEVEL_INFO, "Loaded %d printer(s) from '%s' in %.3f seconds (read %.3f, printers %.3f using %d thread(s), journal %.3f).", cupsArrayCount(ldstate.printers), filename, end - start, read_time - start, printer_time - read_time, num_threads > 0 ? num_threads : 1, end - printer_time);
+
+  cupsArrayDelete(ldstate.printers);
+
+  return (true);
+}
+
+
+//
+// 'papplSystemSaveState()' - Save the current system state.
+//
+// This function saves the current system state to a file.  It is typically
+// used with the @link papplSystemSetSaveCallback@ function to periodically
+// save the state:
+//
+// ```
+// |papplSystemSetSaveCallback(system, (pappl_save_cb_t)papplSystemSaveState,
+// |    (void *)filename);
+// ```
+//
+// When only jobs have changed since the last save, the changed jobs are
+// appended to a journal file ("filename.journal") instead of rewriting the
+// whole state file.  Otherwise, or once the journal gets too long, a new state
+// file is written to a temporary file that then replaces the old one so that a
+// crash never leaves a partial state file behind.
+//
+
+bool					// O - `true` on success, `false` on failure
+papplSystemSaveState(
+    pappl_system_t *system,		// I - System
+    const char     *filename)		// I - File to save
+{
+  bool			ret = false;	// Return value
+  char			journame[1024];	// Journal filename
+  cups_array_t		*changes;	// Job changes to save
+  size_t		config_changes,	// Configuration changes
+			job_changes,	// Job changes
+			num_changes;	// Number of non-job changes
+
+
+  if (!system || !filename)
+    return (false);
+
+  snprintf(journame, sizeof(journame), "%s.journal", filename);
+
+  // Only one thread saves at a time...
+  pthread_mutex_lock(&system->state_mutex);
+
+  // Take the pending job changes so that new changes can be recorded while the
+  // state is written...
+  pthread_mutex_lock(&system->journal_mutex);
+
+  pthread_mutex_lock(&system->save_mutex);
+  config_changes = system->config_changes;
+  pthread_mutex_unlock(&system->save_mutex);
+
+  job_changes     = system->job_changes;
+  changes         = system->journal;
+  system->journal = NULL;
+
+  pthread_mutex_unlock(&system->journal_mutex);
+
+  num_changes = (config_changes - system->state_config_changes) - (job_changes - system->state_job_changes);
+
+  if (system->journal_ok && num_changes == 0 && (system->journal_count + (size_t)cupsArrayCount(changes)) <= _PAPPL_MAX_JOURNAL)
+    ret = save_journal(system, journame, changes);
+
+  if (!ret)
+    ret = save_snapshot(system, filename, journame);
+
+  if (ret)
+  {
+    system->state_config_changes = config_changes;
+    system->state_job_changes    = job_changes;
+  }
+  else
+  {
+    // The job changes taken above were not saved, so the next save needs to
+    // be a full snapshot...
+    system->journal_ok = false;
+  }
+
+  pthread_mutex_unlock(&system->state_mutex);
+
+  cupsArrayDelete(changes);
+
+  return (ret);
+}
+
+
+//
+// 'load_job()' - Load a job from the state file or journal.
+//
+// Jobs that already exist (from the state file or an earlier journal record)
+// are updated in place.
+//
+
+static bool				// O - `true` on success, `false` on error
+load_job(pappl_system_t  *system,	// I - System
+         pappl_printer_t *printer,	// I - Printer
+         int             num_options,	// I - Number of options
+         cups_option_t   *options,	// I - Options
+         int             linenum,	// I - Line number
+         const char      *filename)	// I - State or journal filename
+{
+  pappl_job_t		*job;		// Job
+  bool			is_new;		// New job?
+  ipp_attribute_t	*attr;		// Job attribute
+  struct stat		jobbuf;		// Job file buffer
+  const char		*job_name,	// Job name
+			*job_id,	// Job ID
+			*job_username,	// Job username
+			*job_format,	// Job format
+			*job_value;	// Job option value
+
+
+  if ((job_id = cupsGetOption("id", num_options, options)) == NULL || atoi(job_id) <= 0 || (job_name = cupsGetOption("name", num_options, options)) == NULL || (job_username = cupsGetOption("username", num_options, options)) == NULL || (job_format = cupsGetOption("format", num_options, options)) == NULL)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Bad Job definition on line %d of '%s'.", linenum, filename);
+    return (false);
+  }
+
+  if ((job = papplPrinterFindJob(printer, atoi(job_id))) != NULL)
+  {
+    // Existing job, it gets added back to the right jobs array below...
+    is_new = false;
+
+    _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+    _papplJobListRemove(&printer->active_jobs, job);
+    _papplJobListRemove(&printer->completed_jobs, job);
+    _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+    free(job->filename);
+    job->filename = NULL;
+  }
+  else if ((job = _papplJobCreate(printer, atoi(job_id), job_username, job_format, job_name, NULL)) == NULL)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Error creating job %s for printer %s", job_name, printer->name);
+    return (false);
+  }
+  else
+  {
+    // The name and format strings belong to the options array, so point the
+    // job at copies in its attributes...
+    is_new    = true;
+    job->name = ippGetString(ippFindAttribute(job->attrs, "job-name", IPP_TAG_NAME), 0, NULL);
+
+    if ((attr = ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_MIMETYPE, "document-format-supplied", NULL, job_format)) != NULL)
+      job->format = ippGetString(attr, 0, NULL);
+  }
+
+  if (job->job_id >= printer->next_job_id)
+    printer->next_job_id = job->job_id + 1;
+
+  if ((job_value = cupsGetOption("filename", num_options, options)) != NULL)
+    job->filename = strdup(job_value);
+  if ((job_value = cupsGetOption("compressed", num_options, options)) != NULL)
+    job->spool_compressed = !strcmp(job_value, "true");
+  if ((job_value = cupsGetOption("state", num_options, options)) != NULL)
+    job->state = (ipp_jstate_t)atoi(job_value);
+  if ((job_value = cupsGetOption("state_reasons", num_options, options)) != NULL)
+    job->state_reasons = (ipp_jstate_t)atoi(job_value);
+  if ((job_value = cupsGetOption("created", num_options, options)) != NULL)
+    job->created = atol(job_value);
+  if ((job_value = cupsGetOption("processing", num_options, options)) != NULL)
+    job->processing = atol(job_value);
+  if ((job_value = cupsGetOption("completed", num_options, options)) != NULL)
+    job->completed = atol(job_value);
+  if ((job_value = cupsGetOption("impressions", num_options, options)) != NULL)
+    job->impressions = atoi(job_value);
+  if ((job_value = cupsGetOption("imcompleted", num_options, options)) != NULL)
+    job->impcompleted = atoi(job_value);
+
+  // Add the job to printer completed jobs array...
+  if (job->state < IPP_JSTATE_STOPPED)
+  {
+    if (is_new)
+    {
+      // Load the file attributes from the spool directory...
+      int	attr_fd;		// Attribute file descriptor
+      char	job_attr_filename[256];	// Attribute filename
+
+      if ((attr_fd = papplJobOpenFile(job, job_attr_filename, sizeof(job_attr_filename), system->directory, "ipp", "r")) < 0)
+      {
+	papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to open file for job attributes: '%s'.", job_attr_filename);
+	return (false);
+      }
+
+      ippReadFile(attr_fd, job->attrs);
+      close(attr_fd);
+    }
+
+    if (!job->filename || stat(job->filename, &jobbuf))
+    {
+      // If file removed, then set job state to aborted...
+      job->state = IPP_JSTATE_ABORTED;
+    }
+    else
+    {
+      // Add the job to printer active jobs array...
+      _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+      _papplJobListAdd(&printer->active_jobs, job);
+      _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+    }
+  }
+  else
+  {
+    // Add job to printer completed jobs...
+    _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+    _papplJobListAdd(&printer->completed_jobs, job);
+    _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  }
+
+  return (true);
+}
+
+
+//
+// 'load_journal()' - Apply the job changes in the state journal.
+//
+
+static void
+load_journal(pappl_system_t *system,	// I - System
+             const char     *journame)	// I - Journal filename
+{
+  cups_file_t		*fp;		// Journal file
+  int			linenum = 0,	// Line number
+			num_records = 0,// Number of records applied
+			num_options;	// Number of options
+  cups_option_t		*options;	// Options
+  char			line[2048],	// Line from file
+			*value;		// Value from line
+  const char		*printer_id,	// Printer ID
+			*job_id,	// Job ID
+			*printer_value;	// Printer option value
+  pappl_printer_t	*printer;	// Printer
+  pappl_job_t		*job;		// Job
+
+
+  // Drop any partial record left by an interrupted write...
+  trim_journal(system, journame);
+
+  if ((fp = cupsFileOpen(journame, "r")) == NULL)
+  {
+    if (errno != ENOENT)
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to open system state journal '%s': %s", journame, cupsLastErrorString());
+
+    return;
+  }
+
+  while (read_line(fp, line, sizeof(line), &value, &linenum))
+  {
+    options     = NULL;
+    num_options = value ? cupsParseOptions(value, 0, &options) : 0;
+
+    if ((printer_id = cupsGetOption("printer", num_options, options)) == NULL || (job_id = cupsGetOption("id", num_options, options)) == NULL)
+    {
+      papplLog(system, PAPPL_LOGLEVEL_WARN, "Bad journal record on line %d of '%s'.", linenum, journame);
+    }
+    else if ((printer = papplSystemFindPrinter(system, NULL, atoi(printer_id), NULL)) == NULL)
+    {
+      // Printer was dropped or deleted, ignore...
+    }
+    else if (!strcasecmp(line, "Job"))
+    {
+      if (load_job(system, printer, num_options, options, linenum, journame))
+      {
+        num_records ++;
+
+        if ((printer_value = cupsGetOption("printer_imcompleted", num_options, options)) != NULL)
+          printer->impcompleted = atoi(printer_value);
+      }
+    }
+    else if (!strcasecmp(line, "DeleteJob"))
+    {
+      if ((job = papplPrinterFindJob(printer, atoi(job_id))) != NULL)
+      {
+        _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+        _papplJobListRemove(&printer->active_jobs, job);
+        _papplJobListRemove(&printer->completed_jobs, job);
+        _papplJobListRemove(&printer->all_jobs, job);
+        _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+        _papplJobDelete(job);
+      }
+
+      num_records ++;
+    }
+    else
+    {
+      papplLog(system, PAPPL_LOGLEVEL_WARN, "Unknown journal record '%s' on line %d of '%s'.", line, linenum, journame);
+    }
+
+    cupsFreeOptions(num_options, options);
+  }
+
+  cupsFileClose(fp);
+
+  if (num_records > 0)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_INFO, "Applied %d job change(s) from '%s'.", num_records, journame);
+
+    // Completed jobs might need to be cleaned up...
+    _papplSystemScheduleCleanJobs(system, time(NULL) + 60);
+  }
+}
+
+
+//
+// 'load_printer()' - Create a printer and apply its directives from the state
+//                    file.
+//
+
+static void
+load_printer(
+    pappl_system_t     *system,		// I - System
+    _pappl_ldprinter_t *ldprinter,	// I - Printer definition
+    const char         *filename)	// I - State filename
+{
+  int			i;		// Looping var
+  int			linenum;	// Line number
+  char			line[2048],	// Line from file
+			*ptr,		// Pointer into line/value
+			*value;		// Value from line
+  const char		*current,	// Current directive line
+			*printer_name,	// Printer name
+			*driver_name;	// Driver name
+  pappl_printer_t	*printer;	// Printer
+
+
+  printer_name = cupsGetOption("name", ldprinter->num_options, ldprinter->options);
+  driver_name  = cupsGetOption("driver", ldprinter->num_options, ldprinter->options);
+
+  if ((printer = papplPrinterCreate(system, atoi(cupsGetOption("id", ldprinter->num_options, ldprinter->options)), printer_name, driver_name, cupsGetOption("did", ldprinter->num_options, ldprinter->options), cupsGetOption("uri", ldprinter->num_options, ldprinter->options))) == NULL)
+  {
+    if (errno == EEXIST)
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Printer '%s' already exists, dropping duplicate printer and job history in state file.", printer_name);
+    else if (errno == EIO)
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Dropping printer '%s' and its job history because the driver ('%s') is no longer supported.", printer_name, driver_name);
+    else
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Dropping printer '%s' and its job history because an error occurred: %s", printer_name, strerror(errno));
+
+    return;
+  }
+
+  for (current = (const char *)cupsArrayFirst(ldprinter->lines), linenum = ldprinter->linenum + 1; current; current = (const char *)cupsArrayNext(ldprinter->lines), linenum ++)
+  {
+    strlcpy(line, current, sizeof(line));
+    split_line(line, &value);
+
+    if (!strcasecmp(line, "DNSSDName"))
+      papplPrinterSetDNSSDName(printer, value);
+    else if (!strcasecmp(line, "Location"))
+      papplPrinterSetLocation(printer, value);
+    else if (!strcasecmp(line, "GeoLocation"))
+      papplPrinterSetGeoLocation(printer, value);
+    else if (!strcasecmp(line, "Organization"))
+      papplPrinterSetOrganization(printer, value);
+    else if (!strcasecmp(line, "OrganizationalUnit"))
+      papplPrinterSetOrganizationalUnit(printer, value);
+    else if (!strcasecmp(line, "Contact"))
+    {
+      pappl_contact_t	contact;	// "printer-contact" value
+
+      parse_contact(value, &contact);
+      papplPrinterSetContact(printer, &contact);
+    }
+    else if (!strcasecmp(line, "PrintGroup"))
+      papplPrinterSetPrintGroup(printer, value);
+    else if (!strcasecmp(line, "MaxActiveJobs"))
+      papplPrinterSetMaxActiveJobs(printer, atoi(value));
+    else if (!strcasecmp(line, "MaxCompletedJobs"))
+      papplPrinterSetMaxCompletedJobs(printer, atoi(value));
+    else if (!strcasecmp(line, "NextJobId"))
+      printer->next_job_id = atoi(value);
+    else if (!strcasecmp(line, "ImpressionsCompleted"))
+      printer->impcompleted = atoi(value);
+    else if (!strcasecmp(line, "identify-actions-default"))
+      printer->psdriver.driver_data.identify_default = _papplIdentifyActionsValue(value);
+    else if (!strcasecmp(line, "label-mode-configured"))
+      printer->psdriver.driver_data.mode_configured = _papplLabelModeValue(value);
+    else if (!strcasecmp(line, "label-tear-offset-configured"))
+      printer->psdriver.driver_data.tear_offset_configured = atoi(value);
+    else if (!strcasecmp(line, "media-col-default"))
+      parse_media_col(value, &printer->psdriver.driver_data.media_default);
+    else if (!strncasecmp(line, "media-col-ready", 15))
+    {
+      if ((i = atoi(line + 15)) >= 0 && i < PAPPL_MAX_SOURCE)
+        parse_media_col(value, printer->psdriver.driver_data.media_ready + i);
+    }
+    else if (!strcasecmp(line, "orientation-requested-default"))
+      printer->psdriver.driver_data.orient_default = (ipp_orient_t)ippEnumValue("orientation-requested", value);
+    else if (!strcasecmp(line, "output-bin-default"))
+    {
+      for (i = 0; i < printer->psdriver.driver_data.num_bin; i ++)
+      {
+        if (!strcmp(value, printer->psdriver.driver_data.bin[i]))
+        {
+          printer->psdriver.driver_data.bin_default = i;
+          break;
+        }
+      }
+    }
+    else if (!strcasecmp(line, "print-color-mode-default"))
+      printer->psdriver.driver_data.color_default = _papplColorModeValue(value);
+    else if (!strcasecmp(line, "print-content-optimize-default"))
+      printer->psdriver.driver_data.content_default = _papplContentValue(value);
+    else if (!strcasecmp(line, "print-darkness-default"))
+      printer->psdriver.driver_data.darkness_default = atoi(value);
+    else if (!strcasecmp(line, "print-quality-default"))
+      printer->psdriver.driver_data.quality_default = (ipp_quality_t)ippEnumValue("print-quality", value);
+    else if (!strcasecmp(line, "print-scaling-default"))
+      printer->psdriver.driver_data.scaling_default = _papplScalingValue(value);
+    else if (!strcasecmp(line, "print-speed-default"))
+      printer->psdriver.driver_data.speed_default = atoi(value);
+    else if (!strcasecmp(line, "printer-darkness-configured"))
+      printer->psdriver.driver_data.darkness_configured = atoi(value);
+    else if (!strcasecmp(line, "printer-resolution-default") && value)
+      sscanf(value, "%dx%ddpi", &printer->psdriver.driver_data.x_default, &printer->psdriver.driver_data.y_default);
+    else if (!strcasecmp(line, "sides-default"))
+      printer->psdriver.driver_data.sides_default = _papplSidesValue(value);
+    else if ((ptr = strstr(line, "-default")) != NULL)
+    {
+      // Vendor default, applied when the driver attributes are built...
+      *ptr = '\0';
+
+      _papplPrinterSetVendorDefault(printer, line, value ? value : "");
+    }
+    else if (!strcasecmp(line, "Job") && value)
+    {
+      // Read printer job
+      int		num_joptions;	// Number of job options
+      cups_option_t	*joptions = NULL;
+					// Job options
+
+      num_joptions = cupsParseOptions(value, 0, &joptions);
+      load_job(system, printer, num_joptions, joptions, linenum, filename);
+      cupsFreeOptions(num_joptions, joptions);
+    }
+    else
+      papplLog(system, PAPPL_LOGLEVEL_WARN, "Unknown printer directive '%s' on line %d of '%s'.", line, linenum, filename);
+  }
+
+  // Loaded all printer attributes, call the status callback (if any) to
+  // update the current printer state...
+  if (printer->psdriver.driver_data.status_cb)
+    (printer->psdriver.driver_data.status_cb)(printer);
+}
+
+
+//
+// 'load_printers()' - Create printers from the state file.
+//
+// This function is run by each of the printer loading threads, which take
+// printer definitions from the list until none are left.
+//
+
+static void *				// O - Thread exit status
+load_printers(
+    _pappl_ldstate_t *ldstate)		// I - Printer loading state
+{
+  _pappl_ldprinter_t	*ldprinter;	// Printer definition
+
+
+  for (;;)
+  {
+    pthread_mutex_lock(&ldstate->mutex);
+    ldprinter = (_pappl_ldprinter_t *)cupsArrayIndex(ldstate->printers, ldstate->next_printer ++);
+    pthread_mutex_unlock(&ldstate->mutex);
+
+    if (!ldprinter)
+      break;
+
+    load_printer(ldstate->system, ldprinter, ldstate->filename);
+  }
+
+  return (NULL);
+}
+
+
+//
+// 'parse_contact()' - Parse a contact value.
+//
+
+static void
+parse_contact(char            *value,	// I - Value
+              pappl_contact_t *contact)	// O - Contact
+{
+  int		i,			// Looping var
+		num_options;		// Number of options
+  cups_option_t	*options = NULL,	// Options
+		*option;		// Current option
+
+
+  memset(contact, 0, sizeof(pappl_contact_t));
+  num_options = cupsParseOptions(value, 0, &options);
+
+  for (i = num_options, option = options; i > 0; i --, option ++)
+  {
+    if (!strcasecmp(option->name, "name"))
+      strlcpy(contact->name, option->value, sizeof(contact->name));
+    else if (!strcasecmp(option->name, "email"))
+      strlcpy(contact->email, option->value, sizeof(contact->email));
+    else if (!strcasecmp(option->name, "telephone"))
+      strlcpy(contact->telephone, option->value, sizeof(contact->telephone));
+  }
+
+  cupsFreeOptions(num_options, options);
+}
+
+
+//
+// 'parse_media_col()' - Parse a media-col value.
+//
+
+static void
+parse_media_col(
+    char              *value,		// I - Value
+    pappl_media_col_t *media)		// O - Media collection
+{
+  int		i,			// Looping var
+		num_options;		// Number of options
+  cups_option_t	*options = NULL,	// Options
+		*option;		// Current option
+
+
+  memset(media, 0, sizeof(pappl_media_col_t));
+  num_options = cupsParseOptions(value, 0, &options);
+
+  for (i = num_options, option = options; i > 0; i --, option ++)
+  {
+    if (!strcasecmp(option->name, "bottom"))
+      media->bottom_margin = atoi(option->value);
+    else if (!strcasecmp(option->name, "left"))
+      media->left_margin = atoi(option->value);
+    else if (!strcasecmp(option->name, "right"))
+      media->right_margin = atoi(option->value);
+    else if (!strcasecmp(option->name, "name"))
+      strlcpy(media->size_name, option->value, sizeof(media->size_name));
+    else if (!strcasecmp(option->name, "width"))
+      media->size_width = atoi(option->value);
+    else if (!strcasecmp(option->name, "length"))
+      media->size_length = atoi(option->value);
+    else if (!strcasecmp(option->name, "source"))
+      strlcpy(media->source, option->value, sizeof(media->source));
+    else if (!strcasecmp(option->name, "top"))
+      media->top_margin = atoi(option->value);
+    else if (!strcasecmp(option->name, "offset"))
+      media->top_offset = atoi(option->value);
+    else if (!strcasecmp(option->name, "tracking"))
+      media->tracking = _papplMediaTrackingValue(option->value);
+    else if (!strcasecmp(option->name, "type"))
+      strlcpy(media->type, option->value, sizeof(media->type));
+  }
+
+  cupsFreeOptions(num_options, options);
+}
+
+
+//
+// 'read_line()' - Read a line from the state file.
+//
+// This function is like `cupsFileGetConf`, except that it doesn't support
+// comments since the state files are not meant to be edited or maintained by
+// humans.
+//
+
+static char *				// O  - Line or `NULL` on EOF
+read_line(cups_file_t *fp,		// I  - File
+          char        *line,		// I  - Line buffer
+          size_t      linesize,		// I  - Size of line buffer
+          char        **value,		// O  - Value portion of line
+          int         *linenum)		// IO - Current line number
+{
+  // Try reading a line from the file...
+  *value = NULL;
+
+  if (!cupsFileGets(fp, line, linesize))
+    return (NULL);
+
+  // Got it, bump the line number...
+  (*linenum) ++;
+
+  // Split the line into the directive and value...
+  split_line(line, value);
+
+  return (line);
+}
+
+
+//
+// 'save_journal()' - Append the changed jobs to the state journal.
+//
+// The caller must hold the state mutex.  The system read lock is only held
+// while the records are formatted, not while they are synced to disk.
+//
+
+static bool				// O - `true` on success, `false` on failure
+save_journal(pappl_system_t *system,	// I - System
+             const char     *journame,	// I - Journal filename
+             cups_array_t   *changes)	// I - Job changes
+{
+  cups_file_t		*fp;		// Journal file
+  _pappl_jchange_t	*change;	// Current job change
+  pappl_printer_t	*printer;	// Printer
+  pappl_job_t		*job;		// Job
+  bool			ret = true;	// Return value
 
 
-  // Range check input...
-  if (!system || !filename)
-  {
-    return (false);
-  }
-  else if (system->is_running)
-  {
-    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Cannot load system state while running.");
-    return (false);
-  }
+  if (cupsArrayCount(changes) == 0)
+    return (true);
 
-  // Open the state file...
-  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+  if ((fp = cupsFileOpen(journame, "a")) == NULL)
   {
-    if (errno != ENOENT)
-      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to open system state file '%s': %s", filename, cupsLastErrorString());
-
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to open system state journal '%s': %s", journame, cupsLastErrorString());
     return (false);
   }
 
-  // Read lines from the state file...
-  papplLog(system, PAPPL_LOGLEVEL_INFO, "Loading system state from '%s'.", filename);
+  papplLog(system, PAPPL_LOGLEVEL_DEBUG, "Appending %d job change(s) to '%s'.", cupsArrayCount(changes), journame);
 
-  linenum = 0;
-  while (read_line(fp, line, sizeof(line), &value, &linenum))
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+
+  for (change = (_pappl_jchange_t *)cupsArrayFirst(changes); change; change = (_pappl_jchange_t *)cupsArrayNext(changes))
   {
-    if (!strcasecmp(line, "DNSSDName"))
-      papplSystemSetDNSSDName(system, value);
-    else if (!strcasecmp(line, "Location"))
-      papplSystemSetLocation(system, value);
-    else if (!strcasecmp(line, "GeoLocation"))
-      papplSystemSetGeoLocation(system, value);
-    else if (!strcasecmp(line, "Organization"))
-      papplSystemSetOrganization(system, value);
-    else if (!strcasecmp(line, "OrganizationalUnit"))
-      papplSystemSetOrganizationalUnit(system, value);
-    else if (!strcasecmp(line, "Contact"))
+    // Find the printer...
+    for (printer = (pappl_printer_t *)cupsArrayFirst(system->printers); printer; printer = (pappl_printer_t *)cupsArrayNext(system->printers))
     {
-      pappl_contact_t	contact;		// "system-contact" value
+      if (printer->printer_id == change->printer_id)
+        break;
+    }
 
-      parse_contact(value, &contact);
-      papplSystemSetContact(system, &contact);
+    if (printer && !printer->is_deleted)
+    {
+      // Hold the job list lock while writing so the job cannot be deleted...
+      _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+      if ((job = _papplJobListFind(&printer->all_jobs, change->job_id)) != NULL)
+        write_job(system, fp, job, change->printer_id);
+      _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
     }
-    else if (!strcasecmp(line, "AdminGroup"))
-      papplSystemSetAdminGroup(system, value);
-    else if (!strcasecmp(line, "DefaultPrintGroup"))
-      papplSystemSetDefaultPrintGroup(system, value);
-    else if (!strcasecmp(line, "Password"))
-      papplSystemSetPassword(system, value);
-    else if (!strcasecmp(line, "DefaultPrinterID") && value)
-      system->default_printer_id = atoi(value);
-    else if (!strcasecmp(line, "NextPrinterID") && value)
-      system->next_printer_id = atoi(value);
-    else if (!strcasecmp(line, "UUID") && value)
-      system->uuid = strdup(value);
-    else if (!strcasecmp(line, "<Printer") && value)
+    else
     {
-      // Read a printer...
-      int		num_options;	// Number of options
-      cups_option_t	*options = NULL;// Options
-      const char	*printer_id,	// Printer ID
-			*printer_name,	// Printer name
-			*device_id,	// Device ID
-			*device_uri,	// Device URI
-			*driver_name;	// Driver name
-      pappl_printer_t	*printer;	// Current printer
+      job = NULL;
+    }
 
+    if (!job)
+      cupsFilePrintf(fp, "DeleteJob printer=\"%d\" id=\"%d\"\n", change->printer_id, change->job_id);
 
-      if ((num_options = cupsParseOptions(value, 0, &options)) != 5 || (printer_id = cupsGetOption("id", num_options, options)) == NULL || atoi(printer_id) <= 0 || (printer_name = cupsGetOption("name", num_options, options)) == NULL || (device_id = cupsGetOption("did", num_options, options)) == NULL || (device_uri = cupsGetOption("uri", num_options, options)) == NULL || (driver_name = cupsGetOption("driver", num_options, options)) == NULL)
-      {
-        papplLog(system, PAPPL_LOGLEVEL_ERROR, "Bad printer definition on line %d of '%s'.", linenum, filename);
-        break;
-      }
+    system->journal_count ++;
+  }
 
-      if ((printer = papplPrinterCreate(system, atoi(printer_id), printer_name, driver_name, device_id, device_uri)) == NULL)
-      {
-	if (errno == EEXIST)
-	  papplLog(system, PAPPL_LOGLEVEL_ERROR, "Printer '%s' already exists, dropping duplicate printer and job history in state file.", printer_name);
-	else if (errno == EIO)
-	  papplLog(system, PAPPL_LOGLEVEL_ERROR, "Dropping printer '%s' and its job history because the driver ('%s') is no longer supported.", printer_name, driver_name);
-	else
-	  papplLog(system, PAPPL_LOGLEVEL_ERROR, "Dropping printer '%s' and its job history because an error occurred: %s", printer_name, strerror(errno));
-      }
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
-      while (read_line(fp, line, sizeof(line), &value, &linenum))
-      {
-        if (!strcasecmp(line, "</Printer>"))
-          break;
-	else if (!printer)
-	  continue;
-	else if (!strcasecmp(line, "DNSSDName"))
-	  papplPrinterSetDNSSDName(printer, value);
-	else if (!strcasecmp(line, "Location"))
-	  papplPrinterSetLocation(printer, value);
-	else if (!strcasecmp(line, "GeoLocation"))
-	  papplPrinterSetGeoLocation(printer, value);
-	else if (!strcasecmp(line, "Organization"))
-	  papplPrinterSetOrganization(printer, value);
-	else if (!strcasecmp(line, "OrganizationalUnit"))
-	  papplPrinterSetOrganizationalUnit(printer, value);
-	else if (!strcasecmp(line, "Contact"))
-	{
-	  pappl_contact_t	contact;// "printer-contact" value
-
-	  parse_contact(value, &contact);
-	  papplPrinterSetContact(printer, &contact);
-	}
-	else if (!strcasecmp(line, "PrintGroup"))
-	  papplPrinterSetPrintGroup(printer, value);
-	else if (!strcasecmp(line, "MaxActiveJobs"))
-	  papplPrinterSetMaxActiveJobs(printer, atoi(value));
-	else if (!strcasecmp(line, "MaxCompletedJobs"))
-	  papplPrinterSetMaxCompletedJobs(printer, atoi(value));
-	else if (!strcasecmp(line, "NextJobId"))
-	  printer->next_job_id = atoi(value);
-	else if (!strcasecmp(line, "ImpressionsCompleted"))
-	  printer->impcompleted = atoi(value);
-	else if (!strcasecmp(line, "identify-actions-default"))
-	  printer->psdriver.driver_data.identify_default = _papplIdentifyActionsValue(value);
-	else if (!strcasecmp(line, "label-mode-configured"))
-	  printer->psdriver.driver_data.mode_configured = _papplLabelModeValue(value);
-	else if (!strcasecmp(line, "label-tear-offset-configured"))
-	  printer->psdriver.driver_data.tear_offset_configured = atoi(value);
-	else if (!strcasecmp(line, "media-col-default"))
-	  parse_media_col(value, &printer->psdriver.driver_data.media_default);
-	else if (!strncasecmp(line, "media-col-ready", 15))
-	{
-	  if ((i = atoi(line + 15)) >= 0 && i < PAPPL_MAX_SOURCE)
-	    parse_media_col(value, printer->psdriver.driver_data.media_ready + i);
-	}
-	else if (!strcasecmp(line, "orientation-requested-default"))
-	  printer->psdriver.driver_data.orient_default = (ipp_orient_t)ippEnumValue("orientation-requested", value);
-	else if (!strcasecmp(line, "output-bin-default"))
-	{
-	  for (i = 0; i < printer->psdriver.driver_data.num_bin; i ++)
-	  {
-	    if (!strcmp(value, printer->psdriver.driver_data.bin[i]))
-	    {
-	      printer->psdriver.driver_data.bin_default = i;
-	      break;
-	    }
-	  }
-	}
-	else if (!strcasecmp(line, "print-color-mode-default"))
-	  printer->psdriver.driver_data.color_default = _papplColorModeValue(value);
-	else if (!strcasecmp(line, "print-content-optimize-default"))
-	  printer->psdriver.driver_data.content_default = _papplContentValue(value);
-	else if (!strcasecmp(line, "print-darkness-default"))
-	  printer->psdriver.driver_data.darkness_default = atoi(value);
-	else if (!strcasecmp(line, "print-quality-default"))
-	  printer->psdriver.driver_data.quality_default = (ipp_quality_t)ippEnumValue("print-quality", value);
-	else if (!strcasecmp(line, "print-scaling-default"))
-	  printer->psdriver.driver_data.scaling_default = _papplScalingValue(value);
-	else if (!strcasecmp(line, "print-speed-default"))
-	  printer->psdriver.driver_data.speed_default = atoi(value);
-	else if (!strcasecmp(line, "printer-darkness-configured"))
-	  printer->psdriver.driver_data.darkness_configured = atoi(value);
-	else if (!strcasecmp(line, "printer-resolution-default") && value)
-	  sscanf(value, "%dx%ddpi", &printer->psdriver.driver_data.x_default, &printer->psdriver.driver_data.y_default);
-	else if (!strcasecmp(line, "sides-default"))
-	  printer->psdriver.driver_data.sides_default = _papplSidesValue(value);
-        else if ((ptr = strstr(line, "-default")) != NULL)
-        {
-          char	defname[128],		// xxx-default name
-	      	supname[128];		// xxx-supported name
-	  ipp_attribute_t *attr;	// Attribute
-
-          *ptr = '\0';
-
-          snprintf(defname, sizeof(defname), "%s-default", line);
-          snprintf(supname, sizeof(supname), "%s-supported", line);
-
-          if (!value)
-            value = "";
-
-	  ippDeleteAttribute(printer->driver_attrs, ippFindAttribute(printer->driver_attrs, defname, IPP_TAG_ZERO));
-
-          if ((attr = ippFindAttribute(printer->driver_attrs, supname, IPP_TAG_ZERO)) != NULL)
-          {
-            switch (ippGetValueTag(attr))
-            {
-              case IPP_TAG_BOOLEAN :
-                  ippAddBoolean(printer->driver_attrs, IPP_TAG_PRINTER, defname, !strcmp(value, "true"));
-                  break;
-
-              case IPP_TAG_INTEGER :
-              case IPP_TAG_RANGE :
-                  ippAddInteger(printer->driver_attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, defname, atoi(value));
-                  break;
-
-              case IPP_TAG_KEYWORD :
-		  ippAddString(printer->driver_attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, defname, NULL, value);
-                  break;
-
-              default :
-                  break;
-            }
-	  }
-          else
-          {
-            ippAddString(printer->driver_attrs, IPP_TAG_PRINTER, IPP_TAG_TEXT, defname, NULL, value);
-          }
-        }
-	else if (!strcasecmp(line, "Job") && value)
-	{
-	  // Read printer job
-	  pappl_job_t	*job;		// Current Job
-	  struct stat	jobbuf;		// Job file buffer
-	  const char	*job_name,	// Job name
-			*job_id,	// Job ID
-			*job_username,	// Job username
-			*job_format,	// Job format
-			*job_value;	// Job option value
+  // Make sure the records are on disk before reporting success...
+  if (cupsFileFlush(fp) || fsync(cupsFileNumber(fp)))
+    ret = false;
 
-	  num_options = cupsParseOptions(value, 0, &options);
-
-	  if ((job_id = cupsGetOption("id", num_options, options)) == NULL || atoi(job_id) <= 0 || (job_name = cupsGetOption("name", num_options, options)) == NULL || (job_username = cupsGetOption("username", num_options, options)) == NULL || (job_format = cupsGetOption("format", num_options, options)) == NULL)
-	  {
-	    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Bad Job definition on line %d of '%s'.", linenum, filename);
-	    break;
-	  }
-
-	  if ((job = _papplJobCreate(printer, atoi(job_id), job_username, job_format, job_name, NULL)) == NULL)
-	  {
-	    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Error creating job %s for printer %s", job_name, printer->name);
-	    break;
-	  }
-
-	  if ((job_value = cupsGetOption("filename", num_options, options)) != NULL)
-	    job->filename = strdup(job_value);
-	  if ((job_value = cupsGetOption("state", num_options, options)) != NULL)
-	    job->state = (ipp_jstate_t)atoi(job_value);
-	  if ((job_value = cupsGetOption("state_reasons", num_options, options)) != NULL)
-	    job->state_reasons = (ipp_jstate_t)atoi(job_value);
-	  if ((job_value = cupsGetOption("created", num_options, options)) != NULL)
-	    job->created = atol(job_value);
-	  if ((job_value = cupsGetOption("processing", num_options, options)) != NULL)
-	    job->processing = atol(job_value);
-	  if ((job_value = cupsGetOption("completed", num_options, options)) != NULL)
-	    job->completed = atol(job_value);
-	  if ((job_value = cupsGetOption("impressions", num_options, options)) != NULL)
-	    job->impressions = atoi(job_value);
-	  if ((job_value = cupsGetOption("imcompleted", num_options, options)) != NULL)
-	    job->impcompleted = atoi(job_value);
-
-	  // Add the job to printer completed jobs array...
-	  if (job->state < IPP_JSTATE_STOPPED)
-	  {
-	    // Load the file attributes from the spool directory...
-	    int		attr_fd;	// Attribute file descriptor
-	    char	job_attr_filename[256];		// Attribute filename
-
-	    if ((attr_fd = papplJobOpenFile(job, job_attr_filename, sizeof(job_attr_filename), system->directory, "ipp", "r")) < 0)
-	    {
-	      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to open file for job attributes: '%s'.", job_attr_filename);
-	      continue;
-	    }
-
-	    ippReadFile(attr_fd, job->attrs);
-	    close(attr_fd);
-
-	    if (!job->filename || stat(job->filename, &jobbuf))
-	    {
-	      // If file removed, then set job state to aborted...
-	      job->state = IPP_JSTATE_ABORTED;
-	    }
-	    else
-	    {
-	      // Add the job to printer active jobs array...
-	      cupsArrayAdd(printer->active_jobs, job);
-	    }
-	  }
-	  else
-	  {
-	    // Add job to printer completed jobs...
-	    cupsArrayAdd(printer->completed_jobs, job);
-	  }
-	}
-	else
-	  papplLog(system, PAPPL_LOGLEVEL_WARN, "Unknown printer directive '%s' on line %d of '%s'.", line, linenum, filename);
-      }
+  if (cupsFileClose(fp))
+    ret = false;
 
-      // Loaded all printer attributes, call the status callback (if any) to
-      // update the current printer state...
-      if (printer && printer->psdriver.driver_data.status_cb)
-        (printer->psdriver.driver_data.status_cb)(printer);
-    }
-    else
-    {
-      papplLog(system, PAPPL_LOGLEVEL_WARN, "Unknown directive '%s' on line %d of '%s'.", line, linenum, filename);
-    }
+  if (!ret)
+  {
+    // The journal can no longer be trusted, force a full snapshot...
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to write system state journal '%s': %s", journame, strerror(errno));
+    system->journal_ok = false;
   }
 
-  cupsFileClose(fp);
-
-  return (true);
+  return (ret);
 }
 
 
 //
-// 'papplSystemSaveState()' - Save the current system state.
-//
-// This function saves the current system state to a file.  It is typically
-// used with the @link papplSystemSetSaveCallback@ function to periodically
-// save the state:
+// 'save_snapshot()' - Save the full system state.
 //
-// ```
-// |papplSystemSetSaveCallback(system, (pappl_save_cb_t)papplSystemSaveState,
-// |    (void *)filename);
-// ```
+// The state is written to a temporary file that replaces the old state file
+// when complete.  The caller must hold the state mutex.  The system read lock
+// is only held while the state is formatted, not while it is synced to disk.
 //
 
-bool					// O - `true` on success, `false` on failure
-papplSystemSaveState(
-    pappl_system_t *system,		// I - System
-    const char     *filename)		// I - File to save
+static bool				// O - `true` on success, `false` on failure
+save_snapshot(pappl_system_t *system,	// I - System
+              const char     *filename,	// I - State filename
+              const char     *journame)	// I - Journal filename
 {
   int			i;		// Looping var
   cups_file_t		*fp;		// Output file
+  char			tempname[1024];	// Temporary filename
   pappl_printer_t	*printer;	// Current printer
   pappl_job_t		*job;		// Current Job
+  bool			ret = true;	// Return value
+
 
+  snprintf(tempname, sizeof(tempname), "%s.tmp", filename);
 
-  if ((fp = cupsFileOpen(filename, "w")) == NULL)
+  if ((fp = cupsFileOpen(tempname, "w")) == NULL)
   {
-    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create system state file '%s': %s", filename, cupsLastErrorString());
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create system state file '%s': %s", tempname, cupsLastErrorString());
     return (false);
   }
 
   papplLog(system, PAPPL_LOGLEVEL_INFO, "Saving system state to '%s'.", filename);
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   if (system->dns_sd_name)
     cupsFilePutConf(fp, "DNSSDName", system->dns_sd_name);
@@ -491,194 +1081,165 @@ papplSystemSaveState(
 	      	defvalue[1024];		// xxx-default value
 
       snprintf(defname, sizeof(defname), "%s-default", printer->psdriver.driver_data.vendor[i]);
-      ippAttributeString(ippFindAttribute(printer->driver_attrs, defname, IPP_TAG_ZERO), defvalue, sizeof(defvalue));
+      ippAttributeString(ippFindAttribute(_papplPrinterGetDriverAttrs(printer), defname, IPP_TAG_ZERO), defvalue, sizeof(defvalue));
 
       cupsFilePutConf(fp, defname, defvalue);
     }
 
-    for (job = (pappl_job_t *)cupsArrayFirst(printer->all_jobs); job; job = (pappl_job_t *)cupsArrayNext(printer->all_jobs))
-    {
-      // Add basic job attributes...
-      num_options = 0;
-      num_options = cupsAddIntegerOption("id", job->job_id, num_options, &options);
-      num_options = cupsAddOption("name", job->name, num_options, &options);
-      num_options = cupsAddOption("username", job->username, num_options, &options);
-      num_options = cupsAddOption("format", job->format, num_options, &options);
-
-      if (job->filename)
-        num_options = cupsAddOption("filename", job->filename, num_options, &options);
-      if (job->state)
-        num_options = cupsAddIntegerOption("state", (int)job->state, num_options, &options);
-      if (job->state_reasons)
-        num_options = cupsAddIntegerOption("state_reasons", (int)job->state_reasons, num_options, &options);
-      if (job->created)
-        num_options = cupsAddIntegerOption("created", (int)job->created, num_options, &options);
-      if (job->processing)
-        num_options = cupsAddIntegerOption("processing", (int)job->processing, num_options, &options);
-      if (job->completed)
-        num_options = cupsAddIntegerOption("completed", (int)job->completed, num_options, &options);
-      if (job->impressions)
-        num_options = cupsAddIntegerOption("impressions", job->impressions, num_options, &options);
-      if (job->impcompleted)
-        num_options = cupsAddIntegerOption("imcompleted", job->impcompleted, num_options, &options);
-
-      if (job->attrs)
-      {
-	int	attr_fd;		// Attribute file descriptor
-	char	job_attr_filename[1024];// Attribute filename
+    _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+    for (job = printer->all_jobs.first; job; job = _papplJobListNext(&printer->all_jobs, job))
+      write_job(system, fp, job, 0);
+    _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
 
-        // Save job attributes to file in spool directory...
-        if (job->state < IPP_JSTATE_STOPPED)
-        {
-          if ((attr_fd = papplJobOpenFile(job, job_attr_filename, sizeof(job_attr_filename), system->directory, "ipp", "w")) < 0)
-          {
-            papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create file for job attributes: '%s'.", job_attr_filename);
-            continue;
-          }
-
-          ippWriteFile(attr_fd, job->attrs);
-          close(attr_fd);
-        }
-        else
-        {
-          // If job completed or aborted, remove job-attributes file...
-          papplJobOpenFile(job, job_attr_filename, sizeof(job_attr_filename), system->directory, "ipp", "x");
-        }
-      }
+    cupsFilePuts(fp, "</Printer>\n");
+  }
 
-      write_options(fp, "Job", num_options, options);
-      cupsFreeOptions(num_options, options);
-    }
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
-    cupsFilePuts(fp, "</Printer>\n");
+  // Make sure the new state file is on disk before replacing the old one...
+  if (cupsFileFlush(fp) || fsync(cupsFileNumber(fp)))
+    ret = false;
+
+  if (cupsFileClose(fp))
+    ret = false;
+
+  if (!ret || rename(tempname, filename))
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to save system state file '%s': %s", filename, strerror(errno));
+    unlink(tempname);
+    return (false);
   }
 
-  pthread_rwlock_unlock(&system->rwlock);
+  // Make sure the rename is on disk too...
+  sync_directory(system, filename);
 
-  cupsFileClose(fp);
+  // The new state file includes all job changes, start a new journal...
+  unlink(journame);
+
+  system->journal_count = 0;
+  system->journal_ok    = true;
 
   return (true);
 }
 
 
 //
-// 'parse_contact()' - Parse a contact value.
+// 'split_line()' - Split a state file line into the directive and value.
 //
 
 static void
-parse_contact(char            *value,	// I - Value
-              pappl_contact_t *contact)	// O - Contact
+split_line(char *line,			// I - Line
+           char **value)		// O - Value portion of line
 {
-  int		i,			// Looping var
-		num_options;		// Number of options
-  cups_option_t	*options = NULL,	// Options
-		*option;		// Current option
+  char	*ptr;				// Pointer into line
 
 
-  memset(contact, 0, sizeof(pappl_contact_t));
-  num_options = cupsParseOptions(value, 0, &options);
+  *value = NULL;
 
-  for (i = num_options, option = options; i > 0; i --, option ++)
+  // If we have "something value" then split at the whitespace...
+  if ((ptr = strchr(line, ' ')) != NULL)
   {
-    if (!strcasecmp(option->name, "name"))
-      strlcpy(contact->name, option->value, sizeof(contact->name));
-    else if (!strcasecmp(option->name, "email"))
-      strlcpy(contact->email, option->value, sizeof(contact->email));
-    else if (!strcasecmp(option->name, "telephone"))
-      strlcpy(contact->telephone, option->value, sizeof(contact->telephone));
+    *ptr++ = '\0';
+    *value = ptr;
   }
 
-  cupsFreeOptions(num_options, options);
+  // Strip the trailing ">" for "<something value(s)>"
+  if (line[0] == '<' && *value && (ptr = *value + strlen(*value) - 1) >= *value && *ptr == '>')
+    *ptr = '\0';
 }
 
 
 //
-// 'parse_media_col()' - Parse a media-col value.
+// 'sync_directory()' - Flush the directory containing a file to disk.
 //
 
 static void
-parse_media_col(
-    char              *value,		// I - Value
-    pappl_media_col_t *media)		// O - Media collection
+sync_directory(pappl_system_t *system,	// I - System
+               const char     *filename)// I - Filename
 {
-  int		i,			// Looping var
-		num_options;		// Number of options
-  cups_option_t	*options = NULL,	// Options
-		*option;		// Current option
+  char		dirname[1024],		// Directory name
+		*ptr;			// Pointer into directory name
+  int		fd;			// Directory file descriptor
 
 
-  memset(media, 0, sizeof(pappl_media_col_t));
-  num_options = cupsParseOptions(value, 0, &options);
+  strlcpy(dirname, filename, sizeof(dirname));
+  if ((ptr = strrchr(dirname, '/')) == NULL)
+    strlcpy(dirname, ".", sizeof(dirname));
+  else if (ptr == dirname)
+    ptr[1] = '\0';
+  else
+    *ptr = '\0';
 
-  for (i = num_options, option = options; i > 0; i --, option ++)
+  if ((fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
   {
-    if (!strcasecmp(option->name, "bottom"))
-      media->bottom_margin = atoi(option->value);
-    else if (!strcasecmp(option->name, "left"))
-      media->left_margin = atoi(option->value);
-    else if (!strcasecmp(option->name, "right"))
-      media->right_margin = atoi(option->value);
-    else if (!strcasecmp(option->name, "name"))
-      strlcpy(media->size_name, option->value, sizeof(media->size_name));
-    else if (!strcasecmp(option->name, "width"))
-      media->size_width = atoi(option->value);
-    else if (!strcasecmp(option->name, "length"))
-      media->size_length = atoi(option->value);
-    else if (!strcasecmp(option->name, "source"))
-      strlcpy(media->source, option->value, sizeof(media->source));
-    else if (!strcasecmp(option->name, "top"))
-      media->top_margin = atoi(option->value);
-    else if (!strcasecmp(option->name, "offset"))
-      media->top_offset = atoi(option->value);
-    else if (!strcasecmp(option->name, "tracking"))
-      media->tracking = _papplMediaTrackingValue(option->value);
-    else if (!strcasecmp(option->name, "type"))
-      strlcpy(media->type, option->value, sizeof(media->type));
+    papplLog(system, PAPPL_LOGLEVEL_WARN, "Unable to open directory '%s': %s", dirname, strerror(errno));
+    return;
   }
 
-  cupsFreeOptions(num_options, options);
+  if (fsync(fd))
+    papplLog(system, PAPPL_LOGLEVEL_WARN, "Unable to sync directory '%s': %s", dirname, strerror(errno));
+
+  close(fd);
 }
 
 
 //
-// 'read_line()' - Read a line from the state file.
+// 'trim_journal()' - Remove a partial record from the end of the journal.
 //
-// This function is like `cupsFileGetConf`, except that it doesn't support
-// comments since the state files are not meant to be edited or maintained by
-// humans.
+// A crash while appending to the journal can leave an incomplete last line,
+// which is truncated so that new records start on a line of their own.
 //
 
-static char *				// O  - Line or `NULL` on EOF
-read_line(cups_file_t *fp,		// I  - File
-          char        *line,		// I  - Line buffer
-          size_t      linesize,		// I  - Size of line buffer
-          char        **value,		// O  - Value portion of line
-          int         *linenum)		// IO - Current line number
+static void
+trim_journal(pappl_system_t *system,	// I - System
+             const char     *journame)	// I - Journal filename
 {
-  char	*ptr;				// Pointer into line
+  int		fd;			// Journal file descriptor
+  struct stat	fileinfo;		// Journal file information
+  char		buffer[1024];		// Read buffer
+  off_t		pos,			// Current position
+		end = 0;		// End of last complete record
+  ssize_t	i,			// Looping var
+		bytes = 0;		// Bytes read
 
 
-  // Try reading a line from the file...
-  *value = NULL;
+  if ((fd = open(journame, O_RDWR | O_NOFOLLOW | O_CLOEXEC)) < 0)
+    return;
 
-  if (!cupsFileGets(fp, line, linesize))
-    return (NULL);
+  if (!fstat(fd, &fileinfo) && fileinfo.st_size > 0)
+  {
+    // Scan backwards for the last newline...
+    for (pos = fileinfo.st_size; pos > 0 && !end; pos -= bytes)
+    {
+      bytes = pos > (off_t)sizeof(buffer) ? (ssize_t)sizeof(buffer) : (ssize_t)pos;
 
-  // Got it, bump the line number...
-  (*linenum) ++;
+      if (pread(fd, buffer, (size_t)bytes, pos - bytes) != bytes)
+      {
+        // Unable to read, leave the journal alone...
+        end = fileinfo.st_size;
+        break;
+      }
 
-  // If we have "something value" then split at the whitespace...
-  if ((ptr = strchr(line, ' ')) != NULL)
-  {
-    *ptr++ = '\0';
-    *value = ptr;
-  }
+      for (i = bytes - 1; i >= 0; i --)
+      {
+        if (buffer[i] == '\n')
+        {
+          end = pos - bytes + i + 1;
+          break;
+        }
+      }
+    }
 
-  // Strip the trailing ">" for "<something value(s)>"
-  if (line[0] == '<' && *value && (ptr = *value + strlen(*value) - 1) >= *value && *ptr == '>')
-    *ptr = '\0';
+    if (end < fileinfo.st_size)
+    {
+      papplLog(system, PAPPL_LOGLEVEL_WARN, "Discarding incomplete record at the end of '%s'.", journame);
 
-  return (line);
+      if (ftruncate(fd, end))
+        papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to truncate '%s': %s", journame, strerror(errno));
+    }
+  }
+
+  close(fd);
 }
 
 
@@ -706,6 +1267,105 @@ write_contact(cups_file_t     *fp,	// I - File
 }
 
 
+//
+// 'write_job()' - Write a job record.
+//
+// The "printer_id" argument is non-zero for journal records, which also need
+// the printer they belong to.  The caller must hold the printer's job list
+// lock so the job cannot be deleted while it is written.
+//
+
+static void
+write_job(pappl_system_t *system,	// I - System
+          cups_file_t    *fp,		// I - File
+          pappl_job_t    *job,		// I - Job
+          int            printer_id)	// I - Printer ID or `0` for none
+{
+  int		num_options = 0;	// Number of options
+  cups_option_t	*options = NULL;	// Options
+
+
+  _papplRWLockRead(&job->rwlock, _PAPPL_LOCK_JOB);
+
+  // Add basic job attributes...
+  if (printer_id > 0)
+    num_options = cupsAddIntegerOption("printer", printer_id, num_options, &options);
+
+  num_options = cupsAddIntegerOption("id", job->job_id, num_options, &options);
+  num_options = cupsAddOption("name", job->name, num_options, &options);
+  num_options = cupsAddOption("username", job->username, num_options, &options);
+  num_options = cupsAddOption("format", job->format, num_options, &options);
+
+  if (job->filename && !job->spool_memory)
+    num_options = cupsAddOption("filename", job->filename, num_options, &options);
+  if (job->spool_compressed)
+    num_options = cupsAddOption("compressed", "true", num_options, &options);
+  if (job->state)
+    num_options = cupsAddIntegerOption("state", (int)job->state, num_options, &options);
+  if (job->state_reasons)
+    num_options = cupsAddIntegerOption("state_reasons", (int)job->state_reasons, num_options, &options);
+  if (job->created)
+    num_options = cupsAddIntegerOption("created", (int)job->created, num_options, &options);
+  if (job->processing)
+    num_options = cupsAddIntegerOption("processing", (int)job->processing, num_options, &options);
+  if (job->completed)
+    num_options = cupsAddIntegerOption("completed", (int)job->completed, num_options, &options);
+  if (job->impressions)
+    num_options = cupsAddIntegerOption("impressions", job->impressions, num_options, &options);
+  if (job->impcompleted)
+    num_options = cupsAddIntegerOption("imcompleted", job->impcompleted, num_options, &options);
+  if (printer_id > 0)
+    num_options = cupsAddIntegerOption("printer_imcompleted", job->printer->impcompleted, num_options, &options);
+
+  if (job->attrs)
+  {
+    int		attr_fd;		// Attribute file descriptor
+    char	job_attr_filename[1024],// Attribute filename
+		temp_filename[1024];	// Temporary attribute filename
+
+    // Save job attributes to file in spool directory...
+    if (job->state < IPP_JSTATE_STOPPED)
+    {
+      // Write a temporary file and rename it so the attributes file is always
+      // complete...
+      if ((attr_fd = papplJobOpenFile(job, temp_filename, sizeof(temp_filename), system->directory, "ipp.tmp", "w")) < 0)
+      {
+	papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create file for job attributes: '%s'.", temp_filename);
+	cupsFreeOptions(num_options, options);
+	_papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+	return;
+      }
+
+      ippSetState(job->attrs, IPP_STATE_IDLE);
+      ippWriteFile(attr_fd, job->attrs);
+      close(attr_fd);
+
+      strlcpy(job_attr_filename, temp_filename, sizeof(job_attr_filename));
+      job_attr_filename[strlen(job_attr_filename) - 4] = '\0';
+
+      if (rename(temp_filename, job_attr_filename))
+      {
+	papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create file for job attributes: '%s'.", job_attr_filename);
+	unlink(temp_filename);
+	cupsFreeOptions(num_options, options);
+	_papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+	return;
+      }
+    }
+    else
+    {
+      // If job completed or aborted, remove job-attributes file...
+      papplJobOpenFile(job, job_attr_filename, sizeof(job_attr_filename), system->directory, "ipp", "x");
+    }
+  }
+
+  _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+
+  write_options(fp, "Job", num_options, options);
+  cupsFreeOptions(num_options, options);
+}
+
+
 //
 // 'write_media_col()' - Write a media-col value...
 //
@@ -33,7 +33,7 @@ _papplSystemAddPrinter(
     int             printer_id)		// I - Printer ID or `0` for new
 {
   // Add the printer to the system...
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   if (printer_id)
     printer->printer_id = printer_id;
@@ -48,7 +48,7 @@ _papplSystemAddPrinter(
   if (!system->default_printer_id)
     system->default_printer_id = printer->printer_id;
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   _papplSystemConfigChanged(system);
 }
@@ -72,11 +72,14 @@ papplSystemFindPrinter(
   int			i,		// Current printer index
 			count;		// Printer count
   pappl_printer_t	*printer = NULL;// Matching printer
+  bool			debug;		// Log debugging messages?
 
 
+  debug = _papplLogEnabled(system, PAPPL_LOGCAT_SYSTEM, PAPPL_LOGLEVEL_DEBUG);
+
   papplLog(system, PAPPL_LOGLEVEL_DEBUG, "papplSystemFindPrinter(system, resource=\"%s\", printer_id=%d, device_uri=\"%s\")", resource, printer_id, device_uri);
 
-  pthread_rwlock_rdlock(&system->rwlock);
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   if (resource && (!strcmp(resource, "/") || !strcmp(resource, "/ipp/print") || (!strncmp(resource, "/ipp/print/", 11) && isdigit(resource[11] & 255))))
   {
@@ -95,7 +98,8 @@ papplSystemFindPrinter(
   {
     printer = (pappl_printer_t *)cupsArrayIndex(system->printers, i);
 
-    papplLog(system, PAPPL_LOGLEVEL_DEBUG, "papplSystemFindPrinter: printer '%s' - resource=\"%s\", printer_id=%d, device_uri=\"%s\"", printer->name, printer->resource, printer->printer_id, printer->device_uri);
+    if (debug)
+      papplLog(system, PAPPL_LOGLEVEL_DEBUG, "papplSystemFindPrinter: printer '%s' - resource=\"%s\", printer_id=%d, device_uri=\"%s\"", printer->name, printer->resource, printer->printer_id, printer->device_uri);
 
     if (resource && !strncasecmp(printer->resource, resource, printer->resourcelen) && (!resource[printer->resourcelen] || resource[printer->resourcelen] == '/'))
       break;
@@ -108,7 +112,7 @@ papplSystemFindPrinter(
   if (i >= count)
     printer = NULL;
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   papplLog(system, PAPPL_LOGLEVEL_DEBUG, "papplSystemFindPrinter: Returning %p(%s)", printer, printer ? printer->name : "none");
 
@@ -16,7 +16,10 @@
 //
 
 #  include "dnssd-private.h"
+#  include "job.h"
+#  include "log-private.h"
 #  include "system.h"
+#  include "trace-private.h"
 #  include <grp.h>
 
 
@@ -24,13 +27,79 @@
 // Constants...
 //
 
+#  define _PAPPL_MAX_AUTHCACHE	32	// Maximum number of cached authentication results
+#  define _PAPPL_MAX_EVENTS	256	// Maximum number of recent events
+#  define _PAPPL_MAX_JOURNAL	1000	// Maximum number of state journal records
 #  define _PAPPL_MAX_LISTENERS	32	// Maximum number of listener sockets
+#  define _PAPPL_MAX_SUBSCRIPTIONS	100	// Maximum number of event subscriptions
+#  define _PAPPL_MAX_USER_SUBSCRIPTIONS	20	// Maximum number of event subscriptions per user
+#  define _PAPPL_RESOURCE_HASH	256	// Size of resource hash table
 
 
 //
 // Types and structures...
 //
 
+typedef enum _pappl_event_e		// Printer and job events
+{
+  _PAPPL_EVENT_NONE = 0x0000,			// No event
+  _PAPPL_EVENT_JOB_PROGRESS = 0x0001,		// Job impressions changed
+  _PAPPL_EVENT_JOB_STATE_CHANGED = 0x0002,	// Job created, state, or reasons changed
+  _PAPPL_EVENT_PRINTER_CONFIG_CHANGED = 0x0004,	// Printer supplies or configuration changed
+  _PAPPL_EVENT_PRINTER_STATE_CHANGED = 0x0008,	// Printer state or reasons changed
+  _PAPPL_EVENT_JOB_COMPLETED = 0x0010		// Job completed, canceled, or aborted (subscriptions only)
+} _pappl_event_t;
+
+typedef struct _pappl_notify_s		// Event notification
+{
+  size_t		seq;			// Sequence number
+  time_t		time;			// Time of event
+  _pappl_event_t	event;			// Event
+  int			printer_id;		// Printer ID, if any
+  ipp_pstate_t		printer_state;		// "printer-state" value
+  pappl_preason_t	printer_reasons;	// "printer-state-reasons" bits
+  int			job_id;			// Job ID, if any
+  ipp_jstate_t		job_state;		// "job-state" value
+  pappl_jreason_t	job_reasons;		// "job-state-reasons" bits
+  int			job_impressions;	// "job-impressions-completed" value
+} _pappl_notify_t;
+
+typedef struct _pappl_subscription_s	// Event subscription
+{
+  int			subscription_id;	// "notify-subscription-id" value
+  int			printer_id;		// Printer ID or 0 for all
+  int			job_id;			// "notify-job-id" value or 0 for all
+  _pappl_event_t	mask;			// "notify-events" bits
+  char			username[256];		// "notify-subscriber-user-name" value
+  unsigned char		user_data[63];		// "notify-user-data" value
+  size_t		user_data_len;		// Length of "notify-user-data" value
+  int			lease;			// "notify-lease-duration" value
+  time_t		expire;			// Expiration time or 0 for none
+  size_t		start_seq,		// Last system event before subscription
+			last_seq;		// Last system event for subscription
+  int			num_events;		// "notify-sequence-number" of last event
+} _pappl_subscription_t;
+
+typedef struct _pappl_authcache_s	// Cached authentication result
+{
+  time_t		expire;			// Expiration time
+  char			username[256];		// Username
+  unsigned char		salt[16],		// Random salt
+			hash[32];		// SHA2-256 hash of salt + password
+  bool			valid;			// Were the username and password accepted?
+  gid_t			groups[32];		// Groups for user
+  int			num_groups;		// Number of groups
+} _pappl_authcache_t;
+
+typedef bool (*_pappl_auth_cb_t)(pappl_system_t *system, const char *username, const char *password, gid_t *groups, int *num_groups, void *data);
+					// Authentication callback (for testing)
+
+typedef struct _pappl_jchange_s	// Job change (state journal entry)
+{
+  int			printer_id,		// Printer ID
+			job_id;			// Job ID
+} _pappl_jchange_t;
+
 typedef struct _pappl_mime_filter_s	// MIME filter
 {
   const char		*src,			// Source MIME media type
@@ -41,6 +110,7 @@ typedef struct _pappl_mime_filter_s	// MIME filter
 
 typedef struct _pappl_resource_s	// Resource
 {
+  struct _pappl_resource_s *next;		// Next resource in hash bucket
   char			*path,			// Path
 			*format,		// Content type (MIME media type)
 			*filename,		// Filename
@@ -48,8 +118,10 @@ typedef struct _pappl_resource_s	// Resource
   time_t		last_modified;		// Last-Modified date/time
   const void		*data;			// Static data
   size_t		length;			// Length of file/data
+  bool			compress;		// Compress when the client supports it?
   pappl_resource_cb_t	cb;			// Dynamic callback
   void			*cbdata;		// Callback data
+  size_t		pathlen;		// Length of path
 } _pappl_resource_t;
 
 struct _pappl_system_s			// System data
@@ -59,10 +131,18 @@ struct _pappl_system_s			// System data
   bool			is_running;		// Is the system running?
   time_t		start_time,		// Startup time
 			config_time,		// Time of last config change
-			clean_time,		// Next clean time
 			shutdown_time;		// Shutdown requested?
-  size_t		config_changes,		// Number of configuration changes
-			save_changes;		// Number of saved changes
+  _Atomic time_t	clean_time;		// Next clean time
+  size_t		config_changes,		// Number of configuration changes (also under save_mutex)
+			save_changes,		// Number of saved changes
+			job_changes;		// Number of job changes (under journal_mutex)
+  pthread_mutex_t	journal_mutex;		// Mutex for state journal
+  cups_array_t		*journal;		// Job changes not yet journaled
+  pthread_mutex_t	state_mutex;		// Mutex for saving state (journal file and counts below)
+  bool			journal_ok;		// Can changes be appended to the journal?
+  size_t		journal_count,		// Number of records in journal file
+			state_config_changes,	// Configuration changes at last save
+			state_job_changes;	// Job changes at last save
   char			*uuid,			// "system-uuid" value
 			*name,			// "system-name" value
 			*dns_sd_name,		// "system-dns-sd-name" value
@@ -80,13 +160,33 @@ struct _pappl_system_s			// System data
   char			*directory;		// Spool directory
   char			*logfile;		// Log filename, if any
   int			logfd;			// Log file descriptor, if any
-  pappl_loglevel_t	loglevel;		// Log level
+  pappl_loglevel_t	loglevel,		// Log level
+			logcatlevels[_PAPPL_LOGCAT_MAX];
+						// Log level for each category, if any
+  atomic_uint		logmask;		// Enabled log levels, 5 bits per category
   size_t		logmaxsize;		// Maximum log file size or `0` for none
+  size_t		logsize;		// Current log file size
+  _pappl_logmsg_t	*logring;		// Ring of messages for log writer
+  atomic_size_t		loghead;		// Next ring position to fill
+  size_t		logtail;		// Next ring position to write
+  pthread_t		logtid;			// Log writer thread ID
+  bool			logstop;		// Stop the log writer thread?
+  atomic_bool		logwaiting;		// Is the log writer waiting for messages?
+  pthread_mutex_t	logwait_mutex;		// Mutex for log writer wakeups
+  pthread_cond_t	logwait_cond;		// Condition for log writer wakeups
+  _pappl_trhdr_t	*trace;			// Trace file header, if tracing
+  _pappl_trrec_t	*trace_records;		// Trace records
+  size_t		trace_size;		// Size of trace file mapping
   char			*subtypes;		// DNS-SD sub-types, if any
   bool			tls_only;		// Only support TLS?
   char			*auth_service;		// PAM authorization service, if any
   char			*admin_group;		// PAM administrative group, if any
   gid_t			admin_gid;		// PAM administrative group ID
+  pthread_mutex_t	auth_mutex;		// Mutex for authentication cache
+  _pappl_auth_cb_t	auth_cb;		// Authentication callback, if any (for testing)
+  void			*auth_cbdata;		// Authentication callback data
+  _pappl_authcache_t	auth_cache[_PAPPL_MAX_AUTHCACHE];
+						// Authentication cache
   char			*default_print_group;	// Default PAM printing group, if any
   char			session_key[65];	// Session key
   pthread_rwlock_t	session_rwlock;		// Reader/writer lock for the session key
@@ -94,8 +194,12 @@ struct _pappl_system_s			// System data
   int			num_listeners;		// Number of listener sockets
   struct pollfd		listeners[_PAPPL_MAX_LISTENERS];
 						// Listener sockets
+  int			wakeup_fd[2];		// Main loop wakeup eventfd or pipe
   cups_array_t		*links;			// Web navigation links
+  pthread_rwlock_t	resource_rwlock;	// Reader/writer lock for resources
   cups_array_t		*resources;		// Array of resources
+  _pappl_resource_t	*resource_hash[_PAPPL_RESOURCE_HASH];
+						// Hash table of resources
   cups_array_t		*filters;		// Array of filters
   int			next_client;		// Next client number
   cups_array_t		*printers;		// Array of printers
@@ -115,6 +219,37 @@ struct _pappl_system_s			// System data
   void			*op_cbdata;		// IPP operation callback data
   pappl_save_cb_t	save_cb;		// Save callback
   void			*save_cbdata;		// Save callback data
+  pthread_mutex_t	save_mutex;		// Mutex for save thread
+  pthread_cond_t	save_cond;		// Condition for save thread
+  pthread_t		save_tid;		// Save thread ID
+  bool			save_running;		// Is the save thread running?
+  int			save_delay;		// Delay before saving in milliseconds
+  size_t		save_count;		// Number of saves
+  double		save_total,		// Total save time in seconds
+			save_max;		// Maximum save time in seconds
+  int			idle_timeout;		// Keep-alive idle timeout in seconds
+  pthread_mutex_t	tls_mutex;		// Mutex for TLS statistics
+  size_t		tls_count,		// Number of TLS handshakes
+			tls_failures;		// Number of failed TLS handshakes
+  double		tls_total,		// Total TLS handshake time in seconds
+			tls_max;		// Maximum TLS handshake time in seconds
+  pthread_mutex_t	event_mutex;		// Mutex for events
+  pthread_cond_t	event_cond;		// Condition for new events
+  size_t		event_seq;		// Sequence number of last event
+  _pappl_notify_t	events[_PAPPL_MAX_EVENTS];
+						// Ring of recent events
+  cups_array_t		*subscriptions;		// Event subscriptions
+  int			next_subscription_id;	// Next "notify-subscription-id" value
+  pthread_mutex_t	raw_mutex;		// Mutex for raw socket sessions (before rwlock)
+  pthread_t		raw_tid;		// Raw socket thread ID
+  _Atomic bool		raw_running;		// Is the raw socket thread running?
+  int			raw_pipe[2];		// Raw socket thread wakeup pipe
+  cups_array_t		*raw_sessions;		// Raw socket print sessions
+  unsigned		raw_generation;		// Raw listener/session generation
+  pthread_mutex_t	spool_mutex;		// Mutex for in-memory spool accounting
+  size_t		spool_max_document,	// Maximum size of an in-memory document
+			spool_max_total,	// Maximum total size of in-memory documents
+			spool_used;		// Total size of in-memory documents
 #  ifdef HAVE_DNSSD
   _pappl_srv_t		dns_sd_ipps_ref,	// DNS-SD IPPS service
 			dns_sd_http_ref;	// DNS-SD HTTP service
@@ -123,7 +258,8 @@ struct _pappl_system_s			// System data
   _pappl_srv_t		dns_sd_ref;		// DNS-SD services
 #  endif // HAVE_DNSSD
   unsigned char		dns_sd_loc[16];		// DNS-SD LOC record data
-  bool			dns_sd_any_collision;	// Was there a name collision for any printer?
+  _Atomic bool		dns_sd_registering;	// Are the DNS-SD services being registered?
+  _Atomic bool		dns_sd_any_collision;	// Was there a name collision for any printer?
   bool			dns_sd_collision;	// Was there a name collision for this system?
   int			dns_sd_serial;		// DNS-SD serial number (for collisions)
   int			dns_sd_host_changes;	// Last count of DNS-SD host name changes
@@ -134,13 +270,36 @@ struct _pappl_system_s			// System data
 // Functions...
 //
 
+extern const char	*_papplEventString(_pappl_event_t event) _PAPPL_PRIVATE;
+extern void		_papplSubscriptionIPPCancel(pappl_client_t *client) _PAPPL_PRIVATE;
+extern void		_papplSubscriptionIPPCreate(pappl_client_t *client) _PAPPL_PRIVATE;
+extern void		_papplSubscriptionIPPGetAttributes(pappl_client_t *client) _PAPPL_PRIVATE;
+extern void		_papplSubscriptionIPPGetNotifications(pappl_client_t *client) _PAPPL_PRIVATE;
+extern void		_papplSubscriptionIPPRenew(pappl_client_t *client) _PAPPL_PRIVATE;
+extern void		_papplSystemAddEvent(pappl_system_t *system, pappl_printer_t *printer, pappl_job_t *job, _pappl_event_t event) _PAPPL_PRIVATE;
 extern void		_papplSystemAddPrinter(pappl_system_t *system, pappl_printer_t *printer, int printer_id) _PAPPL_PRIVATE;
 extern void		_papplSystemAddPrinterIcons(pappl_system_t *system, pappl_printer_t *printer) _PAPPL_PRIVATE;
+extern int		_papplSystemAddSubscription(pappl_system_t *system, _pappl_subscription_t *sub) _PAPPL_PRIVATE;
+extern int		_papplSystemAuthenticate(pappl_system_t *system, pappl_client_t *client, const char *username, const char *password, gid_t *groups, int *num_groups) _PAPPL_PRIVATE;
+extern bool		_papplSystemCancelSubscription(pappl_system_t *system, int subscription_id) _PAPPL_PRIVATE;
+extern void		_papplSystemClearAuthCache(pappl_system_t *system) _PAPPL_PRIVATE;
 extern void		_papplSystemCleanJobs(pappl_system_t *system) _PAPPL_PRIVATE;
 extern void		_papplSystemConfigChanged(pappl_system_t *system) _PAPPL_PRIVATE;
+extern void		_papplSystemConfigChangedNoLock(pappl_system_t *system) _PAPPL_PRIVATE;
+extern void		_papplSystemJobChanged(pappl_system_t *system, pappl_job_t *job) _PAPPL_PRIVATE;
+extern void		_papplSystemJobDeleted(pappl_system_t *system, int printer_id, int job_id) _PAPPL_PRIVATE;
 extern void		_papplSystemExportVersions(pappl_system_t *system, ipp_t *ipp, ipp_tag_t group_tag, cups_array_t *ra);
 extern _pappl_mime_filter_t *_papplSystemFindMIMEFilter(pappl_system_t *system, const char *srctype, const char *dsttype) _PAPPL_PRIVATE;
 extern _pappl_resource_t *_papplSystemFindResource(pappl_system_t *system, const char *path) _PAPPL_PRIVATE;
+extern size_t		_papplSystemGetEvents(pappl_system_t *system, size_t *since, int printer_id, _pappl_notify_t *events, size_t max, int msecs) _PAPPL_PRIVATE;
+extern int		_papplSystemGetNotifications(pappl_system_t *system, int subscription_id, int *first, _pappl_subscription_t *sub, _pappl_notify_t *events, _pappl_event_t *sub_events, int max) _PAPPL_PRIVATE;
+extern bool		_papplSystemRenewSubscription(pappl_system_t *system, int subscription_id, int lease) _PAPPL_PRIVATE;
+extern void		*_papplSystemRunRaw(pappl_system_t *system) _PAPPL_PRIVATE;
+extern void		_papplSystemSetAuthCallback(pappl_system_t *system, _pappl_auth_cb_t cb, void *data) _PAPPL_PRIVATE;
+extern void		_papplSystemScheduleCleanJobs(pappl_system_t *system, time_t cleantime) _PAPPL_PRIVATE;
+extern bool		_papplSystemWaitEvents(pappl_system_t *system, size_t seq, int msecs) _PAPPL_PRIVATE;
+extern void		_papplSystemWakeRaw(pappl_system_t *system) _PAPPL_PRIVATE;
+extern void		_papplSystemWakeup(pappl_system_t *system) _PAPPL_PRIVATE;
 extern char		*_papplSystemMakeUUID(pappl_system_t *system, const char *printer_name, int job_id, char *buffer, size_t bufsize) _PAPPL_PRIVATE;
 extern void		_papplSystemProcessIPP(pappl_client_t *client) _PAPPL_PRIVATE;
 extern bool		_papplSystemRegisterDNSSDNoLock(pappl_system_t *system) _PAPPL_PRIVATE;
@@ -150,7 +309,9 @@ extern void		_papplSystemWebAddPrinter(pappl_client_t *client, pappl_system_t *s
 extern void		_papplSystemWebAddScanner(pappl_client_t *client, pappl_system_t *system) _PAPPL_PRIVATE;
 extern void		_papplSystemWebConfig(pappl_client_t *client, pappl_system_t *system) _PAPPL_PRIVATE;
 extern void		_papplSystemWebConfigFinalize(pappl_system_t *system, int num_form, cups_option_t *form) _PAPPL_PRIVATE;
+extern void		_papplSystemWebEvents(pappl_client_t *client, pappl_system_t *system) _PAPPL_PRIVATE;
 extern void		_papplSystemWebHome(pappl_client_t *client, pappl_system_t *system) _PAPPL_PRIVATE;
+extern void		_papplSystemWebLogEvents(pappl_client_t *client, pappl_system_t *system) _PAPPL_PRIVATE;
 extern void		_papplSystemWebLogFile(pappl_client_t *client, pappl_system_t *system) _PAPPL_PRIVATE;
 extern void		_papplSystemWebLogs(pappl_client_t *client, pappl_system_t *system) _PAPPL_PRIVATE;
 extern void		_papplSystemWebNetwork(pappl_client_t *client, pappl_system_t *system) _PAPPL_PRIVATE;
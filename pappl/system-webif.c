@@ -36,6 +36,7 @@ typedef struct _pappl_system_dev_s	// System device callback data
 // Local functions...
 //
 
+static bool	log_filter(int num_form, cups_option_t *form, pappl_loglevel_t *level, char *match, size_t matchsize);
 static bool	system_device_cb(const char *device_info, const char *device_uri, const char *device_id, void *data);
 static void	system_footer(pappl_client_t *client);
 static void	system_header(pappl_client_t *client, const char *title);
@@ -800,6 +801,92 @@ _papplSystemWebConfigFinalize(
 }
 
 
+//
+// '_papplSystemWebEvents()' - Stream printer and job events as Server-Sent Events.
+//
+// The "printer" form variable limits the events to a single printer, while
+// "since" specifies the last event sequence number that was seen - by default
+// only new events are sent.  Each event uses its sequence number as its ID and
+// the event name ("job-progress", "job-state-changed", etc.) as its type, with
+// the current printer and job state as JSON data.
+//
+
+void
+_papplSystemWebEvents(
+    pappl_client_t *client,		// I - Client
+    pappl_system_t *system)		// I - System
+{
+  int			num_form;	// Number of form variables
+  cups_option_t		*form;		// Form variables
+  const char		*value;		// Form variable value
+  int			printer_id;	// Printer ID or 0 for all
+  size_t		since,		// Last event sequence number
+			i,		// Looping var
+			count;		// Number of events
+  _pappl_notify_t	events[32],	// Events
+			*n;		// Current event
+  char			buffer[1024];	// Event text
+  bool			ok = true;	// Still connected?
+
+
+  if (!papplClientHTMLAuthorize(client))
+    return;
+
+  if (client->operation != HTTP_STATE_GET)
+  {
+    papplClientRespond(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0, 0);
+    return;
+  }
+
+  // Get the printer and starting sequence number...
+  num_form = papplClientGetForm(client, &form);
+
+  if ((value = cupsGetOption("printer", num_form, form)) != NULL)
+    printer_id = (int)strtol(value, NULL, 10);
+  else
+    printer_id = 0;
+
+  if ((value = cupsGetOption("since", num_form, form)) != NULL)
+  {
+    since = (size_t)strtoull(value, NULL, 10);
+  }
+  else
+  {
+    pthread_mutex_lock(&system->event_mutex);
+    since = system->event_seq;
+    pthread_mutex_unlock(&system->event_mutex);
+  }
+
+  cupsFreeOptions(num_form, form);
+
+  if (!papplClientRespond(client, HTTP_STATUS_OK, NULL, "text/event-stream", 0, 0))
+    return;
+
+  // Send events until the client goes away or the system shuts down...
+  while (ok && system->is_running)
+  {
+    if ((count = _papplSystemGetEvents(system, &since, printer_id, events, sizeof(events) / sizeof(events[0]), 15000)) == 0)
+    {
+      // Send a comment to keep the connection alive and detect disconnects...
+      ok = httpWrite2(client->http, ":\n\n", 3) >= 0 && httpFlushWrite(client->http) >= 0;
+      continue;
+    }
+
+    for (i = count, n = events; ok && i > 0; i --, n ++)
+    {
+      snprintf(buffer, sizeof(buffer), "id: %lu\nevent: %s\ndata: {\"time\":%ld,\"printer-id\":%d,\"printer-state\":%d,\"printer-state-reasons\":%u,\"job-id\":%d,\"job-state\":%d,\"job-state-reasons\":%u,\"job-impressions-completed\":%d}\n\n", (unsigned long)n->seq, _papplEventString(n->event), (long)n->time, n->printer_id, (int)n->printer_state, (unsigned)n->printer_reasons, n->job_id, (int)n->job_state, (unsigned)n->job_reasons, n->job_impressions);
+      ok = httpWrite2(client->http, buffer, strlen(buffer)) >= 0;
+    }
+
+    if (ok)
+      ok = httpFlushWrite(client->http) >= 0;
+  }
+
+  if (ok)
+    httpWrite2(client->http, "", 0);
+}
+
+
 //
 // '_papplSystemWebHome()' - Show the system home page.
 //
@@ -839,9 +926,159 @@ _papplSystemWebHome(
 }
 
 
+//
+// '_papplSystemWebLogEvents()' - Stream new log lines as Server-Sent Events.
+//
+// The "since" form variable specifies the log file offset to start from,
+// while "tail" starts that many bytes from the end of the log - by default
+// only new lines are sent.  The "level", "printer", and "job" form variables
+// filter the lines that are sent.  Each event contains one or more log lines
+// and uses the following log file offset as its ID.
+//
+
+void
+_papplSystemWebLogEvents(
+    pappl_client_t *client,		// I - Client
+    pappl_system_t *system)		// I - System
+{
+  int			fd;		// Log file descriptor
+  struct stat		loginfo,	// Log file information
+			fileinfo;	// Current log file information
+  off_t			offset,		// Current offset in log file
+			prev;		// Previous offset in log file
+  int			num_form;	// Number of form variables
+  cups_option_t		*form;		// Form variables
+  const char		*value;		// Form variable value
+  pappl_loglevel_t	level;		// Minimum log level
+  char			match[256],	// String to match
+			buffer[16384],	// Log lines
+			*line,		// Current line
+			*next,		// Next line
+			*end;		// End of lines
+  size_t		bytes;		// Bytes in buffer
+  bool			ok = true;	// Still connected?
+
+
+  if (!papplClientHTMLAuthorize(client))
+    return;
+
+  if (client->operation != HTTP_STATE_GET)
+  {
+    papplClientRespond(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0, 0);
+    return;
+  }
+
+  if ((fd = open(system->logfile, O_RDONLY)) < 0 || fstat(fd, &loginfo))
+  {
+    papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to open log file '%s': %s", system->logfile, strerror(errno));
+    papplClientRespond(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0, 0);
+    if (fd >= 0)
+      close(fd);
+    return;
+  }
+
+  // Get the starting offset and filters...
+  num_form = papplClientGetForm(client, &form);
+
+  log_filter(num_form, form, &level, match, sizeof(match));
+
+  if ((value = cupsGetOption("since", num_form, form)) != NULL)
+  {
+    if ((offset = (off_t)strtoll(value, NULL, 10)) < 0 || offset > loginfo.st_size)
+      offset = 0;
+  }
+  else if ((value = cupsGetOption("tail", num_form, form)) != NULL && (offset = loginfo.st_size - (off_t)strtoll(value, NULL, 10)) > 0)
+  {
+    // Start at the beginning of the next line...
+    ssize_t	rbytes;			// Bytes read
+
+    if ((rbytes = pread(fd, buffer, sizeof(buffer), offset)) > 0 && (line = memchr(buffer, '\n', (size_t)rbytes)) != NULL)
+      offset += line - buffer + 1;
+  }
+  else if (!value)
+  {
+    offset = loginfo.st_size;
+  }
+  else
+  {
+    offset = 0;
+  }
+
+  cupsFreeOptions(num_form, form);
+
+  if (!papplClientRespond(client, HTTP_STATUS_OK, NULL, "text/event-stream", 0, 0))
+  {
+    close(fd);
+    return;
+  }
+
+  // Send log lines until the client goes away or the system shuts down...
+  while (ok && system->is_running)
+  {
+    prev  = offset;
+    bytes = _papplLogTail(fd, &offset, level, match[0] ? match : NULL, buffer, sizeof(buffer));
+
+    if (offset != prev)
+    {
+      if (bytes > 0)
+      {
+        char	id[32];			// Event ID
+
+        snprintf(id, sizeof(id), "id: %ld\n", (long)offset);
+        ok = httpWrite2(client->http, id, strlen(id)) >= 0;
+
+        for (line = buffer, end = buffer + bytes; ok && line < end; line = next)
+        {
+          if ((next = memchr(line, '\n', (size_t)(end - line))) == NULL)
+            next = end;
+
+          ok = httpWrite2(client->http, "data: ", 6) >= 0 && httpWrite2(client->http, line, (size_t)(next - line)) >= 0 && httpWrite2(client->http, "\n", 1) >= 0;
+
+          if (next < end)
+            next ++;
+        }
+
+        if (ok)
+          ok = httpWrite2(client->http, "\n", 1) >= 0;
+      }
+      continue;
+    }
+
+    // Caught up, send what we have and wait for more...
+    if (httpFlushWrite(client->http) < 0)
+      break;
+
+    if (!_papplLogWait(system, offset, 15000))
+    {
+      // Send a comment to keep the connection alive and detect disconnects...
+      ok = httpWrite2(client->http, ":\n\n", 3) >= 0 && httpFlushWrite(client->http) >= 0;
+    }
+    else if (stat(system->logfile, &fileinfo) || fileinfo.st_ino != loginfo.st_ino || fileinfo.st_size < offset)
+    {
+      // Log file was rotated, start over with the new one...
+      close(fd);
+
+      if ((fd = open(system->logfile, O_RDONLY)) < 0 || fstat(fd, &loginfo))
+        break;
+
+      offset = 0;
+    }
+  }
+
+  if (fd >= 0)
+    close(fd);
+
+  if (ok)
+    httpWrite2(client->http, "", 0);
+}
+
+
 //
 // '_papplSystemWebLogFile()' - Return the log file as requested
 //
+// The "level", "printer", and "job" form variables filter the lines that are
+// sent.
+//
 
 void
 _papplSystemWebLogFile(
@@ -859,10 +1096,21 @@ _papplSystemWebLogFile(
     size_t		length = 0;	// Log length
     const char		*value;		// Range Field value
     char		*rangeptr;	// Pointer into range...
-    char		buffer[8192];	// Copy buffer
+    char		buffer[32768];	// Copy buffer
     int			fd;		// Resource file descriptor
     long		low = 0,	// Log lower range
 			high = -1;	// Log upper range
+    off_t		offset,		// Current offset in log
+			prev;		// Previous offset in log
+    int			num_form;	// Number of form variables
+    cups_option_t	*form;		// Form variables
+    pappl_loglevel_t	level;		// Minimum log level
+    char		match[256];	// String to match
+    bool		filtered;	// Filter log lines?
+
+    num_form = papplClientGetForm(client, &form);
+    filtered = log_filter(num_form, form, &level, match, sizeof(match));
+    cupsFreeOptions(num_form, form);
 
     value = httpGetField(client->http, HTTP_FIELD_RANGE);
 
@@ -887,6 +1135,7 @@ _papplSystemWebLogFile(
     {
       papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to access log file '%s': %s", system->logfile, strerror(errno));
       papplClientRespond(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0, 0);
+      close(fd);
       return;
     }
 
@@ -908,31 +1157,46 @@ _papplSystemWebLogFile(
       code   = HTTP_STATUS_PARTIAL_CONTENT;
     }
 
-    httpSetLength(client->http, length);
+    // Filtered logs don't have a known length...
+    httpSetLength(client->http, filtered ? 0 : length);
     httpSetField(client->http, HTTP_FIELD_SERVER, papplSystemGetServerHeader(system));
     httpSetField(client->http, HTTP_FIELD_CONTENT_TYPE, "text/plain");
 
-    // Seek to position low in log
-    if (lseek(fd, (off_t)low, SEEK_CUR) < 0)
+    if (httpWriteResponse(client->http, code) < 0)
     {
-      papplLogClient(client, PAPPL_LOGLEVEL_ERROR, "Unable to seek to offset %ld in log file '%s': %s", low, system->logfile, strerror(errno));
-      papplClientRespond(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0, 0);
+      close(fd);
       return;
     }
 
-    if (httpWriteResponse(client->http, code) < 0)
-      return;
-
     papplLogClient(client, PAPPL_LOGLEVEL_INFO, "%s %s %d", code == HTTP_STATUS_OK ? "OK" : "Partial Content", "text/plain", (int)length);
 
-    // Read buffer and write to client
-    while (length > 0 && (bytes = read(fd, buffer, sizeof(buffer))) > 0)
+    // Read buffer and write to client, using pread so no seeking is needed...
+    offset = (off_t)low;
+
+    if (filtered)
     {
-      if ((size_t)bytes > length)
-        bytes = (ssize_t)length;
+      while (length > 0)
+      {
+        prev  = offset;
+        bytes = (ssize_t)_papplLogTail(fd, &offset, level, match[0] ? match : NULL, buffer, length < sizeof(buffer) ? length : sizeof(buffer));
 
-      length -= (size_t)bytes;
-      httpWrite2(client->http, buffer, (size_t)bytes);
+        if (offset == prev)
+          break;
+
+        length -= (size_t)(offset - prev);
+
+        if (bytes > 0)
+          httpWrite2(client->http, buffer, (size_t)bytes);
+      }
+    }
+    else
+    {
+      while (length > 0 && (bytes = pread(fd, buffer, length < sizeof(buffer) ? length : sizeof(buffer), offset)) > 0)
+      {
+        length -= (size_t)bytes;
+        offset += bytes;
+        httpWrite2(client->http, buffer, (size_t)bytes);
+      }
     }
 
     httpWrite2(client->http, "", 0);
@@ -1035,27 +1299,20 @@ _papplSystemWebLogs(
 		      "        </form>\n"
 		      "        <div class=\"log\" id=\"logdiv\"><pre id=\"log\"></pre></div>\n"
 		      "        <script>\n"
-		      "var content_length = 0;\n"
+		      "var log_since = -1;\n"
 		      "function update_log() {\n"
-		      "  let xhr = new XMLHttpRequest();\n"
-		      "  xhr.open('GET', '/logfile.txt');\n"
-		      "  xhr.setRequestHeader('Range', 'bytes=' + content_length + '-');\n"
-		      "  xhr.send();\n"
-		      "  xhr.onreadystatechange = function() {\n"
-		      "    var log = document.getElementById('log');\n"
-		      "    var logdiv = document.getElementById('logdiv');\n"
-		      "    if (xhr.readyState != 4) return;\n"
-		      "    if (xhr.status == 200) {\n"
-		      "      log.innerText = xhr.response;\n"
-		      "      content_length = xhr.getResponseHeader('Content-Length');\n"
-		      "    }\n"
-		      "    else if (xhr.status == 206) {\n"
-		      "       log.innerText += xhr.response;\n"
-		      "       content_length += xhr.getResponseHeader('Content-Length');\n"
-		      "    }\n"
-		      "    window.setTimeout('update_log()', 5000);\n"
+		      "  let events = new EventSource(log_since < 0 ? '/logevents?tail=65536' : '/logevents?since=' + log_since);\n"
+		      "  events.onmessage = function(e) {\n"
+		      "    let log = document.getElementById('log');\n"
+		      "    let logdiv = document.getElementById('logdiv');\n"
+		      "    log.appendChild(document.createTextNode(e.data + '\\n'));\n"
+		      "    log_since = e.lastEventId;\n"
 		      "    logdiv.scrollTop = logdiv.scrollHeight - logdiv.clientHeight;\n"
 		      "  }\n"
+		      "  events.onerror = function() {\n"
+		      "    events.close();\n"
+		      "    window.setTimeout(update_log, 5000);\n"
+		      "  }\n"
 		      "}\n"
 		      "update_log();</script>\n");
 
@@ -1715,6 +1972,54 @@ _papplSystemWebTLSNew(
 #endif // HAVE_GNUTLS
 
 
+//
+// 'log_filter()' - Get the log filter from form variables.
+//
+
+static bool				// O - `true` if lines are filtered, `false` otherwise
+log_filter(int              num_form,	// I - Number of form variables
+           cups_option_t    *form,	// I - Form variables
+           pappl_loglevel_t *level,	// O - Minimum log level
+           char             *match,	// I - String to match
+           size_t           matchsize)	// I - Size of string to match
+{
+  const char	*value;			// Form variable value
+  static const char * const levels[] =	// Log level names
+  {
+    "debug",
+    "info",
+    "warn",
+    "error",
+    "fatal"
+  };
+
+
+  *level   = PAPPL_LOGLEVEL_DEBUG;
+  match[0] = '\0';
+
+  if ((value = cupsGetOption("level", num_form, form)) != NULL)
+  {
+    pappl_loglevel_t	i;		// Looping var
+
+    for (i = PAPPL_LOGLEVEL_DEBUG; i <= PAPPL_LOGLEVEL_FATAL; i ++)
+    {
+      if (!strcmp(value, levels[i]))
+      {
+        *level = i;
+        break;
+      }
+    }
+  }
+
+  if ((value = cupsGetOption("job", num_form, form)) != NULL)
+    snprintf(match, matchsize, "[Job %d]", atoi(value));
+  else if ((value = cupsGetOption("printer", num_form, form)) != NULL)
+    snprintf(match, matchsize, "[Printer %s]", value);
+
+  return (*level > PAPPL_LOGLEVEL_DEBUG || match[0]);
+}
+
+
 //
 // 'system_device_cb()' - Device callback for the "add printer" chooser.
 //
@@ -15,6 +15,9 @@
 #include "pappl-private.h"
 #include "resource-private.h"
 #include "device-private.h"
+#ifdef __linux
+#  include <sys/eventfd.h>
+#endif // __linux
 
 
 //
@@ -23,15 +26,25 @@
 
 static bool	shutdown_system = false;// Shutdown system?
 static bool	restart_logging = false;// Restart logging?
+static int	wakeup_fd = -1;		// Main loop wakeup descriptor for signals
 
 
 //
 // Local functions...
 //
 
+static int	compare_jchanges(_pappl_jchange_t *a, _pappl_jchange_t *b);
+static _pappl_jchange_t *copy_jchange(_pappl_jchange_t *change);
+static int	get_timeout(pappl_system_t *system);
+static bool	journal_job(pappl_system_t *system, int printer_id, int job_id);
 static void	make_attributes(pappl_system_t *system);
+static bool	needs_save(pappl_system_t *system);
+static void	*register_dns_sd(pappl_system_t *system);
+static void	save_state(pappl_system_t *system);
+static void	*save_thread(pappl_system_t *system);
 static void	sighup_handler(int sig);
 static void	sigterm_handler(int sig);
+static void	write_wakeup(int fd);
 
 
 //
@@ -85,12 +98,75 @@ void
 _papplSystemConfigChanged(
     pappl_system_t *system)		// I - System
 {
-  pthread_rwlock_wrlock(&system->rwlock);
+  _papplRWLockWrite(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
   if (system->is_running)
-    system->config_changes ++;
+    _papplSystemConfigChangedNoLock(system);
 
-  pthread_rwlock_unlock(&system->rwlock);
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+}
+
+
+//
+// '_papplSystemConfigChangedNoLock()' - Mark the system configuration as
+//                                       changed without locking.
+//
+// The caller must hold the system write lock, or the journal mutex for job
+// changes.  The change count is also updated under the save mutex so the save
+// thread can read it without the system lock.
+//
+
+void
+_papplSystemConfigChangedNoLock(
+    pappl_system_t *system)		// I - System
+{
+  bool	wakeup;				// Wake up the main loop?
+
+
+  // Wake up the save thread, or the main loop if it does the saving...
+  pthread_mutex_lock(&system->save_mutex);
+  system->config_changes ++;
+  pthread_cond_signal(&system->save_cond);
+  wakeup = !system->save_running;
+  pthread_mutex_unlock(&system->save_mutex);
+
+  if (wakeup)
+    _papplSystemWakeup(system);
+}
+
+
+//
+// '_papplSystemJobChanged()' - Mark a job as changed.
+//
+// Job changes are tracked separately from other configuration changes so that
+// @link papplSystemSaveState@ can append them to the state journal instead of
+// rewriting the whole state file.
+//
+
+void
+_papplSystemJobChanged(
+    pappl_system_t *system,		// I - System
+    pappl_job_t    *job)		// I - Job
+{
+  if (journal_job(system, job->printer->printer_id, job->job_id))
+    _papplSystemAddEvent(system, job->printer, job, _PAPPL_EVENT_JOB_STATE_CHANGED);
+}
+
+
+//
+// '_papplSystemJobDeleted()' - Mark a job as deleted.
+//
+// The job is recorded in the state journal so that it is not restored from
+// an older state file.  The job itself must already be deleted.
+//
+
+void
+_papplSystemJobDeleted(
+    pappl_system_t *system,		// I - System
+    int            printer_id,		// I - Printer ID
+    int            job_id)		// I - Job ID
+{
+  journal_job(system, printer_id, job_id);
 }
 
 
@@ -115,8 +191,18 @@ _papplSystemConfigChanged(
 // - `PAPPL_SOPTIONS_WEB_INTERFACE`: Include the standard printer and job monitoring
 //   web pages.
 // - `PAPPL_SOPTIONS_WEB_TLS`: Include the TLS settings page.
+// - `PAPPL_SOPTIONS_WEB_COMPRESS`: Compress web pages for clients that
+//   support it.
 // - `PAPPL_SOPTIONS_USB_PRINTER`: Accept jobs via USB for the default printer
 //   (embedded Linux only).
+// - `PAPPL_SOPTIONS_IO_URING`: Write print files in the spool directory and
+//   "file" devices using io_uring, when available (Linux only).  Use the
+//   "testspool" program to see whether this helps on the target system.
+// - `PAPPL_SOPTIONS_COMPRESS_SPOOL`: Compress raw print files in the spool
+//   directory with gzip.  Drivers then read the print data from a pipe.
+// - `PAPPL_SOPTIONS_PARALLEL_LOAD`: Create printers from the state file using
+//   multiple threads.  The driver and status callbacks must then be safe to
+//   call concurrently for different printers.
 //
 // The "name" argument specifies a human-readable name for the system.
 //
@@ -158,6 +244,7 @@ papplSystemCreate(
 {
   pappl_system_t	*system;	// System object
   const char		*tmpdir;	// Temporary directory
+  int			i;		// Looping var
 
 
   if (!name)
@@ -170,6 +257,17 @@ papplSystemCreate(
   // Initialize values...
   pthread_rwlock_init(&system->rwlock, NULL);
   pthread_rwlock_init(&system->session_rwlock, NULL);
+  pthread_rwlock_init(&system->resource_rwlock, NULL);
+  pthread_mutex_init(&system->event_mutex, NULL);
+  pthread_cond_init(&system->event_cond, NULL);
+  pthread_mutex_init(&system->journal_mutex, NULL);
+  pthread_mutex_init(&system->state_mutex, NULL);
+  pthread_mutex_init(&system->save_mutex, NULL);
+  pthread_cond_init(&system->save_cond, NULL);
+  pthread_mutex_init(&system->tls_mutex, NULL);
+  pthread_mutex_init(&system->auth_mutex, NULL);
+  pthread_mutex_init(&system->raw_mutex, NULL);
+  pthread_mutex_init(&system->spool_mutex, NULL);
 
   system->options         = options;
   system->start_time      = time(NULL);
@@ -178,16 +276,31 @@ papplSystemCreate(
   system->port            = port;
   system->directory       = spooldir ? strdup(spooldir) : NULL;
   system->logfd           = -1;
+  system->raw_pipe[0]     = -1;
+  system->raw_pipe[1]     = -1;
+  system->wakeup_fd[0]    = -1;
+  system->wakeup_fd[1]    = -1;
   system->logfile         = logfile ? strdup(logfile) : NULL;
   system->loglevel        = loglevel;
   system->logmaxsize      = 1024 * 1024;
   system->next_client     = 1;
   system->next_printer_id = 1;
+  system->save_delay      = 1000;
+  system->idle_timeout    = 30;
   system->subtypes        = subtypes ? strdup(subtypes) : NULL;
   system->tls_only        = tls_only;
   system->admin_gid       = (gid_t)-1;
   system->auth_service    = auth_service ? strdup(auth_service) : NULL;
 
+  // Initialize the log levels before anything gets logged...
+  if (system->loglevel == PAPPL_LOGLEVEL_UNSPEC)
+    system->loglevel = PAPPL_LOGLEVEL_ERROR;
+
+  for (i = 0; i < _PAPPL_LOGCAT_MAX; i ++)
+    system->logcatlevels[i] = PAPPL_LOGLEVEL_UNSPEC;
+
+  _papplLogUpdateMask(system);
+
   // Make sure the system name and UUID are initialized...
   papplSystemSetHostname(system, NULL);
   papplSystemSetUUID(system, NULL);
@@ -217,10 +330,6 @@ papplSystemCreate(
     goto fatal;
   }
 
-  // Initialize logging...
-  if (system->loglevel == PAPPL_LOGLEVEL_UNSPEC)
-    system->loglevel = PAPPL_LOGLEVEL_ERROR;
-
   if (!system->logfile)
   {
     // Default log file is $TMPDIR/papplUID.log...
@@ -279,6 +388,15 @@ papplSystemDelete(
 
   cupsArrayDelete(system->printers);
 
+  // Close the main loop wakeup descriptor now that no printer or job threads
+  // are left to write to it...
+  if (system->wakeup_fd[0] >= 0)
+  {
+    close(system->wakeup_fd[0]);
+    if (system->wakeup_fd[1] != system->wakeup_fd[0])
+      close(system->wakeup_fd[1]);
+  }
+
   free(system->uuid);
   free(system->name);
   free(system->dns_sd_name);
@@ -291,6 +409,9 @@ papplSystemDelete(
   free(system->admin_group);
   free(system->default_print_group);
 
+  _papplLogClose(system);
+  _papplTraceClose(system);
+
   if (system->logfd >= 0 && system->logfd != 2)
     close(system->logfd);
 
@@ -300,9 +421,23 @@ papplSystemDelete(
   cupsArrayDelete(system->filters);
   cupsArrayDelete(system->links);
   cupsArrayDelete(system->resources);
+  cupsArrayDelete(system->journal);
+  cupsArrayDelete(system->subscriptions);
+  cupsArrayDelete(system->raw_sessions);
 
   pthread_rwlock_destroy(&system->rwlock);
   pthread_rwlock_destroy(&system->session_rwlock);
+  pthread_rwlock_destroy(&system->resource_rwlock);
+  pthread_mutex_destroy(&system->event_mutex);
+  pthread_cond_destroy(&system->event_cond);
+  pthread_mutex_destroy(&system->journal_mutex);
+  pthread_mutex_destroy(&system->state_mutex);
+  pthread_mutex_destroy(&system->save_mutex);
+  pthread_cond_destroy(&system->save_cond);
+  pthread_mutex_destroy(&system->tls_mutex);
+  pthread_mutex_destroy(&system->auth_mutex);
+  pthread_mutex_destroy(&system->raw_mutex);
+  pthread_mutex_destroy(&system->spool_mutex);
 
   free(system);
 }
@@ -366,12 +501,24 @@ papplSystemRun(pappl_system_t *system)	// I - System
   int			dns_sd_host_changes;
 					// Current number of host name changes
   pappl_printer_t	*printer;	// Current printer
+  pthread_t		dns_sd_tid;	// DNS-SD registration thread
+  struct pollfd		pfds[_PAPPL_MAX_LISTENERS + 1];
+					// Listener sockets and wakeup descriptor
+  nfds_t		num_pfds;	// Number of poll descriptors
+  char			buffer[256];	// Wakeup buffer
+  double		start,		// Start time
+			resource_time,	// Time after adding resources
+			attr_time,	// Time after making attributes
+			end;		// Time after starting printers
+  time_t		clean_time;	// Scheduled clean time
 
 
   // Range check...
   if (!system)
     return;
 
+  start = _papplGetTime();
+
   if (system->is_running)
   {
     papplLog(system, PAPPL_LOGLEVEL_FATAL, "Tried to run system when already running.");
@@ -393,6 +540,7 @@ papplSystemRun(pappl_system_t *system)	// I - System
 
   if ((system->options & PAPPL_SOPTIONS_WEB_LOG) && system->logfile && strcmp(system->logfile, "-") && strcmp(system->logfile, "syslog"))
   {
+    papplSystemAddResourceCallback(system, "/logevents", "text/event-stream", (pappl_resource_cb_t)_papplSystemWebLogEvents, system);
     papplSystemAddResourceCallback(system, "/logfile.txt", "text/plain", (pappl_resource_cb_t)_papplSystemWebLogFile, system);
     papplSystemAddResourceCallback(system, "/logs", "text/html", (pappl_resource_cb_t)_papplSystemWebLogs, system);
     papplSystemAddLink(system, "View Logs", "/logs", PAPPL_LOPTIONS_LOGGING | PAPPL_LOPTIONS_HTTPS_REQUIRED);
@@ -400,6 +548,8 @@ papplSystemRun(pappl_system_t *system)	// I - System
 
   if (system->options & PAPPL_SOPTIONS_WEB_INTERFACE)
   {
+    papplSystemAddResourceCallback(system, "/events", "text/event-stream", (pappl_resource_cb_t)_papplSystemWebEvents, system);
+
     if (system->options & PAPPL_SOPTIONS_MULTI_QUEUE)
     {
       papplSystemAddResourceCallback(system, "/", "text/html", (pappl_resource_cb_t)_papplSystemWebHome, system);
@@ -435,6 +585,8 @@ papplSystemRun(pappl_system_t *system)	// I - System
 #endif // HAVE_GNUTLS
   }
 
+  resource_time = _papplGetTime();
+
   // Catch important signals...
   papplLog(system, PAPPL_LOGLEVEL_INFO, "Starting system.");
 
@@ -472,31 +624,86 @@ papplSystemRun(pappl_system_t *system)	// I - System
   // Make the static attributes...
   make_attributes(system);
 
-  // Advertise the system via DNS-SD as needed...
-  if (system->dns_sd_name)
-    _papplSystemRegisterDNSSDNoLock(system);
+  attr_time = _papplGetTime();
 
-  // Start up printers...
-  for (printer = (pappl_printer_t *)cupsArrayFirst(system->printers); printer; printer = (pappl_printer_t *)cupsArrayNext(system->printers))
+  // Create the main loop wakeup descriptor so that other threads (and signal
+  // handlers) don't have to wait for a poll timeout.  The descriptor stays
+  // open until the system is deleted since client, job, and DNS-SD threads
+  // may still wake up the main loop after it has stopped...
+  if (system->wakeup_fd[0] < 0)
   {
-    // Advertise via DNS-SD as needed...
-    if (printer->dns_sd_name)
-      _papplPrinterRegisterDNSSDNoLock(printer);
-
-    // Start the raw socket listeners as needed...
-    if ((system->options & PAPPL_SOPTIONS_RAW_SOCKET) && printer->num_listeners > 0)
+#ifdef __linux
+    if ((system->wakeup_fd[0] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) >= 0)
+    {
+      system->wakeup_fd[1] = system->wakeup_fd[0];
+    }
+    else
+#endif // __linux
+    if (pipe(system->wakeup_fd))
+    {
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create main loop wakeup pipe: %s", strerror(errno));
+      system->wakeup_fd[0] = system->wakeup_fd[1] = -1;
+    }
+    else
     {
-      pthread_t	tid;		// Thread ID
+      for (i = 0; i < 2; i ++)
+      {
+        fcntl(system->wakeup_fd[i], F_SETFL, fcntl(system->wakeup_fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(system->wakeup_fd[i], F_SETFD, fcntl(system->wakeup_fd[i], F_GETFD) | FD_CLOEXEC);
+      }
+    }
+  }
+
+  memcpy(pfds, system->listeners, (size_t)system->num_listeners * sizeof(struct pollfd));
+  num_pfds = (nfds_t)system->num_listeners;
+
+  if (system->wakeup_fd[0] >= 0)
+  {
+    pfds[num_pfds].fd     = system->wakeup_fd[0];
+    pfds[num_pfds].events = POLLIN;
+    num_pfds ++;
+
+    wakeup_fd = system->wakeup_fd[1];
+  }
+
+  // Advertise the system and printers via DNS-SD from a separate thread so
+  // that we can start accepting connections right away...
+  system->dns_sd_registering = true;
+
+  if (pthread_create(&dns_sd_tid, NULL, (void *(*)(void *))register_dns_sd, system))
+  {
+    // Unable to create DNS-SD thread, register everything now...
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create DNS-SD registration thread: %s", strerror(errno));
+    register_dns_sd(system);
+  }
+  else
+  {
+    // Detach the main thread from the DNS-SD thread to prevent hangs...
+    pthread_detach(dns_sd_tid);
+  }
 
-      if (pthread_create(&tid, NULL, (void *(*)(void *))_papplPrinterRunRaw, printer))
+  // Start the raw socket thread as needed...
+  if (system->options & PAPPL_SOPTIONS_RAW_SOCKET)
+  {
+    if (pipe(system->raw_pipe))
+    {
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create raw socket wakeup pipe: %s", strerror(errno));
+    }
+    else
+    {
+      for (i = 0; i < 2; i ++)
       {
-	// Unable to create listener thread...
-	papplLogPrinter(printer, PAPPL_LOGLEVEL_ERROR, "Unable to create raw listener thread: %s", strerror(errno));
+        fcntl(system->raw_pipe[i], F_SETFL, fcntl(system->raw_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(system->raw_pipe[i], F_SETFD, fcntl(system->raw_pipe[i], F_GETFD) | FD_CLOEXEC);
       }
-      else
+
+      system->raw_running = true;
+
+      if (pthread_create(&system->raw_tid, NULL, (void *(*)(void *))_papplSystemRunRaw, system))
       {
-	// Detach the main thread from the raw thread to prevent hangs...
-	pthread_detach(tid);
+	// Unable to create raw socket thread...
+	papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create raw socket thread: %s", strerror(errno));
+	system->raw_running = false;
       }
     }
   }
@@ -522,6 +729,23 @@ papplSystemRun(pappl_system_t *system)	// I - System
     }
   }
 
+  // Start the save thread as needed...
+  if (system->save_cb)
+  {
+    system->save_running = true;
+
+    if (pthread_create(&system->save_tid, NULL, (void *(*)(void *))save_thread, system))
+    {
+      // Unable to create save thread, save from the main loop instead...
+      papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create save thread: %s", strerror(errno));
+      system->save_running = false;
+    }
+  }
+
+  end = _papplGetTime();
+
+  papplLog(system, PAPPL_LOGLEVEL_INFO, "Started system in %.3f seconds (resources %.3f, attributes %.3f, printers %.3f).", end - start, resource_time - start, attr_time - resource_time, end - attr_time);
+
   // Loop until we are shutdown or have a hard error...
   while (!shutdown_system)
   {
@@ -531,7 +755,7 @@ papplSystemRun(pappl_system_t *system)	// I - System
       _papplLogOpen(system);
     }
 
-    if ((count = poll(system->listeners, (nfds_t)system->num_listeners, 1000)) < 0 && errno != EINTR && errno != EAGAIN)
+    if ((count = poll(pfds, num_pfds, get_timeout(system))) < 0 && errno != EINTR && errno != EAGAIN)
     {
       papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to accept new connections: %s", strerror(errno));
       break;
@@ -542,9 +766,9 @@ papplSystemRun(pappl_system_t *system)	// I - System
       // Accept client connections as needed...
       for (i = 0; i < system->num_listeners; i ++)
       {
-	if (system->listeners[i].revents & POLLIN)
+	if (pfds[i].revents & POLLIN)
 	{
-	  if ((client = _papplClientCreate(system, system->listeners[i].fd)) != NULL)
+	  if ((client = _papplClientCreate(system, pfds[i].fd)) != NULL)
 	  {
 	    if (pthread_create(&client->thread_id, NULL, (void *(*)(void *))_papplClientRun, client))
 	    {
@@ -560,11 +784,18 @@ papplSystemRun(pappl_system_t *system)	// I - System
 	  }
 	}
       }
+
+      // Drain the wakeup descriptor before checking for work, so that a wakeup
+      // sent after the checks below makes the next poll return immediately...
+      if (system->wakeup_fd[0] >= 0 && (pfds[system->num_listeners].revents & POLLIN))
+      {
+        while (read(system->wakeup_fd[0], buffer, sizeof(buffer)) > 0);
+      }
     }
 
     dns_sd_host_changes = _papplDNSSDGetHostChanges();
 
-    if (system->dns_sd_any_collision || system->dns_sd_host_changes != dns_sd_host_changes)
+    if (!system->dns_sd_registering && (system->dns_sd_any_collision || system->dns_sd_host_changes != dns_sd_host_changes))
     {
       // Handle name collisions...
       bool		force_dns_sd = system->dns_sd_host_changes != dns_sd_host_changes;
@@ -573,7 +804,7 @@ papplSystemRun(pappl_system_t *system)	// I - System
       if (force_dns_sd)
         papplSystemSetHostname(system, NULL);
 
-      pthread_rwlock_rdlock(&system->rwlock);
+      _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
       if (system->dns_sd_collision || force_dns_sd)
         _papplSystemRegisterDNSSDNoLock(system);
@@ -587,18 +818,13 @@ papplSystemRun(pappl_system_t *system)	// I - System
       system->dns_sd_any_collision = false;
       system->dns_sd_host_changes  = dns_sd_host_changes;
 
-      pthread_rwlock_unlock(&system->rwlock);
+      _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
     }
 
-    if (system->config_changes > system->save_changes)
+    if (!system->save_running && system->save_cb && needs_save(system))
     {
-      system->save_changes = system->config_changes;
-
-      if (system->save_cb)
-      {
-        // Save the configuration...
-	(system->save_cb)(system, system->save_cbdata);
-      }
+      // Save the configuration...
+      save_state(system);
     }
 
     if (system->shutdown_time)
@@ -611,22 +837,28 @@ papplSystemRun(pappl_system_t *system)	// I - System
         break;
 
       // Otherwise shutdown immediately if there are no more active jobs...
-      pthread_rwlock_rdlock(&system->rwlock);
+      _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
       for (printer = (pappl_printer_t *)cupsArrayFirst(system->printers); printer; printer = (pappl_printer_t *)cupsArrayNext(system->printers))
       {
-        pthread_rwlock_rdlock(&printer->rwlock);
-        jcount += cupsArrayCount(printer->active_jobs);
-        pthread_rwlock_unlock(&printer->rwlock);
+        _papplRWLockRead(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+        jcount += printer->active_jobs.count;
+        _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
       }
-      pthread_rwlock_unlock(&system->rwlock);
+      _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
 
       if (jcount == 0)
         break;
     }
 
     // Clean out old jobs...
-    if (system->clean_time && time(NULL) >= system->clean_time)
+    if ((clean_time = atomic_load(&system->clean_time)) != 0 && time(NULL) >= clean_time && atomic_compare_exchange_strong(&system->clean_time, &clean_time, 0))
+    {
+      // Only clear the clean time we acted on - a new deadline scheduled by
+      // another thread fails the exchange and is handled on the next pass.
+      // papplSystemCleanJobs schedules another pass for any recent jobs that
+      // are still over the limit...
       papplSystemCleanJobs(system);
+    }
   }
 
   papplLog(system, PAPPL_LOGLEVEL_INFO, "Shutting down system.");
@@ -644,10 +876,40 @@ papplSystemRun(pappl_system_t *system)	// I - System
       _papplPrinterUnregisterDNSSDNoLock(printer);
   }
 
-  if (system->save_changes < system->config_changes && system->save_cb)
+  if (system->raw_running)
+  {
+    // Stop the raw socket thread...
+    system->raw_running = false;
+    _papplSystemWakeRaw(system);
+    pthread_join(system->raw_tid, NULL);
+  }
+
+  for (i = 0; i < 2; i ++)
+  {
+    if (system->raw_pipe[i] >= 0)
+    {
+      close(system->raw_pipe[i]);
+      system->raw_pipe[i] = -1;
+    }
+  }
+
+  wakeup_fd = -1;
+
+  if (system->save_running)
+  {
+    // Stop the save thread...
+    pthread_mutex_lock(&system->save_mutex);
+    system->save_running = false;
+    pthread_cond_signal(&system->save_cond);
+    pthread_mutex_unlock(&system->save_mutex);
+
+    pthread_join(system->save_tid, NULL);
+  }
+
+  if (system->save_cb && needs_save(system))
   {
     // Save the configuration...
-    (system->save_cb)(system, system->save_cbdata);
+    save_state(system);
   }
 
   system->is_running = false;
@@ -657,6 +919,40 @@ papplSystemRun(pappl_system_t *system)	// I - System
 }
 
 
+//
+// '_papplSystemScheduleCleanJobs()' - Schedule cleaning of old jobs.
+//
+// The main loop calls @link papplSystemCleanJobs@ at the earliest scheduled
+// time.
+//
+
+void
+_papplSystemScheduleCleanJobs(
+    pappl_system_t *system,		// I - System
+    time_t         cleantime)		// I - Time to clean jobs
+{
+  time_t	current = atomic_load(&system->clean_time);
+					// Current clean time
+
+
+  // Keep the earliest clean time, retrying if another thread changed it...
+  do
+  {
+    if (current && current <= cleantime)
+    {
+      if (!system->shutdown_time)
+        return;
+      break;
+    }
+  }
+  while (!atomic_compare_exchange_weak(&system->clean_time, &current, cleantime));
+
+  // Wake up the main loop so it can update its timeout or, if a shutdown is
+  // pending, see whether all jobs are done...
+  _papplSystemWakeup(system);
+}
+
+
 //
 // 'papplSystemShutdown()' - Shutdown the system.
 //
@@ -669,7 +965,140 @@ papplSystemShutdown(
     pappl_system_t *system)		// I - System
 {
   if (system && !system->shutdown_time)
+  {
     system->shutdown_time = time(NULL);
+    _papplSystemWakeup(system);
+  }
+}
+
+
+//
+// '_papplSystemWakeup()' - Wake up the main loop.
+//
+// Call this function after changing anything the main loop acts on, such as
+// the shutdown or clean times.
+//
+
+void
+_papplSystemWakeup(
+    pappl_system_t *system)		// I - System
+{
+  write_wakeup(system->wakeup_fd[1]);
+}
+
+
+//
+// 'compare_jchanges()' - Compare two job changes.
+//
+
+static int				// O - Result of comparison
+compare_jchanges(_pappl_jchange_t *a,	// I - First change
+                 _pappl_jchange_t *b)	// I - Second change
+{
+  if (a->printer_id != b->printer_id)
+    return (a->printer_id - b->printer_id);
+  else
+    return (a->job_id - b->job_id);
+}
+
+
+//
+// 'copy_jchange()' - Copy a job change.
+//
+
+static _pappl_jchange_t *		// O - New job change
+copy_jchange(_pappl_jchange_t *change)	// I - Job change
+{
+  _pappl_jchange_t	*newchange;	// New job change
+
+
+  if ((newchange = (_pappl_jchange_t *)malloc(sizeof(_pappl_jchange_t))) != NULL)
+    *newchange = *change;
+
+  return (newchange);
+}
+
+
+//
+// 'get_timeout()' - Get the main loop poll timeout.
+//
+// The main loop sleeps until the next clean or forced shutdown time, or until
+// another thread wakes it up.  Without a wakeup descriptor it polls once a
+// second.
+//
+
+static int				// O - Timeout in milliseconds or -1 to wait forever
+get_timeout(pappl_system_t *system)	// I - System
+{
+  time_t	deadline = 0,		// Next deadline
+		curtime;		// Current time
+  int		timeout;		// Timeout in milliseconds
+
+
+  if (shutdown_system || restart_logging)
+    return (0);
+
+  deadline = atomic_load(&system->clean_time);
+
+  if (system->shutdown_time && (!deadline || (system->shutdown_time + 61) < deadline))
+    deadline = system->shutdown_time + 61;
+
+  if (!deadline)
+    return (system->wakeup_fd[0] >= 0 ? -1 : 1000);
+
+  if ((curtime = time(NULL)) >= deadline)
+    return (0);
+  else if ((deadline - curtime) > 86400)
+    timeout = 86400000;
+  else
+    timeout = (int)(deadline - curtime) * 1000;
+
+  if (system->wakeup_fd[0] < 0 && timeout > 1000)
+    timeout = 1000;
+
+  return (timeout);
+}
+
+
+//
+// 'journal_job()' - Add a job change to the state journal.
+//
+// Jobs that no longer exist when the state is saved are recorded as deleted.
+// Only the journal and save mutexes are used so that job changes never wait
+// for the system lock or for the state to be written.
+//
+
+static bool				// O - `true` if recorded, `false` if the system is not running
+journal_job(pappl_system_t *system,	// I - System
+            int            printer_id,	// I - Printer ID
+            int            job_id)	// I - Job ID
+{
+  _pappl_jchange_t	change;		// Job change
+
+
+  if (!system->is_running)
+    return (false);
+
+  change.printer_id = printer_id;
+  change.job_id     = job_id;
+
+  pthread_mutex_lock(&system->journal_mutex);
+
+  if (!system->journal)
+    system->journal = cupsArrayNew3((cups_array_func_t)compare_jchanges, NULL, NULL, 0, (cups_acopy_func_t)copy_jchange, (cups_afree_func_t)free);
+
+  if (!cupsArrayFind(system->journal, &change))
+    cupsArrayAdd(system->journal, &change);
+
+  // Count the change under both mutexes so papplSystemSaveState sees matching
+  // job and configuration change counts...
+  system->job_changes ++;
+
+  _papplSystemConfigChangedNoLock(system);
+
+  pthread_mutex_unlock(&system->journal_mutex);
+
+  return (true);
 }
 
 
@@ -755,6 +1184,176 @@ make_attributes(pappl_system_t *system)	// I - System
 }
 
 
+//
+// 'needs_save()' - Determine whether there are unsaved changes.
+//
+
+static bool				// O - `true` if changes need saving
+needs_save(pappl_system_t *system)	// I - System
+{
+  bool	ret;				// Return value
+
+
+  pthread_mutex_lock(&system->save_mutex);
+  ret = system->config_changes > system->save_changes;
+  pthread_mutex_unlock(&system->save_mutex);
+
+  return (ret);
+}
+
+
+//
+// 'register_dns_sd()' - Register the system and printers with DNS-SD.
+//
+// This function is run once at startup, normally from a separate thread.
+// Collisions are not handled by the main loop until all of the services have
+// been registered.
+//
+
+static void *				// O - Thread exit status
+register_dns_sd(pappl_system_t *system)	// I - System
+{
+  pappl_printer_t	*printer;	// Current printer
+  int			count = 0;	// Number of registrations
+  double		start;		// Start time
+
+
+  start = _papplGetTime();
+
+  _papplRWLockRead(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+
+  if (system->dns_sd_name)
+  {
+    _papplSystemRegisterDNSSDNoLock(system);
+    count ++;
+  }
+
+  for (printer = (pappl_printer_t *)cupsArrayFirst(system->printers); printer; printer = (pappl_printer_t *)cupsArrayNext(system->printers))
+  {
+    if (printer->dns_sd_name)
+    {
+      _papplPrinterRegisterDNSSDNoLock(printer);
+      count ++;
+    }
+  }
+
+  _papplRWUnlock(&system->rwlock, _PAPPL_LOCK_SYSTEM);
+
+  system->dns_sd_registering = false;
+
+  // Let the main loop handle any collisions that happened while registering...
+  _papplSystemWakeup(system);
+
+  papplLog(system, PAPPL_LOGLEVEL_INFO, "Registered %d DNS-SD service(s) in %.3f seconds.", count, _papplGetTime() - start);
+
+  return (NULL);
+}
+
+
+//
+// 'save_state()' - Call the save callback and record how long it took.
+//
+
+static void
+save_state(pappl_system_t *system)	// I - System
+{
+  size_t	changes;			// Configuration changes being saved
+  double	secs;				// Elapsed time in seconds
+
+
+  pthread_mutex_lock(&system->save_mutex);
+  changes = system->config_changes;
+  pthread_mutex_unlock(&system->save_mutex);
+
+  secs = _papplGetTime();
+
+  (system->save_cb)(system, system->save_cbdata);
+
+  secs = _papplGetTime() - secs;
+
+  if (secs >= 1.0)
+    papplLog(system, PAPPL_LOGLEVEL_WARN, "Saving system state took %.3f seconds.", secs);
+  else
+    papplLog(system, PAPPL_LOGLEVEL_DEBUG, "Saving system state took %.3f seconds.", secs);
+
+  pthread_mutex_lock(&system->save_mutex);
+
+  system->save_changes = changes;
+  system->save_count ++;
+  system->save_total += secs;
+
+  if (secs > system->save_max)
+    system->save_max = secs;
+
+  pthread_mutex_unlock(&system->save_mutex);
+}
+
+
+//
+// 'save_thread()' - Save the system state as the configuration changes.
+//
+// Changes are coalesced by waiting until no changes have been made for the
+// save delay before calling the save callback, which keeps slow saves out of
+// the main loop that accepts connections.  A steady stream of changes
+// postpones the save by at most 10 delays.
+//
+
+static void *				// O - Thread exit status
+save_thread(pappl_system_t *system)	// I - System
+{
+  struct timespec	deadline;	// End of current delay
+  size_t		changes;	// Changes at start of delay
+  int			delays;		// Number of delays
+
+
+  pthread_mutex_lock(&system->save_mutex);
+
+  while (system->save_running)
+  {
+    if (system->config_changes <= system->save_changes)
+    {
+      // Nothing to save, wait for a change...
+      pthread_cond_wait(&system->save_cond, &system->save_mutex);
+      continue;
+    }
+
+    // Wait until a full save delay passes without any additional changes...
+    for (delays = 0; delays < 10 && system->save_running; delays ++)
+    {
+      changes = system->config_changes;
+
+      clock_gettime(CLOCK_REALTIME, &deadline);
+
+      deadline.tv_sec  += system->save_delay / 1000;
+      deadline.tv_nsec += (system->save_delay % 1000) * 1000000;
+
+      if (deadline.tv_nsec >= 1000000000)
+      {
+	deadline.tv_sec ++;
+	deadline.tv_nsec -= 1000000000;
+      }
+
+      while (system->save_running && pthread_cond_timedwait(&system->save_cond, &system->save_mutex, &deadline) != ETIMEDOUT);
+
+      if (system->config_changes == changes)
+        break;
+    }
+
+    if (!system->save_running)
+      break;
+
+    // Save the configuration...
+    pthread_mutex_unlock(&system->save_mutex);
+    save_state(system);
+    pthread_mutex_lock(&system->save_mutex);
+  }
+
+  pthread_mutex_unlock(&system->save_mutex);
+
+  return (NULL);
+}
+
+
 //
 // 'sighup_handler()' - SIGHUP handler
 //
@@ -765,6 +1364,8 @@ sighup_handler(int sig)			// I - Signal (ignored)
   (void)sig;
 
   restart_logging = true;
+
+  write_wakeup(wakeup_fd);
 }
 
 
@@ -778,4 +1379,25 @@ sigterm_handler(int sig)		// I - Signal (ignored)
   (void)sig;
 
   shutdown_system = true;
+
+  write_wakeup(wakeup_fd);
+}
+
+
+//
+// 'write_wakeup()' - Write to a wakeup descriptor.
+//
+// This function is async-signal-safe.
+//
+
+static void
+write_wakeup(int fd)			// I - Wakeup eventfd or pipe
+{
+  uint64_t	value = 1;		// Value to add to the eventfd counter
+
+
+  // Errors are ignored since a full pipe or eventfd counter (EAGAIN) already
+  // has a wakeup pending...
+  if (fd >= 0 && write(fd, &value, sizeof(value)) < 0)
+    return;
 }
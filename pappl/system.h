@@ -51,7 +51,11 @@ enum pappl_soptions_e			// System option bits
   PAPPL_SOPTIONS_WEB_NETWORK = 0x0040,		// Enable the network settings page
   PAPPL_SOPTIONS_WEB_REMOTE = 0x0080,		// Allow remote queue management (vs. localhost only)
   PAPPL_SOPTIONS_WEB_SECURITY = 0x0100,		// Enable the user/password settings page
-  PAPPL_SOPTIONS_WEB_TLS = 0x0200		// Enable the TLS settings page
+  PAPPL_SOPTIONS_WEB_TLS = 0x0200,		// Enable the TLS settings page
+  PAPPL_SOPTIONS_WEB_COMPRESS = 0x0400,		// Compress web pages for clients that support it
+  PAPPL_SOPTIONS_IO_URING = 0x0800,		// Use io_uring for spool and file writes (Linux only)
+  PAPPL_SOPTIONS_COMPRESS_SPOOL = 0x1000,	// Compress raw print files in the spool directory
+  PAPPL_SOPTIONS_PARALLEL_LOAD = 0x2000		// Create printers from the state file using multiple threads
 };
 typedef unsigned pappl_soptions_t;	// Bitfield for system options
 
@@ -115,9 +119,12 @@ extern char		*papplSystemGetDNSSDName(pappl_system_t *system, char *buffer, size
 extern const char	*papplSystemGetFooterHTML(pappl_system_t *system) _PAPPL_PUBLIC;
 extern char		*papplSystemGetGeoLocation(pappl_system_t *system, char *buffer, size_t bufsize) _PAPPL_PUBLIC;
 extern char		*papplSystemGetHostname(pappl_system_t *system, char *buffer, size_t bufsize) _PAPPL_PUBLIC;
+extern int		papplSystemGetIdleTimeout(pappl_system_t *system) _PAPPL_PUBLIC;
 extern char		*papplSystemGetLocation(pappl_system_t *system, char *buffer, size_t bufsize) _PAPPL_PUBLIC;
+extern pappl_loglevel_t	papplSystemGetLogCategoryLevel(pappl_system_t *system, pappl_logcat_t category) _PAPPL_PUBLIC;
 extern pappl_loglevel_t  papplSystemGetLogLevel(pappl_system_t *system) _PAPPL_PUBLIC;
 extern size_t		papplSystemGetMaxLogSize(pappl_system_t *system) _PAPPL_PUBLIC;
+extern size_t		papplSystemGetMemorySpool(pappl_system_t *system, size_t *max_total) _PAPPL_PUBLIC;
 extern char		*papplSystemGetName(pappl_system_t *system, char *buffer, size_t bufsize) _PAPPL_PUBLIC;
 extern int		papplSystemGetNextPrinterID(pappl_system_t *system) _PAPPL_PUBLIC;
 extern pappl_soptions_t	papplSystemGetOptions(pappl_system_t *system) _PAPPL_PUBLIC;
@@ -125,9 +132,12 @@ extern char		*papplSystemGetOrganization(pappl_system_t *system, char *buffer, s
 extern char		*papplSystemGetOrganizationalUnit(pappl_system_t *system, char *buffer, size_t bufsize) _PAPPL_PUBLIC;
 extern char		*papplSystemGetPassword(pappl_system_t *system, char *buffer, size_t bufsize) _PAPPL_PUBLIC;
 extern int		papplSystemGetPort(pappl_system_t *system) _PAPPL_PUBLIC;
+extern int		papplSystemGetSaveDelay(pappl_system_t *system) _PAPPL_PUBLIC;
+extern size_t		papplSystemGetSaveStats(pappl_system_t *system, double *avg_secs, double *max_secs) _PAPPL_PUBLIC;
 extern const char	*papplSystemGetServerHeader(pappl_system_t *system) _PAPPL_PUBLIC;
 extern char		*papplSystemGetSessionKey(pappl_system_t *system, char *buffer, size_t bufsize) _PAPPL_PUBLIC;
 extern bool		papplSystemGetTLSOnly(pappl_system_t *system) _PAPPL_PUBLIC;
+extern size_t		papplSystemGetTLSStats(pappl_system_t *system, size_t *failures, double *avg_secs, double *max_secs) _PAPPL_PUBLIC;
 extern const char	*papplSystemGetUUID(pappl_system_t *system) _PAPPL_PUBLIC;
 extern int		papplSystemGetVersions(pappl_system_t *system, int max_versions, pappl_version_t *versions) _PAPPL_PUBLIC;
 extern char		*papplSystemHashPassword(pappl_system_t *system, const char *salt, const char *password, char *buffer, size_t bufsize) _PAPPL_PUBLIC;
@@ -150,9 +160,12 @@ extern void		papplSystemSetDNSSDName(pappl_system_t *system, const char *value)
 extern void		papplSystemSetFooterHTML(pappl_system_t *system, const char *html) _PAPPL_PUBLIC;
 extern void		papplSystemSetGeoLocation(pappl_system_t *system, const char *value) _PAPPL_PUBLIC;
 extern void		papplSystemSetHostname(pappl_system_t *system, const char *value) _PAPPL_PUBLIC;
+extern void		papplSystemSetIdleTimeout(pappl_system_t *system, int secs) _PAPPL_PUBLIC;
 extern void		papplSystemSetLocation(pappl_system_t *system, const char *value) _PAPPL_PUBLIC;
+extern void		papplSystemSetLogCategoryLevel(pappl_system_t *system, pappl_logcat_t category, pappl_loglevel_t loglevel) _PAPPL_PUBLIC;
 extern void		papplSystemSetLogLevel(pappl_system_t *system, pappl_loglevel_t loglevel) _PAPPL_PUBLIC;
 extern void		papplSystemSetMaxLogSize(pappl_system_t *system, size_t maxSize) _PAPPL_PUBLIC;
+extern void		papplSystemSetMemorySpool(pappl_system_t *system, size_t max_document, size_t max_total) _PAPPL_PUBLIC;
 extern void		papplSystemSetMIMECallback(pappl_system_t *system, pappl_mime_cb_t cb, void *data) _PAPPL_PUBLIC;
 extern void		papplSystemSetNextPrinterID(pappl_system_t *system, int next_printer_id) _PAPPL_PUBLIC;
 extern void		papplSystemSetOperationCallback(pappl_system_t *system, pappl_ipp_op_cb_t cb, void *data) _PAPPL_PUBLIC;
@@ -160,6 +173,8 @@ extern void		papplSystemSetOrganization(pappl_system_t *system, const char *valu
 extern void		papplSystemSetOrganizationalUnit(pappl_system_t *system, const char *value) _PAPPL_PUBLIC;
 extern void		papplSystemSetPassword(pappl_system_t *system, const char *hash) _PAPPL_PUBLIC;
 extern void		papplSystemSetSaveCallback(pappl_system_t *system, pappl_save_cb_t cb, void *data) _PAPPL_PUBLIC;
+extern void		papplSystemSetSaveDelay(pappl_system_t *system, int msecs) _PAPPL_PUBLIC;
+extern bool		papplSystemSetTraceFile(pappl_system_t *system, const char *filename, size_t num_records) _PAPPL_PUBLIC;
 extern void		papplSystemSetUUID(pappl_system_t *system, const char *value) _PAPPL_PUBLIC;
 extern void		papplSystemSetVersions(pappl_system_t *system, int num_versions, pappl_version_t *versions) _PAPPL_PUBLIC;
 extern void		papplSystemShutdown(pappl_system_t *system) _PAPPL_PUBLIC;
@@ -0,0 +1,85 @@
+//
+// Private trace header file for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+#ifndef _PAPPL_TRACE_PRIVATE_H_
+#  define _PAPPL_TRACE_PRIVATE_H_
+
+//
+// Include necessary headers...
+//
+
+#  include "base-private.h"
+#  include <stdatomic.h>
+#  include <stdint.h>
+
+
+//
+// Constants...
+//
+
+#  define _PAPPL_TRACE_MAGIC	"PAPPLTR1"
+					// Trace file magic/version string
+#  define _PAPPL_TRACE_RECORDS	65536	// Default number of trace records
+
+
+//
+// Types...
+//
+// A trace file consists of a header followed by a ring of fixed-size records.
+// Records are claimed by incrementing the "next" counter in the header, so the
+// record for counter value N lives at index N % num_records and has a "seq"
+// value of N + 1 once it has been completely written.  All times are in
+// nanoseconds from CLOCK_MONOTONIC.
+//
+
+typedef enum _pappl_tstage_e		// Trace stages
+{
+  _PAPPL_TSTAGE_ACCEPT,			// Accept a connection
+  _PAPPL_TSTAGE_TLS,			// TLS handshake
+  _PAPPL_TSTAGE_HTTP,			// Read and parse HTTP request
+  _PAPPL_TSTAGE_IPP_READ,		// Read and decode IPP request
+  _PAPPL_TSTAGE_IPP_OP,			// Process IPP operation
+  _PAPPL_TSTAGE_RESPONSE,		// Write response
+  _PAPPL_TSTAGE_JOB_WAIT,		// Wait in job queue
+  _PAPPL_TSTAGE_JOB_RIP,		// Process (filter/RIP) job
+  _PAPPL_TSTAGE_DEVICE,			// Device I/O for job
+  _PAPPL_TSTAGE_MAX			// Number of trace stages
+} _pappl_tstage_t;
+
+typedef struct _pappl_trhdr_s		// Trace file header
+{
+  char			magic[8];		// _PAPPL_TRACE_MAGIC
+  uint32_t		record_size,		// Size of each record
+			num_records;		// Number of records in ring
+  _Atomic uint64_t	next;			// Next record counter
+} _pappl_trhdr_t;
+
+typedef struct _pappl_trrec_s		// Trace record
+{
+  _Atomic uint64_t	seq;			// Counter value + 1 when written
+  uint64_t		start,			// Start time
+			duration;		// Duration
+  int32_t		id,			// Client number or job ID
+			printer_id;		// Printer ID or 0 for none
+  uint16_t		stage,			// Trace stage (_pappl_tstage_t)
+			op;			// IPP operation or 0 for none
+  uint32_t		reserved;		// Reserved for future use
+} _pappl_trrec_t;
+
+
+//
+// Functions...
+//
+
+extern void		_papplTraceClose(pappl_system_t *system) _PAPPL_PRIVATE;
+extern void		_papplTraceEnd(pappl_system_t *system, _pappl_tstage_t stage, uint64_t start, int id, int printer_id, int op) _PAPPL_PRIVATE;
+extern void		_papplTraceRecord(pappl_system_t *system, _pappl_tstage_t stage, uint64_t start, uint64_t duration, int id, int printer_id, int op) _PAPPL_PRIVATE;
+extern uint64_t		_papplTraceStart(pappl_system_t *system) _PAPPL_PRIVATE;
+
+#endif // !_PAPPL_TRACE_PRIVATE_H_
@@ -0,0 +1,229 @@
+//
+// Trace functions for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+//
+// Include necessary headers...
+//
+
+#include "pappl-private.h"
+#include <sys/mman.h>
+
+
+//
+// Local functions...
+//
+
+static uint64_t	get_nsecs(void);
+
+
+//
+// 'papplSystemSetTraceFile()' - Set the trace file for the system.
+//
+// This function enables tracing of the time spent in each stage of processing
+// client requests (accepting the connection, TLS handshake, HTTP and IPP
+// parsing, IPP operation, and response) and print jobs (queue wait,
+// filtering/RIP, and device I/O).  Trace records are stored in a fixed-size
+// ring in the named file, which is memory-mapped so that recording a trace
+// span does not need a system call or lock.  Pass `NULL` to disable tracing.
+//
+// The "num_records" argument specifies the size of the ring - once it is full
+// the oldest records are overwritten.  Specify `0` for the default size of
+// 65536 records.
+//
+// > Note: This function must be called prior to @link papplSystemRun@.
+//
+
+bool					// O - `true` on success, `false` on failure
+papplSystemSetTraceFile(
+    pappl_system_t *system,		// I - System
+    const char     *filename,		// I - Trace filename or `NULL` to disable
+    size_t         num_records)		// I - Number of records or `0` for default
+{
+  int		fd;			// Trace file descriptor
+  size_t	size;			// Size of trace file
+  void		*data;			// Mapped trace file
+  _pappl_trhdr_t *header;		// Trace file header
+
+
+  if (!system)
+  {
+    return (false);
+  }
+  else if (system->is_running)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Cannot change trace file while running.");
+    return (false);
+  }
+
+  // Stop any current trace...
+  _papplTraceClose(system);
+
+  if (!filename)
+    return (true);
+
+  // Create the trace file...
+  if (num_records == 0)
+    num_records = _PAPPL_TRACE_RECORDS;
+  else if (num_records > UINT32_MAX)
+    num_records = UINT32_MAX;
+
+  size = sizeof(_pappl_trhdr_t) + num_records * sizeof(_pappl_trrec_t);
+
+  if ((fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600)) < 0)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create trace file '%s': %s", filename, strerror(errno));
+    return (false);
+  }
+
+  if (ftruncate(fd, (off_t)size))
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to size trace file '%s': %s", filename, strerror(errno));
+    close(fd);
+    unlink(filename);
+    return (false);
+  }
+
+  data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to map trace file '%s': %s", filename, strerror(errno));
+    unlink(filename);
+    return (false);
+  }
+
+  // Initialize the header...
+  header = (_pappl_trhdr_t *)data;
+
+  memcpy(header->magic, _PAPPL_TRACE_MAGIC, sizeof(header->magic));
+  header->record_size = (uint32_t)sizeof(_pappl_trrec_t);
+  header->num_records = (uint32_t)num_records;
+  atomic_init(&header->next, 0);
+
+  system->trace         = header;
+  system->trace_records = (_pappl_trrec_t *)(header + 1);
+  system->trace_size    = size;
+
+  papplLog(system, PAPPL_LOGLEVEL_INFO, "Tracing to '%s' with %u records.", filename, (unsigned)num_records);
+
+  return (true);
+}
+
+
+//
+// '_papplTraceClose()' - Stop tracing.
+//
+
+void
+_papplTraceClose(
+    pappl_system_t *system)		// I - System
+{
+  if (system->trace)
+  {
+    msync(system->trace, system->trace_size, MS_ASYNC);
+    munmap(system->trace, system->trace_size);
+
+    system->trace         = NULL;
+    system->trace_records = NULL;
+    system->trace_size    = 0;
+  }
+}
+
+
+//
+// '_papplTraceEnd()' - Record a trace span ending now.
+//
+// The "start" argument is the value returned by @link _papplTraceStart@.
+// Nothing is recorded if tracing is disabled.
+//
+
+void
+_papplTraceEnd(
+    pappl_system_t  *system,		// I - System
+    _pappl_tstage_t stage,		// I - Trace stage
+    uint64_t        start,		// I - Start time from `_papplTraceStart`
+    int             id,			// I - Client number or job ID
+    int             printer_id,		// I - Printer ID or `0` for none
+    int             op)			// I - IPP operation or `0` for none
+{
+  if (start && system->trace)
+    _papplTraceRecord(system, stage, start, get_nsecs() - start, id, printer_id, op);
+}
+
+
+//
+// '_papplTraceRecord()' - Record a trace span.
+//
+
+void
+_papplTraceRecord(
+    pappl_system_t  *system,		// I - System
+    _pappl_tstage_t stage,		// I - Trace stage
+    uint64_t        start,		// I - Start time in nanoseconds
+    uint64_t        duration,		// I - Duration in nanoseconds
+    int             id,			// I - Client number or job ID
+    int             printer_id,		// I - Printer ID or `0` for none
+    int             op)			// I - IPP operation or `0` for none
+{
+  uint64_t	n;			// Record counter
+  _pappl_trrec_t *rec;			// Record
+
+
+  if (!system->trace)
+    return;
+
+  // Claim the next record in the ring and fill it in...
+  n   = atomic_fetch_add(&system->trace->next, 1);
+  rec = system->trace_records + (n % system->trace->num_records);
+
+  atomic_store_explicit(&rec->seq, 0, memory_order_relaxed);
+
+  rec->start      = start;
+  rec->duration   = duration;
+  rec->id         = (int32_t)id;
+  rec->printer_id = (int32_t)printer_id;
+  rec->stage      = (uint16_t)stage;
+  rec->op         = (uint16_t)op;
+  rec->reserved   = 0;
+
+  // Mark the record as complete...
+  atomic_store_explicit(&rec->seq, n + 1, memory_order_release);
+}
+
+
+//
+// '_papplTraceStart()' - Get the start time for a trace span.
+//
+// This function returns `0` when tracing is disabled so that the matching
+// call to @link _papplTraceEnd@ does nothing.
+//
+
+uint64_t				// O - Start time in nanoseconds or `0` if not tracing
+_papplTraceStart(
+    pappl_system_t *system)		// I - System
+{
+  return (system->trace ? get_nsecs() : 0);
+}
+
+
+//
+// 'get_nsecs()' - Get the current monotonic time in nanoseconds.
+//
+
+static uint64_t				// O - Time in nanoseconds
+get_nsecs(void)
+{
+  struct timespec	curtime;	// Current time
+
+
+  clock_gettime(CLOCK_MONOTONIC, &curtime);
+
+  return ((uint64_t)curtime.tv_sec * 1000000000 + (uint64_t)curtime.tv_nsec);
+}
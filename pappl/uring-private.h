@@ -0,0 +1,46 @@
+//
+// Private io_uring header file for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+#ifndef _PAPPL_URING_PRIVATE_H_
+#  define _PAPPL_URING_PRIVATE_H_
+
+//
+// Include necessary headers...
+//
+
+#  include "base-private.h"
+
+
+//
+// Constants...
+//
+
+#  define _PAPPL_URING_BUFFERS	4	// Number of registered buffers
+#  define _PAPPL_URING_BUFSIZE	65536	// Size of each registered buffer
+
+
+//
+// Types...
+//
+
+typedef struct _pappl_uring_s _pappl_uring_t;
+					// io_uring write queue
+
+
+//
+// Functions...
+//
+
+extern _pappl_uring_t	*_papplUringCreate(bool enabled) _PAPPL_PRIVATE;
+extern void		_papplUringDelete(_pappl_uring_t *ring) _PAPPL_PRIVATE;
+extern bool		_papplUringFlush(_pappl_uring_t *ring) _PAPPL_PRIVATE;
+extern bool		_papplUringWrite(_pappl_uring_t *ring, int fd, off_t offset, const void *data, size_t bytes) _PAPPL_PRIVATE;
+
+
+#endif // !_PAPPL_URING_PRIVATE_H_
@@ -0,0 +1,559 @@
+//
+// io_uring write functions for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+//
+// Include necessary headers...
+//
+
+#include "uring-private.h"
+#ifdef HAVE_LINUX_IO_URING_H
+#  include <linux/io_uring.h>
+#  include <stdatomic.h>
+#  include <stdint.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+
+
+//
+// Types...
+//
+// Data is copied into one of the registered buffers until it is full or the
+// next write is not contiguous, and the buffer is then queued as a fixed
+// buffer write.  Queued writes are only submitted to the kernel when a free
+// buffer is needed or the queue is flushed, so that several writes are
+// submitted with a single system call.  Writes to the current file position
+// (offset -1) are submitted one at a time to preserve their order.
+//
+
+typedef struct _pappl_urbuf_s		// Registered buffer
+{
+  int		fd;			// File descriptor
+  off_t		offset;			// File offset or -1 for current position
+  size_t	used;			// Bytes in buffer
+  bool		busy;			// Queued or in flight?
+} _pappl_urbuf_t;
+
+struct _pappl_uring_s			// io_uring write queue
+{
+  int			ring_fd;	// io_uring file descriptor
+  void			*sq_ring,	// Submission queue ring
+			*cq_ring;	// Completion queue ring
+  size_t		sq_size,	// Size of submission queue ring
+			cq_size;	// Size of completion queue ring
+  struct io_uring_sqe	*sqes;		// Submission queue entries
+  size_t		sqes_size;	// Size of submission queue entries
+  unsigned		*sq_tail,	// Submission queue tail
+			*sq_mask,	// Submission queue index mask
+			*sq_array,	// Submission queue index array
+			*cq_head,	// Completion queue head
+			*cq_tail,	// Completion queue tail
+			*cq_mask;	// Completion queue index mask
+  struct io_uring_cqe	*cqes;		// Completion queue entries
+  unsigned		pending,	// Writes queued but not submitted
+			in_flight;	// Writes submitted but not completed
+  int			current,	// Buffer being filled or -1 for none
+			error;		// First write error, if any
+  char			*data;		// Registered buffer memory
+  _pappl_urbuf_t	bufs[_PAPPL_URING_BUFFERS];
+					// Registered buffers
+};
+
+
+//
+// Local globals...
+//
+
+static atomic_bool	uring_unavailable = false;
+					// Is io_uring unavailable?
+
+
+//
+// Local functions...
+//
+
+static int	get_buffer(_pappl_uring_t *ring);
+static void	queue_buffer(_pappl_uring_t *ring);
+static void	reap_ring(_pappl_uring_t *ring);
+static bool	submit_ring(_pappl_uring_t *ring, bool wait);
+static bool	write_all(int fd, off_t offset, const char *data, size_t bytes);
+#endif // HAVE_LINUX_IO_URING_H
+
+
+//
+// '_papplUringCreate()' - Create an io_uring write queue.
+//
+// `NULL` is returned if io_uring is not enabled or available, in which case
+// the caller uses normal blocking writes.  io_uring is normally only enabled
+// with the `PAPPL_SOPTIONS_IO_URING` system option since copying the data to
+// the registered buffers can make buffered writes slower, particularly on
+// systems with few CPU cores.
+//
+
+_pappl_uring_t *			// O - Write queue or `NULL` if not available
+_papplUringCreate(bool enabled)		// I - `true` if io_uring is enabled
+{
+#ifdef HAVE_LINUX_IO_URING_H
+  _pappl_uring_t	*ring;		// Write queue
+  struct io_uring_params params;	// Setup parameters
+  struct iovec		iov[_PAPPL_URING_BUFFERS];
+					// Buffers to register
+  int			i;		// Looping var
+
+
+  if (!enabled || atomic_load(&uring_unavailable))
+    return (NULL);
+
+  if ((ring = (_pappl_uring_t *)calloc(1, sizeof(_pappl_uring_t))) == NULL)
+    return (NULL);
+
+  ring->current = -1;
+
+  // Create the ring, which needs at least Linux 5.6 for writes to the current
+  // file position...
+  memset(&params, 0, sizeof(params));
+
+  if ((ring->ring_fd = (int)syscall(__NR_io_uring_setup, _PAPPL_URING_BUFFERS, &params)) < 0 || !(params.features & IORING_FEAT_RW_CUR_POS))
+  {
+    if (ring->ring_fd >= 0 || errno == ENOSYS || errno == EPERM)
+      atomic_store(&uring_unavailable, true);
+
+    goto error;
+  }
+
+  fcntl(ring->ring_fd, F_SETFD, fcntl(ring->ring_fd, F_GETFD) | FD_CLOEXEC);
+
+  // Map the submission and completion queues...
+  ring->sq_size   = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size   = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (ring->cq_size > ring->sq_size)
+      ring->sq_size = ring->cq_size;
+
+    ring->cq_size = 0;
+  }
+
+  if ((ring->sq_ring = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING)) == MAP_FAILED)
+  {
+    ring->sq_ring = NULL;
+    goto error;
+  }
+
+  if (ring->cq_size == 0)
+  {
+    ring->cq_ring = ring->sq_ring;
+  }
+  else if ((ring->cq_ring = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+  {
+    ring->cq_ring = NULL;
+    goto error;
+  }
+
+  if ((ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES)) == MAP_FAILED)
+  {
+    ring->sqes = NULL;
+    goto error;
+  }
+
+  ring->sq_tail  = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+  ring->sq_mask  = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+  ring->cq_head  = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+  ring->cq_tail  = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+  ring->cq_mask  = (unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+  ring->cqes     = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+
+  // Allocate and register the buffers...
+  if ((ring->data = mmap(NULL, _PAPPL_URING_BUFFERS * _PAPPL_URING_BUFSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+  {
+    ring->data = NULL;
+    goto error;
+  }
+
+  for (i = 0; i < _PAPPL_URING_BUFFERS; i ++)
+  {
+    iov[i].iov_base = ring->data + i * _PAPPL_URING_BUFSIZE;
+    iov[i].iov_len  = _PAPPL_URING_BUFSIZE;
+  }
+
+  if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_BUFFERS, iov, _PAPPL_URING_BUFFERS) < 0)
+    goto error;
+
+  return (ring);
+
+  // If we get here, something went wrong...
+  error:
+
+  _papplUringDelete(ring);
+
+  return (NULL);
+
+#else
+  (void)enabled;
+
+  return (NULL);
+#endif // HAVE_LINUX_IO_URING_H
+}
+
+
+//
+// '_papplUringDelete()' - Wait for queued writes and delete a write queue.
+//
+
+void
+_papplUringDelete(_pappl_uring_t *ring)	// I - Write queue
+{
+#ifdef HAVE_LINUX_IO_URING_H
+  if (!ring)
+    return;
+
+  if (ring->data && ring->sqes)
+    _papplUringFlush(ring);
+
+  if (ring->data)
+    munmap(ring->data, _PAPPL_URING_BUFFERS * _PAPPL_URING_BUFSIZE);
+  if (ring->sqes)
+    munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    munmap(ring->cq_ring, ring->cq_size);
+  if (ring->sq_ring)
+    munmap(ring->sq_ring, ring->sq_size);
+  if (ring->ring_fd >= 0)
+    close(ring->ring_fd);
+
+  free(ring);
+
+#else
+  (void)ring;
+#endif // HAVE_LINUX_IO_URING_H
+}
+
+
+//
+// '_papplUringFlush()' - Write all queued data and wait for it to complete.
+//
+// `false` is returned, with `errno` set, if any write since the last flush
+// failed.
+//
+
+bool					// O - `true` on success, `false` on error
+_papplUringFlush(_pappl_uring_t *ring)	// I - Write queue
+{
+#ifdef HAVE_LINUX_IO_URING_H
+  int	error;				// Write error, if any
+
+
+  if (ring->current >= 0)
+    queue_buffer(ring);
+
+  while (ring->pending > 0 || ring->in_flight > 0)
+  {
+    if (!submit_ring(ring, true))
+      break;
+  }
+
+  if ((error = ring->error) != 0)
+  {
+    ring->error = 0;
+    errno       = error;
+    return (false);
+  }
+
+  return (true);
+
+#else
+  (void)ring;
+
+  return (true);
+#endif // HAVE_LINUX_IO_URING_H
+}
+
+
+//
+// '_papplUringWrite()' - Queue data to be written to a file.
+//
+// The "offset" argument specifies the file offset for the data, or -1 to
+// write at the current file position.  The data is copied, so the caller can
+// reuse its buffer immediately.  Errors from earlier writes are reported by
+// the next call to this function or @link _papplUringFlush@.
+//
+
+bool					// O - `true` on success, `false` on error
+_papplUringWrite(_pappl_uring_t *ring,	// I - Write queue
+                 int            fd,	// I - File descriptor
+                 off_t          offset,	// I - File offset or -1 for current position
+                 const void     *data,	// I - Data to write
+                 size_t         bytes)	// I - Number of bytes
+{
+#ifdef HAVE_LINUX_IO_URING_H
+  const char		*dataptr = (const char *)data;
+					// Pointer into data
+  _pappl_urbuf_t	*buf;		// Current buffer
+  size_t		count;		// Bytes to copy
+
+
+  while (bytes > 0)
+  {
+    if (ring->error)
+    {
+      errno       = ring->error;
+      ring->error = 0;
+      return (false);
+    }
+
+    if (ring->current >= 0)
+    {
+      // Queue the current buffer if it is full or the data is not contiguous...
+      buf = ring->bufs + ring->current;
+
+      if (buf->fd != fd || buf->used >= _PAPPL_URING_BUFSIZE || (offset < 0) != (buf->offset < 0) || (offset >= 0 && (off_t)(buf->offset + (off_t)buf->used) != offset))
+        queue_buffer(ring);
+    }
+
+    if (ring->current < 0)
+    {
+      // Start a new buffer...
+      if ((ring->current = get_buffer(ring)) < 0)
+        continue;
+
+      buf         = ring->bufs + ring->current;
+      buf->fd     = fd;
+      buf->offset = offset < 0 ? -1 : offset;
+      buf->used   = 0;
+    }
+    else
+    {
+      buf = ring->bufs + ring->current;
+    }
+
+    // Copy the data...
+    if ((count = _PAPPL_URING_BUFSIZE - buf->used) > bytes)
+      count = bytes;
+
+    memcpy(ring->data + ring->current * _PAPPL_URING_BUFSIZE + buf->used, dataptr, count);
+
+    buf->used += count;
+    dataptr   += count;
+    bytes     -= count;
+
+    if (offset >= 0)
+      offset += (off_t)count;
+  }
+
+  return (true);
+
+#else
+  (void)ring;
+  (void)fd;
+  (void)offset;
+  (void)data;
+  (void)bytes;
+
+  errno = ENOSYS;
+
+  return (false);
+#endif // HAVE_LINUX_IO_URING_H
+}
+
+
+#ifdef HAVE_LINUX_IO_URING_H
+//
+// 'get_buffer()' - Get a free buffer, waiting for a write to complete as
+//                  needed.
+//
+
+static int				// O - Buffer index or -1 on error
+get_buffer(_pappl_uring_t *ring)	// I - Write queue
+{
+  int	i;				// Looping var
+
+
+  for (;;)
+  {
+    for (i = 0; i < _PAPPL_URING_BUFFERS; i ++)
+    {
+      if (!ring->bufs[i].busy)
+        return (i);
+    }
+
+    if (!submit_ring(ring, true))
+      return (-1);
+  }
+}
+
+
+//
+// 'queue_buffer()' - Queue the current buffer for writing.
+//
+
+static void
+queue_buffer(_pappl_uring_t *ring)	// I - Write queue
+{
+  int			i = ring->current;
+					// Buffer index
+  _pappl_urbuf_t	*buf = ring->bufs + i;
+					// Buffer
+  unsigned		tail,		// Submission queue tail
+			index;		// Submission queue index
+  struct io_uring_sqe	*sqe;		// Submission queue entry
+
+
+  ring->current = -1;
+
+  if (buf->used == 0)
+    return;
+
+  if (buf->offset < 0)
+  {
+    // Writes to the current position must complete in order...
+    while (ring->pending > 0 || ring->in_flight > 0)
+    {
+      if (!submit_ring(ring, true))
+        break;
+    }
+  }
+
+  // There is one submission queue entry per buffer, so the queue can't be
+  // full...
+  tail  = *ring->sq_tail;
+  index = tail & *ring->sq_mask;
+  sqe   = ring->sqes + index;
+
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+  sqe->opcode    = IORING_OP_WRITE_FIXED;
+  sqe->fd        = buf->fd;
+  sqe->off       = buf->offset < 0 ? (uint64_t)-1 : (uint64_t)buf->offset;
+  sqe->addr      = (uint64_t)(uintptr_t)(ring->data + i * _PAPPL_URING_BUFSIZE);
+  sqe->len       = (unsigned)buf->used;
+  sqe->buf_index = (uint16_t)i;
+  sqe->user_data = (uint64_t)i;
+
+  ring->sq_array[index] = index;
+
+  atomic_store_explicit((_Atomic unsigned *)ring->sq_tail, tail + 1, memory_order_release);
+
+  buf->busy = true;
+  ring->pending ++;
+}
+
+
+//
+// 'reap_ring()' - Process completed writes.
+//
+
+static void
+reap_ring(_pappl_uring_t *ring)		// I - Write queue
+{
+  unsigned		head,		// Completion queue head
+			tail;		// Completion queue tail
+  struct io_uring_cqe	*cqe;		// Completion queue entry
+  _pappl_urbuf_t	*buf;		// Buffer
+  const char		*data;		// Buffer data
+
+
+  head = *ring->cq_head;
+  tail = atomic_load_explicit((_Atomic unsigned *)ring->cq_tail, memory_order_acquire);
+
+  for (; head != tail; head ++)
+  {
+    cqe  = ring->cqes + (head & *ring->cq_mask);
+    buf  = ring->bufs + cqe->user_data;
+    data = ring->data + cqe->user_data * _PAPPL_URING_BUFSIZE;
+
+    if (cqe->res < 0)
+    {
+      if (!ring->error)
+        ring->error = -cqe->res;
+    }
+    else if ((size_t)cqe->res < buf->used)
+    {
+      // Finish a short write synchronously...
+      if (!write_all(buf->fd, buf->offset < 0 ? -1 : buf->offset + cqe->res, data + cqe->res, buf->used - (size_t)cqe->res) && !ring->error)
+        ring->error = errno;
+    }
+
+    buf->busy = false;
+    buf->used = 0;
+
+    ring->in_flight --;
+  }
+
+  atomic_store_explicit((_Atomic unsigned *)ring->cq_head, head, memory_order_release);
+}
+
+
+//
+// 'submit_ring()' - Submit queued writes and optionally wait for one to
+//                   complete.
+//
+
+static bool				// O - `true` on success, `false` on error
+submit_ring(_pappl_uring_t *ring,	// I - Write queue
+            bool           wait)	// I - Wait for a completion?
+{
+  int	ret;				// Return value
+
+
+  while ((ret = (int)syscall(__NR_io_uring_enter, ring->ring_fd, ring->pending, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0)) < 0)
+  {
+    if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+    {
+      if (!ring->error)
+        ring->error = errno;
+
+      return (false);
+    }
+  }
+
+  ring->pending   -= (unsigned)ret;
+  ring->in_flight += (unsigned)ret;
+
+  reap_ring(ring);
+
+  return (true);
+}
+
+
+//
+// 'write_all()' - Write data synchronously.
+//
+
+static bool				// O - `true` on success, `false` on error
+write_all(int        fd,		// I - File descriptor
+          off_t      offset,		// I - File offset or -1 for current position
+          const char *data,		// I - Data to write
+          size_t     bytes)		// I - Number of bytes
+{
+  ssize_t	written;		// Bytes written
+
+
+  while (bytes > 0)
+  {
+    if ((written = offset < 0 ? write(fd, data, bytes) : pwrite(fd, data, bytes, offset)) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+
+      return (false);
+    }
+
+    data  += written;
+    bytes -= (size_t)written;
+
+    if (offset >= 0)
+      offset += written;
+  }
+
+  return (true);
+}
+#endif // HAVE_LINUX_IO_URING_H
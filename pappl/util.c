@@ -17,6 +17,24 @@
 #endif // HAVE_SYS_RANDOM_H
 
 
+//
+// Local globals...
+//
+
+#ifdef DEBUG_LOCKS
+static __thread int	lock_counts[_PAPPL_LOCK_MAX];
+					// Locks held by this thread
+static const char * const lock_names[] =// Lock rank names
+{
+  "system",
+  "printer",
+  "printer device",
+  "printer jobs",
+  "job"
+};
+#endif // DEBUG_LOCKS
+
+
 //
 // Local functions...
 //
@@ -116,6 +134,87 @@ _papplGetRand(void)
 }
 
 
+//
+// '_papplGetTime()' - Return the current monotonic time in seconds.
+//
+// This function is used for measuring elapsed times and is not affected by
+// changes to the system clock.
+//
+
+double					// O - Time in seconds
+_papplGetTime(void)
+{
+  struct timespec	curtime;	// Current time
+
+
+  clock_gettime(CLOCK_MONOTONIC, &curtime);
+
+  return (curtime.tv_sec + 0.000000001 * curtime.tv_nsec);
+}
+
+
+#ifdef DEBUG_LOCKS
+//
+// '_papplLockAcquire()' - Check the lock order before acquiring a lock.
+//
+// Locks must be acquired in the order of their ranks, otherwise two threads
+// can deadlock.  Any violation is reported and the program aborted so that it
+// shows up in testing.  Holding more than one lock of the same rank is
+// allowed, and so is acquiring a lock of a rank that is already held even
+// when higher-ranked locks are also held - this happens when a callback that
+// is run with the printer and job list locks held calls back into the
+// printer's accessor functions.
+//
+
+void
+_papplLockAcquire(_pappl_lock_t rank,	// I - Lock rank
+                  const char    *file,	// I - Source file
+                  int           line)	// I - Source line
+{
+  _pappl_lock_t	held;			// Rank of held lock
+
+
+  if (lock_counts[rank] > 0)
+  {
+    // Already holding a lock of this rank, so the order was checked when it
+    // was acquired...
+    lock_counts[rank] ++;
+    return;
+  }
+
+  for (held = rank + 1; held < _PAPPL_LOCK_MAX; held ++)
+  {
+    if (lock_counts[held] > 0)
+    {
+      fprintf(stderr, "%s:%d: Acquiring %s lock while holding %s lock.\n", file, line, lock_names[rank], lock_names[held]);
+      abort();
+    }
+  }
+
+  lock_counts[rank] ++;
+}
+
+
+//
+// '_papplLockRelease()' - Record that a lock has been released.
+//
+
+void
+_papplLockRelease(_pappl_lock_t rank,	// I - Lock rank
+                  const char    *file,	// I - Source file
+                  int           line)	// I - Source line
+{
+  if (lock_counts[rank] <= 0)
+  {
+    fprintf(stderr, "%s:%d: Releasing %s lock that is not held.\n", file, line, lock_names[rank]);
+    abort();
+  }
+
+  lock_counts[rank] --;
+}
+#endif // DEBUG_LOCKS
+
+
 //
 // 'filter_cb()' - Filter printer attributes based on the requested array.
 //
@@ -0,0 +1,572 @@
+//
+// Job list unit test program for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage:
+//
+//   testjoblist
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl-private.h>
+
+
+//
+// Local functions...
+//
+
+static bool		check_order(_pappl_joblist_t *list, const int *ids, int num_ids);
+static void		free_jobs(_pappl_joblist_t *list);
+static pappl_job_t	*make_job(int job_id, ipp_jstate_t state);
+static bool		test_add(void);
+static bool		test_hash(void);
+static bool		test_index(void);
+static bool		test_move(void);
+static bool		test_oldest(void);
+static bool		test_rehash(void);
+
+
+//
+// 'main()' - Main entry for job list unit test program.
+//
+
+int					// O - Exit status
+main(void)
+{
+  bool	pass = true;			// Did all tests pass?
+
+
+  pass &= test_add();
+  pass &= test_index();
+  pass &= test_move();
+  pass &= test_hash();
+  pass &= test_rehash();
+  pass &= test_oldest();
+
+  puts(pass ? "\nPASSED" : "\nFAILED");
+
+  return (pass ? 0 : 1);
+}
+
+
+//
+// 'check_order()' - Check the order of jobs in a list in both directions.
+//
+
+static bool				// O - `true` if the order matches, `false` otherwise
+check_order(_pappl_joblist_t *list,	// I - Job list
+            const int        *ids,	// I - Expected job IDs, newest first
+            int              num_ids)	// I - Number of job IDs
+{
+  int		i;			// Looping var
+  pappl_job_t	*job;			// Current job
+
+
+  if (list->count != num_ids)
+  {
+    printf("FAIL (got %d jobs, expected %d)\n", list->count, num_ids);
+    return (false);
+  }
+
+  for (i = 0, job = list->first; i < num_ids && job; i ++, job = _papplJobListNext(list, job))
+  {
+    if (job->job_id != ids[i])
+    {
+      printf("FAIL (got job %d at position %d going forward, expected %d)\n", job->job_id, i, ids[i]);
+      return (false);
+    }
+  }
+
+  if (job || i < num_ids)
+  {
+    printf("FAIL (forward walk stopped at position %d of %d)\n", i, num_ids);
+    return (false);
+  }
+
+  for (i = num_ids - 1, job = list->last; i >= 0 && job; i --, job = _papplJobListPrev(list, job))
+  {
+    if (job->job_id != ids[i])
+    {
+      printf("FAIL (got job %d at position %d going backward, expected %d)\n", job->job_id, i, ids[i]);
+      return (false);
+    }
+  }
+
+  if (job || i >= 0)
+  {
+    printf("FAIL (backward walk stopped at position %d of %d)\n", i, num_ids);
+    return (false);
+  }
+
+  return (true);
+}
+
+
+//
+// 'free_jobs()' - Remove and free all jobs in a list of all jobs.
+//
+// The jobs are not real jobs, so `_papplJobListClear` can't be used to delete
+// them.
+//
+
+static void
+free_jobs(_pappl_joblist_t *list)	// I - Job list
+{
+  pappl_job_t	*job;			// Current job
+
+
+  while ((job = list->first) != NULL)
+  {
+    _papplJobListRemove(list, job);
+    free(job);
+  }
+
+  _papplJobListClear(list);
+}
+
+
+//
+// 'make_job()' - Make a fake job for the list functions.
+//
+
+static pappl_job_t *			// O - Job
+make_job(int          job_id,		// I - Job ID
+         ipp_jstate_t state)		// I - Job state
+{
+  pappl_job_t	*job;			// Job
+
+
+  if ((job = (pappl_job_t *)calloc(1, sizeof(pappl_job_t))) == NULL)
+  {
+    perror("testjoblist");
+    exit(1);
+  }
+
+  job->job_id = job_id;
+  job->state  = state;
+
+  return (job);
+}
+
+
+//
+// 'test_add()' - Test sorted inserts with out-of-order job IDs.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_add(void)
+{
+  bool			ret = false;	// Return value
+  _pappl_joblist_t	all;		// List of all jobs
+  int			i;		// Looping var
+  static const int	load[] = { 3, 1, 7, 5, 2, 6, 4 };
+					// Order from a state file
+  static const int	sorted[] = { 8, 7, 6, 5, 4, 3, 2, 1 };
+					// Sorted order
+
+
+  fputs("_papplJobListAdd (out-of-order): ", stdout);
+
+  _papplJobListInit(&all, true);
+
+  for (i = 0; i < (int)(sizeof(load) / sizeof(load[0])); i ++)
+    _papplJobListAdd(&all, make_job(load[i], IPP_JSTATE_PENDING));
+
+  // Then a new job, which goes at the front...
+  _papplJobListAdd(&all, make_job(8, IPP_JSTATE_PENDING));
+
+  if (!check_order(&all, sorted, (int)(sizeof(sorted) / sizeof(sorted[0]))))
+    goto done;
+
+  // Adding a job that is already in the list does nothing...
+  _papplJobListAdd(&all, all.first);
+
+  if (!check_order(&all, sorted, (int)(sizeof(sorted) / sizeof(sorted[0]))))
+    goto done;
+
+  for (i = 1; i <= 8; i ++)
+  {
+    pappl_job_t *job = _papplJobListFind(&all, i);
+					// Matching job
+
+    if (!job || job->job_id != i)
+    {
+      printf("FAIL (unable to find job %d)\n", i);
+      goto done;
+    }
+  }
+
+  if (_papplJobListFind(&all, 9))
+  {
+    puts("FAIL (found job 9, which was never added)");
+    goto done;
+  }
+
+  puts("PASS");
+  ret = true;
+
+  done:
+
+  free_jobs(&all);
+
+  return (ret);
+}
+
+
+//
+// 'test_hash()' - Test unlinking jobs from a shared hash bucket.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_hash(void)
+{
+  bool			ret = false;	// Return value
+  _pappl_joblist_t	all;		// List of all jobs
+  pappl_job_t		*jobs[4];	// Jobs in the same bucket
+  int			i;		// Looping var
+  static const int	remaining[] = { 129, 1 };
+					// Jobs left after removal
+
+
+  fputs("_papplJobListRemove (hash bucket): ", stdout);
+
+  _papplJobListInit(&all, true);
+
+  // Job IDs that differ by the number of buckets share a bucket...
+  for (i = 0; i < 4; i ++)
+    _papplJobListAdd(&all, jobs[i] = make_job(1 + i * (int)all.hashsize, IPP_JSTATE_PENDING));
+
+  if (all.hash[1] != jobs[3] || jobs[3]->hash_next != jobs[2] || jobs[2]->hash_next != jobs[1] || jobs[1]->hash_next != jobs[0] || jobs[0]->hash_next)
+  {
+    puts("FAIL (jobs are not chained in a single bucket)");
+    goto done;
+  }
+
+  // Remove from the middle and then the head of the chain...
+  _papplJobListRemove(&all, jobs[1]);
+  _papplJobListRemove(&all, jobs[3]);
+
+  if (jobs[1]->hash_next || jobs[3]->hash_next)
+  {
+    puts("FAIL (removed jobs are still chained)");
+    goto done;
+  }
+
+  if (_papplJobListFind(&all, jobs[1]->job_id) || _papplJobListFind(&all, jobs[3]->job_id))
+  {
+    puts("FAIL (removed jobs are still found)");
+    goto done;
+  }
+
+  if (all.hash[1] != jobs[2] || _papplJobListFind(&all, jobs[0]->job_id) != jobs[0] || _papplJobListFind(&all, jobs[2]->job_id) != jobs[2])
+  {
+    puts("FAIL (remaining jobs are not found)");
+    goto done;
+  }
+
+  if (!check_order(&all, remaining, (int)(sizeof(remaining) / sizeof(remaining[0]))))
+    goto done;
+
+  // Removing a job that is not in the list does nothing...
+  _papplJobListRemove(&all, jobs[1]);
+
+  if (!check_order(&all, remaining, (int)(sizeof(remaining) / sizeof(remaining[0]))))
+    goto done;
+
+  // Remove the tail of the chain...
+  _papplJobListRemove(&all, jobs[0]);
+
+  if (all.hash[1] != jobs[2] || jobs[2]->hash_next)
+  {
+    puts("FAIL (bucket not updated after removing the last job in the chain)");
+    goto done;
+  }
+
+  puts("PASS");
+  ret = true;
+
+  done:
+
+  for (i = 0; i < 4; i ++)
+  {
+    _papplJobListRemove(&all, jobs[i]);
+    free(jobs[i]);
+  }
+
+  free_jobs(&all);
+
+  return (ret);
+}
+
+
+//
+// 'test_index()' - Test getting the Nth job from both ends of a list.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_index(void)
+{
+  bool			ret = false;	// Return value
+  _pappl_joblist_t	all;		// List of all jobs
+  pappl_job_t		*job;		// Current job
+  int			i;		// Looping var
+
+
+  fputs("_papplJobListIndex: ", stdout);
+
+  _papplJobListInit(&all, true);
+
+  for (i = 1; i <= 9; i ++)
+    _papplJobListAdd(&all, make_job(i, IPP_JSTATE_PENDING));
+
+  // Indices in the first half walk forward from the newest job, the others
+  // walk backward from the oldest job...
+  for (i = 0; i < 9; i ++)
+  {
+    if ((job = _papplJobListIndex(&all, i)) == NULL || job->job_id != 9 - i)
+    {
+      printf("FAIL (got job %d at index %d, expected %d)\n", job ? job->job_id : 0, i, 9 - i);
+      goto done;
+    }
+  }
+
+  if (_papplJobListIndex(&all, -1) || _papplJobListIndex(&all, 9))
+  {
+    puts("FAIL (got a job for an out-of-range index)");
+    goto done;
+  }
+
+  puts("PASS");
+  ret = true;
+
+  done:
+
+  free_jobs(&all);
+
+  return (ret);
+}
+
+
+//
+// 'test_move()' - Test moving jobs between the active and completed lists.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_move(void)
+{
+  bool			ret = false;	// Return value
+  _pappl_joblist_t	all,		// List of all jobs
+			active,		// Active jobs
+			completed;	// Completed jobs
+  pappl_job_t		*job;		// Current job
+  int			i;		// Looping var
+  static const int	all_ids[] = { 5, 4, 3, 2, 1 };
+					// All jobs
+  static const int	active_ids[] = { 5, 2, 1 };
+					// Active jobs after the move
+  static const int	completed_ids[] = { 4, 3 };
+					// Completed jobs after the move
+
+
+  fputs("_papplJobListAdd (move): ", stdout);
+
+  _papplJobListInit(&all, true);
+  _papplJobListInit(&active, false);
+  _papplJobListInit(&completed, false);
+
+  for (i = 1; i <= 5; i ++)
+  {
+    job = make_job(i, IPP_JSTATE_PENDING);
+
+    _papplJobListAdd(&all, job);
+    _papplJobListAdd(&active, job);
+  }
+
+  // Complete jobs 3 and 4 without removing them from the active list first...
+  _papplJobListAdd(&completed, _papplJobListFind(&all, 3));
+  _papplJobListAdd(&completed, _papplJobListFind(&all, 4));
+
+  if (!check_order(&all, all_ids, (int)(sizeof(all_ids) / sizeof(all_ids[0]))))
+    goto done;
+
+  if (!check_order(&active, active_ids, (int)(sizeof(active_ids) / sizeof(active_ids[0]))))
+    goto done;
+
+  if (!check_order(&completed, completed_ids, (int)(sizeof(completed_ids) / sizeof(completed_ids[0]))))
+    goto done;
+
+  if (_papplJobListFind(&active, 3) || _papplJobListFind(&completed, 3) != _papplJobListFind(&all, 3))
+  {
+    puts("FAIL (job 3 is not only in the completed list)");
+    goto done;
+  }
+
+  puts("PASS");
+  ret = true;
+
+  done:
+
+  _papplJobListClear(&active);
+  _papplJobListClear(&completed);
+  free_jobs(&all);
+
+  return (ret);
+}
+
+
+//
+// 'test_oldest()' - Test that pending jobs are dispatched oldest first.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_oldest(void)
+{
+  bool			ret = false;	// Return value
+  _pappl_joblist_t	all,		// List of all jobs
+			active;		// Active jobs
+  pappl_job_t		*job;		// Current job
+  int			i;		// Looping var
+  static const ipp_jstate_t states[] =	// Initial job states
+  {
+    IPP_JSTATE_PROCESSING,		// Job 1
+    IPP_JSTATE_HELD,			// Job 2
+    IPP_JSTATE_PENDING,			// Job 3
+    IPP_JSTATE_PENDING,			// Job 4
+    IPP_JSTATE_PENDING			// Job 5
+  };
+
+
+  fputs("_papplJobListOldest: ", stdout);
+
+  _papplJobListInit(&all, true);
+  _papplJobListInit(&active, false);
+
+  // Add the jobs newest first, like the state file...
+  for (i = 5; i >= 1; i --)
+  {
+    job = make_job(i, states[i - 1]);
+
+    _papplJobListAdd(&all, job);
+    _papplJobListAdd(&active, job);
+  }
+
+  // The oldest pending job is started first, then the next oldest...
+  for (i = 3; i <= 5; i ++)
+  {
+    if ((job = _papplJobListOldest(&active, IPP_JSTATE_PENDING)) == NULL || job->job_id != i)
+    {
+      printf("FAIL (got job %d, expected %d)\n", job ? job->job_id : 0, i);
+      goto done;
+    }
+
+    job->state = IPP_JSTATE_PROCESSING;
+  }
+
+  if ((job = _papplJobListOldest(&active, IPP_JSTATE_PENDING)) != NULL)
+  {
+    printf("FAIL (got job %d, expected none)\n", job->job_id);
+    goto done;
+  }
+
+  // A released job that is older than the others is next...
+  _papplJobListFind(&all, 2)->state = IPP_JSTATE_PENDING;
+  _papplJobListAdd(&active, make_job(6, IPP_JSTATE_PENDING));
+  _papplJobListAdd(&all, active.first);
+
+  if ((job = _papplJobListOldest(&active, IPP_JSTATE_PENDING)) == NULL || job->job_id != 2)
+  {
+    printf("FAIL (got job %d, expected 2)\n", job ? job->job_id : 0);
+    goto done;
+  }
+
+  puts("PASS");
+  ret = true;
+
+  done:
+
+  _papplJobListClear(&active);
+  free_jobs(&all);
+
+  return (ret);
+}
+
+
+//
+// 'test_rehash()' - Test growing the job ID index.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_rehash(void)
+{
+  bool			ret = false;	// Return value
+  _pappl_joblist_t	all;		// List of all jobs
+  pappl_job_t		*job;		// Current job
+  size_t		hashsize;	// Initial number of hash buckets
+  int			i,		// Looping var
+			count;		// Number of jobs
+
+
+  fputs("_papplJobListAdd (rehash): ", stdout);
+
+  _papplJobListInit(&all, true);
+
+  hashsize = all.hashsize;
+  count    = (int)(4 * hashsize) + 1;
+
+  // Add jobs in a scattered order so the chains are not trivially sorted...
+  for (i = 0; i < count; i ++)
+    _papplJobListAdd(&all, make_job(1 + (i * 37) % count, IPP_JSTATE_PENDING));
+
+  if (all.hashsize != 4 * hashsize)
+  {
+    printf("FAIL (got %u hash buckets, expected %u)\n", (unsigned)all.hashsize, (unsigned)(4 * hashsize));
+    goto done;
+  }
+
+  for (i = 1; i <= count; i ++)
+  {
+    if ((job = _papplJobListFind(&all, i)) == NULL || job->job_id != i)
+    {
+      printf("FAIL (unable to find job %d after rehash)\n", i);
+      goto done;
+    }
+  }
+
+  // Every job must be in the bucket for its job ID...
+  for (i = 0; i < (int)all.hashsize; i ++)
+  {
+    for (job = all.hash[i]; job; job = job->hash_next)
+    {
+      if (((unsigned)job->job_id & (all.hashsize - 1)) != (unsigned)i)
+      {
+        printf("FAIL (job %d is in bucket %d)\n", job->job_id, i);
+        goto done;
+      }
+    }
+  }
+
+  for (i = 1, job = all.first; job; job = _papplJobListNext(&all, job), i ++)
+  {
+    if (job->job_id != count + 1 - i)
+    {
+      printf("FAIL (got job %d at position %d, expected %d)\n", job->job_id, i - 1, count + 1 - i);
+      goto done;
+    }
+  }
+
+  puts("PASS");
+  ret = true;
+
+  done:
+
+  free_jobs(&all);
+
+  return (ret);
+}
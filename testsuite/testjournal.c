@@ -0,0 +1,616 @@
+//
+// State journal unit test program for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage:
+//
+//   testjournal [DIRECTORY]
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl-private.h>
+#include "testpappl.h"
+#include <dirent.h>
+
+
+//
+// Local functions...
+//
+
+static pappl_job_t	*add_job(pappl_printer_t *printer);
+static void		complete_job(pappl_job_t *job, ipp_jstate_t state);
+static pappl_system_t	*create_system(const char *directory);
+static int		count_lines(const char *filename);
+static bool		test_compact(pappl_system_t *system, const char *filename, const char *journame);
+static bool		test_journal(pappl_system_t *system, const char *filename, const char *journame);
+static bool		test_replay(const char *directory, const char *filename, const char *journame);
+static bool		test_snapshot(const char *directory, const char *filename, int num_jobs, int impcompleted);
+
+
+//
+// 'main()' - Main entry for state journal unit test program.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  const char		*directory;	// Test directory
+  char			tempdir[1024],	// Temporary directory
+			filename[1024],	// State file
+			journame[1024];	// Journal file
+  pappl_system_t	*system;	// System
+  pappl_printer_t	*printer;	// Printer
+  int			i,		// Looping var
+			num_jobs;	// Number of jobs after compaction
+  bool			pass = true;	// Did all tests pass?
+
+
+  if (argc > 2)
+  {
+    puts("Usage: testjournal [DIRECTORY]");
+    return (1);
+  }
+  else if (argc == 2)
+  {
+    directory = argv[1];
+  }
+  else
+  {
+    // Use a temporary directory...
+    const char *tmpdir = getenv("TMPDIR");
+					// Temporary directory
+
+    snprintf(tempdir, sizeof(tempdir), "%s/testjournal.XXXXXX", tmpdir ? tmpdir : "/tmp");
+    if (!mkdtemp(tempdir))
+    {
+      perror(tempdir);
+      return (1);
+    }
+
+    directory = tempdir;
+  }
+
+  snprintf(filename, sizeof(filename), "%s/testjournal.state", directory);
+  snprintf(journame, sizeof(journame), "%s.journal", filename);
+
+  // Create a system with a printer and three completed jobs, then write the
+  // initial state file...
+  fputs("papplSystemSaveState (snapshot): ", stdout);
+
+  system  = create_system(directory);
+  printer = papplPrinterCreate(system, /* printer_id */0, "Journal Printer", "pwg_common-300dpi-srgb_8", "MFG:PWG;MDL:Journal Printer;", "file:///dev/null");
+
+  if (!printer)
+  {
+    puts("FAIL (unable to create printer)");
+    return (1);
+  }
+
+  for (i = 0; i < 3; i ++)
+    complete_job(add_job(printer), IPP_JSTATE_COMPLETED);
+
+  if (!papplSystemSaveState(system, filename))
+  {
+    puts("FAIL (unable to save state)");
+    pass = false;
+  }
+  else if (!access(journame, F_OK))
+  {
+    puts("FAIL (journal exists after snapshot)");
+    pass = false;
+  }
+  else
+  {
+    puts("PASS");
+  }
+
+  // Job changes are only journaled while the system is running, but running
+  // the system would also start the listeners and other threads...
+  system->is_running = true;
+
+  if (pass)
+    pass = test_journal(system, filename, journame);
+
+  system->is_running = false;
+
+  if (pass)
+    pass = test_replay(directory, filename, journame);
+
+  system->is_running = true;
+
+  if (pass)
+    pass = test_compact(system, filename, journame);
+
+  system->is_running = false;
+
+  num_jobs = printer->all_jobs.count;
+
+  if (pass)
+    pass = test_snapshot(directory, filename, num_jobs, printer->all_jobs.first ? printer->all_jobs.first->impcompleted : 0);
+
+  papplSystemDelete(system);
+
+  if (pass && directory == tempdir)
+  {
+    // Remove the state, journal, log, and spool files...
+    DIR			*dir;		// Directory
+    struct dirent	*dent;		// Directory entry
+    char		path[1024];	// File path
+
+    if ((dir = opendir(directory)) != NULL)
+    {
+      while ((dent = readdir(dir)) != NULL)
+      {
+        if (dent->d_name[0] == '.')
+          continue;
+
+        snprintf(path, sizeof(path), "%s/%s", directory, dent->d_name);
+        unlink(path);
+      }
+
+      closedir(dir);
+    }
+
+    rmdir(directory);
+  }
+  else if (!pass)
+  {
+    printf("Test files are in \"%s\".\n", directory);
+  }
+
+  puts(pass ? "\nPASSED" : "\nFAILED");
+
+  return (pass ? 0 : 1);
+}
+
+
+//
+// 'add_job()' - Add a new job to a printer.
+//
+
+static pappl_job_t *			// O - Job
+add_job(pappl_printer_t *printer)	// I - Printer
+{
+  pappl_job_t	*job;			// Job
+
+
+  if ((job = _papplJobCreate(printer, 0, "testjournal", "application/octet-stream", "Journal Job", NULL)) == NULL)
+  {
+    puts("FAIL (unable to create job)");
+    exit(1);
+  }
+
+  return (job);
+}
+
+
+//
+// 'complete_job()' - Move a job to the completed jobs list.
+//
+
+static void
+complete_job(pappl_job_t  *job,		// I - Job
+             ipp_jstate_t state)	// I - Final job state
+{
+  pappl_printer_t	*printer = job->printer;
+					// Printer
+
+
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplRWLockWrite(&job->rwlock, _PAPPL_LOCK_JOB);
+
+  job->state     = state;
+  job->completed = time(NULL);
+
+  _papplJobListAdd(&printer->completed_jobs, job);
+
+  _papplRWUnlock(&job->rwlock, _PAPPL_LOCK_JOB);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  _papplSystemJobChanged(job->system, job);
+}
+
+
+//
+// 'count_lines()' - Count the lines in a file.
+//
+
+static int				// O - Number of lines or -1 on error
+count_lines(const char *filename)	// I - File
+{
+  FILE	*fp;				// File
+  int	ch,				// Current character
+	count = 0;			// Number of lines
+
+
+  if ((fp = fopen(filename, "r")) == NULL)
+    return (-1);
+
+  while ((ch = getc(fp)) != EOF)
+  {
+    if (ch == '\n')
+      count ++;
+  }
+
+  fclose(fp);
+
+  return (count);
+}
+
+
+//
+// 'create_system()' - Create a system for the tests.
+//
+
+static pappl_system_t *			// O - System
+create_system(const char *directory)	// I - Spool directory
+{
+  pappl_system_t	*system;	// System
+  char			logfile[1024];	// Log file
+
+
+  snprintf(logfile, sizeof(logfile), "%s/testjournal.log", directory);
+
+  if ((system = papplSystemCreate(PAPPL_SOPTIONS_NONE, "Journal Test", 0, NULL, directory, logfile, PAPPL_LOGLEVEL_DEBUG, NULL, false)) == NULL)
+  {
+    puts("FAIL (unable to create system)");
+    exit(1);
+  }
+
+  papplSystemSetPrinterDrivers(system, (int)(sizeof(pwg_drivers) / sizeof(pwg_drivers[0])), pwg_drivers, pwg_autoadd, /* create_cb */NULL, pwg_callback, "testjournal");
+
+  return (system);
+}
+
+
+//
+// 'test_compact()' - Test that a long journal is compacted into a new state
+//                    file.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_compact(pappl_system_t *system,	// I - System
+             const char     *filename,	// I - State file
+             const char     *journame)	// I - Journal file
+{
+  pappl_printer_t	*printer = papplSystemFindPrinter(system, NULL, 1, NULL);
+					// Printer
+  pappl_job_t		*job;		// Current job
+  struct stat		before,		// State file before save
+			after;		// State file after save
+  int			i,		// Looping var
+			round;		// Current round of changes
+  size_t		journal_count;	// Number of journal records before save
+  bool			expect_snapshot;// Expect a new state file?
+
+
+  fputs("papplSystemSaveState (compaction): ", stdout);
+
+  // Add enough jobs that a few saves fill the journal...
+  for (i = 0; i < (_PAPPL_MAX_JOURNAL / 8); i ++)
+    complete_job(add_job(printer), IPP_JSTATE_COMPLETED);
+
+  for (round = 1; round <= 10; round ++)
+  {
+    // Change every job...
+    for (job = printer->all_jobs.first; job; job = _papplJobListNext(&printer->all_jobs, job))
+    {
+      job->impcompleted = round;
+      _papplSystemJobChanged(system, job);
+    }
+
+    journal_count   = system->journal_count;
+    expect_snapshot = (journal_count + (size_t)printer->all_jobs.count) > _PAPPL_MAX_JOURNAL;
+
+    if (stat(filename, &before))
+    {
+      printf("FAIL (unable to stat state file: %s)\n", strerror(errno));
+      return (false);
+    }
+
+    if (!papplSystemSaveState(system, filename))
+    {
+      printf("FAIL (unable to save state in round %d)\n", round);
+      return (false);
+    }
+
+    if (stat(filename, &after))
+    {
+      printf("FAIL (unable to stat state file: %s)\n", strerror(errno));
+      return (false);
+    }
+
+    if (expect_snapshot)
+    {
+      if (!access(journame, F_OK) || system->journal_count != 0)
+      {
+        printf("FAIL (journal not removed after %u records)\n", (unsigned)journal_count);
+        return (false);
+      }
+      else if (before.st_ino == after.st_ino)
+      {
+        printf("FAIL (state file not replaced after %u records)\n", (unsigned)journal_count);
+        return (false);
+      }
+
+      puts("PASS");
+      return (true);
+    }
+
+    if (before.st_ino != after.st_ino)
+    {
+      printf("FAIL (state file replaced after %u records)\n", (unsigned)journal_count);
+      return (false);
+    }
+    else if (system->journal_count != journal_count + (size_t)printer->all_jobs.count || count_lines(journame) != (int)system->journal_count)
+    {
+      printf("FAIL (got %d journal records, expected %u)\n", count_lines(journame), (unsigned)(journal_count + (size_t)printer->all_jobs.count));
+      return (false);
+    }
+  }
+
+  printf("FAIL (journal never compacted, %u records)\n", (unsigned)system->journal_count);
+
+  return (false);
+}
+
+
+//
+// 'test_journal()' - Test appending job changes to the journal.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_journal(pappl_system_t *system,	// I - System
+             const char     *filename,	// I - State file
+             const char     *journame)	// I - Journal file
+{
+  pappl_printer_t	*printer = papplSystemFindPrinter(system, NULL, 1, NULL);
+					// Printer
+  pappl_job_t		*job;		// Job
+  struct stat		before,		// State file before save
+			after;		// State file after save
+  int			lines;		// Number of journal records
+
+
+  fputs("papplSystemSaveState (journal): ", stdout);
+
+  if (stat(filename, &before))
+  {
+    printf("FAIL (unable to stat state file: %s)\n", strerror(errno));
+    return (false);
+  }
+
+  // Delete job 1...
+  job = papplPrinterFindJob(printer, 1);
+
+  _papplRWLockWrite(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+  _papplJobListRemove(&printer->completed_jobs, job);
+  _papplJobListRemove(&printer->all_jobs, job);
+  _papplRWUnlock(&printer->jobs_rwlock, _PAPPL_LOCK_PRINTER_JOBS);
+
+  _papplJobDelete(job);
+  _papplSystemJobDeleted(system, printer->printer_id, 1);
+
+  // Abort job 2...
+  job = papplPrinterFindJob(printer, 2);
+  job->impcompleted = 7;
+  complete_job(job, IPP_JSTATE_ABORTED);
+
+  // Add job 4...
+  complete_job(add_job(printer), IPP_JSTATE_CANCELED);
+
+  if (!papplSystemSaveState(system, filename))
+  {
+    puts("FAIL (unable to save state)");
+    return (false);
+  }
+
+  if (stat(filename, &after))
+  {
+    printf("FAIL (unable to stat state file: %s)\n", strerror(errno));
+    return (false);
+  }
+
+  if (before.st_ino != after.st_ino)
+  {
+    puts("FAIL (state file replaced for job changes)");
+    return (false);
+  }
+
+  if ((lines = count_lines(journame)) != 3 || system->journal_count != 3)
+  {
+    printf("FAIL (got %d journal records, expected 3)\n", lines);
+    return (false);
+  }
+
+  puts("PASS");
+
+  return (true);
+}
+
+
+//
+// 'test_replay()' - Test replaying the journal over an older state file.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_replay(const char *directory,	// I - Spool directory
+            const char *filename,	// I - State file
+            const char *journame)	// I - Journal file
+{
+  bool			ret = false;	// Return value
+  pappl_system_t	*system;	// System
+  pappl_printer_t	*printer;	// Printer
+  pappl_job_t		*job;		// Job
+  FILE			*fp;		// Journal file
+  struct stat		before,		// Journal before torn record
+			after;		// Journal after load
+  static const char	*torn = "Job printer=\"1\" id=\"5\" name=\"Torn";
+					// Torn journal record
+
+
+  fputs("papplSystemLoadState (journal replay): ", stdout);
+
+  // Simulate a crash while appending a record...
+  if (stat(journame, &before))
+  {
+    printf("FAIL (unable to stat journal: %s)\n", strerror(errno));
+    return (false);
+  }
+
+  if ((fp = fopen(journame, "a")) == NULL)
+  {
+    printf("FAIL (unable to open journal: %s)\n", strerror(errno));
+    return (false);
+  }
+
+  fputs(torn, fp);
+  fclose(fp);
+
+  // Load the state file and journal into a new system...
+  system = create_system(directory);
+
+  if (!papplSystemLoadState(system, filename))
+  {
+    puts("FAIL (unable to load state)");
+    goto done;
+  }
+
+  if ((printer = papplSystemFindPrinter(system, NULL, 1, NULL)) == NULL)
+  {
+    puts("FAIL (printer not loaded)");
+    goto done;
+  }
+
+  if (papplPrinterFindJob(printer, 1))
+  {
+    puts("FAIL (deleted job 1 restored from state file)");
+    goto done;
+  }
+
+  if ((job = papplPrinterFindJob(printer, 2)) == NULL || job->state != IPP_JSTATE_ABORTED || job->impcompleted != 7)
+  {
+    puts("FAIL (changes to job 2 not replayed)");
+    goto done;
+  }
+
+  if ((job = papplPrinterFindJob(printer, 3)) == NULL || job->state != IPP_JSTATE_COMPLETED)
+  {
+    puts("FAIL (job 3 not loaded from state file)");
+    goto done;
+  }
+
+  if ((job = papplPrinterFindJob(printer, 4)) == NULL || job->state != IPP_JSTATE_CANCELED)
+  {
+    puts("FAIL (new job 4 not replayed)");
+    goto done;
+  }
+
+  if (papplPrinterFindJob(printer, 5))
+  {
+    puts("FAIL (torn record for job 5 replayed)");
+    goto done;
+  }
+
+  if (printer->all_jobs.count != 3 || printer->completed_jobs.count != 3 || printer->active_jobs.count != 0)
+  {
+    printf("FAIL (got %d jobs, %d completed, %d active, expected 3, 3, 0)\n", printer->all_jobs.count, printer->completed_jobs.count, printer->active_jobs.count);
+    goto done;
+  }
+
+  if (printer->next_job_id != 5)
+  {
+    printf("FAIL (got next job ID %d, expected 5)\n", printer->next_job_id);
+    goto done;
+  }
+
+  // The torn record must be gone so the next record starts on its own line...
+  if (stat(journame, &after))
+  {
+    printf("FAIL (unable to stat journal: %s)\n", strerror(errno));
+    goto done;
+  }
+
+  if (after.st_size != before.st_size)
+  {
+    printf("FAIL (journal is %ld bytes after load, expected %ld)\n", (long)after.st_size, (long)before.st_size);
+    goto done;
+  }
+
+  puts("PASS");
+  ret = true;
+
+  done:
+
+  papplSystemDelete(system);
+
+  return (ret);
+}
+
+
+//
+// 'test_snapshot()' - Test loading a compacted state file.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_snapshot(const char *directory,	// I - Spool directory
+              const char *filename,	// I - State file
+              int        num_jobs,	// I - Expected number of jobs
+              int        impcompleted)	// I - Expected impressions for the newest job
+{
+  bool			ret = false;	// Return value
+  pappl_system_t	*system;	// System
+  pappl_printer_t	*printer;	// Printer
+
+
+  fputs("papplSystemLoadState (compacted): ", stdout);
+
+  system = create_system(directory);
+
+  if (!papplSystemLoadState(system, filename))
+  {
+    puts("FAIL (unable to load state)");
+    goto done;
+  }
+
+  if ((printer = papplSystemFindPrinter(system, NULL, 1, NULL)) == NULL)
+  {
+    puts("FAIL (printer not loaded)");
+    goto done;
+  }
+
+  if (printer->all_jobs.count != num_jobs)
+  {
+    printf("FAIL (got %d jobs, expected %d)\n", printer->all_jobs.count, num_jobs);
+    goto done;
+  }
+
+  if (papplPrinterFindJob(printer, 1) || !papplPrinterFindJob(printer, 2))
+  {
+    puts("FAIL (journaled job changes not in state file)");
+    goto done;
+  }
+
+  if (!printer->all_jobs.first || printer->all_jobs.first->impcompleted != impcompleted)
+  {
+    printf("FAIL (got %d impressions for newest job, expected %d)\n", printer->all_jobs.first ? printer->all_jobs.first->impcompleted : 0, impcompleted);
+    goto done;
+  }
+
+  puts("PASS");
+  ret = true;
+
+  done:
+
+  papplSystemDelete(system);
+
+  return (ret);
+}
@@ -14,6 +14,7 @@
 //
 //   --help               Show help
 //   --list[-TYPE]        List devices (dns-sd, local, network, usb)
+//   --trace TRACE-FILE   Record timing traces to the named file
 //   --version            Show version
 //   -1                   Single queue
 //   -A PAM-SERVICE       Enable authentication using PAM service
@@ -30,6 +31,7 @@
 // Tests:
 //
 //   all                  All of the following tests
+//   auth                 Authentication cache tests
 //   client               Simulated client tests
 //   jpeg                 JPEG image tests
 //   png                  PNG image tests
@@ -41,6 +43,7 @@
 //
 
 #include <pappl/base-private.h>
+#include <pappl/system-private.h>
 #include <cups/dir.h>
 #include "testpappl.h"
 #include <stdlib.h>
@@ -63,16 +66,21 @@ typedef struct _pappl_testdata_s	// Test data
 // Local functions...
 //
 
+static void	age_auth_cache(pappl_system_t *system, time_t secs);
+static bool	auth_cb(pappl_system_t *system, const char *username, const char *password, gid_t *groups, int *num_groups, int *count);
+static bool	check_auth(pappl_system_t *system, const char *username, const char *password, int status, int *count, int expected);
 static http_t	*connect_to_printer(pappl_system_t *system, char *uri, size_t urisize);
 static void	device_error_cb(const char *message, void *err_data);
 static bool	device_list_cb(const char *device_info, const char *device_uri, const char *device_id, void *data);
 static const char *make_raster_file(ipp_t *response, bool grayscale, char *tempname, size_t tempsize);
 static void	*run_tests(_pappl_testdata_t *testdata);
+static bool	test_auth(pappl_system_t *system);
 static bool	test_client(pappl_system_t *system);
 #if defined(HAVE_LIBJPEG) || defined(HAVE_LIBPNG)
 static bool	test_image_files(pappl_system_t *system, const char *prompt, const char *format, int num_files, const char * const *files);
 #endif // HAVE_LIBJPEG || HAVE_LIBPNG
 static bool	test_pwg_raster(pappl_system_t *system);
+static bool	test_tls(pappl_system_t *system);
 static int	usage(int status);
 
 
@@ -91,6 +99,7 @@ main(int  argc,				// I - Number of command-line arguments
 			*outdir = ".",	// Output directory
 			*log = NULL,	// Log file, if any
 			*auth = NULL,	// Auth service, if any
+			*trace = NULL,	// Trace file, if any
 			*model;		// Current printer model
   cups_array_t		*models;	// Printer models, if any
   int			port = 0;	// Port number, if any
@@ -156,6 +165,16 @@ main(int  argc,				// I - Number of command-line arguments
       papplDeviceList(PAPPL_DEVTYPE_USB, device_list_cb, NULL, device_error_cb, NULL);
       return (0);
     }
+    else if (!strcmp(argv[i], "--trace"))
+    {
+      i ++;
+      if (i >= argc)
+      {
+        puts("testpappl: Expected trace file after '--trace'.");
+        return (usage(1));
+      }
+      trace = argv[i];
+    }
     else if (!strcmp(argv[i], "--version"))
     {
       puts(PAPPL_VERSION);
@@ -276,6 +295,7 @@ main(int  argc,				// I - Number of command-line arguments
 
 	      if (!strcmp(argv[i], "all"))
 	      {
+		cupsArrayAdd(testdata.names, "auth");
 		cupsArrayAdd(testdata.names, "client");
 		cupsArrayAdd(testdata.names, "jpeg");
 		cupsArrayAdd(testdata.names, "png");
@@ -321,6 +341,9 @@ main(int  argc,				// I - Number of command-line arguments
   papplSystemSetSaveCallback(system, (pappl_save_cb_t)papplSystemSaveState, (void *)"testpappl.state");
   papplSystemSetVersions(system, (int)(sizeof(versions) / sizeof(versions[0])), versions);
 
+  if (trace && !papplSystemSetTraceFile(system, trace, 0))
+    return (1);
+
   httpAssembleURIf(HTTP_URI_CODING_ALL, device_uri, sizeof(device_uri), "file", NULL, NULL, 0, "%s?ext=pwg", realpath(outdir, outdirname));
 
   if (clean || !papplSystemLoadState(system, "testpappl.state"))
@@ -406,6 +429,102 @@ main(int  argc,				// I - Number of command-line arguments
 }
 
 
+//
+// 'age_auth_cache()' - Make the cached authentication results older.
+//
+
+static void
+age_auth_cache(pappl_system_t *system,	// I - System
+               time_t         secs)	// I - Seconds to subtract from expiration times
+{
+  int	i;				// Looping var
+
+
+  pthread_mutex_lock(&system->auth_mutex);
+
+  for (i = 0; i < _PAPPL_MAX_AUTHCACHE; i ++)
+  {
+    if (system->auth_cache[i].expire)
+      system->auth_cache[i].expire -= secs;
+  }
+
+  pthread_mutex_unlock(&system->auth_mutex);
+}
+
+
+//
+// 'auth_cb()' - Check a username and password for the authentication tests.
+//
+// The password "secret" is accepted for any username.
+//
+
+static bool				// O  - `true` if accepted, `false` otherwise
+auth_cb(pappl_system_t *system,		// I  - System
+        const char     *username,	// I  - Username
+        const char     *password,	// I  - Password
+        gid_t          *groups,		// O  - Groups for user
+        int            *num_groups,	// IO - Number of groups
+        int            *count)		// I  - Number of calls
+{
+  (void)system;
+  (void)username;
+
+  (*count) ++;
+
+  if (strcmp(password, "secret") || *num_groups < 2)
+    return (false);
+
+  groups[0]   = getgid();
+  groups[1]   = 4242;
+  *num_groups = 2;
+
+  return (true);
+}
+
+
+//
+// 'check_auth()' - Check an authentication result and the number of callbacks.
+//
+
+static bool				// O - `true` on success, `false` on failure
+check_auth(pappl_system_t *system,	// I - System
+           const char     *username,	// I - Username
+           const char     *password,	// I - Password
+           int            status,	// I - Expected status (1 = accepted, 0 = rejected)
+           int            *count,	// I - Number of callbacks
+           int            expected)	// I - Expected number of callbacks
+{
+  int	result;				// Authentication result
+  gid_t	groups[32];			// Groups for user
+  int	num_groups = (int)(sizeof(groups) / sizeof(groups[0]));
+					// Number of groups
+
+
+  if ((result = _papplSystemAuthenticate(system, NULL, username, password, groups, &num_groups)) != status)
+  {
+    printf("FAIL (got %d for '%s' with password '%s', expected %d)\n", result, username, password, status);
+    return (false);
+  }
+  else if (*count != expected)
+  {
+    printf("FAIL (%s for '%s' with password '%s')\n", *count > expected ? "cache miss" : "cache hit", username, password);
+    return (false);
+  }
+  else if (status == 1 && (num_groups != 2 || groups[0] != getgid() || groups[1] != 4242))
+  {
+    printf("FAIL (got %d groups for '%s', expected 2)\n", num_groups, username);
+    return (false);
+  }
+  else if (status == 0 && num_groups != 0)
+  {
+    printf("FAIL (got %d groups for rejected '%s', expected 0)\n", num_groups, username);
+    return (false);
+  }
+
+  return (true);
+}
+
+
 //
 // 'connect_to_printer()' - Connect to the system and return the printer URI.
 //
@@ -743,7 +862,14 @@ run_tests(_pappl_testdata_t *testdata)	// I - Testing data
     printf("%s: ", name);
     fflush(stdout);
 
-    if (!strcmp(name, "client"))
+    if (!strcmp(name, "auth"))
+    {
+      if (!test_auth(testdata->system))
+        ret = (void *)1;
+      else
+        puts("PASS");
+    }
+    else if (!strcmp(name, "client"))
     {
       if (!test_client(testdata->system))
         ret = (void *)1;
@@ -779,6 +905,11 @@ run_tests(_pappl_testdata_t *testdata)	// I - Testing data
       else
         puts("PASS");
     }
+    else if (!strcmp(name, "tls"))
+    {
+      if (!test_tls(testdata->system))
+        ret = (void *)1;
+    }
     else
     {
       puts("UNKNOWN TEST");
@@ -812,6 +943,92 @@ run_tests(_pappl_testdata_t *testdata)	// I - Testing data
 }
 
 
+//
+// 'test_auth()' - Test the authentication cache.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_auth(pappl_system_t *system)	// I - System
+{
+  bool			ret = false;	// Return value
+  int			i,		// Looping var
+			count = 0;	// Number of authentication callbacks
+  char			username[32],	// Username
+			group[256];	// Current group
+  pappl_printer_t	*printer;	// Printer
+
+
+  _papplSystemSetAuthCallback(system, (_pappl_auth_cb_t)auth_cb, &count);
+
+  // Accepted and rejected passwords are both cached...
+  if (!check_auth(system, "alice", "secret", 1, &count, 1) || !check_auth(system, "alice", "secret", 1, &count, 1))
+    goto done;
+
+  if (!check_auth(system, "alice", "wrong", 0, &count, 2) || !check_auth(system, "alice", "wrong", 0, &count, 2))
+    goto done;
+
+  if (!check_auth(system, "bob", "secret", 1, &count, 3))
+    goto done;
+
+  // Rejected passwords expire after 30 seconds, accepted ones after 5 minutes...
+  age_auth_cache(system, 31);
+
+  if (!check_auth(system, "alice", "secret", 1, &count, 3) || !check_auth(system, "alice", "wrong", 0, &count, 4))
+    goto done;
+
+  age_auth_cache(system, 300);
+
+  if (!check_auth(system, "alice", "secret", 1, &count, 5))
+    goto done;
+
+  // When the cache is full the entry that expires first is replaced...
+  _papplSystemClearAuthCache(system);
+
+  for (i = 0, count = 0; i <= _PAPPL_MAX_AUTHCACHE; i ++)
+  {
+    snprintf(username, sizeof(username), "user%d", i);
+
+    if (!check_auth(system, username, "secret", 1, &count, i + 1))
+      goto done;
+  }
+
+  if (!check_auth(system, username, "secret", 1, &count, _PAPPL_MAX_AUTHCACHE + 1) || !check_auth(system, "user1", "secret", 1, &count, _PAPPL_MAX_AUTHCACHE + 1) || !check_auth(system, "user0", "secret", 1, &count, _PAPPL_MAX_AUTHCACHE + 2))
+    goto done;
+
+  // Changing the admin or print groups clears the cache...
+  count = 0;
+
+  if (!check_auth(system, "alice", "secret", 1, &count, 1))
+    goto done;
+
+  papplSystemSetAdminGroup(system, papplSystemGetAdminGroup(system, group, sizeof(group)));
+
+  if (!check_auth(system, "alice", "secret", 1, &count, 2))
+    goto done;
+
+  papplSystemSetDefaultPrintGroup(system, papplSystemGetDefaultPrintGroup(system, group, sizeof(group)));
+
+  if (!check_auth(system, "alice", "secret", 1, &count, 3))
+    goto done;
+
+  if ((printer = papplSystemFindPrinter(system, "/ipp/print", 0, NULL)) != NULL)
+  {
+    papplPrinterSetPrintGroup(printer, papplPrinterGetPrintGroup(printer, group, sizeof(group)));
+
+    if (!check_auth(system, "alice", "secret", 1, &count, 4))
+      goto done;
+  }
+
+  ret = true;
+
+  done:
+
+  _papplSystemSetAuthCallback(system, NULL, NULL);
+
+  return (ret);
+}
+
+
 //
 // 'test_client()' - Run simulated client tests.
 //
@@ -823,7 +1040,8 @@ test_client(pappl_system_t *system)	// I - System
   char		uri[1024];		// "printer-uri" value
   ipp_t		*request,		// Request
 		*response;		// Response
-  int		i;			// Looping var
+  int		i,			// Looping var
+		subscription_id;	// "notify-subscription-id" value
   static const char * const pattrs[] =	// Printer attributes
   {
     "printer-contact-col",
@@ -848,6 +1066,12 @@ test_client(pappl_system_t *system)	// I - System
     "system-uuid",
     "system-xri-supported"
   };
+  static const ipp_op_t sops[] =	// Subscription operations
+  {
+    IPP_OP_GET_SUBSCRIPTION_ATTRIBUTES,
+    IPP_OP_RENEW_SUBSCRIPTION,
+    IPP_OP_CANCEL_SUBSCRIPTION
+  };
 
 
   // Connect to system...
@@ -985,6 +1209,147 @@ test_client(pappl_system_t *system)	// I - System
     ippDelete(response);
   }
 
+  // Test Create-Printer-Subscriptions on /ipp/print
+  fputs("\nclient: Create-Printer-Subscriptions ", stdout);
+
+  request = ippNewRequest(IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, "ipp://localhost/ipp/print");
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+  ippAddString(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD, "notify-events", NULL, "printer-state-changed");
+  ippAddString(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD, "notify-pull-method", NULL, "ippget");
+  ippAddInteger(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-duration", 60);
+
+  response = cupsDoRequest(http, request, "/ipp/print");
+
+  if (cupsLastError() != IPP_STATUS_OK)
+  {
+    printf("FAIL (%s)\n", cupsLastErrorString());
+    httpClose(http);
+    ippDelete(response);
+    return (false);
+  }
+  else if ((subscription_id = ippGetInteger(ippFindAttribute(response, "notify-subscription-id", IPP_TAG_INTEGER), 0)) <= 0)
+  {
+    puts("FAIL (Missing required 'notify-subscription-id' attribute in response)");
+    httpClose(http);
+    ippDelete(response);
+    return (false);
+  }
+
+  ippDelete(response);
+
+  // Test Get-Notifications on /ipp/print
+  fputs("\nclient: Get-Notifications ", stdout);
+
+  request = ippNewRequest(IPP_OP_GET_NOTIFICATIONS);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, "ipp://localhost/ipp/print");
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-ids", subscription_id);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-sequence-numbers", 1);
+  ippAddBoolean(request, IPP_TAG_OPERATION, "notify-wait", 0);
+
+  response = cupsDoRequest(http, request, "/ipp/print");
+
+  if (cupsLastError() != IPP_STATUS_OK)
+  {
+    printf("FAIL (%s)\n", cupsLastErrorString());
+    httpClose(http);
+    ippDelete(response);
+    return (false);
+  }
+  else if (!ippFindAttribute(response, "notify-get-interval", IPP_TAG_INTEGER))
+  {
+    puts("FAIL (Missing required 'notify-get-interval' attribute in response)");
+    httpClose(http);
+    ippDelete(response);
+    return (false);
+  }
+
+  ippDelete(response);
+
+  // Test Renew-Subscription on /ipp/print
+  fputs("\nclient: Renew-Subscription ", stdout);
+
+  request = ippNewRequest(IPP_OP_RENEW_SUBSCRIPTION);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, "ipp://localhost/ipp/print");
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id", subscription_id);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+  ippAddInteger(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-duration", 120);
+
+  response = cupsDoRequest(http, request, "/ipp/print");
+
+  if (cupsLastError() != IPP_STATUS_OK)
+  {
+    printf("FAIL (%s)\n", cupsLastErrorString());
+    httpClose(http);
+    ippDelete(response);
+    return (false);
+  }
+  else if (ippGetInteger(ippFindAttribute(response, "notify-lease-duration", IPP_TAG_INTEGER), 0) != 120)
+  {
+    puts("FAIL (Bad 'notify-lease-duration' attribute in response)");
+    httpClose(http);
+    ippDelete(response);
+    return (false);
+  }
+
+  ippDelete(response);
+
+  // Test that another user cannot get, renew, or cancel the subscription
+  for (i = 0; i < (int)(sizeof(sops) / sizeof(sops[0])); i ++)
+  {
+    printf("\nclient: %s=other-user ", ippOpString(sops[i]));
+
+    request = ippNewRequest(sops[i]);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, "ipp://localhost/ipp/print");
+    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id", subscription_id);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, "pappl-other-user");
+
+    response = cupsDoRequest(http, request, "/ipp/print");
+    ippDelete(response);
+
+    if (cupsLastError() != IPP_STATUS_ERROR_NOT_AUTHORIZED)
+    {
+      printf("FAIL (Got '%s', expected client-error-not-authorized)\n", ippErrorString(cupsLastError()));
+      httpClose(http);
+      return (false);
+    }
+  }
+
+  fputs("\nclient: Get-Notifications=other-user ", stdout);
+
+  request = ippNewRequest(IPP_OP_GET_NOTIFICATIONS);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, "ipp://localhost/ipp/print");
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, "pappl-other-user");
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-ids", subscription_id);
+
+  response = cupsDoRequest(http, request, "/ipp/print");
+  ippDelete(response);
+
+  if (cupsLastError() != IPP_STATUS_ERROR_NOT_AUTHORIZED)
+  {
+    printf("FAIL (Got '%s', expected client-error-not-authorized)\n", ippErrorString(cupsLastError()));
+    httpClose(http);
+    return (false);
+  }
+
+  // Test Cancel-Subscription on /ipp/print
+  fputs("\nclient: Cancel-Subscription ", stdout);
+
+  request = ippNewRequest(IPP_OP_CANCEL_SUBSCRIPTION);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, "ipp://localhost/ipp/print");
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id", subscription_id);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+
+  ippDelete(cupsDoRequest(http, request, "/ipp/print"));
+
+  if (cupsLastError() != IPP_STATUS_OK)
+  {
+    printf("FAIL (%s)\n", cupsLastErrorString());
+    httpClose(http);
+    return (false);
+  }
+
   httpClose(http);
 
   return (true);
@@ -1267,6 +1632,64 @@ test_pwg_raster(pappl_system_t *system)	// I - System
 }
 
 
+//
+// 'test_tls()' - Test repeated TLS connections to the system.
+//
+
+static bool				// O - `true` on success, `false` on failure
+test_tls(pappl_system_t *system)	// I - System
+{
+  http_t	*http;			// HTTP connection
+  char		uri[1024];		// "printer-uri" value
+  ipp_t		*request;		// Request
+  int		i;			// Looping var
+  size_t	count,			// Number of handshakes
+		failures;		// Number of failed handshakes
+  double	avg_secs,		// Average handshake time
+		max_secs;		// Maximum handshake time
+  static const int num_connects = 20;	// Number of connections
+
+
+  count = papplSystemGetTLSStats(system, NULL, NULL, NULL);
+
+  for (i = 0; i < num_connects; i ++)
+  {
+    // Connect, send a Get-Printer-Attributes request, and disconnect...
+    httpAssembleURI(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipps", NULL, "localhost", papplSystemGetPort(system), "/ipp/print");
+
+    if ((http = httpConnect2("localhost", papplSystemGetPort(system), NULL, AF_UNSPEC, HTTP_ENCRYPTION_ALWAYS, 1, 30000, NULL)) == NULL)
+    {
+      printf("FAIL (Unable to connect: %s)\n", cupsLastErrorString());
+      return (false);
+    }
+
+    request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, uri);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+    ippAddString(request, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "requested-attributes", NULL, "printer-state");
+
+    ippDelete(cupsDoRequest(http, request, "/ipp/print"));
+    httpClose(http);
+
+    if (cupsLastError() != IPP_STATUS_OK)
+    {
+      printf("FAIL (%s)\n", cupsLastErrorString());
+      return (false);
+    }
+  }
+
+  if ((count = papplSystemGetTLSStats(system, &failures, &avg_secs, &max_secs) - count) < (size_t)num_connects)
+  {
+    printf("FAIL (Got %lu TLS handshakes, expected %d)\n", (unsigned long)count, num_connects);
+    return (false);
+  }
+
+  printf("PASS (%lu handshakes, %lu failures, %.3fs average, %.3fs maximum)\n", (unsigned long)count, (unsigned long)failures, avg_secs, max_secs);
+
+  return (true);
+}
+
+
 //
 // 'usage()' - Show usage.
 //
@@ -1279,6 +1702,7 @@ usage(int status)			// I - Exit status
   puts("  --help               Show help");
   puts("  --list               List devices");
   puts("  --list-TYPE          Lists devices of TYPE (dns-sd, local, network, usb)");
+  puts("  --trace TRACE-FILE   Record timing traces to the named file");
   puts("  --version            Show version");
   puts("  -1                   Single queue");
   puts("  -A PAM-SERVICE       Enable authentication using PAM service");
@@ -1295,10 +1719,12 @@ usage(int status)			// I - Exit status
   puts("");
   puts("Tests:");
   puts("  all                  All of the following tests");
+  puts("  auth                 Authentication cache tests");
   puts("  client               Simulated client tests");
   puts("  jpeg                 JPEG image tests");
   puts("  png                  PNG image tests");
   puts("  pwg-raster           PWG Raster tests");
+  puts("  tls                  TLS reconnect tests (not included in 'all')");
 
   return (status);
 }
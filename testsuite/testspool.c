@@ -0,0 +1,300 @@
+//
+// Spool benchmark program for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage:
+//
+//   testspool [OPTIONS] [DIRECTORY]
+//
+// Options:
+//
+//   --help               Show help
+//   -b BYTES             Size of each write (default 32768)
+//   -n COUNT             Number of documents per pass (default 16)
+//   -p PASSES            Number of passes (default 3)
+//   -s MBYTES            Size of each document in megabytes (default 16)
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl-private.h>
+
+
+//
+// Local functions...
+//
+
+static double	get_seconds(void);
+static double	spool_documents(const char *directory, _pappl_uring_t *ring, const char *data, size_t blocksize, size_t docsize, int count);
+static int	usage(int status);
+
+
+//
+// 'main()' - Main entry for spool benchmark program.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  int			i;		// Looping var
+  const char		*directory = NULL;
+					// Spool directory
+  char			tempdir[1024];	// Temporary directory
+  size_t		blocksize = 32768,
+					// Size of each write
+			docsize = 16;	// Size of each document in megabytes
+  int			count = 16,	// Number of documents
+			passes = 3,	// Number of passes
+			pass;		// Current pass
+  char			*data;		// Print data
+  _pappl_uring_t	*ring;		// io_uring write queue
+  double		secs,		// Time for pass
+			best_write = 0.0,
+					// Best time with write()
+			best_uring = 0.0;
+					// Best time with io_uring
+  double		mbytes;		// Megabytes per pass
+
+
+  // Parse command-line...
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      return (usage(0));
+    }
+    else if (!strcmp(argv[i], "-b"))
+    {
+      i ++;
+      if (i >= argc || (blocksize = (size_t)strtol(argv[i], NULL, 10)) == 0)
+        return (usage(1));
+    }
+    else if (!strcmp(argv[i], "-n"))
+    {
+      i ++;
+      if (i >= argc || (count = atoi(argv[i])) <= 0)
+        return (usage(1));
+    }
+    else if (!strcmp(argv[i], "-p"))
+    {
+      i ++;
+      if (i >= argc || (passes = atoi(argv[i])) <= 0)
+        return (usage(1));
+    }
+    else if (!strcmp(argv[i], "-s"))
+    {
+      i ++;
+      if (i >= argc || (docsize = (size_t)strtol(argv[i], NULL, 10)) == 0)
+        return (usage(1));
+    }
+    else if (argv[i][0] == '-' || directory)
+    {
+      return (usage(1));
+    }
+    else
+    {
+      directory = argv[i];
+    }
+  }
+
+  if (!directory)
+  {
+    // Use a temporary spool directory...
+    const char *tmpdir = getenv("TMPDIR");
+					// Temporary directory
+
+    snprintf(tempdir, sizeof(tempdir), "%s/testspool.XXXXXX", tmpdir ? tmpdir : "/tmp");
+    if (!mkdtemp(tempdir))
+    {
+      perror(tempdir);
+      return (1);
+    }
+
+    directory = tempdir;
+  }
+
+  docsize *= 1024 * 1024;
+
+  if ((data = malloc(blocksize)) == NULL)
+  {
+    perror("testspool");
+    return (1);
+  }
+
+  for (i = 0; i < (int)blocksize; i ++)
+    data[i] = (char)(i * 7);
+
+  if ((ring = _papplUringCreate(true)) == NULL)
+    puts("io_uring is not available, only testing write().");
+
+  // Spool the documents, alternating between write() and io_uring...
+  mbytes = (double)docsize * count / 1048576.0;
+
+  printf("Spooling %d %.0fMB document(s) with %u byte writes to \"%s\".\n", count, (double)docsize / 1048576.0, (unsigned)blocksize, directory);
+
+  for (pass = 1; pass <= passes; pass ++)
+  {
+    if ((secs = spool_documents(directory, NULL, data, blocksize, docsize, count)) < 0.0)
+      return (1);
+
+    printf("Pass %d: write()   %8.1f MB/sec\n", pass, mbytes / secs);
+
+    if (best_write == 0.0 || secs < best_write)
+      best_write = secs;
+
+    if (!ring)
+      continue;
+
+    if ((secs = spool_documents(directory, ring, data, blocksize, docsize, count)) < 0.0)
+      return (1);
+
+    printf("Pass %d: io_uring  %8.1f MB/sec\n", pass, mbytes / secs);
+
+    if (best_uring == 0.0 || secs < best_uring)
+      best_uring = secs;
+  }
+
+  printf("Best:   write()   %8.1f MB/sec\n", mbytes / best_write);
+  if (ring)
+    printf("Best:   io_uring  %8.1f MB/sec (%+.0f%%)\n", mbytes / best_uring, 100.0 * (best_write / best_uring - 1.0));
+
+  _papplUringDelete(ring);
+  free(data);
+
+  if (directory == tempdir)
+    rmdir(tempdir);
+
+  return (0);
+}
+
+
+//
+// 'get_seconds()' - Get the current time in seconds.
+//
+
+static double				// O - Time in seconds
+get_seconds(void)
+{
+  struct timespec	curtime;	// Current time
+
+
+  clock_gettime(CLOCK_MONOTONIC, &curtime);
+
+  return ((double)curtime.tv_sec + 0.000000001 * curtime.tv_nsec);
+}
+
+
+//
+// 'spool_documents()' - Spool documents the way job creation does.
+//
+// Each document is written to a new file in the spool directory and closed,
+// like `_papplJobWriteSpool` and `_papplJobCloseSpool` do for a document that
+// is not kept in memory.
+//
+
+static double				// O - Elapsed time or -1.0 on error
+spool_documents(
+    const char     *directory,		// I - Spool directory
+    _pappl_uring_t *ring,		// I - io_uring write queue or `NULL` for write()
+    const char     *data,		// I - Print data
+    size_t         blocksize,		// I - Size of each write
+    size_t         docsize,		// I - Size of each document
+    int            count)		// I - Number of documents
+{
+  int		i;			// Looping var
+  char		filename[1024];		// Spool file
+  int		fd;			// Spool file descriptor
+  size_t	bytes,			// Bytes written to document
+		length;			// Length of this write
+  const char	*ptr;			// Pointer into data
+  ssize_t	written;		// Bytes written
+  double	start;			// Start time
+
+
+  start = get_seconds();
+
+  for (i = 0; i < count; i ++)
+  {
+    snprintf(filename, sizeof(filename), "%s/p00001j%09d-testspool.prn", directory, i + 1);
+
+    if ((fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_EXCL | O_CLOEXEC, 0600)) < 0)
+    {
+      perror(filename);
+      return (-1.0);
+    }
+
+    for (bytes = 0; bytes < docsize; bytes += length)
+    {
+      if ((length = docsize - bytes) > blocksize)
+        length = blocksize;
+
+      if (ring)
+      {
+        if (!_papplUringWrite(ring, fd, (off_t)bytes, data, length))
+        {
+          perror(filename);
+          return (-1.0);
+        }
+        continue;
+      }
+
+      for (ptr = data; ptr < (data + length); ptr += written)
+      {
+        if ((written = write(fd, ptr, length - (size_t)(ptr - data))) < 0)
+        {
+          if (errno == EINTR || errno == EAGAIN)
+          {
+            written = 0;
+            continue;
+          }
+
+          perror(filename);
+          return (-1.0);
+        }
+      }
+    }
+
+    if ((ring && !_papplUringFlush(ring)) || close(fd))
+    {
+      perror(filename);
+      return (-1.0);
+    }
+  }
+
+  start = get_seconds() - start;
+
+  // Remove the spool files...
+  for (i = 0; i < count; i ++)
+  {
+    snprintf(filename, sizeof(filename), "%s/p00001j%09d-testspool.prn", directory, i + 1);
+    unlink(filename);
+  }
+
+  return (start);
+}
+
+
+//
+// 'usage()' - Show program usage.
+//
+
+static int				// O - Exit status
+usage(int status)			// I - Exit status
+{
+  puts("Usage: testspool [OPTIONS] [DIRECTORY]");
+  puts("Options:");
+  puts("  --help               Show help");
+  puts("  -b BYTES             Size of each write (default 32768)");
+  puts("  -n COUNT             Number of documents per pass (default 16)");
+  puts("  -p PASSES            Number of passes (default 3)");
+  puts("  -s MBYTES            Size of each document in megabytes (default 16)");
+
+  return (status);
+}
@@ -0,0 +1,255 @@
+//
+// Trace report program for the Printer Application Framework
+//
+// Copyright © 2020 by Michael R Sweet.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage:
+//
+//   testtrace [OPTIONS] TRACE-FILE
+//
+// Options:
+//
+//   --help               Show help
+//   -o OPERATION         Only report on the named IPP operation
+//   -P PRINTER-ID        Only report on the specified printer
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl-private.h>
+#include <sys/mman.h>
+
+
+//
+// Local globals...
+//
+
+static const char * const stages[] =	// Trace stage names
+{
+  "accept",
+  "tls",
+  "http",
+  "ipp-read",
+  "ipp-op",
+  "response",
+  "job-wait",
+  "job-rip",
+  "device"
+};
+
+
+//
+// Local functions...
+//
+
+static int	compare_durations(const uint64_t *a, const uint64_t *b);
+static double	percentile(uint64_t *durations, size_t count, double pct);
+static int	usage(int status);
+
+
+//
+// 'main()' - Main entry for trace report program.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  int			i;		// Looping var
+  const char		*filename = NULL;
+					// Trace file
+  int			op = 0,		// IPP operation, if any
+			printer_id = 0;	// Printer ID, if any
+  int			fd;		// Trace file descriptor
+  struct stat		fileinfo;	// Trace file information
+  void			*data;		// Mapped trace file
+  _pappl_trhdr_t	*header;	// Trace file header
+  _pappl_trrec_t	*records,	// Trace records
+			*rec;		// Current record
+  uint32_t		r;		// Current record index
+  uint64_t		seq,		// Record sequence number
+			total;		// Total duration
+  uint64_t		*durations[_PAPPL_TSTAGE_MAX];
+					// Durations for each stage
+  size_t		counts[_PAPPL_TSTAGE_MAX];
+					// Number of durations for each stage
+  size_t		count;		// Number of durations
+
+
+  // Parse command-line options...
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      return (usage(0));
+    }
+    else if (!strcmp(argv[i], "-o"))
+    {
+      i ++;
+      if (i >= argc || (op = ippOpValue(argv[i])) <= 0)
+      {
+        puts("testtrace: Expected IPP operation name after '-o'.");
+        return (usage(1));
+      }
+    }
+    else if (!strcmp(argv[i], "-P"))
+    {
+      i ++;
+      if (i >= argc || (printer_id = atoi(argv[i])) <= 0)
+      {
+        puts("testtrace: Expected printer ID after '-P'.");
+        return (usage(1));
+      }
+    }
+    else if (argv[i][0] == '-' || filename)
+    {
+      printf("testtrace: Unknown option '%s'.\n", argv[i]);
+      return (usage(1));
+    }
+    else
+    {
+      filename = argv[i];
+    }
+  }
+
+  if (!filename)
+    return (usage(1));
+
+  // Map the trace file...
+  if ((fd = open(filename, O_RDONLY)) < 0)
+  {
+    perror(filename);
+    return (1);
+  }
+
+  if (fstat(fd, &fileinfo) || (size_t)fileinfo.st_size < sizeof(_pappl_trhdr_t))
+  {
+    printf("testtrace: '%s' is not a trace file.\n", filename);
+    close(fd);
+    return (1);
+  }
+
+  if ((data = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    perror(filename);
+    close(fd);
+    return (1);
+  }
+
+  close(fd);
+
+  header  = (_pappl_trhdr_t *)data;
+  records = (_pappl_trrec_t *)(header + 1);
+
+  if (memcmp(header->magic, _PAPPL_TRACE_MAGIC, sizeof(header->magic)) || header->record_size != sizeof(_pappl_trrec_t) || (size_t)fileinfo.st_size < (sizeof(_pappl_trhdr_t) + header->num_records * sizeof(_pappl_trrec_t)))
+  {
+    printf("testtrace: '%s' is not a supported trace file.\n", filename);
+    return (1);
+  }
+
+  // Collect the durations for each stage...
+  for (i = 0; i < _PAPPL_TSTAGE_MAX; i ++)
+  {
+    durations[i] = calloc(header->num_records, sizeof(uint64_t));
+    counts[i]    = 0;
+
+    if (!durations[i])
+    {
+      perror("testtrace");
+      return (1);
+    }
+  }
+
+  for (r = 0, rec = records; r < header->num_records; r ++, rec ++)
+  {
+    // Skip records that are unused or still being written...
+    if ((seq = atomic_load(&rec->seq)) == 0 || (seq - 1) % header->num_records != r)
+      continue;
+
+    if (rec->stage >= _PAPPL_TSTAGE_MAX || (op && rec->op != op) || (printer_id && rec->printer_id != printer_id))
+      continue;
+
+    durations[rec->stage][counts[rec->stage] ++] = rec->duration;
+  }
+
+  // Report the percentiles for each stage...
+  printf("%llu trace record(s) in '%s'.\n\n", (unsigned long long)atomic_load(&header->next), filename);
+  puts("Stage         Count    Mean(ms)     50%(ms)     90%(ms)     99%(ms)     Max(ms)");
+  puts("----------  -------  ----------  ----------  ----------  ----------  ----------");
+
+  for (i = 0; i < _PAPPL_TSTAGE_MAX; i ++)
+  {
+    if ((count = counts[i]) == 0)
+      continue;
+
+    qsort(durations[i], count, sizeof(uint64_t), (int (*)(const void *, const void *))compare_durations);
+
+    for (r = 0, total = 0; r < count; r ++)
+      total += durations[i][r];
+
+    printf("%-10s  %7u  %10.3f  %10.3f  %10.3f  %10.3f  %10.3f\n", stages[i], (unsigned)count, 0.000001 * total / count, percentile(durations[i], count, 0.5), percentile(durations[i], count, 0.9), percentile(durations[i], count, 0.99), 0.000001 * durations[i][count - 1]);
+  }
+
+  for (i = 0; i < _PAPPL_TSTAGE_MAX; i ++)
+    free(durations[i]);
+
+  munmap(data, (size_t)fileinfo.st_size);
+
+  return (0);
+}
+
+
+//
+// 'compare_durations()' - Compare two durations.
+//
+
+static int				// O - Result of comparison
+compare_durations(const uint64_t *a,	// I - First duration
+                  const uint64_t *b)	// I - Second duration
+{
+  if (*a < *b)
+    return (-1);
+  else if (*a > *b)
+    return (1);
+  else
+    return (0);
+}
+
+
+//
+// 'percentile()' - Get a percentile from sorted durations in milliseconds.
+//
+
+static double				// O - Percentile value in milliseconds
+percentile(uint64_t *durations,		// I - Sorted durations
+           size_t   count,		// I - Number of durations
+           double   pct)		// I - Percentile (0.0 to 1.0)
+{
+  size_t	index = (size_t)(pct * (count - 1) + 0.5);
+					// Index of percentile
+
+
+  return (0.000001 * durations[index]);
+}
+
+
+//
+// 'usage()' - Show usage.
+//
+
+static int				// O - Exit status
+usage(int status)			// I - Exit status
+{
+  puts("Usage: testtrace [OPTIONS] TRACE-FILE");
+  puts("Options:");
+  puts("  --help               Show help");
+  puts("  -o OPERATION         Only report on the named IPP operation");
+  puts("  -P PRINTER-ID        Only report on the specified printer");
+
+  return (status);
+}